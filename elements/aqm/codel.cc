@@ -91,11 +91,7 @@ CoDel::initialize(ErrorHandler *errh)
 	_queue1 = _queues[0];
 
     _total_drops = 0;
-    _state_drops = 0;
-    _dropping = false;
-
-    _first_above_time = Timestamp();
-    _drop_next = Timestamp();
+    _state.reset();
 
     return 0;
 }
@@ -121,126 +117,93 @@ CoDel::handle_drop(Packet *p)
     _total_drops++;
 }
 
-// delegate to the codel handler on a pull-request which can then generate (or not) the packet //
-Packet *
-CoDel::pull(int)
+bool
+CoDelState::should_drop(const Timestamp &enqueued, const Timestamp &now,
+			const Timestamp &target, const Timestamp &interval)
 {
-    return delegate_codel();
-}
+    bool ok_to_drop = false;
+    int after_drop = _after_drop;
+    _after_drop = AFTER_NONE;
 
-// helper: pull a packet, and tracks if the sojourn time of the packet is above the target //
-Packet *
-CoDel::dequeue_and_track_sojourn_time(Timestamp now, bool &retVal)
-{
-    _ok_to_drop = 0;
-    Packet *p = input(0).pull();
-
-    if (p == NULL) {
-        // if no packet then reset _first_above_time
-        _first_above_time.assign(0, 0);
-        retVal = false;
-        return NULL;
-    } else if (!FIRST_TIMESTAMP_ANNO(p).sec()) {
-        // if FIRST_TIMESTAMP_ANNO not set, then do nothing; imp else CoDel would misbehave!
-        retVal = false;
-        return p;
-    } else {
-        Timestamp sojourn_time = now - FIRST_TIMESTAMP_ANNO(p);
+    // track if the sojourn time of the packet is above the target
+    bool valid = enqueued.sec() != 0;
+    if (valid) {
+        Timestamp sojourn_time = now - enqueued;
 
 #if CODEL_DEBUG
-        click_chatter("[%d] [%s] sojourn_time: %s pkt_ts: %s target: %s", EXTRA_PACKETS_ANNO(p), now.unparse().c_str(), sojourn_time.unparse().c_str(), FIRST_TIMESTAMP_ANNO(p).unparse().c_str(), _codel_target_ts.unparse().c_str());
+        click_chatter("[%s] sojourn_time: %s pkt_ts: %s target: %s", now.unparse().c_str(), sojourn_time.unparse().c_str(), enqueued.unparse().c_str(), target.unparse().c_str());
 #endif
 
-        if (sojourn_time < _codel_target_ts) {
+        if (sojourn_time < target) {
             // sojourn_time not high enough, reset again
             _first_above_time.assign(0, 0);
-        } else {
-            // check if the packet needs to be dropped
-            if (_first_above_time == Timestamp::make_msec(0, 0)) {
-                // first time above sojourn time, then check again later
-                _first_above_time = now + _codel_interval_ts;
-            } else if (now >= _first_above_time) {
-                // mark to drop it
-                _ok_to_drop = 1;
-            }
+        } else if (_first_above_time == Timestamp::make_msec(0, 0)) {
+            // first time above sojourn time, then check again later
+            _first_above_time = now + interval;
+        } else if (now >= _first_above_time) {
+            // mark to drop it
+            ok_to_drop = true;
         }
     }
-    retVal = true;
-    return p;
-}
 
-// heavy-lifter - calls dequeue_and_track_sojourn_time and drops packets, if required //
-Packet*
-CoDel::delegate_codel()
-{
-    Packet *p = NULL;
-    bool ret_val = false;
-    Timestamp now = Timestamp::now();
-
-    p = dequeue_and_track_sojourn_time(now, ret_val);
+    // the packet dequeued after entering the dropping state is kept
+    if (after_drop == AFTER_ENTER)
+        return false;
 
-    // ret_val can be false in two cases:
-    //  1. no packet in the queue to pull from
-    //  2. FIRST_TIMESTAMP_ANNO not set in the packet - so 'sojourn_time' cannot be calculated'
-    //  In either case, just return and do nothing
-
-    if (!ret_val) {
+    // without FIRST_TIMESTAMP_ANNO the sojourn time cannot be calculated,
+    // do nothing; imp else CoDel would misbehave!
+    if (!valid) {
         _dropping = false;
-        return p;
+        return false;
     }
 
     // already in the dropping state
     if (_dropping) {
         // is it time to leave the dropping state?
-        if (!_ok_to_drop) {
+        if (!ok_to_drop) {
             _dropping = false;
-        } else if (now >= _drop_next) {
-            // drop the current packet and dequeue the next
-            while ((now >= _drop_next) && _dropping) {
-                assert(now >= _drop_next);
-                handle_drop(p);
+            return false;
+        }
+        // next packet of the dropping loop
+        if (after_drop == AFTER_LOOP)
+            _drop_next = control_law(_drop_next, interval, _state_drops);
+        if (now >= _drop_next) {
 #if CODEL_DEBUG
-                click_chatter("total_drops: %d, now: %s, drop_next: %s\n", _total_drops, now.unparse().c_str(), _drop_next.unparse().c_str());
+            click_chatter("state_drops: %d, now: %s, drop_next: %s\n", _state_drops, now.unparse().c_str(), _drop_next.unparse().c_str());
 #endif
-                ++_state_drops;
-                p = dequeue_and_track_sojourn_time(now, ret_val);
-
-                if (!_ok_to_drop) {
-                    _dropping = false;
-                } else {
-                    _drop_next = control_law(_drop_next);
-                }
-            }
+            ++_state_drops;
+            _after_drop = AFTER_LOOP;
+            return true;
         }
-    } else if (_ok_to_drop && ((now - _drop_next < _codel_interval_ts) || (now - _first_above_time >= _codel_interval_ts))) {
+    } else if (ok_to_drop && ((now - _drop_next < interval) || (now - _first_above_time >= interval))) {
 
         // not in the dropping state - want to enter? then check:
         // 1. been in the 'dropping' state recently, or
         // 2. first_above_time been above 'interval'
 
-        // drop the packet, dequeue next packet and enter dropping state
-        handle_drop(p);
-        p = dequeue_and_track_sojourn_time(now, ret_val);
+        // drop the packet and enter dropping state
         _dropping = true;
 
-        if (now - _drop_next < _codel_interval_ts) {
+        if (now - _drop_next < interval) {
             _state_drops = (_state_drops > 2) ? (_state_drops - 2) : 1;
         } else {
             _state_drops = 1;
         }
-        _drop_next = control_law(now);
+        _drop_next = control_law(now, interval, _state_drops);
+        _after_drop = AFTER_ENTER;
+        return true;
     }
-    return p;
+    return false;
 }
 
 // determines the next drop time of the packet - scaling done to allow usage of int_sqrt to minimize floating point arithmetic, etc. //
 Timestamp
-CoDel::control_law(Timestamp t)
+CoDelState::control_law(Timestamp t, const Timestamp &interval, uint32_t drops)
 {
     uint32_t scale_factor = 1 << 4;
     uint32_t scale_factor_squared = scale_factor * scale_factor;
-    uint32_t scaled_codel_interval = _codel_interval_ts.msecval() * scale_factor;
-    uint32_t scaled_state_drops = _state_drops * scale_factor_squared;
+    uint32_t scaled_codel_interval = interval.msecval() * scale_factor;
+    uint32_t scaled_state_drops = drops * scale_factor_squared;
 
     uint32_t val_click_ns = int_divide(scaled_codel_interval * Timestamp::nsec_per_msec, int_sqrt(scaled_state_drops));
 
@@ -251,6 +214,61 @@ CoDel::control_law(Timestamp t)
     return (t + val_click_ts);
 }
 
+inline bool
+CoDel::should_drop(Packet *p, const Timestamp &now)
+{
+    return _state.should_drop(FIRST_TIMESTAMP_ANNO(p), now, _codel_target_ts, _codel_interval_ts);
+}
+
+// pull packets until one is not dropped, or the queue is empty //
+Packet *
+CoDel::pull(int)
+{
+    Timestamp now = Timestamp::now();
+    while (Packet *p = input(0).pull()) {
+        if (!should_drop(p, now))
+            return p;
+        handle_drop(p);
+    }
+    _state.empty();
+    return 0;
+}
+
+#if HAVE_BATCH
+// pull a batch, and pull again to replace the packets that were dropped //
+PacketBatch *
+CoDel::pull_batch(int, unsigned max)
+{
+    Timestamp now = Timestamp::now();
+    PacketBatch *head = 0;
+    unsigned want = max;
+    while (want > 0) {
+        PacketBatch *batch = input_pull_batch(0, want);
+        if (!batch) {
+            _state.empty();
+            break;
+        }
+        unsigned count = batch->count();
+        auto fnt = [this, &now](Packet *p) -> Packet * {
+            return should_drop(p, now) ? 0 : p;
+        };
+        auto on_drop = [this](Packet *p) { handle_drop(p); };
+        EXECUTE_FOR_EACH_PACKET_DROPPABLE(fnt, batch, on_drop);
+        if (batch) {
+            unsigned kept = batch->count();
+            want -= kept;
+            if (head)
+                head->append_batch(batch);
+            else
+                head = batch;
+            if (kept == count)
+                break;
+        }
+    }
+    return head;
+}
+#endif
+
 // HANDLERS
 
 String
@@ -1,11 +1,55 @@
 #ifndef CLICK_CODEL_HH
 #define CLICK_CODEL_HH
-#include <click/element.hh>
+#include <click/batchelement.hh>
 #include <click/ewma.hh>
 #include <click/timestamp.hh>
 CLICK_DECLS
 class Storage;
 
+/* CoDel control state of one queue. Packets are passed to should_drop() in
+ * dequeue order; a dropped packet is always followed by the next packet of
+ * the same queue, as in the dropping loop of the pseudocode, until empty()
+ * reports that the queue is empty. Used by CoDel and FQCoDel. */
+class CoDelState { public:
+
+    CoDelState() {
+	reset();
+    }
+
+    void reset() {
+	_first_above_time = Timestamp();
+	_drop_next = Timestamp();
+	_state_drops = 0;
+	_dropping = false;
+	_after_drop = AFTER_NONE;
+    }
+
+    /* Returns true if the packet enqueued at ENQUEUED and dequeued at NOW
+     * must be dropped. An ENQUEUED of zero seconds means unknown. */
+    bool should_drop(const Timestamp &enqueued, const Timestamp &now,
+		     const Timestamp &target, const Timestamp &interval);
+
+    /* Called when the queue was found empty. */
+    void empty() {
+	_first_above_time.assign(0, 0);
+	_dropping = false;
+	_after_drop = AFTER_NONE;
+    }
+
+    bool dropping() const			{ return _dropping; }
+
+    static Timestamp control_law(Timestamp t, const Timestamp &interval, uint32_t drops);
+
+  private:
+
+    Timestamp _first_above_time, _drop_next;
+    uint32_t _state_drops;
+    bool _dropping;
+    enum { AFTER_NONE, AFTER_ENTER, AFTER_LOOP };
+    uint8_t _after_drop;
+
+};
+
 /*
 =c
 
@@ -30,7 +74,10 @@ this annotation with the sojourn time experienced by the corresponding
 packet for (possible) statistical use thereafter.
 
 By default, the Queues are found with flow-based router context and only the
-upstream queues are searched. CoDel is a pull element.
+upstream queues are searched. CoDel is a pull element. Batches are pulled
+from the queue at once and the sojourn time of all their packets is computed
+against a single clock reading; packets dropped from a batch are replaced by
+pulling again.
 
 Arguments are:
 
@@ -78,14 +125,14 @@ Returns the number of packets dropped so far.
 
 Returns some human-readable statistics.
 
-=a Queue, SetTimestamp
+=a Queue, SetTimestamp, FQCoDel
 
 Kathleen Nichols and Van Jacobson. I<Controlling Queue Delay>.
 ACM Queue, 2012, vol.10, no.5. L<http://queue.acm.org/detail.cfm?id=2209336>
 
 Appendix: CoDel Pseudocode. L<http://queue.acm.org/appendices/codel.html>. */
 
-class CoDel : public Element { public:
+class CoDel : public BatchElement { public:
 
     CoDel() CLICK_COLD;
     ~CoDel() CLICK_COLD;
@@ -105,6 +152,9 @@ class CoDel : public Element { public:
 
     void handle_drop(Packet *);
     Packet *pull(int port);
+#if HAVE_BATCH
+    PacketBatch *pull_batch(int port, unsigned max);
+#endif
 
   protected:
 
@@ -112,17 +162,12 @@ class CoDel : public Element { public:
     Vector<Storage *> _queues;
 
     int _total_drops;
-    int _state_drops;
-    Timestamp _first_above_time, _drop_next;
-    bool _dropping;
-    bool _ok_to_drop;
+    CoDelState _state;
 
     Timestamp _codel_interval_ts, _codel_target_ts;
     Vector<Element *> _queue_elements;
 
-    Packet * delegate_codel();
-    Timestamp control_law(Timestamp);
-    Packet * dequeue_and_track_sojourn_time(Timestamp, bool &);
+    inline bool should_drop(Packet *p, const Timestamp &now);
     static String read_handler(Element *, void *) CLICK_COLD;
     int finish_configure(const String &queues, ErrorHandler *errh);
 };
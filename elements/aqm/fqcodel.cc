@@ -0,0 +1,311 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * fqcodel.{cc,hh} -- element implements the FQ-CoDel packet scheduler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "fqcodel.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+FQCoDel::FQCoDel()
+{
+}
+
+FQCoDel::~FQCoDel()
+{
+}
+
+void *
+FQCoDel::cast(const char *n)
+{
+    if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return BatchElement::cast(n);
+}
+
+int
+FQCoDel::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _nflows = 1024;
+    _limit = 10240;
+    _quantum = 1514;
+    _target = Timestamp::make_msec(0, 5);
+    _interval = Timestamp::make_msec(0, 100);
+
+    if (Args(conf, this, errh)
+	.read("FLOWS", _nflows)
+	.read("LIMIT", _limit)
+	.read("QUANTUM", _quantum)
+	.read("TARGET", _target)
+	.read("INTERVAL", _interval)
+	.complete() < 0)
+	return -1;
+    if (_nflows == 0 || _nflows > 65536)
+	return errh->error("FLOWS must be between 1 and 65536");
+    if (_limit == 0)
+	return errh->error("LIMIT must be positive");
+    if (_quantum <= 0)
+	return errh->error("QUANTUM must be positive");
+
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    return 0;
+}
+
+int
+FQCoDel::initialize(ErrorHandler *)
+{
+    _flows.resize(_nflows);
+    _perturbation = click_random();
+    _count = 0;
+    _drops = 0;
+    _overlimit_drops = 0;
+    return 0;
+}
+
+void
+FQCoDel::cleanup(CleanupStage)
+{
+    for (int i = 0; i < _flows.size(); i++)
+	while (Packet *p = _flows[i].pop())
+	    p->kill();
+}
+
+inline Packet *
+FQCoDel::Flow::pop()
+{
+    Packet *p = head;
+    if (p) {
+	head = p->next();
+	if (!head)
+	    tail = 0;
+	p->set_next(0);
+	count--;
+	bytes -= p->length();
+    }
+    return p;
+}
+
+inline void
+FQCoDel::list_push(FlowList &l, int fi)
+{
+    _flows[fi].next = -1;
+    if (l.tail >= 0)
+	_flows[l.tail].next = fi;
+    else
+	l.head = fi;
+    l.tail = fi;
+}
+
+inline int
+FQCoDel::list_pop(FlowList &l)
+{
+    int fi = l.head;
+    l.head = _flows[fi].next;
+    if (l.head < 0)
+	l.tail = -1;
+    return fi;
+}
+
+inline unsigned
+FQCoDel::flow_of(Packet *p) const
+{
+    if (!p->has_network_header() || p->network_length() < (int) sizeof(click_ip))
+	return 0;
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_v != 4)
+	return 0;
+    uint32_t h = _perturbation ^ iph->ip_src.s_addr;
+    h = (h * 0x9E3779B1U) ^ iph->ip_dst.s_addr;
+    h = (h * 0x9E3779B1U) ^ iph->ip_p;
+    // fragments of a datagram go to the same queue
+    const uint8_t *th = p->network_header() + (iph->ip_hl << 2);
+    if ((iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP)
+	&& !IP_ISFRAG(iph) && th + 4 <= p->end_data())
+	h = (h * 0x9E3779B1U) ^ *reinterpret_cast<const uint32_t *>(th);
+    h *= 0x9E3779B1U;
+    h ^= h >> 16;
+    return ((uint64_t) h * _nflows) >> 32;
+}
+
+inline void
+FQCoDel::enqueue(Packet *p, const Timestamp &now)
+{
+    int fi = flow_of(p);
+    Flow &f = _flows[fi];
+    SET_FIRST_TIMESTAMP_ANNO(p, now);
+    p->set_next(0);
+    if (f.tail)
+	f.tail->set_next(p);
+    else
+	f.head = p;
+    f.tail = p;
+    f.count++;
+    f.bytes += p->length();
+    _count++;
+    if (!f.active) {
+	f.active = true;
+	f.deficit = _quantum;
+	list_push(_new_flows, fi);
+    }
+}
+
+/* Drops packets from the head of the queue holding the most bytes, until it
+ * is halved, while there are more than LIMIT packets. */
+void
+FQCoDel::drop_overlimit()
+{
+    while (_count > _limit) {
+	int fat = 0;
+	for (unsigned i = 1; i < _nflows; i++)
+	    if (_flows[i].bytes > _flows[fat].bytes)
+		fat = i;
+	Flow &f = _flows[fat];
+	uint32_t threshold = f.bytes / 2;
+	while (f.head && (f.bytes > threshold || _count > _limit)) {
+	    f.pop()->kill();
+	    _count--;
+	    _drops++;
+	    _overlimit_drops++;
+	}
+    }
+}
+
+inline Packet *
+FQCoDel::codel_dequeue(Flow &f, const Timestamp &now)
+{
+    while (Packet *p = f.pop()) {
+	_count--;
+	if (!f.codel.should_drop(FIRST_TIMESTAMP_ANNO(p), now, _target, _interval))
+	    return p;
+	p->kill();
+	_drops++;
+    }
+    f.codel.empty();
+    return 0;
+}
+
+inline Packet *
+FQCoDel::dequeue(const Timestamp &now)
+{
+    while (true) {
+	FlowList *l = _new_flows.head >= 0 ? &_new_flows : &_old_flows;
+	if (l->head < 0)
+	    return 0;
+	int fi = l->head;
+	Flow &f = _flows[fi];
+	if (f.deficit <= 0) {
+	    f.deficit += _quantum;
+	    list_pop(*l);
+	    list_push(_old_flows, fi);
+	    continue;
+	}
+	if (Packet *p = codel_dequeue(f, now)) {
+	    f.deficit -= p->length();
+	    return p;
+	}
+	// an emptied new queue goes through the old list once, so that a
+	// flow cannot stay in the new list by sending one packet at a time
+	list_pop(*l);
+	if (l == &_new_flows && _old_flows.head >= 0)
+	    list_push(_old_flows, fi);
+	else
+	    f.active = false;
+    }
+}
+
+void
+FQCoDel::push(int, Packet *p)
+{
+    enqueue(p, Timestamp::now());
+    if (_count > _limit)
+	drop_overlimit();
+    _empty_note.wake();
+}
+
+Packet *
+FQCoDel::pull(int)
+{
+    Packet *p = dequeue(Timestamp::now());
+    if (!p)
+	_empty_note.sleep();
+    return p;
+}
+
+#if HAVE_BATCH
+void
+FQCoDel::push_batch(int, PacketBatch *batch)
+{
+    Timestamp now = Timestamp::now();
+    FOR_EACH_PACKET_SAFE(batch, p) {
+	enqueue(p, now);
+    }
+    if (_count > _limit)
+	drop_overlimit();
+    _empty_note.wake();
+}
+
+PacketBatch *
+FQCoDel::pull_batch(int, unsigned max)
+{
+    Timestamp now = Timestamp::now();
+    PacketBatch *batch;
+    MAKE_BATCH(dequeue(now), batch, max);
+    if (!batch)
+	_empty_note.sleep();
+    return batch;
+}
+#endif
+
+enum { h_length, h_flows, h_drops, h_overlimit_drops, h_capacity };
+
+String
+FQCoDel::read_handler(Element *e, void *thunk)
+{
+    FQCoDel *fq = static_cast<FQCoDel *>(e);
+    switch ((intptr_t) thunk) {
+    case h_length:
+	return String(fq->_count);
+    case h_flows: {
+	int n = 0;
+	for (int i = 0; i < fq->_flows.size(); i++)
+	    n += fq->_flows[i].count != 0;
+	return String(n);
+    }
+    case h_drops:
+	return String(fq->_drops);
+    case h_overlimit_drops:
+	return String(fq->_overlimit_drops);
+    default:
+	return String(fq->_limit);
+    }
+}
+
+void
+FQCoDel::add_handlers()
+{
+    add_read_handler("length", read_handler, h_length);
+    add_read_handler("flows", read_handler, h_flows);
+    add_read_handler("drops", read_handler, h_drops);
+    add_read_handler("overlimit_drops", read_handler, h_overlimit_drops);
+    add_read_handler("capacity", read_handler, h_capacity);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(CoDel)
+EXPORT_ELEMENT(FQCoDel)
@@ -0,0 +1,183 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_FQCODEL_HH
+#define CLICK_FQCODEL_HH
+#include <click/batchelement.hh>
+#include <click/notifier.hh>
+#include <click/timestamp.hh>
+#include <click/vector.hh>
+#include "codel.hh"
+CLICK_DECLS
+
+/*
+=c
+
+FQCoDel([I<KEYWORDS>])
+
+=s aqm
+
+stores packets in per-flow queues managed by P<CoDel>
+
+=d
+
+Implements the FQ-CoDel (Flow Queue CoDel) packet scheduler and active queue
+management mechanism.
+
+Packets pushed on the input are hashed on their IPv4 addresses, protocol and
+ports into one of FLOWS queues. Non-IP packets, and packets without a network
+header annotation, all go to the first queue. Pulls serve the queues holding
+packets with Deficit Round Robin, QUANTUM bytes at a time; queues that just
+became active are served before the others, so sparse flows see little
+queueing delay. Each queue is managed by its own CoDel instance, which drops
+packets at dequeue depending on the time they spent in FQCoDel. When FQCoDel
+holds more than LIMIT packets, it drops packets from the head of the queue
+holding the most bytes, until that queue is halved.
+
+FQCoDel handles batches natively: the packets of a pushed batch are stamped
+with a single clock reading, and a pulled batch is filled by the scheduler in
+one call. FQCoDel overwrites the "first timestamp" annotation with the time
+packets were enqueued.
+
+FQCoDel is an empty notifier: downstream elements like Unqueue or ToDevice
+sleep while it holds no packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item FLOWS
+
+Integer. Number of flow queues. Default is 1024.
+
+=item LIMIT
+
+Integer. Maximum number of packets held in all queues. Default is 10240.
+
+=item QUANTUM
+
+Integer. Number of bytes a queue may send in a round. Default is 1514.
+
+=item TARGET
+
+Time. Target sojourn time of the CoDel instances. Default is 5 ms.
+
+=item INTERVAL
+
+Time. Sliding minimum window width of the CoDel instances. Default is 100 ms.
+
+=back
+
+B<Multithreaded Click note:> FQCoDel must be pushed and pulled by the same
+thread.
+
+=e
+
+  FromDevice(eth0) -> ... -> FQCoDel(FLOWS 1024, LIMIT 10240) -> ToDevice(eth1);
+
+=h length read-only
+
+Returns the number of packets held.
+
+=h flows read-only
+
+Returns the number of queues holding packets.
+
+=h drops read-only
+
+Returns the number of packets dropped so far, by CoDel and because of the
+LIMIT.
+
+=h overlimit_drops read-only
+
+Returns the number of packets dropped because of the LIMIT.
+
+=h capacity read-only
+
+Returns the LIMIT configuration parameter.
+
+=a CoDel, DRRSched, Queue
+
+T. Hoeiland-Joergensen, P. McKenney, D. Taht, J. Gettys and E. Dumazet.
+I<The Flow Queue CoDel Packet Scheduler and Active Queue Management
+Algorithm>. RFC 8290, January 2018. */
+
+class FQCoDel : public BatchElement { public:
+
+    FQCoDel() CLICK_COLD;
+    ~FQCoDel() CLICK_COLD;
+
+    const char *class_name() const override		{ return "FQCoDel"; }
+    const char *port_count() const override		{ return PORTS_1_1; }
+    const char *processing() const override		{ return PUSH_TO_PULL; }
+    void *cast(const char *) override;
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) override CLICK_COLD;
+    int initialize(ErrorHandler *errh) override CLICK_COLD;
+    void cleanup(CleanupStage) override CLICK_COLD;
+    void add_handlers() override CLICK_COLD;
+
+    void push(int port, Packet *) override;
+    Packet *pull(int port) override;
+#if HAVE_BATCH
+    void push_batch(int port, PacketBatch *) override;
+    PacketBatch *pull_batch(int port, unsigned max) override;
+#endif
+
+  private:
+
+    struct Flow {
+	Packet *head;
+	Packet *tail;
+	uint32_t count;
+	uint32_t bytes;
+	int deficit;
+	int next;		// next flow of the new or old list
+	bool active;		// in the new or old list
+	CoDelState codel;
+
+	Flow()
+	    : head(0), tail(0), count(0), bytes(0), deficit(0), next(-1),
+	      active(false) {
+	}
+	inline Packet *pop();
+    };
+
+    struct FlowList {
+	int head;
+	int tail;
+
+	FlowList()
+	    : head(-1), tail(-1) {
+	}
+    };
+
+    Vector<Flow> _flows;
+    FlowList _new_flows;
+    FlowList _old_flows;
+    uint32_t _perturbation;
+
+    unsigned _nflows;
+    unsigned _limit;
+    int _quantum;
+    Timestamp _target;
+    Timestamp _interval;
+
+    unsigned _count;
+    uint32_t _drops;
+    uint32_t _overlimit_drops;
+    ActiveNotifier _empty_note;
+
+    inline unsigned flow_of(Packet *p) const;
+    inline void enqueue(Packet *p, const Timestamp &now);
+    inline Packet *dequeue(const Timestamp &now);
+    inline Packet *codel_dequeue(Flow &f, const Timestamp &now);
+    void drop_overlimit();
+
+    inline void list_push(FlowList &l, int fi);
+    inline int list_pop(FlowList &l);
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
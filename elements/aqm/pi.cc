@@ -1,6 +1,6 @@
 // -*- mode: c++; c-basic-offset: 4 -*-
 /*
- * pi.{cc,hh} -- element implements Random Early Detection dropping policy
+ * pi.{cc,hh} -- element implements Proportional-Integral controller dropping policy
  * Eddie Kohler
  *
  * Copyright (c) 1999-2000 Massachusetts Institute of Technology
@@ -80,14 +80,14 @@ PI::configure(Vector<String> &conf, ErrorHandler *errh)
 
     // check queues_string
     if (queues_string) {
-		Vector<String> eids;
-		cp_spacevec(queues_string, eids);
-		_queue_elements.clear();
+	Vector<String> eids;
+	cp_spacevec(queues_string, eids);
+	_queue_elements.clear();
 	for (int i = 0; i < eids.size(); i++)
-		if (Element *e = router()->find(eids[i], this, errh))
-			_queue_elements.push_back(e);
-		if (eids.size() != _queue_elements.size())
-		return -1;
+	    if (Element *e = router()->find(eids[i], this, errh))
+		_queue_elements.push_back(e);
+	if (eids.size() != _queue_elements.size())
+	    return -1;
     }
 
     // OK: set variables
@@ -166,8 +166,9 @@ PI::initialize(ErrorHandler *errh)
 	_queue1 = _queues[0];
 
     _size.clear();
-	_old_q = 0;
-	_p = 0;
+    _old_q = 0;
+    _p = 0;
+    _drop_thresh = 0;
     _drops = 0;
     _last_jiffies = 0;
 
@@ -179,7 +180,7 @@ PI::initialize(ErrorHandler *errh)
 
 void PI::cleanup(CleanupStage)
 {
-    _timer.cleanup();
+    _timer.unschedule();
 }
 
 void
@@ -206,18 +207,22 @@ PI::queue_size() const
 void
 PI::run_timer(Timer *)
 {
-	_p = _a*(queue_size() - _target_q) - _b*(_old_q - _target_q) + _p;
+    unsigned q = queue_size();
+    _size.update(q);
+    _p += _a * ((double) q - _target_q) - _b * ((double) _old_q - _target_q);
+    if (_p < 0)
+	_p = 0;
+    else if (_p > 1)
+	_p = 1;
+    _old_q = q;
+    _drop_thresh = (uint32_t) (_p * ((double) CLICK_RAND_MAX + 1));
     _timer.reschedule_after_msec(_w*1000);
 }
 
-bool
+inline bool
 PI::should_drop()
 {
-	double _random_value = click_random();
-    if (_random_value > _p*MAX_RAND) {
-		return true;
-    }
-    return false;
+    return click_random() < _drop_thresh;
 }
 
 inline void
@@ -252,6 +257,47 @@ PI::pull(int)
     }
 }
 
+#if HAVE_BATCH
+void
+PI::push_batch(int, PacketBatch *batch)
+{
+    auto fnt = [this](Packet *p) -> Packet * {
+	if (should_drop()) {
+	    _drops++;
+	    return 0;
+	}
+	return p;
+    };
+    EXECUTE_FOR_EACH_PACKET_DROP_LIST(fnt, batch, drop_batch);
+    if (drop_batch)
+	checked_output_push_batch(1, drop_batch);
+    if (batch)
+	output_push_batch(0, batch);
+}
+
+PacketBatch *
+PI::pull_batch(int, unsigned max)
+{
+    auto fnt = [this](Packet *p) -> Packet * {
+	if (should_drop()) {
+	    _drops++;
+	    return 0;
+	}
+	return p;
+    };
+    while (true) {
+	PacketBatch *batch = input_pull_batch(0, max);
+	if (!batch)
+	    return 0;
+	EXECUTE_FOR_EACH_PACKET_DROP_LIST(fnt, batch, drop_batch);
+	if (drop_batch)
+	    checked_output_push_batch(1, drop_batch);
+	if (batch)
+	    return batch;
+    }
+}
+#endif
+
 
 // HANDLERS
 
@@ -267,28 +313,29 @@ PI::read_parameter(Element *f, void *vparam)
 {
     PI *pi = (PI *)f;
     StringAccum sa;
-    switch ((int)vparam) {
-      case 3:			// _target_q
-	return String(pi->_target_q);
+    switch ((intptr_t)vparam) {
+      case 3:			// avg_queue_size
+	return pi->_size.unparse();
       case 4:			// stats
-	sa << red->queue_size() << " current queue\n"
-	   << red->_size.unparse() << " avg queue\n"
-	   << red->drops() << " drops\n"
+	sa << pi->queue_size() << " current queue\n"
+	   << pi->_size.unparse() << " avg queue\n"
+	   << pi->_p << " drop probability\n"
+	   << pi->drops() << " drops\n"
 #if CLICK_STATS >= 1
-	   << red->output(0).npackets() << " packets\n"
+	   << pi->output(0).npackets() << " packets\n"
 #endif
 	    ;
 	return sa.take_string();
       case 5:			// queues
-	for (int i = 0; i < red->_queue_elements.size(); i++)
-	    sa << red->_queue_elements[i]->name() + "\n";
+	for (int i = 0; i < pi->_queue_elements.size(); i++)
+	    sa << pi->_queue_elements[i]->name() << "\n";
 	return sa.take_string();
       default:
-	sa << _a << ", " << _b << ", " << _w << ", " << _target_q
+	sa << pi->_w << ", " << pi->_a << ", " << pi->_b << ", " << pi->_target_q
 	   << ", QUEUES";
-	for (int i = 0; i < _queue_elements.size(); i++)
-	    sa << ' ' << _queue_elements[i]->name();
-	sa << ", STABILITY " << _size.stability_shift();
+	for (int i = 0; i < pi->_queue_elements.size(); i++)
+	    sa << ' ' << pi->_queue_elements[i]->name();
+	sa << ", STABILITY " << pi->_size.stability_shift();
 	return sa.take_string();
     }
 }
@@ -297,9 +344,12 @@ void
 PI::add_handlers()
 {
     add_read_handler("drops", pi_read_drops);
-    set_handler("w", Handler::OP_READ | Handler::OP_WRITE, configuration_keyword_handler, "W", (void *) (uintptr_t) 1);
-    set_handler("a", Handler::OP_READ | Handler::OP_WRITE, configuration_keyword_handler, "A", (void *) (uintptr_t) 2);
-    set_handler("b", Handler::OP_READ | Handler::OP_WRITE, configuration_keyword_handler, "B", (void *) (uintptr_t) 3);
+    add_read_handler("w", read_keyword_handler, "0 W");
+    add_write_handler("w", reconfigure_keyword_handler, "0 W");
+    add_read_handler("a", read_keyword_handler, "1 A");
+    add_write_handler("a", reconfigure_keyword_handler, "1 A");
+    add_read_handler("b", read_keyword_handler, "2 B");
+    add_write_handler("b", reconfigure_keyword_handler, "2 B");
     add_read_handler("avg_queue_size", read_parameter, 3);
     add_read_handler("stats", read_parameter, 4);
     add_read_handler("queues", read_parameter, 5);
@@ -308,5 +358,5 @@ PI::add_handlers()
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(int64 false)
+ELEMENT_REQUIRES(int64 userlevel)
 EXPORT_ELEMENT(PI)
@@ -1,13 +1,90 @@
 // -*- mode: c++; c-basic-offset: 4 -*-
 #ifndef CLICK_PI_HH
 #define CLICK_PI_HH
-#include <click/element.hh>
+#include <click/batchelement.hh>
 #include <click/ewma.hh>
 #include <click/timer.hh>
 CLICK_DECLS
 class Storage;
 
-class PI : public Element { public:
+/*
+=c
+
+PI(W, A, B, TARGET [, I<KEYWORDS>])
+
+=s aqm
+
+drops packets according to a PI controller
+
+=d
+
+Implements the Proportional-Integral controller active queue management
+mechanism.
+
+A PI element is associated with one or more Storage elements (usually
+Queues), found as by the RED element. Every W seconds, it samples the sum of
+the queue lengths q and updates the drop probability p:
+
+   p = p + A * (q - TARGET) - B * (q_old - TARGET)
+
+where q_old is the previous sample. Packets are then dropped with
+probability p, or emitted on output 1 if PI has two output ports. Since the
+probability only changes on the timer, the packets of a batch are processed
+together against the same probability.
+
+Keyword arguments are:
+
+=over 8
+
+=item QUEUES
+
+This argument is a space-separated list of Storage element names, as for RED.
+
+=item QREF
+
+Integer. Same as TARGET.
+
+=item STABILITY
+
+Unsigned. Stability of the average queue size reported by the avg_queue_size
+handler, as for RED. Default is 4.
+
+=back
+
+=e
+
+  ... -> PI(0.006, 0.00001822, 0.00001816, 200) -> Queue(800) -> ...
+
+=h w read/write
+
+Returns or sets the W configuration parameter.
+
+=h a read/write
+
+Returns or sets the A configuration parameter.
+
+=h b read/write
+
+Returns or sets the B configuration parameter.
+
+=h drops read-only
+
+Returns the number of packets dropped so far.
+
+=h stats read-only
+
+Returns some human-readable statistics.
+
+=h queues read-only
+
+Returns the Queues associated with this PI element, listed one per line.
+
+=a RED, Queue
+
+C.V. Hollot, V. Misra, D. Towsley and W. Gong. I<On Designing Improved
+Controllers for AQM Routers Supporting TCP Flows>. IEEE INFOCOM 2001. */
+
+class PI : public BatchElement { public:
 
     // Queue sizes are shifted by this much.
     enum { QUEUE_SCALE = 10 };
@@ -37,6 +114,10 @@ class PI : public Element { public:
     void handle_drop(Packet *);
     void push(int port, Packet *);
     Packet *pull(int port);
+#if HAVE_BATCH
+    void push_batch(int port, PacketBatch *);
+    PacketBatch *pull_batch(int port, unsigned max);
+#endif
     void run_timer(Timer *);
 
   protected:
@@ -52,15 +133,14 @@ class PI : public Element { public:
 
     int _drops;
 
-	double _a, _b, _w, _p;
-	unsigned _target_q, _old_q;
+    double _a, _b, _w, _p;
+    unsigned _target_q, _old_q;
+    uint32_t _drop_thresh;	// _p scaled to CLICK_RAND_MAX
 
     Vector<Element *> _queue_elements;
 
     static String read_parameter(Element *, void *);
 
-    static const int MAX_RAND=2147483647;
-
 };
 
 CLICK_ENDDECLS
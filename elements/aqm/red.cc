@@ -181,11 +181,16 @@ RED::queue_size() const
 
 bool
 RED::should_drop()
+{
+    return should_drop(queue_size());
+}
+
+bool
+RED::should_drop(int s)
 {
     // calculate the new average queue size.
     // Do some rigamarole to handle empty periods, but don't work too hard.
     // (Therefore it contains errors. XXX)
-    int s = queue_size();
     unsigned avg;
 
     if (_size.stability_shift() == 0)
@@ -280,6 +285,52 @@ RED::pull(int)
     }
 }
 
+#if HAVE_BATCH
+void
+RED::push_batch(int, PacketBatch *batch)
+{
+    // the packets let through are counted as enqueued downstream
+    int s = queue_size();
+    auto fnt = [this, &s](Packet *p) -> Packet * {
+	if (should_drop(s)) {
+	    _drops++;
+	    return 0;
+	}
+	s++;
+	return p;
+    };
+    EXECUTE_FOR_EACH_PACKET_DROP_LIST(fnt, batch, drop_batch);
+    if (drop_batch)
+	checked_output_push_batch(1, drop_batch);
+    if (batch)
+	output_push_batch(0, batch);
+}
+
+PacketBatch *
+RED::pull_batch(int, unsigned max)
+{
+    while (true) {
+	PacketBatch *batch = input_pull_batch(0, max);
+	if (!batch)
+	    return 0;
+	// the packets after the current one are still counted as queued
+	int s = queue_size() + batch->count();
+	auto fnt = [this, &s](Packet *p) -> Packet * {
+	    if (should_drop(--s)) {
+		_drops++;
+		return 0;
+	    }
+	    return p;
+	};
+	EXECUTE_FOR_EACH_PACKET_DROP_LIST(fnt, batch, drop_batch);
+	if (drop_batch)
+	    checked_output_push_batch(1, drop_batch);
+	if (batch)
+	    return batch;
+    }
+}
+#endif
+
 
 // HANDLERS
 
@@ -1,7 +1,7 @@
 // -*- mode: c++; c-basic-offset: 4 -*-
 #ifndef CLICK_RED_HH
 #define CLICK_RED_HH
-#include <click/element.hh>
+#include <click/batchelement.hh>
 #include <click/ewma.hh>
 CLICK_DECLS
 class Storage;
@@ -30,6 +30,12 @@ nearest upstream Queues.
 Marked packets are dropped, or emitted on output 1 if RED has two output
 ports.
 
+RED handles batches of packets without going through the queues for each
+packet. A push RED accounts for the packets of the batch it lets through, as
+if they were already enqueued, and a pull RED for the packets of the pulled
+batch that follow the current one, so the marking decisions are the same as
+with packets processed one at a time.
+
 Arguments are:
 
 =over 8
@@ -129,7 +135,7 @@ Congestion Avoidance>. ACM Transactions on Networking, B<1>(4), August
 Sally Floyd. "Optimum functions for computing the drop
 probability", October 1997. L<http://www.icir.org/floyd/REDfunc.txt>. */
 
-class RED : public Element { public:
+class RED : public BatchElement { public:
 
     // Queue sizes are shifted by this much.
     enum { QUEUE_SCALE = 10 };
@@ -156,9 +162,14 @@ class RED : public Element { public:
     void add_handlers() CLICK_COLD;
 
     bool should_drop();
+    bool should_drop(int queue_size);
     void handle_drop(Packet *);
     void push(int port, Packet *);
     Packet *pull(int port);
+#if HAVE_BATCH
+    void push_batch(int port, PacketBatch *);
+    PacketBatch *pull_batch(int port, unsigned max);
+#endif
 
   protected:
 
@@ -68,7 +68,7 @@ EtherEncap::push(int, Packet *p)
 void
 EtherEncap::push_batch(int, PacketBatch *batch)
 {
-    EXECUTE_FOR_EACH_PACKET_DROPPABLE(smaction, batch, [](Packet *){});
+    EXECUTE_FOR_EACH_PACKET_DROPPABLE_PREFETCH(smaction, batch, [](Packet *){});
     if (batch)
         output(0).push_batch(batch);
 }
@@ -56,38 +56,11 @@ EtherRewrite::smaction(Packet *p)
 }
 
 inline void
-EtherRewrite::push(int, Packet *p)
+EtherRewrite::simple_action_vector(PacketVector &v)
 {
-    if (Packet *q = smaction(p))
-        output(0).push(q);
+    v.filter([this](Packet *p) { return smaction(p); }, [](Packet *) {});
 }
 
-Packet *
-EtherRewrite::pull(int)
-{
-    if (Packet *p = input(0).pull())
-       return smaction(p);
-    else
-       return 0;
-}
-
-#if HAVE_BATCH
-void
-EtherRewrite::push_batch(int, PacketBatch *batch)
-{
-    EXECUTE_FOR_EACH_PACKET(smaction, batch);
-    output(0).push_batch(batch);
-}
-
-PacketBatch *
-EtherRewrite::pull_batch(int, unsigned max)
-{
-    PacketBatch *batch = input_pull_batch(0, max);
-    EXECUTE_FOR_EACH_PACKET(smaction, batch);
-    return batch;
-}
-#endif
-
 void
 EtherRewrite::add_handlers()
 {
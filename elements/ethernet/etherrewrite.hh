@@ -44,7 +44,7 @@ Return or set the DST parameter.
 EtherEncap, EtherVLANEncap, ARPQuerier, EnsureEther, StoreEtherAddress */
 
 
-class EtherRewrite : public BatchElement { public:
+class EtherRewrite : public SimpleVectorElement<EtherRewrite> { public:
 
     EtherRewrite() CLICK_COLD;
     ~EtherRewrite() CLICK_COLD;
@@ -57,13 +57,7 @@ class EtherRewrite : public BatchElement { public:
     void add_handlers() CLICK_COLD;
 
     inline Packet *smaction(Packet *);
-    Packet *pull(int) override;
-    void push(int, Packet *) override;
-
-#if HAVE_BATCH
-    void push_batch(int, PacketBatch *) override;
-    PacketBatch *pull_batch(int, unsigned) override;
-#endif
+    inline void simple_action_vector(PacketVector &);
 
   private:
 
@@ -54,11 +54,50 @@ IP Address. Can be repeated multiple times, once per destination.
 =item VIP
 IP Address of this load-balancer.
 
+=item LB_MODE
+
+Method used to choose the destination of a new flow. Among others, "rr"
+(round-robin, the default), "hash" (hash of the 5-tuple), "pow2" (power of
+two choices), "least" (least loaded) and "table". "maglev" looks the hash of
+the 5-tuple up in a Maglev table, and "rendezvous" chooses the destination
+with the highest weighted score for the flow (rendezvous hashing). With these
+two methods, adding, removing or reweighting a destination only moves the
+flows from or to that destination (nearly so for "maglev"), so stateless
+replicas agree on the destination of existing flows.
+
+=item WEIGHT
+
+Unsigned. Weight of a destination for the "maglev" and "rendezvous" modes.
+Give it once per destination, in the order of DST. Defaults to 1. An active
+destination must keep a non-zero weight: configurations and "weight" writes
+setting every active weight to 0 are refused.
+
+=item MAGLEV_SIZE
+
+Prime number. Size of the Maglev table. Defaults to 65537.
+
 =back
 
+=h weight read/write
+
+Returns the weight of each destination. Write `C<DST WEIGHT>' to set the
+weight of destination index DST. A weight of 0 disables the destination in
+the "maglev" and "rendezvous" modes.
+
+=h add_server write-only
+
+Activates the spare destination whose index is given, or a random one.
+
+=h remove_server write-only
+
+Deactivates the destination whose index is given, or a random one.
+
 =e
     FlowIPLoadBalancer(VIP 10.220.0.1, DST 10.221.0.1, DST 10.221.0.2, DST 10.221.0.3)
 
+    FlowIPLoadBalancer(VIP 10.220.0.1, DST 10.221.0.1, DST 10.221.0.2,
+                       WEIGHT 1, WEIGHT 2, LB_MODE maglev)
+
 =a
 
 FlowIPLoadBalancer, FlowIPNAT */
@@ -68,6 +68,25 @@ FlowIPManager_CuckooPP::find(IPFlow5ID &f)
     return ret >= 0 ? data.a: 0;
 }
 
+void
+FlowIPManager_CuckooPP::find_batch(IPFlow5ID *keys, int *ret, int n)
+{
+    auto *table = 	reinterpret_cast<rte_hash_hvariant *>(_tables->hash);
+    hash_key_t k[n];
+    hash_data_t data[n];
+    for (int i = 0; i < n; i++) {
+        IPFlow5ID &f = keys[i];
+        k[i].a = ((uint64_t) f.saddr().addr() << 32) | ((uint64_t)f.daddr().addr());
+        k[i].b = ((uint64_t) f.proto() << 32) | ((uint64_t)f.sport() << 16) | ((uint64_t)f.dport());
+    }
+
+    uint64_t hits = 0;
+    if (unlikely(rte_hash_bloom_lookup_bulk_data(table, k, n, &hits, data, 0) < 0))
+        hits = 0;
+    for (int i = 0; i < n; i++)
+        ret[i] = (hits >> i) & 1 ? data[i].a : 0;
+}
+
 
 int
 FlowIPManager_CuckooPP::count()
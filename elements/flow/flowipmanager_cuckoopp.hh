@@ -34,6 +34,7 @@ protected:
     //Implemented for VirtualFlowManagerIMP. It is using CRTP so no override.
     inline int alloc(FlowIPManager_CuckooPPState& table, int core, ErrorHandler* errh);
 	inline int find(IPFlow5ID &f);
+	inline void find_batch(IPFlow5ID *keys, int *ret, int n);
 	inline int insert(IPFlow5ID &f, int flowid);
     inline int remove(IPFlow5ID &f);
     inline int count();
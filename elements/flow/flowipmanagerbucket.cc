@@ -266,7 +266,7 @@ void FlowIPManagerBucket::push_batch(int, PacketBatch* batch) {
         core.watch = epoch;
 
     int last = -1;
-    FOR_EACH_PACKET_SAFE(batch, p) {
+    FOR_EACH_PACKET_SAFE_PREFETCH(batch, p) {
         int groupid = AGGREGATE_ANNO(p) % _groups;
             if (unlikely(_do_migration && _tables[groupid].owner != click_current_cpu_id())) {
                 //The owner is for the old CPU core
@@ -74,6 +74,25 @@ FlowIPManager_DPDK::find(IPFlow5ID &f)
     return ret;
 }
 
+/**
+ * Bulk lookup: DPDK computes all signatures, prefetches the buckets and
+ * compares the keys in a second pass
+ */
+void
+FlowIPManager_DPDK::find_batch(IPFlow5ID *keys, int *ret, int n)
+{
+    auto *table = reinterpret_cast<rte_hash*>(_tables->hash);
+    const void *k[n];
+    for (int i = 0; i < n; i++)
+        k[i] = &keys[i];
+
+    static_assert(sizeof(int) == sizeof(int32_t), "positions are int32_t");
+    if (unlikely(rte_hash_lookup_bulk(table, k, n, (int32_t *) ret) != 0)) {
+        for (int i = 0; i < n; i++)
+            ret[i] = rte_hash_lookup(table, &keys[i]);
+    }
+}
+
 
 int
 FlowIPManager_DPDK::count()
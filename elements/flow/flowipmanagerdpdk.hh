@@ -22,7 +22,7 @@ class FlowIPManager_DPDKState: public FlowManagerIMPStateNoFID { public:
 
 /**
  * =c
- * FlowIPManager_DPDK(CAPACITY [, RESERVE])
+ * FlowIPManager_DPDK(CAPACITY [, RESERVE, TIMEOUT, SYN_TIMEOUT, TCP_TIMEOUT, RECYCLE_INTERVAL])
  *
  * =s flow
  *  FCB packet classifier - cuckoo per-thread
@@ -32,6 +32,11 @@ class FlowIPManager_DPDKState: public FlowManagerIMPStateNoFID { public:
  * Initialize the FCB stack for every packets passing by.
  * The classification is done using a per-core cuckoo hash table.
  *
+ * Flows idle for TIMEOUT seconds are removed, checked every RECYCLE_INTERVAL
+ * seconds using a hierarchical timer wheel. SYN_TIMEOUT and TCP_TIMEOUT
+ * override TIMEOUT for TCP flows that only sent a SYN and for other TCP
+ * flows. TCP_TIMEOUT should not be shorter than SYN_TIMEOUT.
+ *
  * This element does not find automatically the FCB layout for FlowElement,
  * neither set the offsets for placement in the FCB automatically. Look at
  * the middleclick branch for alternatives.
@@ -58,6 +63,7 @@ class FlowIPManager_DPDK: public VirtualFlowManagerIMP<FlowIPManager_DPDK, FlowI
     //Implemented for VirtualFlowManagerIMP. It is using CRTP so no override.
     inline int alloc(FlowIPManager_DPDKState& table, int core, ErrorHandler* errh);
 	inline int find(IPFlow5ID &f);
+	inline void find_batch(IPFlow5ID *keys, int *ret, int n);
 	inline int insert(IPFlow5ID &f, int);
     inline int remove(IPFlow5ID &f);
     inline int count();
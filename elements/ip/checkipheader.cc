@@ -237,6 +237,16 @@ CheckIPHeader::simple_action(Packet *p)
     }
 }
 
+#if HAVE_BATCH
+void
+CheckIPHeader::push_batch(int port, PacketBatch *batch)
+{
+    EXECUTE_FOR_EACH_PACKET_DROPPABLE_PREFETCH(simple_action, batch, [](Packet *){});
+    if (batch)
+        output(port).push_batch(batch);
+}
+#endif
+
 String
 CheckIPHeader::read_handler(Element *e, void *thunk)
 {
@@ -123,6 +123,9 @@ class CheckIPHeader : public SimpleElement<CheckIPHeader> {
         void add_handlers() CLICK_COLD;
 
         Packet *simple_action(Packet *p);
+#if HAVE_BATCH
+        void push_batch(int, PacketBatch *) override;
+#endif
 
         struct OldBadSrcArg {
             static bool parse(const String &str, Vector<IPAddress> &result, Args &args);
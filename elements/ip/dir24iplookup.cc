@@ -0,0 +1,368 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * dir24iplookup.{cc,hh} -- DIR-24-8 IP routing table with batched lookups
+ */
+
+#include <click/config.h>
+#include "dir24iplookup.hh"
+#include <click/ipaddress.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#if CLICK_USERLEVEL
+# include <click/hugepagearena.hh>
+#endif
+CLICK_DECLS
+
+// Number of lookups whose memory accesses are overlapped
+#define DIR24_PREFETCH_BURST 32
+
+static inline uint32_t
+prefix_mask(int len)
+{
+    return len ? 0xFFFFFFFFU << (32 - len) : 0;
+}
+
+Dir24IPLookup::Dir24IPLookup()
+    : _tbl24(0)
+{
+}
+
+Dir24IPLookup::~Dir24IPLookup()
+{
+}
+
+int
+Dir24IPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+#if CLICK_USERLEVEL
+    _tbl24 = (uint32_t *) HugepageArena::allocate(sizeof(uint32_t) * TBL24_SIZE);
+#else
+    _tbl24 = (uint32_t *) CLICK_LALLOC(sizeof(uint32_t) * TBL24_SIZE);
+#endif
+    if (!_tbl24)
+        return errh->error("out of memory");
+    flush();
+    return IPRouteTable::configure(conf, errh);
+}
+
+void
+Dir24IPLookup::cleanup(CleanupStage)
+{
+#if CLICK_USERLEVEL
+    HugepageArena::deallocate(_tbl24, sizeof(uint32_t) * TBL24_SIZE);
+#else
+    CLICK_LFREE(_tbl24, sizeof(uint32_t) * TBL24_SIZE);
+#endif
+    _tbl24 = 0;
+}
+
+void
+Dir24IPLookup::flush()
+{
+    memset(_tbl24, 0, sizeof(uint32_t) * TBL24_SIZE);
+    _tbl8.clear();
+    _tbl8_free.clear();
+    _nh.clear();
+    _nh_free.clear();
+    _nh_map.clear();
+    _routes.clear();
+}
+
+/**
+ * Return the index of the next hop (gw, port), creating it if needed, and
+ * take a reference on it.
+ */
+int
+Dir24IPLookup::nexthop_ref(IPAddress gw, int32_t port)
+{
+    uint64_t key = ((uint64_t) gw.addr() << 32) | (uint32_t) port;
+    HashTable<uint64_t, uint32_t>::iterator it = _nh_map.find(key);
+    if (it) {
+        _nh[it.value()].refcount++;
+        return it.value();
+    }
+
+    uint32_t nh;
+    if (_nh_free.size()) {
+        nh = _nh_free.back();
+        _nh_free.pop_back();
+    } else {
+        if (_nh.size() > E_INDEX)
+            return -ENOMEM;
+        nh = _nh.size();
+        _nh.push_back(NextHop());
+    }
+    _nh[nh].gw = gw;
+    _nh[nh].port = port;
+    _nh[nh].refcount = 1;
+    _nh_map.set(key, nh);
+    return nh;
+}
+
+void
+Dir24IPLookup::nexthop_unref(uint32_t nh)
+{
+    if (--_nh[nh].refcount == 0) {
+        _nh_map.erase(((uint64_t) _nh[nh].gw.addr() << 32) | (uint32_t) _nh[nh].port);
+        _nh_free.push_back(nh);
+    }
+}
+
+/**
+ * Return a free group of the second table, with all entries set to @a fill
+ */
+int
+Dir24IPLookup::tbl8_alloc(uint32_t fill)
+{
+    uint32_t g;
+    if (_tbl8_free.size()) {
+        g = _tbl8_free.back();
+        _tbl8_free.pop_back();
+    } else {
+        g = _tbl8.size() >> 8;
+        if (g > E_INDEX)
+            return -ENOMEM;
+        _tbl8.resize(_tbl8.size() + 256);
+    }
+    uint32_t *group = _tbl8.data() + (g << 8);
+    for (int i = 0; i < 256; i++)
+        group[i] = fill;
+    return g;
+}
+
+/**
+ * Find the longest route strictly shorter than @a len covering @a prefix
+ */
+const IPRoute *
+Dir24IPLookup::parent_route(uint32_t prefix, int len) const
+{
+    for (int l = len - 1; l >= 0; l--) {
+        HashTable<uint64_t, IPRoute>::const_iterator it = _routes.find(route_key(prefix & prefix_mask(l), l));
+        if (it)
+            return &it.value();
+    }
+    return 0;
+}
+
+/**
+ * Write @a entry in all the entries covered by @a prefix/@a len.
+ *
+ * If @a owner is negative, the route is being added and the entries set by
+ * shorter or equal prefixes are overwritten. The group of the second table
+ * must then already exist for prefixes longer than /24. Otherwise the route
+ * of length @a owner is being removed and only the entries it set are
+ * replaced.
+ */
+void
+Dir24IPLookup::write_range(uint32_t prefix, int len, uint32_t entry, int owner)
+{
+#define DIR24_OWNED(e) (owner < 0 ? entry_depth(e) <= (uint32_t) len \
+                        : ((e) & E_VALID) && entry_depth(e) == (uint32_t) owner)
+    if (len <= 24) {
+        uint32_t first = prefix >> 8;
+        uint32_t last = first + (1U << (24 - len));
+        for (uint32_t i = first; i < last; i++) {
+            uint32_t e = _tbl24[i];
+            if (!(e & E_EXT)) {
+                if (DIR24_OWNED(e))
+                    _tbl24[i] = entry;
+            } else {
+                uint32_t *group = _tbl8.data() + ((e & E_INDEX) << 8);
+                for (int j = 0; j < 256; j++)
+                    if (DIR24_OWNED(group[j]))
+                        group[j] = entry;
+            }
+        }
+        return;
+    }
+
+    uint32_t i = prefix >> 8;
+    uint32_t e = _tbl24[i];
+    if (!(e & E_EXT))
+        return;
+
+    uint32_t *group = _tbl8.data() + ((e & E_INDEX) << 8);
+    uint32_t first = prefix & 0xFF;
+    uint32_t last = first + (1U << (32 - len));
+    for (uint32_t j = first; j < last; j++)
+        if (DIR24_OWNED(group[j]))
+            group[j] = entry;
+#undef DIR24_OWNED
+
+    // Give the group back once no prefix longer than /24 remains in it
+    if (owner >= 0) {
+        for (int j = 1; j < 256; j++)
+            if (group[j] != group[0])
+                return;
+        if (entry_depth(group[0]) > 24)
+            return;
+        _tbl24[i] = group[0];
+        _tbl8_free.push_back(e & E_INDEX);
+    }
+}
+
+int
+Dir24IPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, ErrorHandler *)
+{
+    int len = route.prefix_len();
+    if (len < 0)
+        return -EINVAL;
+    uint32_t prefix = ntohl(route.addr.addr()) & prefix_mask(len);
+    uint64_t key = route_key(prefix, len);
+
+    HashTable<uint64_t, IPRoute>::iterator it = _routes.find(key);
+    if (it) {
+        if (old_route)
+            *old_route = it.value();
+        if (!set)
+            return -EEXIST;
+    }
+
+    int nh = nexthop_ref(route.gw, route.port);
+    if (nh < 0)
+        return nh;
+
+    // Longer prefixes than /24 need a group in the second table
+    uint32_t &e24 = _tbl24[prefix >> 8];
+    if (len > 24 && !(e24 & E_EXT)) {
+        int g = tbl8_alloc(e24);
+        if (g < 0) {
+            nexthop_unref(nh);
+            return g;
+        }
+        e24 = g | E_VALID | E_EXT;
+    }
+
+    write_range(prefix, len, make_entry(nh, len), -1);
+
+    if (it)
+        nexthop_unref(it.value().extra);
+    IPRoute &r = _routes[key];
+    r = route;
+    r.extra = nh;
+    return 0;
+}
+
+int
+Dir24IPLookup::remove_route(const IPRoute &route, IPRoute *old_route, ErrorHandler *)
+{
+    int len = route.prefix_len();
+    if (len < 0)
+        return -EINVAL;
+    uint32_t prefix = ntohl(route.addr.addr()) & prefix_mask(len);
+
+    HashTable<uint64_t, IPRoute>::iterator it = _routes.find(route_key(prefix, len));
+    if (!it)
+        return -ENOENT;
+    if (old_route)
+        *old_route = it.value();
+    if (!route.match(it.value()))
+        return -ENOENT;
+
+    // Entries set by the route fall back to the next shorter covering route
+    uint32_t replacement = 0;
+    if (const IPRoute *parent = parent_route(prefix, len))
+        replacement = make_entry(parent->extra, parent->prefix_len());
+    write_range(prefix, len, replacement, len);
+
+    nexthop_unref(it.value().extra);
+    _routes.erase(it);
+    return 0;
+}
+
+int
+Dir24IPLookup::lookup_route(IPAddress addr, IPAddress &gw) const
+{
+    uint32_t a = ntohl(addr.addr());
+    uint32_t e = _tbl24[a >> 8];
+    if (e & E_EXT)
+        e = _tbl8[((e & E_INDEX) << 8) | (a & 0xFF)];
+    return resolve(e, gw);
+}
+
+/*
+ * Resolve the lookups in bursts, in three passes: prefetch the first table
+ * entries, read them and prefetch the second table entries they point to,
+ * then read the results. The cache misses of a burst are then served in
+ * parallel.
+ */
+void
+Dir24IPLookup::lookup_route_batch(const IPAddress *addrs, int n, int *ports, IPAddress *gws) const
+{
+    uint32_t idx[DIR24_PREFETCH_BURST];
+    uint32_t e[DIR24_PREFETCH_BURST];
+
+    for (int base = 0; base < n; base += DIR24_PREFETCH_BURST) {
+        int m = n - base < DIR24_PREFETCH_BURST ? n - base : DIR24_PREFETCH_BURST;
+
+        for (int i = 0; i < m; i++) {
+            uint32_t a = ntohl(addrs[base + i].addr());
+            idx[i] = a;
+            __builtin_prefetch(&_tbl24[a >> 8]);
+        }
+
+        for (int i = 0; i < m; i++) {
+            e[i] = _tbl24[idx[i] >> 8];
+            if (e[i] & E_EXT) {
+                idx[i] = ((e[i] & E_INDEX) << 8) | (idx[i] & 0xFF);
+                __builtin_prefetch(&_tbl8[idx[i]]);
+            }
+        }
+
+        for (int i = 0; i < m; i++) {
+            if (e[i] & E_EXT)
+                e[i] = _tbl8[idx[i]];
+            ports[base + i] = resolve(e[i], gws[base + i]);
+        }
+    }
+}
+
+void
+Dir24IPLookup::push(int, Packet *p)
+{
+    IPAddress gw;
+    int port = lookup_route(p->dst_ip_anno(), gw);
+
+    if (port >= 0) {
+        if (gw)
+            p->set_dst_ip_anno(gw);
+        output(port).push(p);
+    } else
+        p->kill();
+}
+
+String
+Dir24IPLookup::dump_routes()
+{
+    StringAccum sa;
+    for (HashTable<uint64_t, IPRoute>::iterator it = _routes.begin(); it; ++it)
+        it.value().unparse(sa, true) << '\n';
+    return sa.take_string();
+}
+
+int
+Dir24IPLookup::flush_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    Dir24IPLookup *t = static_cast<Dir24IPLookup *>(e);
+    t->flush();
+    return 0;
+}
+
+String
+Dir24IPLookup::read_handler(Element *e, void *)
+{
+    Dir24IPLookup *t = static_cast<Dir24IPLookup *>(e);
+    return String((t->_tbl8.size() >> 8) - t->_tbl8_free.size());
+}
+
+void
+Dir24IPLookup::add_handlers()
+{
+    IPRouteTable::add_handlers();
+    add_write_handler("flush", flush_handler, 0, Handler::BUTTON);
+    add_read_handler("tbl8_groups", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRouteTable)
+EXPORT_ELEMENT(Dir24IPLookup)
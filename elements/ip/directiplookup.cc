@@ -33,14 +33,16 @@ CLICK_DECLS
 // kernel, because it's too large to be allocated all at once.
 
 int
-DirectIPLookup::Table::initialize()
+DirectIPLookup::Table::initialize(uint32_t tbl_24_31_capacity,
+				  uint32_t vport_capacity,
+				  uint32_t rtable_capacity)
 {
     assert(!_tbl_0_23 && !_tbl_24_31 && !_vport && !_rtable && !_rt_hashtbl
 	   && !_tbl_0_23_plen && !_tbl_24_31_plen);
 
-    _tbl_24_31_capacity = 4096;
-    _vport_capacity = 1024;
-    _rtable_capacity = 2048;
+    _tbl_24_31_capacity = tbl_24_31_capacity;
+    _vport_capacity = vport_capacity;
+    _rtable_capacity = rtable_capacity;
 
     if ((_tbl_0_23 = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * (1 << 24)))
 	&& (_tbl_24_31 = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity))
@@ -69,6 +71,37 @@ DirectIPLookup::Table::cleanup()
     _rt_hashtbl = 0;
 }
 
+// Make this table a copy of @a t, reusing its memory if the capacities match
+int
+DirectIPLookup::Table::copy(const Table &t)
+{
+    if (!_tbl_0_23
+	|| _tbl_24_31_capacity != t._tbl_24_31_capacity
+	|| _vport_capacity != t._vport_capacity
+	|| _rtable_capacity != t._rtable_capacity) {
+	cleanup();
+	if (initialize(t._tbl_24_31_capacity, t._vport_capacity, t._rtable_capacity) < 0) {
+	    cleanup();
+	    return -ENOMEM;
+	}
+    }
+
+    memcpy(_tbl_0_23, t._tbl_0_23, (sizeof(uint16_t) + sizeof(uint8_t)) * (1 << 24));
+    memcpy(_tbl_24_31, t._tbl_24_31, (sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity);
+    memcpy(_vport, t._vport, sizeof(VirtualPort) * _vport_capacity);
+    memcpy(_rtable, t._rtable, sizeof(CleartextEntry) * _rtable_capacity);
+    memcpy(_rt_hashtbl, t._rt_hashtbl, sizeof(int) * PREF_HASHSIZE);
+
+    _rtable_size = t._rtable_size;
+    _tbl_24_31_size = t._tbl_24_31_size;
+    _vport_size = t._vport_size;
+    _rt_empty_head = t._rt_empty_head;
+    _tbl_24_31_empty_head = t._tbl_24_31_empty_head;
+    _vport_head = t._vport_head;
+    _vport_empty_head = t._vport_empty_head;
+    return 0;
+}
+
 
 inline uint32_t
 DirectIPLookup::Table::prefix_hash(uint32_t prefix, uint32_t len)
@@ -488,11 +521,8 @@ DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, Er
 // DIRECTIPLOOKUP
 
 DirectIPLookup::DirectIPLookup()
+    : _current(0), _updating(false)
 {
-#if HAVE_BATCH
-	// TODO: Remove this when push_batch() will actually be implemented
-	in_batch_mode = BATCH_MODE_NO;
-#endif
 }
 
 DirectIPLookup::~DirectIPLookup()
@@ -503,16 +533,19 @@ int
 DirectIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     int r;
-    if ((r = _t.initialize()) < 0)
+    if ((r = _t[0].initialize()) < 0)
 	return r;
-    _t.flush();
+    _t[0].flush();
+    _current = 0;
+    _table.initialize(&_t[0]);
     return IPRouteTable::configure(conf, errh);
 }
 
 void
 DirectIPLookup::cleanup(CleanupStage)
 {
-    _t.cleanup();
+    _t[0].cleanup();
+    _t[1].cleanup();
 }
 
 void
@@ -532,41 +565,88 @@ DirectIPLookup::push(int, Packet *p)
 int
 DirectIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
 {
-    uint32_t ip_addr = ntohl(dest.addr());
-    uint16_t vport_i = _t._tbl_0_23[ip_addr >> 8];
-
-    if (vport_i & 0x8000)
-        vport_i = _t._tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
+    int flags;
+    const Table *t = _table.read_begin(flags);
+    int port = t->lookup_route(dest, gw);
+    _table.read_end(flags);
+    return port;
+}
 
-    gw = _t._vport[vport_i].gw;
-    return _t._vport[vport_i].port;
+void
+DirectIPLookup::lookup_route_batch(const IPAddress *addrs, int n, int *ports, IPAddress *gws) const
+{
+    int flags;
+    const Table *t = _table.read_begin(flags);
+    for (int i = 0; i < n; i++)
+	ports[i] = t->lookup_route(addrs[i], gws[i]);
+    _table.read_end(flags);
 }
 
 int
 DirectIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.add_route(route, allow_replace, old_route, errh);
+    return writable().add_route(route, allow_replace, old_route, errh);
 }
 
 int
 DirectIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.remove_route(route, old_route, errh);
+    return writable().remove_route(route, old_route, errh);
+}
+
+int
+DirectIPLookup::begin_update(ErrorHandler *errh)
+{
+    assert(!_updating);
+    if (_t[1 - _current].copy(_t[_current]) < 0)
+	return errh->error("out of memory");
+    _updating = true;
+    return 1;
+}
+
+void
+DirectIPLookup::end_update(bool commit)
+{
+    _updating = false;
+    if (commit)
+	swap_table(1 - _current);
+}
+
+/*
+ * Make table @a i the one used by lookups. The second, empty, write waits
+ * until no reader may still use the other table, so it can be overwritten
+ * by the next update.
+ */
+void
+DirectIPLookup::swap_table(int i)
+{
+    int flags;
+    _table.write_begin(flags) = &_t[i];
+    _table.write_commit(flags);
+    _current = i;
+    _table.write_begin(flags);
+    _table.write_commit(flags);
 }
 
 int
 DirectIPLookup::flush_handler(const String &, Element *e, void *,
-				ErrorHandler *)
+				ErrorHandler *errh)
 {
     DirectIPLookup *t = static_cast<DirectIPLookup *>(e);
-    t->_t.flush();
+    Table &spare = t->_t[1 - t->_current];
+    if (!spare._tbl_0_23 && spare.initialize() < 0) {
+	spare.cleanup();
+	return errh->error("out of memory");
+    }
+    spare.flush();
+    t->swap_table(1 - t->_current);
     return 0;
 }
 
 String
 DirectIPLookup::dump_routes()
 {
-    return _t.dump();
+    return writable().dump();
 }
 
 void
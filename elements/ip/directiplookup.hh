@@ -1,6 +1,7 @@
 // -*- c-basic-offset: 4 -*-
 #ifndef CLICK_DIRECTIPLOOKUP_HH
 #define CLICK_DIRECTIPLOOKUP_HH
+#include <click/multithread.hh>
 #include "iproutetable.hh"
 CLICK_DECLS
 
@@ -33,6 +34,13 @@ relatively low CPU overhead, allowing for high update rates.
 DirectIPLookup implements the I<DIR-24-8-BASIC> lookup scheme described by
 Gupta, Lin, and McKeown in the paper cited below.
 
+Route changes made through the handlers are applied to a second copy of the
+table, which then replaces the one used by the data path with a
+read-copy-update swap. Worker threads never block on route changes and never
+see a half-updated table. Each change costs a copy of the table, so many
+changes should be applied at once through the C<ctrl> handler. The second
+copy doubles the memory used by the element once the first change is made.
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -102,6 +110,9 @@ class DirectIPLookup : public IPRouteTable { public:
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_route_batch(const IPAddress *, int, int *, IPAddress *) const;
+    int begin_update(ErrorHandler *);
+    void end_update(bool);
     String dump_routes();
 
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
@@ -164,8 +175,22 @@ class DirectIPLookup : public IPRouteTable { public:
 	    cleanup();
 	}
 
-	int initialize();
+	int initialize(uint32_t tbl_24_31_capacity = 4096,
+		       uint32_t vport_capacity = 1024,
+		       uint32_t rtable_capacity = 2048);
 	void cleanup();
+	int copy(const Table &t);
+
+	inline int lookup_route(IPAddress dest, IPAddress &gw) const {
+	    uint32_t ip_addr = ntohl(dest.addr());
+	    uint16_t vport_i = _tbl_0_23[ip_addr >> 8];
+
+	    if (vport_i & 0x8000)
+		vport_i = _tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
+
+	    gw = _vport[vport_i].gw;
+	    return _vport[vport_i].port;
+	}
 
 	static inline uint32_t prefix_hash(uint32_t, uint32_t);
 
@@ -183,7 +208,16 @@ class DirectIPLookup : public IPRouteTable { public:
 
   protected:
 
-    Table _t;
+    // The table in use and the one route changes are made to
+    Table _t[2];
+    int _current;
+    bool _updating;
+
+    // Table used by lookups, swapped by end_update()
+    mutable fast_rcu<Table *> _table;
+
+    Table &writable()			{ return _t[_updating ? 1 - _current : _current]; }
+    void swap_table(int i);
 
     friend class RangeIPLookup;
 
@@ -161,7 +161,7 @@ IPFilter::static_cleanup()
     delete dbs[1];
 }
 
-IPFilter::IPFilter() : _caching(false), _cache()
+IPFilter::IPFilter() : _use_jit(true), _columnwise(false), _caching(false), _cache()
 {
 }
 
@@ -1325,8 +1325,12 @@ IPFilter::configure(Vector<String> &conf, ErrorHandler *errh)
     // Consume key-value argument before parsing the rules
     if (Args(this, errh).bind(conf)
         .read("CACHING", _caching)
+        .read("JIT", _use_jit)
+        .read("COLUMNWISE", _columnwise)
         .consume() < 0)
         return -1;
+    if (_caching && _columnwise)
+        return errh->error("CACHING and COLUMNWISE are mutually exclusive");
 
     if (_caching) {
         errh->message("%s::%s: Caching mode enabled", name().c_str(), class_name());
@@ -1336,7 +1340,14 @@ IPFilter::configure(Vector<String> &conf, ErrorHandler *errh)
     parse_program(zprog, conf, noutputs(), this, errh);
 
     if (!errh->nerrors()) {
+        Classification::Wordwise::CompiledProgram jit;
+        if (_use_jit)
+            jit.compile(zprog, offset_net, offset_transp);
         _zprog = zprog;
+        _jit.swap(jit);
+        // After a live reconfiguration, other threads may still be running
+        // the old code: keep it mapped for a grace period
+        _retired_jit.retire(jit);
         return 0;
     }
 
@@ -1352,6 +1363,9 @@ IPFilter::read_handler(Element *e, void *thunk)
         case H_PROGRAM: {
             return ipf->_zprog.unparse();
         }
+        case H_JIT: {
+            return String(ipf->_jit.compiled());
+        }
         case H_CACHE_HITS: {
             if (!ipf->_caching){
                 return "-1";
@@ -1396,10 +1410,18 @@ IPFilter::read_handler(Element *e, void *thunk)
     }
 }
 
+int
+IPFilter::initialize(ErrorHandler *)
+{
+    _retired_jit.initialize(this);
+    return 0;
+}
+
 void
 IPFilter::add_handlers()
 {
     add_read_handler("program", read_handler, H_PROGRAM);
+    add_read_handler("jit", read_handler, H_JIT);
     add_read_handler("cache_hits_count", read_handler, H_CACHE_HITS);
     add_read_handler("cache_misses_count", read_handler, H_CACHE_MISSES);
     add_read_handler("cache_total_count", read_handler, H_CACHE_TOTAL);
@@ -1476,10 +1498,114 @@ IPFilter::length_checked_match(const IPFilterProgram &zprog, const Packet *p, in
 }
 
 #if HAVE_BATCH
+/*
+ * Apply each test to all the packets of the vector that reach it, rather than
+ * running the whole program on one packet after the other. The tested word is
+ * gathered from these packets, and compared against every value of the test
+ * in branch-free loops the compiler vectorizes. Tests are visited in program
+ * order, which is a topological order as all jumps go forward.
+ */
+void
+IPFilter::match_columns(PacketVector &v, int *ports) const
+{
+    const IPFilterProgram &zprog = _zprog;
+    unsigned n = v.count();
+    const unsigned char *region[3][PACKET_VECTOR_CAPACITY];
+    int32_t pc[PACKET_VECTOR_CAPACITY];     // next test of each packet, or -1
+    uint16_t idx[PACKET_VECTOR_CAPACITY];
+    uint32_t data[PACKET_VECTOR_CAPACITY];
+    uint32_t hit[PACKET_VECTOR_CAPACITY];
+
+    int32_t next = -1;
+    for (unsigned i = 0; i < n; i++) {
+        const Packet *p = v[i];
+        int packet_length = p->network_length(),
+            network_header_length = p->network_header_length();
+        if (packet_length > network_header_length)
+            packet_length += offset_transp - network_header_length;
+        else
+            packet_length += offset_net;
+        if (packet_length < (int) zprog.safe_length()) {
+            ports[i] = length_checked_match(zprog, p, packet_length);
+            pc[i] = -1;
+            continue;
+        }
+        region[0][i] = p->mac_header() - 2;
+        region[1][i] = p->network_header();
+        region[2][i] = p->transport_header();
+        pc[i] = 0;
+        next = 0;
+    }
+
+    while (next >= 0) {
+        int32_t w = next;
+        const uint32_t *pr = zprog.begin() + w;
+
+        // Packets at this test, and the next test reached by the others
+        unsigned m = 0;
+        next = -1;
+        for (unsigned i = 0; i < n; i++) {
+            if (pc[i] == w)
+                idx[m++] = i;
+            else if (pc[i] > w && (next < 0 || pc[i] < next))
+                next = pc[i];
+        }
+
+        int off = (int16_t) pr[0];
+        int r = 0;
+        if (off >= offset_transp) {
+            r = 2;
+            off -= offset_transp;
+        } else if (off >= offset_net) {
+            r = 1;
+            off -= offset_net;
+        }
+        const unsigned char **base = region[r];
+        uint32_t mask = pr[3];
+        for (unsigned k = 0; k < m; k++)
+            data[k] = *(const uint32_t *)(base[idx[k]] + off) & mask;
+
+        for (unsigned k = 0; k < m; k++)
+            hit[k] = 0;
+        for (int j = 0, nval = pr[0] >> 17; j < nval; j++) {
+            uint32_t value = pr[4 + j];
+            for (unsigned k = 0; k < m; k++)
+                hit[k] |= (data[k] == value);
+        }
+
+        int32_t yes = pr[2], no = pr[1];
+        for (unsigned k = 0; k < m; k++) {
+            int32_t j = hit[k] ? yes : no;
+            unsigned i = idx[k];
+            if (j > 0) {
+                pc[i] = w + j;
+                if (next < 0 || w + j < next)
+                    next = w + j;
+            } else {
+                pc[i] = -1;
+                ports[i] = -j;
+            }
+        }
+    }
+}
+
 void
 IPFilter::push_batch(int, PacketBatch *batch)
 {
-    CLASSIFY_EACH_PACKET(
+    if (_columnwise && _zprog.output_everything() < 0) {
+        PacketVector v;
+        int ports[PACKET_VECTOR_CAPACITY];
+        while (batch) {
+            batch = v.load(batch);
+            match_columns(v, ports);
+            unsigned i = 0;
+            v.classify(noutputs() + 1, [&ports, &i](Packet*) { return ports[i++]; },
+                       [this](int o, PacketBatch* b) { checked_output_push_batch(o, b); });
+        }
+        return;
+    }
+
+    CLASSIFY_EACH_PACKET_PREFETCH(
         (noutputs() + 1),
         match,
         batch,
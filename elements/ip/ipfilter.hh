@@ -2,6 +2,9 @@
 #define CLICK_IPFILTER_HH
 #include "elements/standard/classification.hh"
 #include <click/batchelement.hh>
+#if HAVE_BATCH
+# include <click/packetvector.hh>
+#endif
 #include <click/ipflowid.hh>
 #include <click/error.hh>
 CLICK_DECLS
@@ -9,7 +12,7 @@ CLICK_DECLS
 /*
 =c
 
-IPFilter([CACHING,] ACTION_1 PATTERN_1, ..., ACTION_N PATTERN_N)
+IPFilter([CACHING, JIT, COLUMNWISE,] ACTION_1 PATTERN_1, ..., ACTION_N PATTERN_N)
 
 =s ip
 
@@ -45,6 +48,26 @@ Arguments:
 
 Boolean. Enables or disables caching. Defaults to false (i.e., no caching).
 
+=item JIT
+
+Boolean. If true, the optimized program is translated to native code when
+the element is configured or reconfigured, and packets are classified by
+running that code instead of interpreting the program. Each test becomes a
+load, a mask and a binary search tree of compare-and-branch instructions, so
+large rule sets cost neither interpretation nor its branch mispredictions.
+Only available at user level on x86-64; elsewhere the program is always
+interpreted. Defaults to true.
+
+=item COLUMNWISE
+
+Boolean. If true, batches are classified one test at a time rather than one
+packet at a time: the word a test checks is loaded from all the packets of
+the batch that reach it, compared against the test values in a loop the
+compiler vectorizes, and the packets are dispatched to the next tests. The
+per-packet branches of the program become data-parallel work, which pays off
+for short rule sets matching a handful of header fields. Long value sets are
+better served by JIT. Incompatible with CACHING. Defaults to false.
+
 =n
 
 Every IPFilter element has an equivalent corresponding IPClassifier element
@@ -116,6 +139,9 @@ is using to classify packets. At each step in the program, four bytes
 of packet data are ANDed with a mask and compared against four bytes of
 classifier pattern.
 
+=h jit read-only
+Returns true if packets are classified by native code (see JIT).
+
 =h cache_hits_count read-only
 If CACHING is enabled, the IPFilter element stores the last rule in a cache.
 This handler returns the number of cache hits (i.e., number of input packets
@@ -171,6 +197,7 @@ class IPFilter : public BatchElement { public:
     bool can_live_reconfigure() const       { return true; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
     void add_handlers() CLICK_COLD;
 
 #if HAVE_BATCH
@@ -319,13 +346,17 @@ class IPFilter : public BatchElement { public:
     };
 
     IPFilterProgram _zprog;
+    Classification::Wordwise::CompiledProgram _jit;
+    Classification::Wordwise::RetiredPrograms _retired_jit;
+    bool _use_jit;
+    bool _columnwise;
     bool _caching;
     IPFilterCache _cache;
 
     static String read_handler(Element *e, void *thunk);
 
     enum {
-        H_PROGRAM,
+        H_PROGRAM, H_JIT,
         H_CACHE_HITS, H_CACHE_MISSES, H_CACHE_TOTAL,
         H_CACHE_HITS_RATIO, H_CACHE_MISSES_RATIO
     };
@@ -369,6 +400,10 @@ class IPFilter : public BatchElement { public:
     };
 
     static int length_checked_match(const IPFilterProgram &zprog, const Packet *p, int packet_length);
+    static inline int interpret_match(const IPFilterProgram &zprog, const Packet *p);
+#if HAVE_BATCH
+    void match_columns(PacketVector &v, int *ports) const;
+#endif
 
 };
 
@@ -430,6 +465,26 @@ IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
         _cache.cache_misses_nb++;
     }
 
+    int port;
+#if CLICK_CLASSIFICATION_JIT
+    Classification::Wordwise::CompiledProgram::function_type fn;
+    if (likely(&zprog == &_zprog && (fn = _jit.function())))
+        port = fn(p->mac_header() - 2, p->network_header(), p->transport_header());
+    else
+#endif
+        port = interpret_match(zprog, p);
+
+    if (_caching) {
+        IPFlow5ID new_flow_id(p);
+        _cache.last_flow_id = &new_flow_id;
+        _cache.last_port = port;
+    }
+    return port;
+}
+
+inline int
+IPFilter::interpret_match(const IPFilterProgram &zprog, const Packet *p)
+{
     const unsigned char *neth_data = p->network_header();
     const unsigned char *transph_data = p->transport_header();
 
@@ -468,14 +523,8 @@ IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
         }
         off = pr[1];
         gotit:
-        if (off <= 0) {
-            if (_caching) {
-                IPFlow5ID new_flow_id(p);
-                _cache.last_flow_id = &new_flow_id;
-                _cache.last_port = -off;
-            }
+        if (off <= 0)
             return -off;
-        }
         pr += off;
     }
 }
@@ -66,12 +66,28 @@ IPMapper::rewrite_flowid(IPRewriterInput *, const IPFlowID &, IPFlowID &,
     return IPRewriterBase::rw_drop;
 }
 
+//
+// IPRewriterHeap
+//
+
+void
+IPRewriterHeap::enable_wheel()
+{
+    if (_use_wheel)
+	return;
+    assert(size() == 0);
+    _use_wheel = true;
+    _wheel_base = click_jiffies();
+    _wheel.initialize(wheel_horizon);
+}
+
 //
 // IPRewriterBase
 //
 
 IPRewriterBase::IPRewriterBase()
-    : _state(), _set_aggregate(false), _handle_migration(false)
+    : _state(), _set_aggregate(false), _handle_migration(false),
+      _sharded(false), _nshards(1)
 {
     _gc_interval_sec = default_gc_interval;
 
@@ -179,6 +195,8 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
     int32_t heapcap;
     bool use_cache = false;
     bool set_aggregate = false;
+    bool sharded = false;
+    bool timer_wheel = false;
     bool _handle_migration; //TODO Temp placeholder
 
     if (Args(this, errh).bind(conf)
@@ -191,9 +209,15 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("USE_CACHE", use_cache)
 	.read("SET_AGGREGATE", set_aggregate)
 	.read("HANDLE_MIGRATION", _handle_migration)
+	.read("SHARDED", sharded)
+	.read("TIMER_WHEEL", timer_wheel)
 	.consume() < 0)
 	return -1;
 
+    if (sharded && this->_handle_migration)
+	return errh->error("SHARDED and HANDLE_MIGRATION are mutually exclusive");
+    _sharded = sharded;
+
 
     for (unsigned i=0; i<_mem_units_no; i++) {
         if (has_timeout[0])
@@ -223,6 +247,10 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
             return errh->error("bad MAPPING_CAPACITY");
     }
 
+    if (timer_wheel)
+	for (unsigned i = 0; i < _mem_units_no; i++)
+	    _heap[i]->enable_wheel();
+
 
 
     if (conf.size() != ninputs())
@@ -253,13 +281,26 @@ IPRewriterBase::initialize(ErrorHandler *errh)
 	    _input_specs[i].u.mapper->notify_rewriter(this, &_input_specs[i], &cerrh);
     }
 
+    if (_sharded) {
+	Bitvector threads = get_passing_threads();
+	_shard_of.assign(click_max_cpu_ids(), -1);
+	_nshards = 0;
+	for (int i = 0; i < threads.size(); i++)
+	    if (threads[i])
+		_shard_of[i] = _nshards++;
+	if (_nshards == 0)
+	    _nshards = 1;
+    }
+
     for (int i = 0; i < _state.weight(); i ++) {
         IPRewriterState &state = _state.get_value(i);
         Timer& gc_timer = state.gc_timer;
         new(&gc_timer) Timer(gc_timer_hook, this); //Reconstruct as Timer does not allow assignment
         gc_timer.initialize(this);
         gc_timer.move_thread(_state.get_mapping(i));
-        if (_gc_interval_sec)
+        if (_heap[_state.get_mapping(i)]->use_wheel())
+            gc_timer.schedule_after(Timestamp::make_jiffies((click_jiffies_t) IPRewriterHeap::wheel_epoch));
+        else if (_gc_interval_sec)
             gc_timer.schedule_after_sec(_gc_interval_sec);
     }
     return errh->nerrors() ? -1 : 0;
@@ -318,15 +359,18 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
 	    return 0;
     }
 
+    // Other threads only read our map while migrating flows
+    if (!_sharded)
 	state.map_lock.write_begin();
     IPRewriterEntry *old = map.set(&flow->entry(false));
+    if (!_sharded)
 	state.map_lock.write_end();
-	if (old) {
-		if (_handle_migration)
-			return old; //TODO : an old flow is back. Change expiry
-		else
-			assert(!old);
-	}
+    if (old) {
+	if (_handle_migration)
+	    return old; //TODO : an old flow is back. Change expiry
+	else
+	    assert(!old);
+    }
 
     auto &heap = _heap[click_current_cpu_id()];
 
@@ -338,10 +382,15 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
 		old->flow()->destroy(heap);
     }
 
-    Vector<IPRewriterFlow *> &myheap = heap->_heaps[flow->guaranteed()];
-    myheap.push_back(flow);
-    push_heap(myheap.begin(), myheap.end(),
-	      IPRewriterFlow::heap_less(), IPRewriterFlow::heap_place());
+    if (heap->_use_wheel) {
+	heap->wheel_schedule(flow);
+	++heap->_wheel_count;
+    } else {
+	Vector<IPRewriterFlow *> &myheap = heap->_heaps[flow->guaranteed()];
+	myheap.push_back(flow);
+	push_heap(myheap.begin(), myheap.end(),
+		  IPRewriterFlow::heap_less(), IPRewriterFlow::heap_place());
+    }
     ++_input_specs[input].count;
 
     if (unlikely(heap->size() > heap->capacity())) {
@@ -360,19 +409,71 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
     }
 
     if (map.unbalanced()) {
-              state.map_lock.write_begin();
-              map.rehash(map.bucket_count() + 1);
-              state.map_lock.write_end();
+	if (!_sharded)
+	    state.map_lock.write_begin();
+	map.rehash(map.bucket_count() + 1);
+	if (!_sharded)
+	    state.map_lock.write_end();
     }
     if (reply_map_ptr != &map && reply_map_ptr->unbalanced()) {
-              state.map_lock.write_begin();
-          reply_map_ptr->rehash(reply_map_ptr->bucket_count() + 1);
-              state.map_lock.write_begin();
+	if (!_sharded)
+	    state.map_lock.write_begin();
+	reply_map_ptr->rehash(reply_map_ptr->bucket_count() + 1);
+	if (!_sharded)
+	    state.map_lock.write_end();
     }
 
     return &flow->entry(false);
 }
 
+void
+IPRewriterBase::run_wheel(IPRewriterHeap *heap, click_jiffies_t now_j)
+{
+    // Visit the due buckets. Flows refreshed since they were scheduled go
+    // back in the wheel for their remaining time.
+    while (!click_jiffies_less(now_j, heap->wheel_due(heap->_wheel.index())))
+	heap->_wheel.run_timers([heap, now_j](IPRewriterFlow *f) {
+	    IPRewriterFlow *next = f->_wheel_next;
+	    f->_wheel_pprev = 0;
+	    if (f->_guaranteed && f->expired(now_j)) {
+		f->_expiry_j = f->owner()->owner->best_effort_expiry(f);
+		f->_guaranteed = false;
+	    }
+	    if (f->expired(now_j))
+		f->destroy(heap);
+	    else
+		heap->wheel_schedule(f);
+	    return next;
+	});
+}
+
+IPRewriterFlow *
+IPRewriterBase::wheel_victim(IPRewriterHeap *heap, click_jiffies_t now_j)
+{
+    // Take the first best-effort flow of the earliest buckets, or the next
+    // to expire of the few flows following it in its bucket. Flows whose
+    // guarantee ended less than an epoch ago are still guaranteed until
+    // their bucket is run; they are only taken if there is no best-effort
+    // flow. Each search looks at most at wheel_victim_scan flows, so a
+    // table full of guaranteed flows costs a bounded time per new flow.
+    auto next = [](IPRewriterFlow *f) {
+	return f->_wheel_next;
+    };
+    IPRewriterFlow *victim = heap->_wheel.find([](IPRewriterFlow *f) {
+	    return !f->guaranteed();
+	}, next, IPRewriterHeap::wheel_victim_scan);
+    if (victim) {
+	IPRewriterFlow *f = victim->_wheel_next;
+	for (int n = IPRewriterHeap::wheel_victim_scan; f && n > 0; f = f->_wheel_next, n--)
+	    if (!f->guaranteed() && click_jiffies_less(f->expiry(), victim->expiry()))
+		victim = f;
+	return victim;
+    }
+    return heap->_wheel.find([now_j](IPRewriterFlow *f) {
+	    return f->expired(now_j);
+	}, next, IPRewriterHeap::wheel_victim_scan);
+}
+
 void
 IPRewriterBase::shift_heap_best_effort(click_jiffies_t now_j)
 {
@@ -386,6 +487,8 @@ IPRewriterBase::shift_heap_best_effort(click_jiffies_t now_j)
 }
 
 int IPRewriterBase::thread_configure(ThreadReconfigurationStage stage, ErrorHandler* errh, Bitvector threads) {
+	if (_sharded) //Shards never migrate, replies follow the port
+		return 0;
 	if (stage == THREAD_RECONFIGURE_UP_PRE) {
         set_migration(true, threads, _state);
 	} else if (stage == THREAD_RECONFIGURE_DOWN_PRE){
@@ -398,6 +501,18 @@ bool
 IPRewriterBase::shrink_heap_for_new_flow(IPRewriterFlow *flow,
 					 click_jiffies_t now_j)
 {
+    IPRewriterHeap *heap = _heap[click_current_cpu_id()];
+    if (heap->_use_wheel) {
+	// Remove the first best-effort flow of the earliest buckets, or the
+	// current flow if none is found
+	run_wheel(heap, now_j);
+	IPRewriterFlow *deadf = wheel_victim(heap, now_j);
+	if (!deadf)
+	    deadf = flow;
+	deadf->destroy(heap);
+	return deadf == flow;
+    }
+
     shift_heap_best_effort(now_j);
     // At this point, all flows in the guarantee heap expire in the future.
     // So remove the next-to-expire best-effort flow, unless there are none.
@@ -417,6 +532,31 @@ void
 IPRewriterBase::shrink_heap(bool clear_all, int thid)
 {
     click_jiffies_t now_j = click_jiffies();
+    IPRewriterHeap *heap = _heap[thid];
+    if (heap->_use_wheel) {
+	if (clear_all) {
+	    heap->_wheel.drain([heap](IPRewriterFlow *f) {
+		IPRewriterFlow *next = f->_wheel_next;
+		f->_wheel_pprev = 0;
+		f->destroy(heap);
+		return next;
+	    });
+	    return;
+	}
+	run_wheel(heap, now_j);
+	while (heap->size() > heap->_capacity) {
+	    IPRewriterFlow *deadf = wheel_victim(heap, now_j);
+	    if (!deadf)
+		deadf = heap->_wheel.find([](IPRewriterFlow *) {
+			return true;
+		    }, [](IPRewriterFlow *f) {
+			return f->_wheel_next;
+		    });
+	    deadf->destroy(heap);
+	}
+	return;
+    }
+
     shift_heap_best_effort(now_j);
     Vector<IPRewriterFlow *> &best_effort_heap = _heap[thid]->_heaps[0];
     while (best_effort_heap.size() && best_effort_heap[0]->expired(now_j))
@@ -434,7 +574,9 @@ IPRewriterBase::gc_timer_hook(Timer *t, void *user_data)
 {
     IPRewriterBase *rw = static_cast<IPRewriterBase *>(user_data);
     rw->shrink_heap(false, click_current_cpu_id());
-    if (rw->_gc_interval_sec)
+    if (rw->_heap[click_current_cpu_id()]->use_wheel())
+        t->reschedule_after(Timestamp::make_jiffies((click_jiffies_t) IPRewriterHeap::wheel_epoch));
+    else if (rw->_gc_interval_sec)
         t->reschedule_after_sec(rw->_gc_interval_sec);
 }
 
@@ -466,6 +608,12 @@ IPRewriterBase::read_handler(Element *e, void *user_data)
     case h_capacity:
 	sa << rw->_heap[click_current_cpu_id()]->_capacity;
 	break;
+    case h_shards:
+	for (int i = 0; i < rw->_shard_of.size(); ++i)
+	    if (rw->_shard_of[i] >= 0)
+		sa << "thread " << i << " shard " << rw->_shard_of[i]
+		   << '/' << rw->_nshards << '\n';
+	break;
     default:
 	for (int i = 0; i < rw->_input_specs.size(); ++i) {
 	    if (what != h_patterns && what != i)
@@ -530,14 +678,27 @@ IPRewriterBase::pattern_write_handler(const String &str, Element *e, void *user_
     assert(click_current_cpu_id() == 0); //MT to be reviewed
 
 	// remove all existing flows created by this input
-	for (int which_heap = 0; which_heap < 2; ++which_heap) {
-	    Vector<IPRewriterFlow *> &myheap = rw->_heap[click_current_cpu_id()]->_heaps[which_heap]; //TODO : Same comment about MT
-	    for (int i = myheap.size() - 1; i >= 0; --i)
-		if (myheap[i]->owner() == spec) {
-		    myheap[i]->destroy(rw->_heap[click_current_cpu_id()]);  //TODO : Same comment about MT
-		    if (i < myheap.size())
-			++i;
-		}
+	IPRewriterHeap *heap = rw->_heap[click_current_cpu_id()];
+	if (heap->use_wheel()) {
+	    heap->_wheel.drain([heap, spec](IPRewriterFlow *f) {
+		IPRewriterFlow *next = f->_wheel_next;
+		f->_wheel_pprev = 0;
+		if (f->owner() == spec)
+		    f->destroy(heap);
+		else
+		    heap->wheel_schedule(f);
+		return next;
+	    });
+	} else {
+	    for (int which_heap = 0; which_heap < 2; ++which_heap) {
+		Vector<IPRewriterFlow *> &myheap = heap->_heaps[which_heap]; //TODO : Same comment about MT
+		for (int i = myheap.size() - 1; i >= 0; --i)
+		    if (myheap[i]->owner() == spec) {
+			myheap[i]->destroy(heap);
+			if (i < myheap.size())
+			    ++i;
+		    }
+	    }
 	}
 
 	// change pattern
@@ -557,6 +718,7 @@ IPRewriterBase::add_rewriter_handlers(bool writable_patterns)
     add_read_handler("patterns", read_handler, h_patterns);
     add_read_handler("size", read_handler, h_size);
     add_read_handler("capacity", read_handler, h_capacity);
+    add_read_handler("shards", read_handler, h_shards);
     add_write_handler("capacity", write_handler, h_capacity);
     add_write_handler("clear", write_handler, h_clear);
     for (int i = 0; i < ninputs(); ++i) {
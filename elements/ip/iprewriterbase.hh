@@ -6,6 +6,7 @@
 #include <click/batchelement.hh>
 #include <click/bitvector.hh>
 #include <click/multithread.hh>
+#include <click/timerwheel.hh>
 #include <click/error.hh>
 #include <click/standard/scheduleinfo.hh>
 
@@ -31,7 +32,7 @@ class IPRewriterInput { public:
     } u;
 
     IPRewriterInput()
-	: kind(i_drop), foutput(-1), routput(-1), count(0), failures(0) {
+	: owner(0), kind(i_drop), foutput(-1), routput(-1), count(0), failures(0) {
 	u.pattern = 0;
     }
 
@@ -47,7 +48,8 @@ class IPRewriterInput { public:
 class IPRewriterHeap { public:
 
     IPRewriterHeap()
-	: _capacity(0x7FFFFFFF), _use_count(1) {
+	: _capacity(0x7FFFFFFF), _use_count(1), _use_wheel(false),
+	  _wheel_count(0), _wheel_base(0) {
     }
     ~IPRewriterHeap() {
 	assert(size() == 0);
@@ -63,12 +65,19 @@ class IPRewriterHeap { public:
     }
 
     Vector<IPRewriterFlow *>::size_type size() const {
-	    return _heaps[0].size() + _heaps[1].size();
+	if (_use_wheel)
+	    return _wheel_count;
+	return _heaps[0].size() + _heaps[1].size();
     }
     int32_t capacity() const {
 	return _capacity;
     }
 
+    bool use_wheel() const {
+	return _use_wheel;
+    }
+    void enable_wheel();
+
   private:
 
     enum {
@@ -78,6 +87,25 @@ class IPRewriterHeap { public:
     int32_t _capacity;
     uint32_t _use_count;
 
+    // Timer wheel mode: flows are kept in coarse buckets and only looked at
+    // when their bucket is due. Refreshing a flow just changes its expiry,
+    // it is put back in the wheel for the remaining time when visited.
+    enum {
+	wheel_epoch = CLICK_HZ,		// jiffies per wheel epoch
+	wheel_horizon = 1 << 23,	// in epochs
+	wheel_victim_scan = 64		// flows looked at to evict one
+    };
+    bool _use_wheel;
+    uint32_t _wheel_count;
+    click_jiffies_t _wheel_base;	// jiffies of epoch 0
+    TimerWheel<IPRewriterFlow> _wheel;
+
+    inline click_jiffies_t wheel_due(uint32_t epoch) const {
+	return _wheel_base + (click_jiffies_t) epoch * wheel_epoch;
+    }
+    inline void wheel_schedule(IPRewriterFlow *flow);
+    inline void wheel_unlink(IPRewriterFlow *flow);
+
     friend class IPRewriterBase;
     friend class IPRewriterFlow;
 
@@ -185,6 +213,13 @@ class IPRewriterBase : public BatchElement { public:
     bool _use_cache;
     bool _handle_migration;
 
+    // In sharded mode, each thread only allocates the pattern ports (or
+    // addresses) equal to its shard modulo _nshards, so that replies can be
+    // steered to the thread owning the flow and no state is ever shared
+    bool _sharded;
+    Vector<int> _shard_of;	// thread id -> shard, or -1
+    uint32_t _nshards;
+
     enum {
 	default_timeout = 300,	   // 5 minutes
 	default_guarantee = 5,	   // 5 seconds
@@ -207,7 +242,7 @@ class IPRewriterBase : public BatchElement { public:
 
     enum {			// < 0 because individual patterns are >= 0
 	h_nmappings = -1, h_mapping_failures = -2, h_patterns = -3,
-	h_size = -4, h_capacity = -5, h_clear = -6
+	h_size = -4, h_capacity = -5, h_clear = -6, h_shards = -7
     };
     static String read_handler(Element *e, void *user_data) CLICK_COLD;
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh) CLICK_COLD;
@@ -219,6 +254,8 @@ class IPRewriterBase : public BatchElement { public:
   private:
 
     void shift_heap_best_effort(click_jiffies_t now_j);
+    static void run_wheel(IPRewriterHeap *heap, click_jiffies_t now_j);
+    static IPRewriterFlow *wheel_victim(IPRewriterHeap *heap, click_jiffies_t now_j);
     bool shrink_heap_for_new_flow(IPRewriterFlow *flow, click_jiffies_t now_j);
     void shrink_heap(bool clear_all, int thid);
 
@@ -260,7 +297,15 @@ IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
 	    reply_map = &reply_element->_state->map;
 	else
 	    reply_map = reply_element->get_map(mapid);
-	i = u.pattern->rewrite_flowid(flowid, rewritten_flowid, *reply_map);
+	if (owner && owner->_sharded) {
+	    int shard = owner->_shard_of[click_current_cpu_id()];
+	    if (unlikely(shard < 0))
+		i = IPRewriterBase::rw_drop;
+	    else
+		i = u.pattern->rewrite_flowid(flowid, rewritten_flowid, *reply_map,
+					      shard, owner->_nshards);
+	} else
+	    i = u.pattern->rewrite_flowid(flowid, rewritten_flowid, *reply_map);
 	goto check_for_failure;
     }
     case i_mapper:
@@ -291,6 +336,39 @@ IPRewriterBase::unmap_flow(IPRewriterFlow *flow, Map &map,
 	reply_map_ptr->erase(it);
 }
 
+inline void
+IPRewriterHeap::wheel_schedule(IPRewriterFlow *flow)
+{
+    uint32_t index = _wheel.index();
+    click_jiffies_t now_due = wheel_due(index);
+    uint32_t timeout = 1;
+    if (click_jiffies_less(now_due, flow->_expiry_j)) {
+	click_jiffies_t d = flow->_expiry_j - now_due;
+	timeout = (d + wheel_epoch - 1) / wheel_epoch;
+	if (timeout > wheel_horizon)
+	    timeout = wheel_horizon;
+    }
+    flow->_place = index + timeout;
+    _wheel.schedule_after_head(flow, timeout, [](IPRewriterFlow *f, IPRewriterFlow **head) {
+	f->_wheel_next = *head;
+	f->_wheel_pprev = head;
+	if (*head)
+	    (*head)->_wheel_pprev = &f->_wheel_next;
+	*head = f;
+    });
+}
+
+inline void
+IPRewriterHeap::wheel_unlink(IPRewriterFlow *flow)
+{
+    if (flow->_wheel_pprev) {
+	*flow->_wheel_pprev = flow->_wheel_next;
+	if (flow->_wheel_next)
+	    flow->_wheel_next->_wheel_pprev = flow->_wheel_pprev;
+	flow->_wheel_pprev = 0;
+    }
+}
+
 inline IPRewriterEntry *
 IPRewriterBase::search_entry(const IPFlowID &flowid)
 {
@@ -28,6 +28,9 @@
 #include <click/error.hh>
 #include <click/glue.hh>
 #include <click/straccum.hh>
+#if HAVE_BATCH
+# include <click/packetvector.hh>
+#endif
 #include <click/router.hh>
 #include "iproutetable.hh"
 CLICK_DECLS
@@ -143,6 +146,24 @@ IPRouteTable::lookup_route(IPAddress, IPAddress&) const
     return -1;			// by default, route lookups fail
 }
 
+void
+IPRouteTable::lookup_route_batch(const IPAddress* addrs, int n, int* ports, IPAddress* gws) const
+{
+    for (int i = 0; i < n; i++)
+        ports[i] = lookup_route(addrs[i], gws[i]);
+}
+
+int
+IPRouteTable::begin_update(ErrorHandler *)
+{
+    return 0;			// by default, routes change in place
+}
+
+void
+IPRouteTable::end_update(bool)
+{
+}
+
 String
 IPRouteTable::dump_routes()
 {
@@ -182,9 +203,37 @@ IPRouteTable::push(int port, Packet *p)
 
 #if HAVE_BATCH
 void
-IPRouteTable::push_batch(int port, PacketBatch *batch)
+IPRouteTable::push_batch(int, PacketBatch *batch)
 {
-    CLASSIFY_EACH_PACKET(noutputs() + 1,([this,port](Packet* p){return process(port,p);}),batch,checked_output_push_batch);
+    PacketVector v;
+    IPAddress addrs[PACKET_VECTOR_CAPACITY];
+    IPAddress gws[PACKET_VECTOR_CAPACITY];
+    int ports[PACKET_VECTOR_CAPACITY];
+
+    while (batch) {
+        batch = v.load(batch);
+        unsigned n = v.count();
+        for (unsigned i = 0; i < n; i++)
+            addrs[i] = v[i]->dst_ip_anno();
+
+        lookup_route_batch(addrs, n, ports, gws);
+
+        for (unsigned i = 0; i < n; i++) {
+            if (ports[i] >= 0) {
+                assert(ports[i] < noutputs());
+                if (gws[i])
+                    v[i]->set_dst_ip_anno(gws[i]);
+            } else {
+                static int complained = 0;
+                if (++complained <= 5)
+                    click_chatter("IPRouteTable: no route for %s", addrs[i].unparse().c_str());
+            }
+        }
+
+        unsigned i = 0;
+        v.classify(noutputs() + 1, [&ports, &i](Packet*) { return ports[i++]; },
+                   [this](int o, PacketBatch* b) { checked_output_push_batch(o, b); });
+    }
 }
 #endif
 
@@ -231,14 +280,24 @@ int
 IPRouteTable::add_route_handler(const String &conf, Element *e, void *thunk, ErrorHandler *errh)
 {
     IPRouteTable *table = static_cast<IPRouteTable *>(e);
-    return table->run_command((thunk ? CMD_SET : CMD_ADD), conf, 0, errh);
+    int r = table->begin_update(errh);
+    if (r < 0)
+	return r;
+    r = table->run_command((thunk ? CMD_SET : CMD_ADD), conf, 0, errh);
+    table->end_update(r >= 0);
+    return r;
 }
 
 int
 IPRouteTable::remove_route_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
 {
     IPRouteTable *table = static_cast<IPRouteTable *>(e);
-    return table->run_command(CMD_REMOVE, conf, 0, errh);
+    int r = table->begin_update(errh);
+    if (r < 0)
+	return r;
+    r = table->run_command(CMD_REMOVE, conf, 0, errh);
+    table->end_update(r >= 0);
+    return r;
 }
 
 int
@@ -249,7 +308,12 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
     const char* s = conf.begin(), *end = conf.end();
 
     Vector<IPRoute> old_routes;
-    int r = 0;
+    int r = table->begin_update(errh);
+    if (r < 0)
+	return r;
+    // With a private copy, dropping it is enough to roll back
+    bool shadow = r > 0;
+    r = 0;
 
     while (s < end) {
 	const char* nl = find(s, end, '\n');
@@ -263,18 +327,21 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
 	    command = CMD_REMOVE;
 	else if (first_word == "set")
 	    command = CMD_SET;
-	else if (!first_word)
+	else if (!first_word) {
+	    s = nl + 1;
 	    continue;
+	}
 	else {
 	    r = errh->error("bad command %<%#s%>", first_word.c_str());
 	    goto rollback;
 	}
 
-	if ((r = table->run_command(command, line, &old_routes, errh)) < 0)
+	if ((r = table->run_command(command, line, shadow ? 0 : &old_routes, errh)) < 0)
 	    goto rollback;
 
 	s = nl + 1;
     }
+    table->end_update(true);
     return 0;
 
   rollback:
@@ -288,6 +355,7 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
 	    table->add_route(rt, true, 0, errh);
 	old_routes.pop_back();
     }
+    table->end_update(false);
     return r;
 }
 
@@ -108,6 +108,27 @@ Looks up the route associated with address C<dst>. Should set C<gw_return> to
 the resulting gateway and return the relevant output port (or negative if
 there is no route). The default implementation returns -1.
 
+=item C<void B<lookup_route_batch>(const IPAddress *dst, int n, int *ports, IPAddress *gws) const>
+
+Looks up the routes of the C<n> addresses of C<dst>, as B<lookup_route> would
+for each of them, storing the output ports in C<ports> and the gateways in
+C<gws>. Tables can override it to overlap the memory accesses of several
+lookups. The default implementation calls B<lookup_route> for each address.
+
+=item C<int B<begin_update>(ErrorHandler *errh)>
+
+Called by the handlers before they change routes. Tables that can be read by
+other threads while routes change may then start a private copy of the table,
+to which following B<add_route> and B<remove_route> calls apply. Should return
+1 in that case, 0 if routes are changed in place, and negative on failure. The
+default implementation returns 0.
+
+=item C<void B<end_update>(bool commit)>
+
+Called by the handlers after they changed routes. If C<commit> is true, the
+private copy started by B<begin_update> replaces the current table at once;
+otherwise it is dropped. The default implementation does nothing.
+
 =item C<String B<dump_routes>()>
 
 Returns a textual description of the current routing table. The default
@@ -132,6 +153,12 @@ The default implementation of B<push> uses B<lookup_route> to perform IP
 routing lookup. Normally, subclasses implement their own B<push> methods,
 avoiding virtual function call overhead.
 
+=item C<void B<push_batch>(int port, PacketBatch *batch)>
+
+The default implementation of B<push_batch> resolves the destinations of up to
+PACKET_VECTOR_CAPACITY packets at a time with B<lookup_route_batch>, then
+splits the batch by output port.
+
 =item C<static int B<add_route_handler>(const String &, Element *, void *, ErrorHandler *)>
 
 This write handler callback parses its input as an add-route request
@@ -147,8 +174,9 @@ handler.
 =item C<static int B<ctrl_handler>(const String &, Element *, void *, ErrorHandler *)>
 
 This write handler callback function parses its input as a route control
-request and calls B<add_route> or B<remove_route> as directed. Normally hooked
-up to the `C<ctrl>' handler.
+request and calls B<add_route> or B<remove_route> as directed. All the
+commands are applied within a single B<begin_update>/B<end_update> pair.
+Normally hooked up to the `C<ctrl>' handler.
 
 =item C<static String B<table_handler>(Element *, void *)>
 
@@ -194,6 +222,9 @@ class IPRouteTable : public BatchElement { public:
     virtual int add_route(const IPRoute& route, bool allow_replace, IPRoute* replaced_route, ErrorHandler* errh);
     virtual int remove_route(const IPRoute& route, IPRoute* removed_route, ErrorHandler* errh);
     virtual int lookup_route(IPAddress addr, IPAddress& gw) const = 0;
+    virtual void lookup_route_batch(const IPAddress* addrs, int n, int* ports, IPAddress* gws) const;
+    virtual int begin_update(ErrorHandler* errh);
+    virtual void end_update(bool commit);
     virtual String dump_routes();
 
     void push(int, Packet      *p);
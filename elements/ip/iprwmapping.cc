@@ -39,7 +39,7 @@ IPRewriterFlow::IPRewriterFlow(IPRewriterInput *owner, const IPFlowID &flowid,
 				   uint8_t input)
     : _expiry_j(expiry_j), _ip_p(ip_p), _tflags(0),
       _guaranteed(guaranteed), _reply_anno(0),
-      _owner(owner), _input(input)
+      _owner(owner), _input(input), _wheel_next(0), _wheel_pprev(0)
 {
     _e[0].initialize(flowid, owner->foutput, false);
     _e[1].initialize(rewritten_flowid.reverse(), owner->routput, true);
@@ -96,6 +96,17 @@ void
 IPRewriterFlow::change_expiry(IPRewriterHeap *h, bool guaranteed,
 			      click_jiffies_t expiry_j)
 {
+    if (h->_use_wheel) {
+	// Lazy: the flow is looked at again when its bucket is due, unless
+	// it now expires before that
+	_expiry_j = expiry_j;
+	_guaranteed = guaranteed;
+	if (click_jiffies_less(expiry_j, h->wheel_due(_place))) {
+	    h->wheel_unlink(this);
+	    h->wheel_schedule(this);
+	}
+	return;
+    }
     Vector<IPRewriterFlow *> &current_heap = h->_heaps[_guaranteed];
     assert(current_heap[_place] == this);
     _expiry_j = expiry_j;
@@ -118,10 +129,15 @@ IPRewriterFlow::change_expiry(IPRewriterHeap *h, bool guaranteed,
 void
 IPRewriterFlow::destroy(IPRewriterHeap *heap)
 {
-    Vector<IPRewriterFlow *> &myheap = heap->_heaps[_guaranteed];
-    remove_heap(myheap.begin(), myheap.end(), myheap.begin() + _place,
-		heap_less(), heap_place());
-    myheap.pop_back();
+    if (heap->_use_wheel) {
+	heap->wheel_unlink(this);
+	--heap->_wheel_count;
+    } else {
+	Vector<IPRewriterFlow *> &myheap = heap->_heaps[_guaranteed];
+	remove_heap(myheap.begin(), myheap.end(), myheap.begin() + _place,
+		    heap_less(), heap_place());
+	myheap.pop_back();
+    }
     --_owner->count;
     _owner->owner->destroy_flow(this);
 }
@@ -173,9 +173,12 @@ class IPRewriterFlow { public:
     uint8_t _input;
     IPRewriterInput *_owner;
     uint32_t _agg;
+    IPRewriterFlow *_wheel_next;	// in timer wheel mode, _place is the
+    IPRewriterFlow **_wheel_pprev;	//   epoch of the bucket
 
     friend class IPRewriterBase;
     friend class IPRewriterEntry;
+    friend class IPRewriterHeap;
 
   private:
 
@@ -39,7 +39,8 @@ IPRewriterPattern::IPRewriterPattern(const IPAddress &saddr, int sport,
 		       bool is_napt, bool sequential, bool same_first,
 		       uint32_t variation_top)
     : _saddr(saddr), _sport(sport), _daddr(daddr), _dport(dport),
-      _variation_top(variation_top),_is_napt(is_napt),
+      _variation_top(variation_top), _shard_next_variation(0),
+      _is_napt(is_napt),
       _sequential(sequential), _same_first(same_first), _refcount(0)
 {
     _next_variation = 0;
@@ -217,10 +218,96 @@ IPRewriterPattern::parse_with_ports(const String &conf, IPRewriterInput *input,
 	&& parse_ports(port_words, input, e, errh);
 }
 
+bool
+IPRewriterPattern::choose_variation(IPFlowID &lookup, uint32_t base,
+				    const IPFlowID &flowid,
+				    const HashContainer<IPRewriterEntry> &reply_map)
+{
+    uint32_t next = _next_variation;
+    uint32_t val;
+    if (_same_first
+	&& (val = ntohs(flowid.sport()) - base) <= _variation_top) {
+	lookup.set_dport(flowid.sport());
+	if (!reply_map.find(lookup))
+	    goto found_variation;
+    }
+
+ retry_variation:
+    if (_sequential)
+	val = (next > _variation_top ? 0 : next);
+    else
+	val = click_random(0, _variation_top);
+
+    for (uint32_t count = 0; count <= _variation_top;
+	 ++count, val = (val == _variation_top ? 0 : val + 1)) {
+	if (_is_napt)
+	    lookup.set_dport(htons(base + val));
+	else
+	    lookup.set_daddr(htonl(base + val));
+	//Verify that the new variation is not already in the map
+	if (!reply_map.find(lookup))
+	    goto found_variation;
+    }
+
+    return false;
+
+ found_variation:
+    if ((_next_variation.compare_swap(next, val + 1) != next))
+	goto retry_variation;
+    return true;
+}
+
+bool
+IPRewriterPattern::choose_shard_variation(IPFlowID &lookup, uint32_t base,
+					  const IPFlowID &flowid,
+					  const HashContainer<IPRewriterEntry> &reply_map,
+					  uint32_t shard, uint32_t nshards)
+{
+    // The shard owns variations first, first + nshards, first + 2*nshards...
+    // Its cursor is private to the thread, so nothing is shared with the
+    // other shards.
+    uint32_t first = (shard + nshards - base % nshards) % nshards;
+    if (first > _variation_top)
+	return false;
+    uint32_t top = (_variation_top - first) / nshards;
+    uint32_t &next = *_shard_next_variation;
+    uint32_t val;
+
+    if (_same_first && _is_napt
+	&& (val = ntohs(flowid.sport()) - base) <= _variation_top
+	&& val % nshards == first) {
+	lookup.set_dport(flowid.sport());
+	if (!reply_map.find(lookup))
+	    return true;
+    }
+
+    uint32_t i;
+    if (_sequential)
+	i = (next > top ? 0 : next);
+    else
+	i = click_random(0, top);
+
+    for (uint32_t count = 0; count <= top;
+	 ++count, i = (i == top ? 0 : i + 1)) {
+	val = first + i * nshards;
+	if (_is_napt)
+	    lookup.set_dport(htons(base + val));
+	else
+	    lookup.set_daddr(htonl(base + val));
+	if (!reply_map.find(lookup)) {
+	    next = i + 1;
+	    return true;
+	}
+    }
+
+    return false;
+}
+
 int
 IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 				  IPFlowID &rewritten_flowid,
-				  const HashContainer<IPRewriterEntry> &reply_map)
+				  const HashContainer<IPRewriterEntry> &reply_map,
+				  uint32_t shard, uint32_t nshards)
 {
     rewritten_flowid = flowid;
     if (_saddr)
@@ -236,37 +323,13 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 	IPFlowID lookup = rewritten_flowid.reverse();
 	uint32_t base = (_is_napt ? ntohs(_sport) : ntohl(_saddr.addr()));
 
-    uint32_t next = _next_variation;
-	uint32_t val;
-	if (_same_first
-	    && (val = ntohs(flowid.sport()) - base) <= _variation_top) {
-	    lookup.set_dport(flowid.sport());
-	    if (!reply_map.find(lookup))
-		goto found_variation;
-	}
-
- retry_variation:
-	if (_sequential)
-	    val = (next > _variation_top ? 0 : next);
-	else
-	    val = click_random(0, _variation_top);
-
-	for (uint32_t count = 0; count <= _variation_top;
-	     ++count, val = (val == _variation_top ? 0 : val + 1)) {
-	    if (_is_napt)
-		lookup.set_dport(htons(base + val));
-	    else
-		lookup.set_daddr(htonl(base + val));
-        //Verify that the new variation is not already in the map
-	    if (!reply_map.find(lookup))
-		goto found_variation;
-	}
-
-	return IPRewriterBase::rw_drop;
+	if (nshards > 1) {
+	    if (!choose_shard_variation(lookup, base, flowid, reply_map,
+					shard, nshards))
+		return IPRewriterBase::rw_drop;
+	} else if (!choose_variation(lookup, base, flowid, reply_map))
+	    return IPRewriterBase::rw_drop;
 
-found_variation:
-	if ((_next_variation.compare_swap(next, val + 1) != next))
-        goto retry_variation;
 	if (_is_napt)
 	    rewritten_flowid.set_sport(lookup.dport());
 	else
@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/hashcontainer.hh>
 #include <click/ipflowid.hh>
+#include <click/sync.hh>
 CLICK_DECLS
 class IPRewriterFlow;
 class IPRewriterEntry;
@@ -37,8 +38,11 @@ class IPRewriterPattern { public:
 	return _daddr;
     }
 
+    // With nshards > 1, only variations whose port (or address, if not
+    // NAPT) equals shard modulo nshards are chosen
     int rewrite_flowid(const IPFlowID &flowid, IPFlowID &rewritten_flowid,
-		       const HashContainer<IPRewriterEntry> &reply_map);
+		       const HashContainer<IPRewriterEntry> &reply_map,
+		       uint32_t shard = 0, uint32_t nshards = 1);
 
     String unparse() const;
 
@@ -51,6 +55,7 @@ class IPRewriterPattern { public:
 
     uint32_t _variation_top;
     atomic_uint32_t _next_variation;
+    per_thread<uint32_t> _shard_next_variation;
 
     bool _is_napt;
     bool _sequential;
@@ -58,6 +63,14 @@ class IPRewriterPattern { public:
 
     int _refcount;
 
+    bool choose_variation(IPFlowID &lookup, uint32_t base,
+			  const IPFlowID &flowid,
+			  const HashContainer<IPRewriterEntry> &reply_map);
+    bool choose_shard_variation(IPFlowID &lookup, uint32_t base,
+				const IPFlowID &flowid,
+				const HashContainer<IPRewriterEntry> &reply_map,
+				uint32_t shard, uint32_t nshards);
+
     IPRewriterPattern(const IPRewriterPattern&);
     IPRewriterPattern& operator=(const IPRewriterPattern&);
 
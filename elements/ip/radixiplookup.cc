@@ -31,6 +31,7 @@ CLICK_DECLS
 class RadixIPLookup::Radix { public:
 
     static Radix *make_radix(int level);
+    static Radix *copy_radix(const Radix *r, int level);
     static void free_radix(Radix *r, int level);
 
     int change(uint32_t addr, uint32_t mask, int key, bool set, int level);
@@ -86,9 +87,10 @@ const int RadixIPLookup::Radix::_nbuckets [5] = {65536, 16, 16, 16, 16};
     
 int
 RadixIPLookup::find_lookup_key(IPAddress gw, int32_t port) {
-    for(int i=0; i  < _lookup.size(); i++) {
-	if(_lookup[i].gw == gw  &&
-	   _lookup[i].port == port) 
+    const Vector<GWPort> &lookup = writable().lookup;
+    for(int i=0; i  < lookup.size(); i++) {
+	if(lookup[i].gw == gw  &&
+	   lookup[i].port == port) 
 	    return (i + 1);
     }
     return 0;
@@ -105,6 +107,26 @@ RadixIPLookup::Radix::make_radix(int level)
 	return 0;
 }
 
+RadixIPLookup::Radix*
+RadixIPLookup::Radix::copy_radix(const Radix *r, int level)
+{
+    int n = _nbuckets[level];
+    Radix *c = make_radix(level);
+    if (!c)
+	return 0;
+    memcpy(c->_children, r->_children, n * sizeof(Child) + (n - 2) * sizeof(int));
+    for (int i = 0; i < n; i++)
+	if (r->_children[i].child
+	    && !(c->_children[i].child = copy_radix(r->_children[i].child, level + 1))) {
+	    // the children from i on still point into r
+	    for (; i < n; i++)
+		c->_children[i].child = 0;
+	    free_radix(c, level);
+	    return 0;
+	}
+    return c;
+}
+
 void
 RadixIPLookup::Radix::free_radix(Radix* r, int level)
 {
@@ -160,9 +182,43 @@ RadixIPLookup::Radix::change(uint32_t addr, uint32_t mask, int key, bool set, in
 }
 
 
+RadixIPLookup::Table::Table()
+    : vfree(-1), default_key(0), radix(Radix::make_radix(0))
+{
+}
+
+RadixIPLookup::Table::Table(const Table &t)
+    : v(t.v), vfree(t.vfree), lookup(t.lookup), default_key(t.default_key),
+      radix(Radix::copy_radix(t.radix, 0))
+{
+}
+
+RadixIPLookup::Table::~Table()
+{
+    if (radix)
+	Radix::free_radix(radix, 0);
+}
+
+inline int
+RadixIPLookup::Table::lookup_route(IPAddress addr, IPAddress &gw) const
+{
+    int level = 0;
+    int key = Radix::lookup(radix, default_key, ntohl(addr.addr()), level);
+    int lookup_key = get_lookup_key(key);
+    if (lookup_key) {
+	gw = lookup[lookup_key - 1].gw;
+	return lookup[lookup_key - 1].port;
+    } else {
+	gw = 0;
+	return -1;
+    }
+}
+
+
 RadixIPLookup::RadixIPLookup()
-    : _vfree(-1), _default_key(0), _radix(Radix::make_radix(0))
+    : _current(new Table), _shadow(0)
 {
+    _table.initialize(_current);
 }
 
 RadixIPLookup::~RadixIPLookup()
@@ -173,10 +229,9 @@ RadixIPLookup::~RadixIPLookup()
 void
 RadixIPLookup::cleanup(CleanupStage)
 {
-    int level = 0;
-    _v.clear();
-    Radix::free_radix(_radix, level);
-    _radix = 0;
+    delete _shadow;
+    delete _current;
+    _shadow = _current = 0;
 }
 
 void
@@ -189,12 +244,13 @@ RadixIPLookup::add_handlers()
 String
 RadixIPLookup::dump_routes()
 {
+    Table &t = writable();
     StringAccum sa;
-    for (int j = _vfree; j >= 0; j = _v[j].extra)
-	_v[j].kill();
-    for (int i = 0; i < _v.size(); i++)
-	if (_v[i].real())
-	    _v[i].unparse(sa, true) << '\n';
+    for (int j = t.vfree; j >= 0; j = t.v[j].extra)
+	t.v[j].kill();
+    for (int i = 0; i < t.v.size(); i++)
+	if (t.v[i].real())
+	    t.v[i].unparse(sa, true) << '\n';
     return sa.take_string();
 }
 
@@ -202,45 +258,46 @@ RadixIPLookup::dump_routes()
 int
 RadixIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, ErrorHandler *)
 {
-    int found = (_vfree < 0 ? _v.size() : _vfree), last_key;
+    Table &t = writable();
+    int found = (t.vfree < 0 ? t.v.size() : t.vfree), last_key;
     int lookup_key = find_lookup_key(route.gw, route.port);
     if(!lookup_key) 
-	lookup_key = _lookup.size() + 1;
+	lookup_key = t.lookup.size() + 1;
 		    
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
 	int level = 0;
-	last_key = _radix->change(addr, mask, combine_key(found + 1, lookup_key), set, level);
+	last_key = t.radix->change(addr, mask, combine_key(found + 1, lookup_key), set, level);
 	// The key returned by change is the combined key, we need only the _v key.
 	last_key = get_key(last_key);
     } else {
-	last_key = get_key(_default_key);
+	last_key = get_key(t.default_key);
 	if (!last_key || set)
-	    _default_key = combine_key(found + 1, lookup_key);
+	    t.default_key = combine_key(found + 1, lookup_key);
     }
 
     if (last_key && old_route)
-	*old_route = _v[last_key - 1];
+	*old_route = t.v[last_key - 1];
     if (last_key && !set)
 	return -EEXIST;
 
-    if (lookup_key == (_lookup.size() + 1)) {
+    if (lookup_key == (t.lookup.size() + 1)) {
 	GWPort gw_port = {route.gw, route.port};
-	_lookup.push_back(gw_port);
+	t.lookup.push_back(gw_port);
     }
 
-    if (found == _v.size())
-	_v.push_back(route);
+    if (found == t.v.size())
+	t.v.push_back(route);
     else {
-	_vfree = _v[found].extra;
-	_v[found] = route;
+	t.vfree = t.v[found].extra;
+	t.v[found] = route;
     }
-    _v[found].extra = -1;
+    t.v[found].extra = -1;
 
     if (last_key) {
-	_v[last_key - 1].extra = _vfree;
-	_vfree = last_key - 1;
+	t.v[last_key - 1].extra = t.vfree;
+	t.vfree = last_key - 1;
     }
 
     return 0;
@@ -249,57 +306,100 @@ RadixIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, Err
 int
 RadixIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler*)
 {
+    Table &t = writable();
     int last_key;
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
 	int level = 0;
 	// NB: this will never actually make changes
-	last_key = get_key(_radix->change(addr, mask, 0, false, level));
+	last_key = get_key(t.radix->change(addr, mask, 0, false, level));
     } else
-	last_key = get_key(_default_key);
+	last_key = get_key(t.default_key);
 
     if (last_key && old_route)
-	*old_route = _v[last_key - 1];
-    if (!last_key || !route.match(_v[last_key - 1]))
+	*old_route = t.v[last_key - 1];
+    if (!last_key || !route.match(t.v[last_key - 1]))
 	return -ENOENT;
-    _v[last_key - 1].extra = _vfree;
-    _vfree = last_key - 1;
+    t.v[last_key - 1].extra = t.vfree;
+    t.vfree = last_key - 1;
 
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
 	int level = 0;
-	(void) _radix->change(addr, mask, 0, true, level);
+	(void) t.radix->change(addr, mask, 0, true, level);
     } else
-	_default_key = 0;
+	t.default_key = 0;
     return 0;
 }
 
 int
 RadixIPLookup::lookup_route(IPAddress addr, IPAddress &gw) const
 {
-    int level = 0;    
-    int key = Radix::lookup(_radix, _default_key, ntohl(addr.addr()), level);
-    int lookup_key = get_lookup_key(key);
-    if (lookup_key) {
-	gw = _lookup[lookup_key - 1].gw;
-	return _lookup[lookup_key - 1].port;
-    } else {
-	gw = 0;
-	return -1;
+    int flags;
+    const Table *t = _table.read_begin(flags);
+    int port = t->lookup_route(addr, gw);
+    _table.read_end(flags);
+    return port;
+}
+
+void
+RadixIPLookup::lookup_route_batch(const IPAddress *addrs, int n, int *ports, IPAddress *gws) const
+{
+    int flags;
+    const Table *t = _table.read_begin(flags);
+    for (int i = 0; i < n; i++)
+	ports[i] = t->lookup_route(addrs[i], gws[i]);
+    _table.read_end(flags);
+}
+
+int
+RadixIPLookup::begin_update(ErrorHandler *errh)
+{
+    assert(!_shadow);
+    _shadow = new Table(*_current);
+    if (!_shadow || !_shadow->radix) {
+	delete _shadow;
+	_shadow = 0;
+	return errh->error("out of memory");
     }
+    return 1;
+}
+
+void
+RadixIPLookup::end_update(bool commit)
+{
+    Table *t = _shadow;
+    _shadow = 0;
+    if (commit)
+	swap_table(t);
+    else
+	delete t;
+}
+
+/*
+ * Make @a t the table used by lookups, then free the previous one. The
+ * second, empty, write waits until no reader may still use the previous
+ * table.
+ */
+void
+RadixIPLookup::swap_table(Table *t)
+{
+    Table *old = _current;
+    int flags;
+    _table.write_begin(flags) = t;
+    _table.write_commit(flags);
+    _current = t;
+    _table.write_begin(flags);
+    _table.write_commit(flags);
+    delete old;
 }
 
 void
 RadixIPLookup::flush_table()
 {
-    int level = 0;
-    _v.clear();
-    Radix::free_radix(_radix, level);
-    _radix = Radix::make_radix(0);
-    _vfree = -1;
-    _default_key = 0;
+    swap_table(new Table);
 }
 
 int
@@ -3,6 +3,7 @@
 #define CLICK_RADIXIPLOOKUP_HH
 #include <click/glue.hh>
 #include <click/element.hh>
+#include <click/multithread.hh>
 #include "iproutetable.hh"
 CLICK_DECLS
 
@@ -31,6 +32,13 @@ gateway IP address, and an output port.
 
 Uses the IPRouteTable interface; see IPRouteTable for description.
 
+Route changes made through the handlers never modify the table used by the
+data path. They are applied to a private copy, which then replaces the current
+table with a read-copy-update swap. The old table is freed once no thread uses
+it anymore. Worker threads thus never block and never see a half-updated
+table. Use the C<ctrl> handler to apply many changes, such as a BGP
+convergence event, with a single copy and swap.
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -85,6 +93,9 @@ class RadixIPLookup : public IPRouteTable { public:
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_route_batch(const IPAddress *, int, int *, IPAddress *) const;
+    int begin_update(ErrorHandler *);
+    void end_update(bool);
     int find_lookup_key(IPAddress gw, int port);
     String dump_routes();
 
@@ -115,15 +126,33 @@ class RadixIPLookup : public IPRouteTable { public:
 
     class Radix;
 
-    // Simple routing table
-    Vector<IPRoute> _v;
-    int _vfree;
-    
-    // Compressed routing table holding unique values of (gw, port).
-    Vector<GWPort> _lookup;
+    // One version of the routing table
+    struct Table {
+	Table();
+	Table(const Table &t);
+	~Table();
+
+	inline int lookup_route(IPAddress addr, IPAddress &gw) const;
+
+	// Simple routing table
+	Vector<IPRoute> v;
+	int vfree;
+
+	// Compressed routing table holding unique values of (gw, port).
+	Vector<GWPort> lookup;
+
+	int default_key;
+	Radix *radix;
+    };
+
+    // Table used by lookups, swapped by end_update()
+    mutable fast_rcu<Table *> _table;
+    Table *_current;
+    // Private copy being updated between begin_update() and end_update()
+    Table *_shadow;
 
-    int _default_key;
-    Radix *_radix;
+    Table &writable()			{ return _shadow ? *_shadow : *_current; }
+    void swap_table(Table *t);
 
 };
 
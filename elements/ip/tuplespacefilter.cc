@@ -0,0 +1,512 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * tuplespacefilter.{cc,hh} -- 5-tuple packet filter using tuple space search
+ */
+
+#include <click/config.h>
+#include "tuplespacefilter.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/ipaddress.hh>
+#if HAVE_BATCH
+# include <click/packetvector.hh>
+#endif
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+TupleSpaceFilter::TupleSpaceFilter()
+{
+}
+
+TupleSpaceFilter::~TupleSpaceFilter()
+{
+}
+
+int
+TupleSpaceFilter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    flush();
+    for (int i = 0; i < conf.size(); i++) {
+        PrefixErrorHandler cerrh(errh, "pattern " + String(i) + ": ");
+        add_rule(i * 10, conf[i], &cerrh);
+    }
+    sort_tuples();
+    return errh->nerrors() ? -1 : 0;
+}
+
+void
+TupleSpaceFilter::cleanup(CleanupStage)
+{
+    flush();
+}
+
+void
+TupleSpaceFilter::flush()
+{
+    for (int i = 0; i < _tuples.size(); i++)
+        delete _tuples[i];
+    _tuples.clear();
+    _tuple_index.clear();
+    _rules.clear();
+}
+
+/**
+ * Append to @a out the prefixes covering the port range [@a lo, @a hi], as
+ * (value, mask) pairs in host byte order.
+ */
+static void
+port_prefixes(uint32_t lo, uint32_t hi, Vector<uint32_t> &out)
+{
+    while (lo <= hi) {
+        uint32_t size = lo ? (lo & -lo) : 0x10000;
+        while (lo + size - 1 > hi)
+            size >>= 1;
+        out.push_back(lo);
+        out.push_back(~(size - 1) & 0xFFFF);
+        lo += size;
+    }
+}
+
+static bool
+parse_protocol(const String &word, int &proto)
+{
+    if (word == "tcp")
+        proto = IP_PROTO_TCP;
+    else if (word == "udp")
+        proto = IP_PROTO_UDP;
+    else if (word == "icmp")
+        proto = IP_PROTO_ICMP;
+    else if (!IntArg().parse(word, proto) || proto < 0 || proto > 255)
+        return false;
+    return true;
+}
+
+/**
+ * Parse the rule @a text into its action and its entries in the tuples.
+ */
+int
+TupleSpaceFilter::parse_rule(const String &text, Rule &rule, ErrorHandler *errh) const
+{
+    Vector<String> words;
+    cp_spacevec(text, words);
+    if (!words.size())
+        return errh->error("empty rule");
+
+    const String &action = words[0];
+    if (action == "allow")
+        rule.output = 0;
+    else if (action == "deny" || action == "drop")
+        rule.output = -1;
+    else if (IntArg().parse(action, rule.output) && rule.output >= 0) {
+        if (rule.output >= noutputs())
+            return errh->error("output %d out of range", rule.output);
+    } else
+        return errh->error("bad action %<%s%>", action.c_str());
+
+    ArgContext context(this, errh);
+    Key value, mask;
+    int proto = -1;
+    bool ports = false;
+    uint32_t range[2][2] = {{0, 0xFFFF}, {0, 0xFFFF}};	// src, dst ports
+    int n = words.size();
+    for (int i = 1; i < n; ) {
+        String w = words[i++];
+        if (w == "&&" || w == "and" || w == "all" || w == "-")
+            continue;
+        if (w == "or" || w == "||" || w == "not" || w == "!" || w[0] == '(')
+            return errh->error("only conjunctions of tests are supported");
+
+        int p = -1;
+        if (w == "tcp" || w == "udp" || w == "icmp")
+            parse_protocol(w, p);
+        else if (w == "ip" || w == "proto") {
+            if (w == "ip" && (i >= n || words[i++] != "proto"))
+                return errh->error("expected %<ip proto%>");
+            if (i >= n || !parse_protocol(words[i++], p))
+                return errh->error("bad protocol");
+        }
+        if (p >= 0) {
+            if (proto >= 0 && proto != p)
+                return errh->error("conflicting protocols");
+            proto = p;
+            continue;
+        }
+
+        int dir;
+        if (w == "src")
+            dir = 0;
+        else if (w == "dst")
+            dir = 1;
+        else
+            return errh->error("unsupported test %<%s%>", w.c_str());
+        if (i >= n)
+            return errh->error("missing test after %<%s%>", w.c_str());
+        w = words[i++];
+
+        if (w == "port") {
+            if (i >= n)
+                return errh->error("missing port");
+            String op = "=", val = words[i++];
+            if (val == "=" || val == "==" || val == "<" || val == "<="
+                || val == ">" || val == ">=") {
+                if (i >= n)
+                    return errh->error("missing port");
+                op = val;
+                val = words[i++];
+            } else if (val[0] == '<' || val[0] == '>' || val[0] == '=') {
+                int oplen = val.length() > 1 && val[1] == '=' ? 2 : 1;
+                op = val.substring(0, oplen);
+                val = val.substring(oplen);
+            }
+            uint16_t port;
+            if (!IPPortArg(proto == IP_PROTO_UDP ? IP_PROTO_UDP : IP_PROTO_TCP).parse(val, port, context))
+                return errh->error("bad port %<%s%>", val.c_str());
+            uint32_t lo = 0, hi = 0xFFFF;
+            if (op == "<")
+                hi = port - 1;
+            else if (op == "<=")
+                hi = port;
+            else if (op == ">")
+                lo = port + 1;
+            else if (op == ">=")
+                lo = port;
+            else
+                lo = hi = port;
+            if (lo > range[dir][0])
+                range[dir][0] = lo;
+            if (hi < range[dir][1])
+                range[dir][1] = hi;
+            if (range[dir][0] > range[dir][1] || (op == "<" && port == 0))
+                return errh->error("port test matches no packet");
+            ports = true;
+            continue;
+        }
+
+        if (w == "host" || w == "net") {
+            if (i >= n)
+                return errh->error("missing address");
+            w = words[i++];
+        }
+        IPAddress a, m;
+        if (!IPPrefixArg(true).parse(w, a, m, context))
+            return errh->error("bad address %<%s%>", w.c_str());
+        uint32_t &v = dir ? value.dst : value.src;
+        uint32_t &vm = dir ? mask.dst : mask.src;
+        if (vm)
+            return errh->error("more than one %s address test", dir ? "dst" : "src");
+        v = a.addr() & m.addr();
+        vm = m.addr();
+    }
+
+    if (ports && proto >= 0 && proto != IP_PROTO_TCP && proto != IP_PROTO_UDP)
+        return errh->error("port tests need TCP or UDP");
+
+    // Split port ranges into prefixes, and port tests without a protocol
+    // into a TCP and a UDP entry
+    Vector<int> protos;
+    if (proto >= 0)
+        protos.push_back(proto);
+    else if (ports) {
+        protos.push_back(IP_PROTO_TCP);
+        protos.push_back(IP_PROTO_UDP);
+    } else
+        protos.push_back(-1);
+    Vector<uint32_t> sp, dp;
+    port_prefixes(range[0][0], range[0][1], sp);
+    port_prefixes(range[1][0], range[1][1], dp);
+    if (protos.size() * (sp.size() / 2) * (dp.size() / 2) > (int) max_entries)
+        return errh->error("port ranges split into too many prefixes");
+
+    for (int pi = 0; pi < protos.size(); pi++)
+        for (int si = 0; si < sp.size(); si += 2)
+            for (int di = 0; di < dp.size(); di += 2) {
+                Entry e;
+                e.value = value;
+                e.mask = mask;
+                if (protos[pi] >= 0) {
+                    e.value.proto = protos[pi];
+                    e.mask.proto = ports ? 0xFF | no_ports : 0xFF;
+                }
+                e.value.sport = htons(sp[si]);
+                e.mask.sport = htons(sp[si + 1]);
+                e.value.dport = htons(dp[di]);
+                e.mask.dport = htons(dp[di + 1]);
+                rule.entries.push_back(e);
+            }
+    return 0;
+}
+
+void
+TupleSpaceFilter::insert_entry(const Entry &e, const Match &m)
+{
+    Tuple *t;
+    HashTable<Key, int>::iterator ti = _tuple_index.find(e.mask);
+    if (ti)
+        t = _tuples[ti.value()];
+    else {
+        t = new Tuple;
+        t->mask = e.mask;
+        t->best = no_match;
+        t->staged = e.mask.sport || e.mask.dport;
+        _tuple_index.set(e.mask, _tuples.size());
+        _tuples.push_back(t);
+    }
+
+    Bucket &b = t->rules[e.value];
+    int j = b.size();
+    b.push_back(m);
+    for (; j > 0 && b[j - 1].priority > m.priority; j--)
+        b[j] = b[j - 1];
+    b[j] = m;
+    if (b.size() == 1 && t->staged)
+        t->stage[stage_key(e.value)]++;
+    if (m.priority < t->best)
+        t->best = m.priority;
+}
+
+void
+TupleSpaceFilter::remove_entry(const Entry &e, uint32_t priority)
+{
+    HashTable<Key, int>::iterator ti = _tuple_index.find(e.mask);
+    if (!ti)
+        return;
+    int index = ti.value();
+    Tuple *t = _tuples[index];
+    HashTable<Key, Bucket>::iterator it = t->rules.find(e.value);
+    if (!it)
+        return;
+
+    Bucket &b = it.value();
+    for (int j = 0; j < b.size(); j++)
+        if (b[j].priority == priority) {
+            // Shift the following rules down to keep the bucket sorted
+            for (; j < b.size() - 1; j++)
+                b[j] = b[j + 1];
+            b.pop_back();
+            break;
+        }
+    if (b.empty()) {
+        t->rules.erase(it);
+        if (t->staged) {
+            HashTable<Key, uint32_t>::iterator st = t->stage.find(stage_key(e.value));
+            if (--st.value() == 0)
+                t->stage.erase(st);
+        }
+    }
+
+    if (t->rules.empty()) {
+        _tuple_index.erase(ti);
+        if (index != _tuples.size() - 1) {
+            _tuples[index] = _tuples.back();
+            _tuple_index.set(_tuples[index]->mask, index);
+        }
+        _tuples.pop_back();
+        delete t;
+    } else if (priority == t->best) {
+        t->best = no_match;
+        for (HashTable<Key, Bucket>::iterator bi = t->rules.begin(); bi; ++bi)
+            if (bi.value()[0].priority < t->best)
+                t->best = bi.value()[0].priority;
+    }
+}
+
+int
+TupleSpaceFilter::compare_tuples(const void *a, const void *b, void *)
+{
+    const Tuple *ta = *static_cast<Tuple * const *>(a);
+    const Tuple *tb = *static_cast<Tuple * const *>(b);
+    return ta->best < tb->best ? -1 : (ta->best > tb->best ? 1 : 0);
+}
+
+void
+TupleSpaceFilter::sort_tuples()
+{
+    click_qsort(_tuples.begin(), _tuples.size(), sizeof(Tuple *), compare_tuples, 0);
+    for (int i = 0; i < _tuples.size(); i++)
+        _tuple_index.set(_tuples[i]->mask, i);
+}
+
+int
+TupleSpaceFilter::add_rule(uint32_t priority, const String &text, ErrorHandler *errh)
+{
+    if (_rules.find(priority))
+        return errh->error("a rule with priority %u exists", priority);
+    Rule rule;
+    if (parse_rule(text, rule, errh) < 0)
+        return -1;
+    Vector<String> words;
+    cp_spacevec(text, words);
+    rule.text = cp_unspacevec(words);
+
+    Match m;
+    m.priority = priority;
+    m.output = rule.output;
+    for (int i = 0; i < rule.entries.size(); i++)
+        insert_entry(rule.entries[i], m);
+    _rules.set(priority, rule);
+    return 0;
+}
+
+int
+TupleSpaceFilter::remove_rule(uint32_t priority)
+{
+    HashTable<uint32_t, Rule>::iterator it = _rules.find(priority);
+    if (!it)
+        return -ENOENT;
+    const Vector<Entry> &entries = it.value().entries;
+    for (int i = 0; i < entries.size(); i++)
+        remove_entry(entries[i], priority);
+    _rules.erase(it);
+    return 0;
+}
+
+inline void
+TupleSpaceFilter::packet_key(const Packet *p, Key &k)
+{
+    const click_ip *iph = p->ip_header();
+    k.src = iph->ip_src.s_addr;
+    k.dst = iph->ip_dst.s_addr;
+    k.proto = iph->ip_p;
+    if ((k.proto == IP_PROTO_TCP || k.proto == IP_PROTO_UDP)
+        && IP_FIRSTFRAG(iph) && p->transport_length() >= 4) {
+        const uint16_t *ports = reinterpret_cast<const uint16_t *>(p->transport_header());
+        k.sport = ports[0];
+        k.dport = ports[1];
+    } else {
+        k.sport = k.dport = 0;
+        k.proto |= no_ports;
+    }
+}
+
+/*
+ * Probe the tuples by order of their best rule, and stop once none of the
+ * remaining ones can beat the match found so far.
+ */
+inline int
+TupleSpaceFilter::lookup(const Key &k) const
+{
+    uint32_t best = no_match;
+    int output = -1;
+    for (int i = 0; i < _tuples.size(); i++) {
+        const Tuple *t = _tuples[i];
+        if (t->best >= best)
+            break;
+        Key mk = k & t->mask;
+        if (t->staged && !t->stage.find(stage_key(mk)))
+            continue;
+        HashTable<Key, Bucket>::const_iterator it = t->rules.find(mk);
+        if (it && it.value()[0].priority < best) {
+            best = it.value()[0].priority;
+            output = it.value()[0].output;
+        }
+    }
+    return output;
+}
+
+void
+TupleSpaceFilter::push(int, Packet *p)
+{
+    Key k;
+    packet_key(p, k);
+    _lock.acquire_read();
+    int output = lookup(k);
+    _lock.release_read();
+    checked_output_push(output, p);
+}
+
+#if HAVE_BATCH
+void
+TupleSpaceFilter::push_batch(int, PacketBatch *batch)
+{
+    PacketVector v;
+    int ports[PACKET_VECTOR_CAPACITY];
+
+    while (batch) {
+        batch = v.load(batch);
+        unsigned n = v.count();
+        _lock.acquire_read();
+        for (unsigned i = 0; i < n; i++) {
+            Key k;
+            packet_key(v[i], k);
+            ports[i] = lookup(k);
+        }
+        _lock.release_read();
+
+        unsigned i = 0;
+        v.classify(noutputs() + 1, [&ports, &i](Packet*) { return ports[i++]; },
+                   [this](int o, PacketBatch* b) { checked_output_push_batch(o, b); });
+    }
+}
+#endif
+
+enum { h_add, h_remove, h_flush, h_rules, h_nrules, h_ntuples };
+
+int
+TupleSpaceFilter::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    TupleSpaceFilter *f = static_cast<TupleSpaceFilter *>(e);
+    String s = str;
+    uint32_t priority = 0;
+    if ((uintptr_t) thunk != h_flush
+        && !IntArg().parse(cp_shift_spacevec(s), priority))
+        return errh->error("expected priority");
+
+    int r = 0;
+    f->_lock.acquire_write();
+    switch ((uintptr_t) thunk) {
+    case h_add:
+        if ((r = f->add_rule(priority, s, errh)) >= 0)
+            f->sort_tuples();
+        break;
+    case h_remove:
+        if ((r = f->remove_rule(priority)) >= 0)
+            f->sort_tuples();
+        else
+            errh->error("no rule with priority %u", priority);
+        break;
+    case h_flush:
+        f->flush();
+        break;
+    }
+    f->_lock.release_write();
+    return r;
+}
+
+String
+TupleSpaceFilter::read_handler(Element *e, void *thunk)
+{
+    TupleSpaceFilter *f = static_cast<TupleSpaceFilter *>(e);
+    switch ((uintptr_t) thunk) {
+    case h_rules: {
+        Vector<uint32_t> priorities;
+        for (HashTable<uint32_t, Rule>::iterator it = f->_rules.begin(); it; ++it)
+            priorities.push_back(it.key());
+        click_qsort(priorities.begin(), priorities.size());
+        StringAccum sa;
+        for (int i = 0; i < priorities.size(); i++)
+            sa << priorities[i] << ' ' << f->_rules[priorities[i]].text << '\n';
+        return sa.take_string();
+    }
+    case h_nrules:
+        return String(f->_rules.size());
+    case h_ntuples:
+        return String(f->_tuples.size());
+    }
+    return String();
+}
+
+void
+TupleSpaceFilter::add_handlers()
+{
+    add_write_handler("add", write_handler, h_add);
+    add_write_handler("remove", write_handler, h_remove);
+    add_write_handler("flush", write_handler, h_flush, Handler::BUTTON);
+    add_read_handler("rules", read_handler, h_rules);
+    add_read_handler("nrules", read_handler, h_nrules);
+    add_read_handler("ntuples", read_handler, h_ntuples);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TupleSpaceFilter)
+ELEMENT_MT_SAFE(TupleSpaceFilter)
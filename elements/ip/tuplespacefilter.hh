@@ -0,0 +1,224 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TUPLESPACEFILTER_HH
+#define CLICK_TUPLESPACEFILTER_HH
+#include <click/batchelement.hh>
+#include <click/hashtable.hh>
+#include <click/vector.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TupleSpaceFilter(ACTION_1 PATTERN_1, ..., ACTION_N PATTERN_N)
+
+=s ip
+
+filters IP packets by 5-tuple using tuple space search
+
+=d
+
+Filters IP packets like IPFilter, but scales to rule sets of tens of
+thousands of rules, which can be changed at run time. Packets must have their
+IP header annotation set.
+
+Each argument is a rule, an ACTION followed by a PATTERN. ACTION is "allow"
+(send the packet to output 0), "deny" or "drop" (drop the packet), or an
+output port number. A packet is handled by the first rule it matches, and
+dropped if it matches none.
+
+PATTERNs use the IPFilter syntax, restricted to conjunctions ("&&" or "and",
+which may be omitted) of the following tests:
+
+=over 8
+
+=item "all", "-"
+
+Matches every packet.
+
+=item "tcp", "udp", "icmp", "ip proto PROTO"
+
+Matches packets of the given IP protocol.
+
+=item "src host ADDR", "dst host ADDR", "src net NET", "dst net NET"
+
+Matches packets with the given source or destination address or prefix.
+"host" and "net" may be omitted.
+
+=item "[tcp|udp] src port [OP] PORT", "[tcp|udp] dst port [OP] PORT"
+
+Matches TCP or UDP packets whose port is equal to PORT, or compares to it as
+OP says: "<", "<=", ">" or ">=". Port tests never match non-first fragments.
+
+=back
+
+Disjunctions, negations and the other IPFilter tests are not supported; write
+several rules instead.
+
+Rules are kept in tuple space search tables, as in Open vSwitch. Each
+distinct combination of prefix lengths of the five fields (a tuple) gets a
+hash table of the rules using it, keyed by their masked fields. Port ranges
+are split into prefixes, so a rule may land in several tuples. A lookup masks
+the packet's 5-tuple with each tuple's masks and probes its table. Tuples are
+sorted by their highest priority rule, so the search stops as soon as no
+remaining tuple can hold a better match. Each tuple also has a first-stage
+table keyed by addresses and protocol only, which rejects most packets before
+the ports are looked at. Adding or removing a rule only touches the tables of
+its tuples.
+
+Rules have a priority: the rule with the smallest priority wins. Rules of the
+configuration get priorities 0, 10, 20, and so on, which leaves room to add
+rules between them.
+
+=h add write-only
+
+Adds a rule. Format is `C<PRIORITY ACTION PATTERN>'. Fails if a rule with
+that priority exists.
+
+=h remove write-only
+
+Removes the rule with the given priority.
+
+=h flush write-only
+
+Removes all rules.
+
+=h rules read-only
+
+Returns the rules, one per line as `C<PRIORITY ACTION PATTERN>', by
+increasing priority.
+
+=h nrules read-only
+
+Returns the number of rules.
+
+=h ntuples read-only
+
+Returns the number of tuples, which bounds the hash probes of a lookup.
+
+=e
+
+  TupleSpaceFilter(allow src net 10.0.0.0/8 && tcp dst port 22,
+                   1 udp dst port >= 1024,
+                   deny all);
+
+=a IPFilter, IPClassifier */
+
+class TupleSpaceFilter : public BatchElement { public:
+
+    TupleSpaceFilter() CLICK_COLD;
+    ~TupleSpaceFilter() CLICK_COLD;
+
+    const char *class_name() const override	{ return "TupleSpaceFilter"; }
+    const char *port_count() const override	{ return "1/-"; }
+    const char *processing() const override	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    void cleanup(CleanupStage stage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int port, Packet *p) override;
+#if HAVE_BATCH
+    void push_batch(int port, PacketBatch *batch) override;
+#endif
+
+    // Fields of a packet tested by rules, in network byte order
+    struct Key {
+	uint32_t src;
+	uint32_t dst;
+	uint16_t sport;
+	uint16_t dport;
+	uint32_t proto;
+
+	Key()
+	    : src(0), dst(0), sport(0), dport(0), proto(0) {
+	}
+
+	inline Key operator&(const Key &mask) const {
+	    Key k;
+	    k.src = src & mask.src;
+	    k.dst = dst & mask.dst;
+	    k.sport = sport & mask.sport;
+	    k.dport = dport & mask.dport;
+	    k.proto = proto & mask.proto;
+	    return k;
+	}
+	inline bool operator==(const Key &x) const {
+	    return src == x.src && dst == x.dst && sport == x.sport
+		&& dport == x.dport && proto == x.proto;
+	}
+	inline hashcode_t hashcode() const {
+	    uint32_t h = src * 0x9E3779B1U;
+	    h ^= dst + 0x7F4A7C15U + (h << 6) + (h >> 2);
+	    h ^= (((uint32_t) sport << 16) | dport) + (proto << 24) + (h << 6) + (h >> 2);
+	    return h;
+	}
+    };
+
+  private:
+
+    enum {
+	no_match = 0xFFFFFFFFU,
+	no_ports = 0x100,		// Key::proto flag: no transport ports
+	max_entries = 4096		// per rule, after splitting port ranges
+    };
+
+    struct Match {
+	uint32_t priority;
+	int output;
+    };
+
+    // Rules with the same masked fields in a tuple, by increasing priority
+    typedef Vector<Match> Bucket;
+
+    struct Tuple {
+	Key mask;
+	uint32_t best;			// smallest priority in the tuple
+	bool staged;			// has port masks
+	HashTable<Key, Bucket> rules;
+	HashTable<Key, uint32_t> stage;	// masked addresses and protocol ->
+					//   number of buckets sharing them
+    };
+
+    // An entry of a rule in one tuple
+    struct Entry {
+	Key value;
+	Key mask;
+    };
+
+    struct Rule {
+	int output;
+	String text;
+	Vector<Entry> entries;
+    };
+
+    Vector<Tuple *> _tuples;			// by increasing best priority
+    HashTable<Key, int> _tuple_index;		// mask -> index in _tuples
+    HashTable<uint32_t, Rule> _rules;		// priority -> rule
+    ReadWriteLock _lock;
+
+    static inline Key stage_key(const Key &k) {
+	Key s = k;
+	s.sport = s.dport = 0;
+	return s;
+    }
+
+    static inline void packet_key(const Packet *p, Key &k);
+    inline int lookup(const Key &k) const;
+
+    int parse_rule(const String &text, Rule &rule, ErrorHandler *errh) const;
+    int add_rule(uint32_t priority, const String &text, ErrorHandler *errh);
+    int remove_rule(uint32_t priority);
+    void insert_entry(const Entry &e, const Match &m);
+    void remove_entry(const Entry &e, uint32_t priority);
+    void sort_tuples();
+    static int compare_tuples(const void *a, const void *b, void *);
+    void flush();
+
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -21,6 +21,9 @@
 #include <click/ip6address.hh>
 #include <click/args.hh>
 #include <click/error.hh>
+#if HAVE_BATCH
+# include <click/packetvector.hh>
+#endif
 CLICK_DECLS
 
 LookupIP6Route::LookupIP6Route()
@@ -65,7 +68,10 @@ LookupIP6Route::configure(Vector<String> &conf, ErrorHandler *errh)
 #endif
 
   if (ok && output_num>=0) {
-    _t.add(dst, mask, gw, output_num);
+    if (mask.mask_to_prefix_len() < 0)
+      errh->error("argument %d: mask %s is not a prefix", i+1, mask.unparse().c_str());
+    else if (!_t.add(dst, mask, gw, output_num))
+      errh->error("argument %d: too many routes", i+1);
     if( output_num > maxout)
         maxout = output_num;
     } else {
@@ -148,6 +154,34 @@ LookupIP6Route::classify(Packet *p)
   }
 }
 
+#if HAVE_BATCH
+void
+LookupIP6Route::push_batch(int, PacketBatch *batch)
+{
+  PacketVector v;
+  IP6Address addrs[PACKET_VECTOR_CAPACITY];
+  IP6Address gws[PACKET_VECTOR_CAPACITY];
+  int ports[PACKET_VECTOR_CAPACITY];
+
+  while (batch) {
+    batch = v.load(batch);
+    unsigned n = v.count();
+    for (unsigned i = 0; i < n; i++)
+      addrs[i] = DST_IP6_ANNO(v[i]);
+
+    _t.lookup_batch(addrs, n, gws, ports);
+
+    for (unsigned i = 0; i < n; i++)
+      if (ports[i] >= 0 && gws[i])
+	SET_DST_IP6_ANNO(v[i], gws[i]);
+
+    unsigned i = 0;
+    v.classify(noutputs() + 1, [&ports, &i](Packet *) { return ports[i++]; },
+	       [this](int o, PacketBatch *b) { checked_output_push_batch(o, b); });
+  }
+}
+#endif
+
 int
 LookupIP6Route::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
                           int output, ErrorHandler *errh)
@@ -155,7 +189,10 @@ LookupIP6Route::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
   if (output < 0 && output >= noutputs())
     return errh->error("port number out of range"); // Can't happen...
 
-  _t.add(addr, mask, gw, output);
+  if (mask.mask_to_prefix_len() < 0)
+    return errh->error("mask %s is not a prefix", mask.unparse().c_str());
+  if (!_t.add(addr, mask, gw, output))
+    return errh->error("too many routes");
   return 0;
 }
 
@@ -21,6 +21,22 @@ CLICK_DECLS
  * a destination and mask, a gateway (zero means none),
  * and an output index.
  *
+ * Routes are stored in a multibit trie, so the lookup cost depends on the
+ * prefix lengths and not on the number of routes. Batches are looked up
+ * several packets at a time, overlapping their memory accesses.
+ *
+ * =h table read-only
+ *
+ * Outputs a human-readable version of the current routing table.
+ *
+ * =h add write-only
+ *
+ * Adds a route to the table. Format should be `C<ADDR/MASK [GW] OUT>'.
+ *
+ * =h remove write-only
+ *
+ * Removes a route from the table. Format should be `C<ADDR/MASK>'.
+ *
  * =e
  *
  *   ... -> GetIP6Address(24) -> rt;
@@ -53,6 +69,9 @@ public:
   void add_handlers() override CLICK_COLD;
 
   int classify(Packet *p);
+#if HAVE_BATCH
+  void push_batch(int port, PacketBatch *batch) override;
+#endif
 
   int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
   int remove_route(IP6Address, IP6Address, ErrorHandler *);
@@ -0,0 +1,338 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * espaes.{cc,hh} -- elements implement IPsec ESP with AES-GCM or AES-CBC
+ * and HMAC-SHA-256, on batches of packets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "espaes.hh"
+#include "esp.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+IPsecESPAESBase::IPsecESPAESBase()
+    : _mode(MODE_GCM), _accel(true)
+{
+    _drops = 0;
+}
+
+int
+IPsecESPAESBase::configure_crypto(Vector<String> &conf, Element *e, ErrorHandler *errh)
+{
+    String mode = "gcm";
+    if (Args(conf, e, errh)
+	.read("MODE", WordArg(), mode)
+	.read("AESNI", _accel)
+	.complete() < 0)
+	return -1;
+    if (mode == "gcm")
+	_mode = MODE_GCM;
+    else if (mode == "cbc")
+	_mode = MODE_CBC;
+    else
+	return errh->error("MODE must be gcm or cbc");
+    IPsecCrypto::static_initialize();
+    _accel = _accel && IPsecCrypto::accelerated();
+    return 0;
+}
+
+IPsecESPAESBase::SAState *
+IPsecESPAESBase::state(const SADataTuple *sa)
+{
+    HashTable<const SADataTuple *, SAState> &states = *_states;
+    SAState *st = states.get_pointer(sa);
+    if (likely(st && memcmp(st->enc_key, sa->Encryption_key, KEY_SIZE) == 0
+	       && memcmp(st->auth_key, sa->Authentication_key, KEY_SIZE) == 0))
+	return st;
+
+    if (!st)
+	st = &states[sa];
+    memcpy(st->enc_key, sa->Encryption_key, KEY_SIZE);
+    memcpy(st->auth_key, sa->Authentication_key, KEY_SIZE);
+    IPsecCrypto::set_aes_key(st->key, sa->Encryption_key);
+    memcpy(st->key.salt, sa->Authentication_key, 4);
+    IPsecCrypto::set_hmac_key(st->key, sa->Authentication_key, KEY_SIZE);
+    st->iv = ((uint64_t) click_random() << 32) ^ ((uint64_t) click_random() << 16) ^ click_random();
+    return st;
+}
+
+
+IPsecESPAESEncap::IPsecESPAESEncap()
+{
+}
+
+IPsecESPAESEncap::~IPsecESPAESEncap()
+{
+}
+
+int
+IPsecESPAESEncap::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return configure_crypto(conf, this, errh);
+}
+
+/* Adds the ESP header and trailer around P, and describes the part to
+ * encrypt in JOB. Returns the packet, or null if it was dropped. */
+inline WritablePacket *
+IPsecESPAESEncap::encap(Packet *p, SADataTuple *sa, SAState *st, IPsecCryptoJob &job)
+{
+    uint8_t ip_p = 0;
+    if (p->has_network_header())
+	ip_p = p->ip_header()->ip_p;
+
+    int plen = p->length();
+    int align = alignment();
+    int padding = ((align - ((plen + 2) % align)) % align) + 2;
+    int hlen = header_length();
+
+    WritablePacket *q = p->push(hlen);
+    if (!q)
+	return 0;
+    q = q->put(padding + IPSEC_ICV_SIZE);
+    if (!q)
+	return 0;
+
+    struct esp_new *esp = (struct esp_new *) q->data();
+    esp->esp_spi = htonl((uint32_t) IPSEC_SPI_ANNO(q));
+    esp->esp_rpl = htonl(sa->cur_rpl);
+    if ((sa->cur_rpl++) == 0) {
+	//if the replay counter rolls over...set it to the agreed start value
+	sa->cur_rpl = sa->replay_start_counter;
+    }
+    uint64_t iv = st->iv++;
+    memcpy(esp->esp_iv, &iv, 8);
+    if (_mode == MODE_CBC)
+	memset(esp->esp_iv + 8, 0, 8);
+
+    // default padding specified by RFC 2406, then pad length and next header
+    uint8_t *pad = q->data() + hlen + plen;
+    for (int i = 0; i < padding - 2; i++)
+	pad[i] = i + 1;
+    pad[padding - 2] = padding - 2;
+    pad[padding - 1] = ip_p;
+
+    job.key = &st->key;
+    job.data = q->data() + hlen;
+    job.len = plen + padding;
+    job.iv = esp->esp_iv;
+    job.aad = q->data();
+    job.icv = job.data + job.len;
+    return q;
+}
+
+inline void
+IPsecESPAESEncap::simple_action_vector(PacketVector &v)
+{
+    IPsecCryptoJob jobs[PACKET_VECTOR_CAPACITY];
+    unsigned n = 0;
+    const SADataTuple *last_sa = 0;
+    SAState *st = 0;
+
+    v.filter([this, &jobs, &n, &last_sa, &st](Packet *p) -> Packet * {
+	    SADataTuple *sa = (SADataTuple *) IPSEC_SA_DATA_REFERENCE_ANNO(p);
+	    if (unlikely(!sa)) {
+		_drops++;
+		p->kill();
+		return 0;
+	    }
+	    // Packets of a tunnel come in runs, keys are looked up once per run
+	    if (sa != last_sa) {
+		st = state(sa);
+		last_sa = sa;
+	    }
+	    WritablePacket *q = encap(p, sa, st, jobs[n]);
+	    if (q)
+		n++;
+	    else
+		_drops++;
+	    return q;
+	}, [](Packet *) {});
+
+    if (n == 0)
+	return;
+    if (_mode == MODE_GCM)
+	IPsecCrypto::gcm_seal(jobs, n, _accel);
+    else {
+	IPsecCrypto::cbc_encrypt(jobs, n, _accel);
+	for (unsigned i = 0; i < n; i++) {
+	    const uint8_t *esp = jobs[i].aad;
+	    IPsecCrypto::hmac_sha256(*jobs[i].key, esp, jobs[i].icv - esp, jobs[i].icv, _accel);
+	}
+    }
+}
+
+void
+IPsecESPAESEncap::add_handlers()
+{
+    add_crypto_handlers(this);
+}
+
+
+IPsecESPAESUnencap::IPsecESPAESUnencap()
+{
+}
+
+IPsecESPAESUnencap::~IPsecESPAESUnencap()
+{
+}
+
+int
+IPsecESPAESUnencap::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return configure_crypto(conf, this, errh);
+}
+
+/* Checks the lengths of ESP packet P and describes its encrypted part in
+ * JOB. The ICV is not checked yet. */
+inline bool
+IPsecESPAESUnencap::check(Packet *p, IPsecCryptoJob &job)
+{
+    int hlen = header_length();
+    int len = p->length() - hlen - IPSEC_ICV_SIZE;
+    if (len <= 0 || len % alignment() != 0)
+	return false;
+    uint8_t *esp = const_cast<uint8_t *>(p->data());
+    job.data = esp + hlen;
+    job.len = len;
+    job.iv = esp + 8;
+    job.aad = esp;
+    job.icv = job.data + len;
+    job.ok = false;
+    return true;
+}
+
+/* Removes the ESP header and trailer of decrypted packet P. Returns false if
+ * the padding is corrupt. */
+inline bool
+IPsecESPAESUnencap::unencap(WritablePacket *p)
+{
+    int hlen = header_length();
+    const uint8_t *trailer = p->end_data() - IPSEC_ICV_SIZE - 2;
+    int padlen = trailer[0];
+    if (padlen + 2 > (int) p->length() - hlen - IPSEC_ICV_SIZE)
+	return false;
+    const uint8_t *pad = trailer - padlen;
+    for (int i = 0; i < padlen; i++)
+	if (pad[i] != i + 1)
+	    return false;
+    p->pull(hlen);
+    p->take(padlen + 2 + IPSEC_ICV_SIZE);
+    return true;
+}
+
+void
+IPsecESPAESUnencap::process(PacketVector &v)
+{
+    IPsecCryptoJob jobs[PACKET_VECTOR_CAPACITY];
+    int job_of[PACKET_VECTOR_CAPACITY];
+    unsigned n = 0;
+    const SADataTuple *last_sa = 0;
+    SAState *st = 0;
+
+    v.filter([](Packet *p) -> Packet * { return p->uniqueify(); }, [](Packet *) {});
+
+    for (unsigned i = 0; i < v.count(); i++) {
+	Packet *p = v[i];
+	SADataTuple *sa = (SADataTuple *) IPSEC_SA_DATA_REFERENCE_ANNO(p);
+	job_of[i] = -1;
+	if (unlikely(!sa) || !check(p, jobs[n]))
+	    continue;
+	if (sa != last_sa) {
+	    st = state(sa);
+	    last_sa = sa;
+	}
+	jobs[n].key = &st->key;
+	job_of[i] = n++;
+    }
+
+    if (n > 0) {
+	if (_mode == MODE_GCM)
+	    IPsecCrypto::gcm_open(jobs, n, _accel);
+	else {
+	    // decrypt only the packets whose ICV is valid
+	    IPsecCryptoJob valid[PACKET_VECTOR_CAPACITY];
+	    unsigned nvalid = 0;
+	    for (unsigned i = 0; i < n; i++) {
+		uint8_t icv[IPSEC_ICV_SIZE];
+		IPsecCrypto::hmac_sha256(*jobs[i].key, jobs[i].aad, jobs[i].icv - jobs[i].aad,
+					 icv, _accel);
+		jobs[i].ok = IPsecCrypto::equal(icv, jobs[i].icv, IPSEC_ICV_SIZE);
+		if (jobs[i].ok)
+		    valid[nvalid++] = jobs[i];
+	    }
+	    IPsecCrypto::cbc_decrypt(valid, nvalid, _accel);
+	}
+    }
+
+    unsigned drops = 0;
+    for (unsigned i = 0; i < v.count(); i++) {
+	WritablePacket *p = static_cast<WritablePacket *>(v[i]);
+	int j = job_of[i];
+	bool ok = j >= 0 && jobs[j].ok;
+	if (ok) {
+	    // the replay window is updated by authenticated packets only
+	    const struct esp_new *esp = reinterpret_cast<const struct esp_new *>(p->data());
+	    SADataTuple *sa = (SADataTuple *) IPSEC_SA_DATA_REFERENCE_ANNO(p);
+	    ok = sa->check_replay_window(ntohl(esp->esp_rpl)) && unencap(p);
+	}
+	job_of[i] = ok ? 0 : 1;
+	if (!ok)
+	    drops++;
+    }
+    if (drops)
+	_drops += drops;
+
+    unsigned i = 0;
+    v.classify(2, [&job_of, &i](Packet *) { return job_of[i++]; },
+	       [this](int o, PacketBatch *b) { checked_output_push_batch(o, b); });
+}
+
+#if HAVE_BATCH
+void
+IPsecESPAESUnencap::push_batch(int, PacketBatch *batch)
+{
+    PacketVector v;
+    while (batch) {
+	batch = v.load(batch);
+	process(v);
+    }
+}
+#endif
+
+void
+IPsecESPAESUnencap::push(int, Packet *p)
+{
+    PacketVector v;
+    v.push_back(p);
+    process(v);
+}
+
+void
+IPsecESPAESUnencap::add_handlers()
+{
+    add_crypto_handlers(this);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecCrypto)
+EXPORT_ELEMENT(IPsecESPAESEncap)
+EXPORT_ELEMENT(IPsecESPAESUnencap)
+ELEMENT_MT_SAFE(IPsecESPAESEncap)
+ELEMENT_MT_SAFE(IPsecESPAESUnencap)
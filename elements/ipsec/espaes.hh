@@ -0,0 +1,217 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPSEC_ESPAES_HH
+#define CLICK_IPSEC_ESPAES_HH
+#include <click/batchelement.hh>
+#include <click/hashtable.hh>
+#include <click/multithread.hh>
+#include <click/atomic.hh>
+#include "espcrypto.hh"
+#include "sadatatuple.hh"
+CLICK_DECLS
+
+class IPsecESPAESBase { public:
+
+    IPsecESPAESBase();
+
+    enum { MODE_GCM, MODE_CBC };
+
+  protected:
+
+    struct SAState {
+	IPsecAESKey key;
+	uint8_t enc_key[KEY_SIZE];
+	uint8_t auth_key[KEY_SIZE];
+	uint64_t iv;
+    };
+
+    int _mode;
+    bool _accel;
+    atomic_uint32_t _drops;
+    per_thread<HashTable<const SADataTuple *, SAState> > _states;
+
+    int configure_crypto(Vector<String> &conf, Element *e, ErrorHandler *errh);
+
+    /* Length of the ESP header with the IV */
+    inline int header_length() const {
+	return _mode == MODE_GCM ? 16 : 24;
+    }
+    inline int alignment() const {
+	return _mode == MODE_GCM ? 4 : 16;
+    }
+
+    /* Returns the expanded keys of SA for the current thread, expanding
+     * them if SA is new or its keys changed */
+    SAState *state(const SADataTuple *sa);
+
+    enum { h_drops, h_implementation };
+    template <typename T> static String read_handler(Element *e, void *thunk);
+    template <typename T> void add_crypto_handlers(T *e);
+
+};
+
+/*
+=c
+
+IPsecESPAESEncap([I<KEYWORDS>])
+
+=s ipsec
+
+apply IPsec ESP encapsulation and AES encryption
+
+=d
+
+Adds an ESP header to each packet, then encrypts and authenticates it with
+the keys of its Security Association, in a single pass. This replaces the
+IPsecESPEncap, IPsecAES and IPsecAuthHMACSHA1 chain.
+
+The Security Association and the SPI come from the annotations set by
+RadixIPsecLookup. The AES-128 key is the ENCRYPT_KEY of the route. The
+sequence number is taken from the Security Association like IPsecESPEncap
+does, and the next header is the protocol of the packet's IP header.
+
+Keyword arguments are:
+
+=over 8
+
+=item MODE
+
+Either C<gcm> or C<cbc>. In C<gcm> mode, packets are encrypted and
+authenticated with AES-GCM and a 16-byte ICV (RFC 4106). The first 4 bytes of
+the AUTH_KEY of the route are the salt of the nonce, and the explicit IV is a
+64-bit counter starting at a random value. Padding aligns the payload to 4
+bytes. In C<cbc> mode, packets are encrypted with AES-CBC (RFC 3602) and
+authenticated with HMAC-SHA-256-128 (RFC 4868) keyed by the 16-byte AUTH_KEY.
+The IV is the encryption of a counter. Padding aligns the payload to 16
+bytes. Default is C<gcm>.
+
+=item AESNI
+
+Boolean. If true, use AES-NI, PCLMULQDQ and SHA instructions when the CPU
+supports them. Default is true.
+
+=back
+
+Packets of a batch are processed together: the expanded keys of a Security
+Association are looked up once per run of packets of the same association,
+and the accelerated kernels encrypt four packets at a time.
+
+=h drops read-only
+
+Returns the number of packets dropped because they had no Security
+Association, or could not be extended.
+
+=h implementation read-only
+
+Returns "aesni" if the accelerated kernels are used, "generic" otherwise.
+
+=e
+
+  rt :: RadixIPsecLookup(10.0.0.0/8 192.168.0.2 1 1234
+                         \<0123456789abcdef0123456789abcdef>
+                         \<00112233445566778899aabbccddeeff> 1 64, ...);
+  rt[1] -> IPsecESPAESEncap(MODE gcm) -> IPsecEncap(50) -> ...
+
+=a IPsecESPAESUnencap, IPsecESPEncap, RadixIPsecLookup, IPsecEncap
+*/
+
+class IPsecESPAESEncap : public SimpleVectorElement<IPsecESPAESEncap>, public IPsecESPAESBase { public:
+
+    IPsecESPAESEncap() CLICK_COLD;
+    ~IPsecESPAESEncap() CLICK_COLD;
+
+    const char *class_name() const override	{ return "IPsecESPAESEncap"; }
+    const char *port_count() const override	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &, ErrorHandler *) override CLICK_COLD;
+    void add_handlers() override CLICK_COLD;
+
+    inline void simple_action_vector(PacketVector &v);
+
+  private:
+
+    inline WritablePacket *encap(Packet *p, SADataTuple *sa, SAState *st, IPsecCryptoJob &job);
+
+};
+
+/*
+=c
+
+IPsecESPAESUnencap([I<KEYWORDS>])
+
+=s ipsec
+
+verify, decrypt and remove IPsec ESP encapsulation
+
+=d
+
+Verifies the ICV of ESP packets, checks their sequence number against the
+replay window of their Security Association, decrypts them and removes the
+ESP header and trailer. Packets must start with the ESP header, and have the
+Security Association annotation set by RadixIPsecLookup.
+
+Packets that fail a check are emitted on output 1 if it exists, and dropped
+otherwise.
+
+Keyword arguments are MODE and AESNI, as for IPsecESPAESEncap.
+
+=h drops read-only
+
+Returns the number of packets that failed a check.
+
+=h implementation read-only
+
+Returns "aesni" if the accelerated kernels are used, "generic" otherwise.
+
+=e
+
+  rt[0] -> StripIPHeader -> IPsecESPAESUnencap(MODE gcm) -> CheckIPHeader -> ...
+
+=a IPsecESPAESEncap, IPsecESPUnencap
+*/
+
+class IPsecESPAESUnencap : public BatchElement, public IPsecESPAESBase { public:
+
+    IPsecESPAESUnencap() CLICK_COLD;
+    ~IPsecESPAESUnencap() CLICK_COLD;
+
+    const char *class_name() const override	{ return "IPsecESPAESUnencap"; }
+    const char *port_count() const override	{ return "1/1-2"; }
+    const char *processing() const override	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) override CLICK_COLD;
+    void add_handlers() override CLICK_COLD;
+
+    void push(int, Packet *) override;
+#if HAVE_BATCH
+    void push_batch(int, PacketBatch *) override;
+#endif
+
+  private:
+
+    inline bool check(Packet *p, IPsecCryptoJob &job);
+    inline bool unencap(WritablePacket *p);
+    void process(PacketVector &v);
+
+};
+
+template <typename T> String
+IPsecESPAESBase::read_handler(Element *e, void *thunk)
+{
+    T *t = static_cast<T *>(e);
+    switch ((uintptr_t) thunk) {
+    case h_drops:
+	return String(t->_drops.value());
+    default:
+	return t->_accel ? "aesni" : "generic";
+    }
+}
+
+template <typename T> void
+IPsecESPAESBase::add_crypto_handlers(T *e)
+{
+    e->add_read_handler("drops", read_handler<T>, h_drops);
+    e->add_read_handler("implementation", read_handler<T>, h_implementation);
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,898 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * espcrypto.{cc,hh} -- AES-128 (GCM, CBC) and HMAC-SHA-256 for ESP
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "espcrypto.hh"
+#include <click/glue.hh>
+
+#if !CLICK_LINUXMODULE && !CLICK_BSDMODULE && !CLICK_MINIOS \
+    && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define CLICK_ESP_AESNI 1
+# include <immintrin.h>
+# include <cpuid.h>
+#endif
+CLICK_DECLS
+
+static inline uint32_t
+load_be32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+	| ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline void
+store_be32(uint8_t *p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+static inline uint64_t
+load_be64(const uint8_t *p)
+{
+    return ((uint64_t) load_be32(p) << 32) | load_be32(p + 4);
+}
+
+static inline void
+store_be64(uint8_t *p, uint64_t x)
+{
+    store_be32(p, x >> 32);
+    store_be32(p + 4, x);
+}
+
+
+/*
+ * Portable AES-128. The S-boxes are computed from their definition by
+ * IPsecCrypto::static_initialize().
+ */
+
+static uint8_t aes_sbox[256];
+static uint8_t aes_inv_sbox[256];
+
+static inline uint8_t
+aes_xtime(uint8_t x)
+{
+    return (x << 1) ^ ((x & 0x80) ? 0x1B : 0);
+}
+
+static uint8_t
+aes_mul(uint8_t a, uint8_t b)
+{
+    uint8_t r = 0;
+    for (; b; b >>= 1, a = aes_xtime(a))
+	if (b & 1)
+	    r ^= a;
+    return r;
+}
+
+static void
+aes_init_tables()
+{
+    for (int x = 0; x < 256; x++) {
+	// multiplicative inverse, x^254, then the affine transform
+	uint8_t inv = 0;
+	if (x) {
+	    uint8_t b = x;
+	    inv = 1;
+	    for (int e = 254; e; e >>= 1, b = aes_mul(b, b))
+		if (e & 1)
+		    inv = aes_mul(inv, b);
+	}
+	uint8_t s = inv;
+	for (int i = 1; i < 5; i++)
+	    s ^= (uint8_t) ((inv << i) | (inv >> (8 - i)));
+	s ^= 0x63;
+	aes_sbox[x] = s;
+	aes_inv_sbox[s] = x;
+    }
+}
+
+static inline void
+aes_mix_column(uint8_t *a)
+{
+    uint8_t a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+    uint8_t t = a0 ^ a1 ^ a2 ^ a3;
+    a[0] ^= t ^ aes_xtime(a0 ^ a1);
+    a[1] ^= t ^ aes_xtime(a1 ^ a2);
+    a[2] ^= t ^ aes_xtime(a2 ^ a3);
+    a[3] ^= t ^ aes_xtime(a3 ^ a0);
+}
+
+static inline void
+aes_inv_mix_column(uint8_t *a)
+{
+    uint8_t a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+    a[0] = aes_mul(a0, 14) ^ aes_mul(a1, 11) ^ aes_mul(a2, 13) ^ aes_mul(a3, 9);
+    a[1] = aes_mul(a0, 9) ^ aes_mul(a1, 14) ^ aes_mul(a2, 11) ^ aes_mul(a3, 13);
+    a[2] = aes_mul(a0, 13) ^ aes_mul(a1, 9) ^ aes_mul(a2, 14) ^ aes_mul(a3, 11);
+    a[3] = aes_mul(a0, 11) ^ aes_mul(a1, 13) ^ aes_mul(a2, 9) ^ aes_mul(a3, 14);
+}
+
+static void
+aes_encrypt_block(const IPsecAESKey &k, const uint8_t *in, uint8_t *out)
+{
+    uint8_t s[16], t[16];
+    for (int i = 0; i < 16; i++)
+	s[i] = in[i] ^ k.enc[0][i];
+    for (int r = 1; r <= IPSEC_AES_ROUNDS; r++) {
+	// SubBytes and ShiftRows
+	for (int c = 0; c < 4; c++)
+	    for (int j = 0; j < 4; j++)
+		t[c * 4 + j] = aes_sbox[s[((c + j) & 3) * 4 + j]];
+	if (r < IPSEC_AES_ROUNDS)
+	    for (int c = 0; c < 4; c++)
+		aes_mix_column(t + c * 4);
+	for (int i = 0; i < 16; i++)
+	    s[i] = t[i] ^ k.enc[r][i];
+    }
+    memcpy(out, s, 16);
+}
+
+/* Equivalent inverse cipher, the one of AESDEC, with the dec round keys */
+static void
+aes_decrypt_block(const IPsecAESKey &k, const uint8_t *in, uint8_t *out)
+{
+    uint8_t s[16], t[16];
+    for (int i = 0; i < 16; i++)
+	s[i] = in[i] ^ k.dec[0][i];
+    for (int r = 1; r <= IPSEC_AES_ROUNDS; r++) {
+	// InvSubBytes and InvShiftRows
+	for (int c = 0; c < 4; c++)
+	    for (int j = 0; j < 4; j++)
+		t[c * 4 + j] = aes_inv_sbox[s[((c - j) & 3) * 4 + j]];
+	if (r < IPSEC_AES_ROUNDS)
+	    for (int c = 0; c < 4; c++)
+		aes_inv_mix_column(t + c * 4);
+	for (int i = 0; i < 16; i++)
+	    s[i] = t[i] ^ k.dec[r][i];
+    }
+    memcpy(out, s, 16);
+}
+
+/* X = X * H in GF(2^128), bit by bit (NIST SP 800-38D, algorithm 1) */
+static void
+ghash_mul(uint8_t *x, const uint8_t *h)
+{
+    uint64_t z0 = 0, z1 = 0;
+    uint64_t v0 = load_be64(h), v1 = load_be64(h + 8);
+    for (int i = 0; i < 128; i++) {
+	if (x[i >> 3] & (0x80 >> (i & 7))) {
+	    z0 ^= v0;
+	    z1 ^= v1;
+	}
+	bool lsb = v1 & 1;
+	v1 = (v1 >> 1) | (v0 << 63);
+	v0 >>= 1;
+	if (lsb)
+	    v0 ^= 0xE100000000000000ULL;
+    }
+    store_be64(x, z0);
+    store_be64(x + 8, z1);
+}
+
+static void
+gcm_generic(IPsecCryptoJob &j, bool seal)
+{
+    const IPsecAESKey &k = *j.key;
+    uint8_t y[16], ctr[16], ks[16];
+    memset(y, 0, 16);
+    memcpy(y, j.aad, 8);
+    ghash_mul(y, k.h);
+    memcpy(ctr, k.salt, 4);
+    memcpy(ctr + 4, j.iv, 8);
+    uint32_t c = 2;
+    for (int off = 0; off < j.len; off += 16) {
+	int n = j.len - off < 16 ? j.len - off : 16;
+	uint8_t *p = j.data + off;
+	store_be32(ctr + 12, c++);
+	aes_encrypt_block(k, ctr, ks);
+	if (!seal)
+	    for (int i = 0; i < n; i++)
+		y[i] ^= p[i];
+	for (int i = 0; i < n; i++)
+	    p[i] ^= ks[i];
+	if (seal)
+	    for (int i = 0; i < n; i++)
+		y[i] ^= p[i];
+	ghash_mul(y, k.h);
+    }
+    uint8_t l[16];
+    store_be64(l, 64);
+    store_be64(l + 8, (uint64_t) j.len * 8);
+    for (int i = 0; i < 16; i++)
+	y[i] ^= l[i];
+    ghash_mul(y, k.h);
+    store_be32(ctr + 12, 1);
+    aes_encrypt_block(k, ctr, ks);
+    for (int i = 0; i < 16; i++)
+	ks[i] ^= y[i];
+    if (seal)
+	memcpy(j.icv, ks, 16);
+    else
+	j.ok = IPsecCrypto::equal(ks, j.icv, 16);
+}
+
+static void
+cbc_encrypt_generic(IPsecCryptoJob &j)
+{
+    aes_encrypt_block(*j.key, j.iv, j.iv);
+    const uint8_t *prev = j.iv;
+    for (int off = 0; off < j.len; off += 16) {
+	uint8_t *p = j.data + off;
+	for (int i = 0; i < 16; i++)
+	    p[i] ^= prev[i];
+	aes_encrypt_block(*j.key, p, p);
+	prev = p;
+    }
+}
+
+static void
+cbc_decrypt_generic(IPsecCryptoJob &j)
+{
+    uint8_t prev[16], c[16];
+    memcpy(prev, j.iv, 16);
+    for (int off = 0; off < j.len; off += 16) {
+	uint8_t *p = j.data + off;
+	memcpy(c, p, 16);
+	aes_decrypt_block(*j.key, p, p);
+	for (int i = 0; i < 16; i++)
+	    p[i] ^= prev[i];
+	memcpy(prev, c, 16);
+    }
+}
+
+
+/*
+ * Portable SHA-256 (FIPS 180-4)
+ */
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static inline uint32_t
+ror32(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static void
+sha256_blocks_generic(uint32_t *st, const uint8_t *data, int nblocks)
+{
+    uint32_t w[64];
+    for (; nblocks > 0; nblocks--, data += 64) {
+	for (int i = 0; i < 16; i++)
+	    w[i] = load_be32(data + i * 4);
+	for (int i = 16; i < 64; i++) {
+	    uint32_t s0 = ror32(w[i - 15], 7) ^ ror32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+	    uint32_t s1 = ror32(w[i - 2], 17) ^ ror32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+	    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+	uint32_t a = st[0], b = st[1], c = st[2], d = st[3];
+	uint32_t e = st[4], f = st[5], g = st[6], h = st[7];
+	for (int i = 0; i < 64; i++) {
+	    uint32_t t1 = h + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25))
+		+ ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+	    uint32_t t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22))
+		+ ((a & b) ^ (a & c) ^ (b & c));
+	    h = g;
+	    g = f;
+	    f = e;
+	    e = d + t1;
+	    d = c;
+	    c = b;
+	    b = a;
+	    a = t1 + t2;
+	}
+	st[0] += a;
+	st[1] += b;
+	st[2] += c;
+	st[3] += d;
+	st[4] += e;
+	st[5] += f;
+	st[6] += g;
+	st[7] += h;
+    }
+}
+
+
+#if CLICK_ESP_AESNI
+/*
+ * AES-NI, PCLMULQDQ and SHA extensions kernels
+ */
+
+# define ESP_TARGET_AES __attribute__((target("aes,pclmul,sse4.1")))
+# define ESP_TARGET_SHA __attribute__((target("sha,sse4.1")))
+
+static bool has_aesni;
+static bool has_sha;
+
+static void
+check_cpu()
+{
+    unsigned a, b, c, d;
+    if (__get_cpuid(1, &a, &b, &c, &d))
+	has_aesni = (c & bit_AES) && (c & bit_PCLMUL) && (c & bit_SSE4_1);
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d))
+	has_sha = has_aesni && (b & bit_SHA);
+}
+
+ESP_TARGET_AES static inline __m128i
+bswap128(__m128i x)
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+					    8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+/* Multiplication in GF(2^128) of byte-reflected operands. The GHASH key is
+ * stored multiplied by x in the POLYVAL field, which turns the reduction of
+ * the product into two carry-less multiplications (RFC 8452, appendix A). */
+ESP_TARGET_AES static inline __m128i
+gfmul(__m128i a, __m128i b)
+{
+    const __m128i poly = _mm_set_epi32(0xC2000000, 0, 0, 1);
+    __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+				_mm_clmulepi64_si128(a, b, 0x01));
+    __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    lo = _mm_xor_si128(_mm_shuffle_epi32(lo, 0x4E), _mm_clmulepi64_si128(lo, poly, 0x10));
+    lo = _mm_xor_si128(_mm_shuffle_epi32(lo, 0x4E), _mm_clmulepi64_si128(lo, poly, 0x10));
+    return _mm_xor_si128(hi, lo);
+}
+
+ESP_TARGET_AES static inline __m128i
+aesni_encrypt(const __m128i *rk, __m128i x)
+{
+    x = _mm_xor_si128(x, _mm_loadu_si128(rk));
+#pragma GCC unroll 16
+    for (int r = 1; r < IPSEC_AES_ROUNDS; r++)
+	x = _mm_aesenc_si128(x, _mm_loadu_si128(rk + r));
+    return _mm_aesenclast_si128(x, _mm_loadu_si128(rk + IPSEC_AES_ROUNDS));
+}
+
+ESP_TARGET_AES static inline __m128i
+aesni_decrypt(const __m128i *rk, __m128i x)
+{
+    x = _mm_xor_si128(x, _mm_loadu_si128(rk));
+#pragma GCC unroll 16
+    for (int r = 1; r < IPSEC_AES_ROUNDS; r++)
+	x = _mm_aesdec_si128(x, _mm_loadu_si128(rk + r));
+    return _mm_aesdeclast_si128(x, _mm_loadu_si128(rk + IPSEC_AES_ROUNDS));
+}
+
+/*
+ * Multi-buffer GCM. Each lane holds a packet; a step encrypts the next
+ * counter block of every lane and folds the resulting ciphertext in the
+ * lane's GHASH. When the full blocks of a lane are done, its tail and tag
+ * are computed alone and the next job takes the lane.
+ */
+struct GCMLane {
+    IPsecCryptoJob *job;
+    const __m128i *rk;
+    __m128i j0;		// salt, IV and counter 0
+    __m128i h;		// GHASH key in the POLYVAL field
+    __m128i y;		// byte-reflected GHASH accumulator
+    uint8_t *p;
+    int nfull;
+    uint32_t ctr;
+};
+
+ESP_TARGET_AES static inline __m128i
+gcm_counter(const GCMLane &l, uint32_t ctr)
+{
+    return _mm_insert_epi32(l.j0, (int) __builtin_bswap32(ctr), 3);
+}
+
+ESP_TARGET_AES static void
+gcm_lane_start(GCMLane &l, IPsecCryptoJob *j)
+{
+    uint8_t nonce[16];
+    memcpy(nonce, j->key->salt, 4);
+    memcpy(nonce + 4, j->iv, 8);
+    memset(nonce + 12, 0, 4);
+    l.job = j;
+    l.rk = (const __m128i *) j->key->enc;
+    l.j0 = _mm_loadu_si128((const __m128i *) nonce);
+    l.h = _mm_loadu_si128((const __m128i *) j->key->polyval_h);
+    l.y = gfmul(bswap128(_mm_loadl_epi64((const __m128i *) j->aad)), l.h);
+    l.p = j->data;
+    l.nfull = j->len >> 4;
+    l.ctr = 2;
+}
+
+template <int L, bool SEAL> ESP_TARGET_AES static void
+gcm_steps(GCMLane *l, int steps)
+{
+    // work on copies, so that the compiler keeps the lanes in registers
+    __m128i y[L];
+    uint8_t *p[L];
+#pragma GCC unroll 16
+    for (int i = 0; i < L; i++) {
+	y[i] = l[i].y;
+	p[i] = l[i].p;
+    }
+    for (int s = 0; s < steps; s++) {
+	__m128i x[L];
+#pragma GCC unroll 16
+	for (int i = 0; i < L; i++)
+	    x[i] = _mm_xor_si128(gcm_counter(l[i], l[i].ctr + s), _mm_loadu_si128(l[i].rk));
+#pragma GCC unroll 16
+	for (int r = 1; r < IPSEC_AES_ROUNDS; r++)
+#pragma GCC unroll 16
+	    for (int i = 0; i < L; i++)
+		x[i] = _mm_aesenc_si128(x[i], _mm_loadu_si128(l[i].rk + r));
+#pragma GCC unroll 16
+	for (int i = 0; i < L; i++)
+	    x[i] = _mm_aesenclast_si128(x[i], _mm_loadu_si128(l[i].rk + IPSEC_AES_ROUNDS));
+#pragma GCC unroll 16
+	for (int i = 0; i < L; i++) {
+	    __m128i in = _mm_loadu_si128((const __m128i *) p[i]);
+	    __m128i out = _mm_xor_si128(in, x[i]);
+	    _mm_storeu_si128((__m128i *) p[i], out);
+	    y[i] = gfmul(_mm_xor_si128(y[i], bswap128(SEAL ? out : in)), l[i].h);
+	    p[i] += 16;
+	}
+    }
+#pragma GCC unroll 16
+    for (int i = 0; i < L; i++) {
+	l[i].y = y[i];
+	l[i].p = p[i];
+	l[i].ctr += steps;
+	l[i].nfull -= steps;
+    }
+}
+
+template <bool SEAL> ESP_TARGET_AES static void
+gcm_lane_finish(GCMLane &l)
+{
+    IPsecCryptoJob *j = l.job;
+    int tail = j->len & 15;
+    if (tail) {
+	uint8_t b[16], ks[16];
+	memset(b, 0, 16);
+	memcpy(b, l.p, tail);
+	_mm_storeu_si128((__m128i *) ks, aesni_encrypt(l.rk, gcm_counter(l, l.ctr)));
+	if (!SEAL)
+	    l.y = gfmul(_mm_xor_si128(l.y, bswap128(_mm_loadu_si128((const __m128i *) b))), l.h);
+	for (int i = 0; i < tail; i++)
+	    b[i] ^= ks[i];
+	memcpy(l.p, b, tail);
+	if (SEAL) {
+	    memset(b + tail, 0, 16 - tail);
+	    l.y = gfmul(_mm_xor_si128(l.y, bswap128(_mm_loadu_si128((const __m128i *) b))), l.h);
+	}
+    }
+    // lengths block: 64 bits of AAD, then the ciphertext length in bits
+    __m128i len = _mm_set_epi64x(64, (long long) j->len * 8);
+    l.y = gfmul(_mm_xor_si128(l.y, len), l.h);
+    uint8_t tag[16];
+    _mm_storeu_si128((__m128i *) tag, _mm_xor_si128(bswap128(l.y),
+						    aesni_encrypt(l.rk, gcm_counter(l, 1))));
+    if (SEAL)
+	memcpy(j->icv, tag, 16);
+    else
+	j->ok = IPsecCrypto::equal(tag, j->icv, 16);
+}
+
+template <bool SEAL> ESP_TARGET_AES static void
+gcm_aesni(IPsecCryptoJob *jobs, int n)
+{
+    GCMLane l[4];
+    int nl = 0, next = 0;
+    for (;;) {
+	while (nl < 4 && next < n)
+	    gcm_lane_start(l[nl++], &jobs[next++]);
+	if (nl == 0)
+	    break;
+	int steps = l[0].nfull;
+	for (int i = 1; i < nl; i++)
+	    if (l[i].nfull < steps)
+		steps = l[i].nfull;
+	switch (nl) {
+	case 4: gcm_steps<4, SEAL>(l, steps); break;
+	case 3: gcm_steps<3, SEAL>(l, steps); break;
+	case 2: gcm_steps<2, SEAL>(l, steps); break;
+	default: gcm_steps<1, SEAL>(l, steps); break;
+	}
+	for (int i = 0; i < nl; )
+	    if (l[i].nfull == 0) {
+		gcm_lane_finish<SEAL>(l[i]);
+		l[i] = l[--nl];
+	    } else
+		i++;
+    }
+}
+
+/*
+ * Multi-buffer CBC encryption, the chain of each packet is sequential so
+ * the four lanes are the only source of parallelism.
+ */
+struct CBCLane {
+    const __m128i *rk;
+    __m128i x;		// last ciphertext block
+    uint8_t *p;
+    int nfull;
+};
+
+template <int L> ESP_TARGET_AES static void
+cbc_steps(CBCLane *l, int steps)
+{
+    for (int s = 0; s < steps; s++) {
+	__m128i x[L];
+#pragma GCC unroll 16
+	for (int i = 0; i < L; i++)
+	    x[i] = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *) l[i].p), l[i].x),
+				 _mm_loadu_si128(l[i].rk));
+#pragma GCC unroll 16
+	for (int r = 1; r < IPSEC_AES_ROUNDS; r++)
+#pragma GCC unroll 16
+	    for (int i = 0; i < L; i++)
+		x[i] = _mm_aesenc_si128(x[i], _mm_loadu_si128(l[i].rk + r));
+#pragma GCC unroll 16
+	for (int i = 0; i < L; i++) {
+	    l[i].x = _mm_aesenclast_si128(x[i], _mm_loadu_si128(l[i].rk + IPSEC_AES_ROUNDS));
+	    _mm_storeu_si128((__m128i *) l[i].p, l[i].x);
+	    l[i].p += 16;
+	}
+    }
+#pragma GCC unroll 16
+    for (int i = 0; i < L; i++)
+	l[i].nfull -= steps;
+}
+
+ESP_TARGET_AES static void
+cbc_encrypt_aesni(IPsecCryptoJob *jobs, int n)
+{
+    CBCLane l[4];
+    int nl = 0, next = 0;
+    for (;;) {
+	while (nl < 4 && next < n) {
+	    IPsecCryptoJob *j = &jobs[next++];
+	    CBCLane &c = l[nl++];
+	    c.rk = (const __m128i *) j->key->enc;
+	    c.x = aesni_encrypt(c.rk, _mm_loadu_si128((const __m128i *) j->iv));
+	    _mm_storeu_si128((__m128i *) j->iv, c.x);
+	    c.p = j->data;
+	    c.nfull = j->len >> 4;
+	}
+	if (nl == 0)
+	    break;
+	int steps = l[0].nfull;
+	for (int i = 1; i < nl; i++)
+	    if (l[i].nfull < steps)
+		steps = l[i].nfull;
+	switch (nl) {
+	case 4: cbc_steps<4>(l, steps); break;
+	case 3: cbc_steps<3>(l, steps); break;
+	case 2: cbc_steps<2>(l, steps); break;
+	default: cbc_steps<1>(l, steps); break;
+	}
+	for (int i = 0; i < nl; )
+	    if (l[i].nfull == 0)
+		l[i] = l[--nl];
+	    else
+		i++;
+    }
+}
+
+/* CBC decryption of the blocks of a packet is independent, four blocks are
+ * decrypted at once. */
+ESP_TARGET_AES static void
+cbc_decrypt_aesni(IPsecCryptoJob *jobs, int n)
+{
+    for (int k = 0; k < n; k++) {
+	IPsecCryptoJob &j = jobs[k];
+	const __m128i *rk = (const __m128i *) j.key->dec;
+	__m128i prev = _mm_loadu_si128((const __m128i *) j.iv);
+	__m128i *p = (__m128i *) j.data;
+	int nb = j.len >> 4;
+	for (; nb >= 4; nb -= 4, p += 4) {
+	    __m128i c[4], x[4];
+#pragma GCC unroll 16
+	    for (int i = 0; i < 4; i++) {
+		c[i] = _mm_loadu_si128(p + i);
+		x[i] = _mm_xor_si128(c[i], _mm_loadu_si128(rk));
+	    }
+#pragma GCC unroll 16
+	    for (int r = 1; r < IPSEC_AES_ROUNDS; r++)
+#pragma GCC unroll 16
+		for (int i = 0; i < 4; i++)
+		    x[i] = _mm_aesdec_si128(x[i], _mm_loadu_si128(rk + r));
+#pragma GCC unroll 16
+	    for (int i = 0; i < 4; i++)
+		x[i] = _mm_aesdeclast_si128(x[i], _mm_loadu_si128(rk + IPSEC_AES_ROUNDS));
+	    _mm_storeu_si128(p, _mm_xor_si128(x[0], prev));
+#pragma GCC unroll 16
+	    for (int i = 1; i < 4; i++)
+		_mm_storeu_si128(p + i, _mm_xor_si128(x[i], c[i - 1]));
+	    prev = c[3];
+	}
+	for (; nb > 0; nb--, p++) {
+	    __m128i c = _mm_loadu_si128(p);
+	    _mm_storeu_si128(p, _mm_xor_si128(aesni_decrypt(rk, c), prev));
+	    prev = c;
+	}
+    }
+}
+
+ESP_TARGET_SHA static void
+sha256_blocks_shani(uint32_t *st, const uint8_t *data, int nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    // the instructions work on the state as ABEF and CDGH
+    __m128i t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) st), 0xB1);
+    __m128i s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (st + 4)), 0x1B);
+    __m128i s0 = _mm_alignr_epi8(t, s1, 8);
+    s1 = _mm_blend_epi16(s1, t, 0xF0);
+
+    for (; nblocks > 0; nblocks--, data += 64) {
+	__m128i save0 = s0, save1 = s1;
+	__m128i m[4];
+#pragma GCC unroll 16
+	for (int i = 0; i < 4; i++)
+	    m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + i * 16)), mask);
+#pragma GCC unroll 16
+	for (int g = 0; g < 16; g++) {
+	    __m128i msg = _mm_add_epi32(m[g & 3], _mm_loadu_si128((const __m128i *) (sha256_k + g * 4)));
+	    s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+	    s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(msg, 0x0E));
+	    if (g < 12) {
+		// message words 4g+16 to 4g+19 replace the ones just used
+		__m128i w7 = _mm_alignr_epi8(m[(g + 3) & 3], m[(g + 2) & 3], 4);
+		__m128i w = _mm_add_epi32(_mm_sha256msg1_epu32(m[g & 3], m[(g + 1) & 3]), w7);
+		m[g & 3] = _mm_sha256msg2_epu32(w, m[(g + 3) & 3]);
+	    }
+	}
+	s0 = _mm_add_epi32(s0, save0);
+	s1 = _mm_add_epi32(s1, save1);
+    }
+
+    t = _mm_shuffle_epi32(s0, 0x1B);
+    s1 = _mm_shuffle_epi32(s1, 0xB1);
+    s0 = _mm_blend_epi16(t, s1, 0xF0);
+    s1 = _mm_alignr_epi8(s1, t, 8);
+    _mm_storeu_si128((__m128i *) st, s0);
+    _mm_storeu_si128((__m128i *) (st + 4), s1);
+}
+#endif
+
+
+void
+IPsecCrypto::static_initialize()
+{
+    static bool initialized;
+    if (initialized)
+	return;
+    aes_init_tables();
+#if CLICK_ESP_AESNI
+    check_cpu();
+#endif
+    initialized = true;
+}
+
+bool
+IPsecCrypto::accelerated()
+{
+#if CLICK_ESP_AESNI
+    return has_aesni;
+#else
+    return false;
+#endif
+}
+
+void
+IPsecCrypto::set_aes_key(IPsecAESKey &k, const uint8_t *key)
+{
+    memcpy(k.enc[0], key, 16);
+    uint8_t rcon = 1;
+    for (int r = 1; r <= IPSEC_AES_ROUNDS; r++) {
+	const uint8_t *p = k.enc[r - 1];
+	uint8_t *q = k.enc[r];
+	q[0] = p[0] ^ aes_sbox[p[13]] ^ rcon;
+	q[1] = p[1] ^ aes_sbox[p[14]];
+	q[2] = p[2] ^ aes_sbox[p[15]];
+	q[3] = p[3] ^ aes_sbox[p[12]];
+	for (int i = 4; i < 16; i++)
+	    q[i] = p[i] ^ q[i - 4];
+	rcon = aes_xtime(rcon);
+    }
+    memcpy(k.dec[0], k.enc[IPSEC_AES_ROUNDS], 16);
+    for (int r = 1; r < IPSEC_AES_ROUNDS; r++) {
+	memcpy(k.dec[r], k.enc[IPSEC_AES_ROUNDS - r], 16);
+	for (int c = 0; c < 4; c++)
+	    aes_inv_mix_column(k.dec[r] + c * 4);
+    }
+    memcpy(k.dec[IPSEC_AES_ROUNDS], k.enc[0], 16);
+
+    uint8_t zero[16];
+    memset(zero, 0, 16);
+    aes_encrypt_block(k, zero, k.h);
+    // mulX_POLYVAL(ByteReverse(H)), little-endian
+    uint64_t h_lo = load_be64(k.h + 8), h_hi = load_be64(k.h);
+    uint64_t carry = h_hi >> 63;
+    h_hi = (h_hi << 1) | (h_lo >> 63);
+    h_lo <<= 1;
+    if (carry) {
+	h_hi ^= 0xC200000000000000ULL;
+	h_lo ^= 1;
+    }
+    for (int i = 0; i < 8; i++) {
+	k.polyval_h[i] = h_lo >> (i * 8);
+	k.polyval_h[i + 8] = h_hi >> (i * 8);
+    }
+}
+
+void
+IPsecCrypto::set_hmac_key(IPsecAESKey &k, const uint8_t *key, int len)
+{
+    uint8_t pad[64];
+    uint32_t key_hash[8];
+    if (len > 64) {
+	// longer keys are replaced by their digest (RFC 2104)
+	uint8_t digest[32];
+	memcpy(key_hash, sha256_iv, sizeof(key_hash));
+	int full = len / 64;
+	sha256_blocks_generic(key_hash, key, full);
+	uint8_t last[128];
+	int rest = len - full * 64;
+	int nb = rest + 9 > 64 ? 2 : 1;
+	memset(last, 0, sizeof(last));
+	memcpy(last, key + full * 64, rest);
+	last[rest] = 0x80;
+	store_be64(last + nb * 64 - 8, (uint64_t) len * 8);
+	sha256_blocks_generic(key_hash, last, nb);
+	for (int i = 0; i < 8; i++)
+	    store_be32(digest + i * 4, key_hash[i]);
+	set_hmac_key(k, digest, 32);
+	return;
+    }
+    memset(pad, 0x36, 64);
+    for (int i = 0; i < len; i++)
+	pad[i] ^= key[i];
+    memcpy(k.hmac_inner, sha256_iv, sizeof(k.hmac_inner));
+    sha256_blocks_generic(k.hmac_inner, pad, 1);
+    memset(pad, 0x5C, 64);
+    for (int i = 0; i < len; i++)
+	pad[i] ^= key[i];
+    memcpy(k.hmac_outer, sha256_iv, sizeof(k.hmac_outer));
+    sha256_blocks_generic(k.hmac_outer, pad, 1);
+}
+
+/* Hashes LEN bytes at DATA into ST, which already covers PREFIX bytes, and
+ * writes the digest to OUT */
+static void
+sha256_finish(uint32_t *st, const uint8_t *data, int len, int prefix, uint8_t *out, bool shani)
+{
+    void (*blocks)(uint32_t *, const uint8_t *, int) = sha256_blocks_generic;
+#if CLICK_ESP_AESNI
+    if (shani)
+	blocks = sha256_blocks_shani;
+#else
+    (void) shani;
+#endif
+    int full = len / 64;
+    blocks(st, data, full);
+    uint8_t last[128];
+    int rest = len - full * 64;
+    int nb = rest + 9 > 64 ? 2 : 1;
+    memset(last, 0, sizeof(last));
+    memcpy(last, data + full * 64, rest);
+    last[rest] = 0x80;
+    store_be64(last + nb * 64 - 8, (uint64_t) (prefix + len) * 8);
+    blocks(st, last, nb);
+    for (int i = 0; i < 8; i++)
+	store_be32(out + i * 4, st[i]);
+}
+
+void
+IPsecCrypto::hmac_sha256(const IPsecAESKey &k, const uint8_t *data, int len,
+			 uint8_t *out, bool accel)
+{
+    bool shani = false;
+#if CLICK_ESP_AESNI
+    shani = accel && IPsecCrypto::accelerated() && has_sha;
+#else
+    (void) accel;
+#endif
+    uint32_t st[8];
+    uint8_t inner[32], digest[32];
+    memcpy(st, k.hmac_inner, sizeof(st));
+    sha256_finish(st, data, len, 64, inner, shani);
+    memcpy(st, k.hmac_outer, sizeof(st));
+    sha256_finish(st, inner, 32, 64, digest, shani);
+    memcpy(out, digest, IPSEC_ICV_SIZE);
+}
+
+void
+IPsecCrypto::gcm_seal(IPsecCryptoJob *jobs, int n, bool accel)
+{
+#if CLICK_ESP_AESNI
+    if (accel && accelerated()) {
+	gcm_aesni<true>(jobs, n);
+	return;
+    }
+#else
+    (void) accel;
+#endif
+    for (int i = 0; i < n; i++)
+	gcm_generic(jobs[i], true);
+}
+
+void
+IPsecCrypto::gcm_open(IPsecCryptoJob *jobs, int n, bool accel)
+{
+#if CLICK_ESP_AESNI
+    if (accel && accelerated()) {
+	gcm_aesni<false>(jobs, n);
+	return;
+    }
+#else
+    (void) accel;
+#endif
+    for (int i = 0; i < n; i++)
+	gcm_generic(jobs[i], false);
+}
+
+void
+IPsecCrypto::cbc_encrypt(IPsecCryptoJob *jobs, int n, bool accel)
+{
+#if CLICK_ESP_AESNI
+    if (accel && accelerated()) {
+	cbc_encrypt_aesni(jobs, n);
+	return;
+    }
+#else
+    (void) accel;
+#endif
+    for (int i = 0; i < n; i++)
+	cbc_encrypt_generic(jobs[i]);
+}
+
+void
+IPsecCrypto::cbc_decrypt(IPsecCryptoJob *jobs, int n, bool accel)
+{
+#if CLICK_ESP_AESNI
+    if (accel && accelerated()) {
+	cbc_decrypt_aesni(jobs, n);
+	return;
+    }
+#else
+    (void) accel;
+#endif
+    for (int i = 0; i < n; i++)
+	cbc_decrypt_generic(jobs[i]);
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IPsecCrypto)
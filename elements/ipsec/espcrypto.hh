@@ -0,0 +1,88 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPSEC_ESPCRYPTO_HH
+#define CLICK_IPSEC_ESPCRYPTO_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * espcrypto.{cc,hh} -- AES-128 (GCM, CBC) and HMAC-SHA-256 for ESP
+ *
+ * The kernels take an array of jobs, one per packet, so that they can work
+ * on several packets at once. When the CPU has AES-NI and PCLMULQDQ, GCM
+ * and CBC encryption run four packets in parallel: each step encrypts one
+ * block of each packet, so the latencies of AESENC and of the GHASH
+ * multiplications of one packet are hidden behind the work on the other
+ * ones. CBC decryption is parallel within a packet. Otherwise, a portable
+ * byte-oriented implementation processes jobs one after the other.
+ */
+
+#define IPSEC_AES_BLOCK	16
+#define IPSEC_AES_ROUNDS	10
+#define IPSEC_ICV_SIZE	16
+
+/* Expanded keys of a Security Association. */
+struct IPsecAESKey {
+    uint8_t enc[IPSEC_AES_ROUNDS + 1][IPSEC_AES_BLOCK];	// encryption round keys
+    uint8_t dec[IPSEC_AES_ROUNDS + 1][IPSEC_AES_BLOCK];	// equivalent inverse cipher round keys
+    uint8_t h[IPSEC_AES_BLOCK];		// GHASH key, E(K, 0)
+    uint8_t polyval_h[IPSEC_AES_BLOCK];	// H for the PCLMULQDQ kernels
+    uint8_t salt[4];			// implicit part of the GCM nonce
+    uint32_t hmac_inner[8];		// SHA-256 state after K ^ ipad
+    uint32_t hmac_outer[8];		// SHA-256 state after K ^ opad
+};
+
+struct IPsecCryptoJob {
+    const IPsecAESKey *key;
+    uint8_t *data;		// encrypted or decrypted in place
+    int len;			// bytes at data, a multiple of 16 for CBC
+    uint8_t *iv;		// 8-byte explicit IV (GCM) or 16-byte IV (CBC)
+    const uint8_t *aad;		// 8 bytes of ESP header, GCM only
+    uint8_t *icv;		// 16-byte GCM tag
+    bool ok;			// false if the tag did not verify
+};
+
+class IPsecCrypto { public:
+
+    /* Builds the AES tables and detects the CPU features. Must be called
+     * before any other function, at configuration time: nothing is set up
+     * lazily on the data path. */
+    static void static_initialize();
+
+    /* Returns true if the CPU supports the accelerated kernels. */
+    static bool accelerated();
+
+    /* Expands an AES-128 KEY, and computes the GHASH key. */
+    static void set_aes_key(IPsecAESKey &k, const uint8_t *key);
+
+    /* Precomputes the inner and outer HMAC-SHA-256 states for KEY. */
+    static void set_hmac_key(IPsecAESKey &k, const uint8_t *key, int len);
+
+    /* AES-GCM with a 16-byte tag (RFC 4106). The nonce is the salt of the
+     * key followed by the 8-byte IV. gcm_seal encrypts and writes the tag
+     * to icv; gcm_open decrypts and sets ok if icv matches. */
+    static void gcm_seal(IPsecCryptoJob *jobs, int n, bool accel);
+    static void gcm_open(IPsecCryptoJob *jobs, int n, bool accel);
+
+    /* AES-CBC (RFC 3602). cbc_encrypt first replaces the 16 bytes at iv
+     * by their encryption, so a counter gives an unpredictable IV (NIST
+     * SP 800-38A, appendix C). */
+    static void cbc_encrypt(IPsecCryptoJob *jobs, int n, bool accel);
+    static void cbc_decrypt(IPsecCryptoJob *jobs, int n, bool accel);
+
+    /* Writes the first IPSEC_ICV_SIZE bytes of the HMAC-SHA-256 of LEN
+     * bytes at DATA to OUT (RFC 4868). */
+    static void hmac_sha256(const IPsecAESKey &k, const uint8_t *data, int len,
+			    uint8_t *out, bool accel);
+
+    /* Compares N bytes in a time independent of their contents. */
+    static inline bool equal(const uint8_t *a, const uint8_t *b, int n) {
+	uint8_t d = 0;
+	for (int i = 0; i < n; i++)
+	    d |= a[i] ^ b[i];
+	return d == 0;
+    }
+
+};
+
+CLICK_ENDDECLS
+#endif
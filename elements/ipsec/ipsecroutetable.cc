@@ -190,8 +190,12 @@ IPsecRouteTable::dump_routes()
     return String();
 }
 
-void
-IPsecRouteTable::push(int, Packet *p)
+/* Returns the output port of P after setting its IPsec annotations, or -1 if
+ * P must be dropped. LAST_SPI and LAST_SA remember the Security Association
+ * of the previous incoming ESP packet, so that a run of packets of the same
+ * tunnel looks the SA table up once. */
+inline int
+IPsecRouteTable::process(Packet *p, uint32_t &last_spi, SADataTuple *&last_sa)
 {
 
     IPAddress gw;
@@ -226,11 +230,15 @@ IPsecRouteTable::push(int, Packet *p)
 	    // so we set the proper annotation with reference to Security Data Table to be used by IPsec modules
             // Careful this enhancement is 32-bit architecture specific!!
             struct esp_new * esp =(struct esp_new *)(p->data()+sizeof(click_ip));
-            sa_data = _sa_table.lookup(SPI(ntohl(esp->esp_spi)));
+            uint32_t esp_spi = ntohl(esp->esp_spi);
+            if (esp_spi != last_spi || last_sa == NULL) {
+                last_sa = _sa_table.lookup(SPI(esp_spi));
+                last_spi = esp_spi;
+            }
+            sa_data = last_sa;
 	    if(sa_data == NULL) {
-		click_chatter("Invalid SPI %d, Dropping packet",ntohl(esp->esp_spi));
-	p->kill();
-                return;
+		click_chatter("Invalid SPI %d, Dropping packet",esp_spi);
+                return -1;
            }
 	   SET_IPSEC_SA_DATA_REFERENCE_ANNO(p, (uintptr_t)sa_data);
 	   break;
@@ -239,15 +247,38 @@ IPsecRouteTable::push(int, Packet *p)
 	assert(port < noutputs());
 	if (gw)
 	    p->set_dst_ip_anno(gw);
-	output(port).push(p);
+	return port;
     } else {
 	static int complained = 0;
 	if (++complained <= 5)
 	    click_chatter("IPsecRouteTable: no route for %s", p->dst_ip_anno().unparse().c_str());
-	p->kill();
+	return -1;
     }
 }
 
+void
+IPsecRouteTable::push(int, Packet *p)
+{
+    uint32_t last_spi = 0;
+    SADataTuple *last_sa = NULL;
+    int port = process(p, last_spi, last_sa);
+    if (port >= 0)
+	output(port).push(p);
+    else
+	p->kill();
+}
+
+#if HAVE_BATCH
+void
+IPsecRouteTable::push_batch(int, PacketBatch *batch)
+{
+    uint32_t last_spi = 0;
+    SADataTuple *last_sa = NULL;
+    auto fnt = [this, &last_spi, &last_sa](Packet *p) { return process(p, last_spi, last_sa); };
+    CLASSIFY_EACH_PACKET(noutputs() + 1, fnt, batch, checked_output_push_batch);
+}
+#endif
+
 
 int
 IPsecRouteTable::run_command(int command, const String &str, Vector<IPsecRoute> * old_routes, ErrorHandler *errh)
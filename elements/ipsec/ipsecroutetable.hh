@@ -2,7 +2,7 @@
 #ifndef CLICK_IPSECROUTETABLE_HH
 #define CLICK_IPSECROUTETABLE_HH
 #include <click/glue.hh>
-#include <click/element.hh>
+#include <click/batchelement.hh>
 #include "satable.hh"
 #include "sadatatuple.hh"
 CLICK_DECLS
@@ -199,7 +199,7 @@ struct IPsecRoute {
 };
 
 
-class IPsecRouteTable : public Element { public:
+class IPsecRouteTable : public BatchElement { public:
 
     void* cast(const char*);
     int configure(Vector<String>&, ErrorHandler*) CLICK_COLD;
@@ -211,6 +211,9 @@ class IPsecRouteTable : public Element { public:
     virtual String dump_routes();
 
     void push(int port, Packet* p);
+#if HAVE_BATCH
+    void push_batch(int port, PacketBatch* batch);
+#endif
 
     static int add_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int remove_route_handler(const String&, Element*, void*, ErrorHandler*);
@@ -222,6 +225,7 @@ class IPsecRouteTable : public Element { public:
 
   private:
     enum { CMD_ADD, CMD_SET, CMD_REMOVE };
+    inline int process(Packet* p, uint32_t& last_spi, SADataTuple*& last_sa);
     int run_command(int command, const String &, Vector<IPsecRoute>* old_routes, ErrorHandler*);
 
 };
@@ -101,6 +101,42 @@ class SADataTuple {
          return ((cur_rpl != 0));
      }
 
+    /* Anti-replay check of sequence number SEQ. Returns 1 and marks it as
+     * seen if it is acceptable, 0 otherwise. */
+    int check_replay_window(unsigned long seq)
+    {
+	unsigned long diff;
+
+	if (seq == 0)
+		return 0;		/* first == 0 or wrapped */
+	/*This logic has been added for the time being to deal with replay rollover*/
+	if((seq == replay_start_counter) && (lastseq!=replay_start_counter)) { bitmap=0;lastseq=seq;return 1;}
+
+	if (seq > lastseq)	/* new larger sequence number */
+	{
+		diff = seq - lastseq;
+		if (diff < ooowin) /* In win, set bit for this pkt */
+			bitmap = (bitmap << diff) | 1;
+		else
+			bitmap = 1; /* This packet has way larger */
+
+		lastseq = seq;
+		return 1;		/* larger is good */
+	}
+	diff = lastseq - seq;
+	if (diff >= ooowin) {	/* too old or wrapped */
+		click_chatter("Replay protection: This packet is too old to be accepted\n");
+		return 0;
+
+        }
+	if (bitmap & (1 << diff)) { /* this packet already seen */
+		click_chatter("Replay protection: This packet is already seen...\n");
+		return 0;
+        }
+	bitmap |= (1 << diff);	/* mark as seen */
+	return 1;			/* out of order but good */
+    }
+
 String unparse_entries() const
      {
          char buf[71];
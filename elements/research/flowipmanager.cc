@@ -280,7 +280,7 @@ void FlowIPManager::push_batch(int, PacketBatch* batch)
     SFCB_STACK(
     BatchBuilder b;
     Timestamp recent = Timestamp::recent_steady();
-    FOR_EACH_PACKET_SAFE(batch, p) {
+    FOR_EACH_PACKET_SAFE_PREFETCH(batch, p) {
         process(p, b, recent);
     }
 
@@ -126,7 +126,7 @@ void FlowIPManagerHMP::push_batch(int, PacketBatch* batch)
 {
     BatchBuilder b;
 
-    FOR_EACH_PACKET_SAFE(batch, p) {
+    FOR_EACH_PACKET_SAFE_PREFETCH(batch, p) {
         process(p, b);
     }
 
@@ -23,6 +23,10 @@
 #include <click/error.hh>
 #include <click/straccum.hh>
 #include <click/standard/alignmentinfo.hh>
+#if CLICK_CLASSIFICATION_JIT
+# include <sys/mman.h>
+# include <string.h>
+#endif
 CLICK_DECLS
 namespace Classification {
 namespace Wordwise {
@@ -1138,6 +1142,311 @@ CompressedProgram::unparse() const
 }
 
 
+//
+// NATIVE CODE GENERATION
+//
+
+#if CLICK_CLASSIFICATION_JIT
+namespace {
+
+// Emits x86-64 code for a CompressedProgram. The generated function follows
+// the System V calling convention: the three data regions arrive in %rdi,
+// %rsi and %rdx, and the output is returned in %eax, the only register used.
+class CodeEmitter { public:
+
+    CodeEmitter(const CompressedProgram &zprog, int offset_net,
+		int offset_transp)
+	: _zprog(zprog), _offset_net(offset_net),
+	  _offset_transp(offset_transp) {
+    }
+
+    bool emit();
+
+    const Vector<unsigned char> &code() const {
+	return _code;
+    }
+
+  private:
+
+    enum {
+	op_jmp = 0, op_jb = 0x82, op_je = 0x84,
+	reg_rdx = 2, reg_rsi = 6, reg_rdi = 7,
+	max_linear = 4		// largest value set tested linearly
+    };
+
+    const CompressedProgram &_zprog;
+    int _offset_net;
+    int _offset_transp;
+    Vector<unsigned char> _code;
+    Vector<int> _test_pos;	// code position of each test, by word
+    Vector<int> _fixup_pos;	// rel32 fields to patch...
+    Vector<int32_t> _fixup_target; // ...with a word (> 0) or an output (<= 0)
+
+    void u8(unsigned char x) {
+	_code.push_back(x);
+    }
+    void u32(uint32_t x) {
+	for (int i = 0; i < 4; ++i)
+	    _code.push_back(x >> (8 * i));
+    }
+    void patch32(int pos, uint32_t x) {
+	for (int i = 0; i < 4; ++i)
+	    _code[pos + i] = x >> (8 * i);
+    }
+
+    void load(int off);
+    void branch(int op, int word, int32_t jump);
+    void search(const uint32_t *v, int n, int word, int32_t yes, int32_t no,
+		bool fall_through);
+
+};
+
+// mov off(%region), %eax
+void
+CodeEmitter::load(int off)
+{
+    int reg = reg_rdi;
+    if (off >= _offset_transp) {
+	reg = reg_rdx;
+	off -= _offset_transp;
+    } else if (off >= _offset_net) {
+	reg = reg_rsi;
+	off -= _offset_net;
+    }
+    u8(0x8B);
+    u8(0x80 | reg);
+    u32(off);
+}
+
+// Jump to the test @a jump words after @a word, or return output -@a jump
+void
+CodeEmitter::branch(int op, int word, int32_t jump)
+{
+    if (op == op_jmp)
+	u8(0xE9);
+    else {
+	u8(0x0F);
+	u8(op);
+    }
+    _fixup_pos.push_back(_code.size());
+    _fixup_target.push_back(jump > 0 ? word + jump : jump);
+    u32(0);
+}
+
+// Branch to @a yes if %eax is one of the @a n sorted values, to @a no
+// otherwise. Large sets become a binary search tree of comparisons.
+void
+CodeEmitter::search(const uint32_t *v, int n, int word, int32_t yes,
+		    int32_t no, bool fall_through)
+{
+    if (n <= max_linear) {
+	for (int i = 0; i < n; ++i) {
+	    u8(0x3D);		// cmp $v, %eax
+	    u32(v[i]);
+	    branch(op_je, word, yes);
+	}
+	if (!fall_through)
+	    branch(op_jmp, word, no);
+	return;
+    }
+
+    int mid = n / 2;
+    u8(0x3D);
+    u32(v[mid]);
+    branch(op_je, word, yes);
+    u8(0x0F);
+    u8(op_jb);
+    int below = _code.size();
+    u32(0);
+    search(v + mid + 1, n - mid - 1, word, yes, no, false);
+    patch32(below, _code.size() - (below + 4));
+    search(v, mid, word, yes, no, fall_through);
+}
+
+bool
+CodeEmitter::emit()
+{
+    const uint32_t *begin = _zprog.begin(), *end = _zprog.end();
+    if (begin == end)
+	return false;
+    _test_pos.assign(end - begin, -1);
+
+    Vector<uint32_t> values;
+    for (const uint32_t *pr = begin; pr < end; ) {
+	int word = pr - begin;
+	int nval = pr[0] >> 17;
+	if (pr + 4 + nval > end)
+	    return false;
+	_test_pos[word] = _code.size();
+
+	load((int16_t) pr[0]);
+	if (pr[3] != 0xFFFFFFFFU) {
+	    u8(0x25);		// and $mask, %eax
+	    u32(pr[3]);
+	}
+	// Any value may match, so they can be reordered for the search
+	values.clear();
+	for (int i = 0; i < nval; ++i)
+	    values.push_back(pr[4 + i]);
+	click_qsort(values.begin(), nval);
+	// The failure branch usually leads to the next test
+	bool fall_through = (int32_t) pr[1] == 4 + nval && pr + 4 + nval < end;
+	search(values.begin(), nval, word, pr[2], pr[1], fall_through);
+
+	pr += 4 + nval;
+    }
+
+    // One return stub per output
+    Vector<int32_t> outputs;
+    Vector<int> stub_pos;
+    for (int i = 0; i < _fixup_pos.size(); ++i) {
+	int32_t target = _fixup_target[i];
+	int pos;
+	if (target > 0) {
+	    if (target >= _test_pos.size() || _test_pos[target] < 0)
+		return false;
+	    pos = _test_pos[target];
+	} else {
+	    int j = 0;
+	    while (j < outputs.size() && outputs[j] != target)
+		++j;
+	    if (j == outputs.size()) {
+		outputs.push_back(target);
+		stub_pos.push_back(_code.size());
+		u8(0xB8);	// mov $output, %eax
+		u32(-target);
+		u8(0xC3);	// ret
+	    }
+	    pos = stub_pos[j];
+	}
+	patch32(_fixup_pos[i], pos - (_fixup_pos[i] + 4));
+    }
+    return true;
+}
+
+}
+#endif
+
+/** @brief Generate native code for @a zprog.
+ *
+ * Returns false, leaving the CompiledProgram empty, if native code is not
+ * supported or @a zprog has no tests (CompressedProgram::output_everything()
+ * is then the answer). */
+bool
+CompiledProgram::compile(const CompressedProgram &zprog, int offset_net,
+			 int offset_transp)
+{
+    clear();
+#if CLICK_CLASSIFICATION_JIT
+    if (zprog.output_everything() >= 0)
+	return false;
+    CodeEmitter emitter(zprog, offset_net, offset_transp);
+    if (!emitter.emit())
+	return false;
+
+    size_t size = emitter.code().size();
+    void *code = mmap(0, size, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+	return false;
+    memcpy(code, emitter.code().begin(), size);
+    if (mprotect(code, size, PROT_READ | PROT_EXEC) < 0) {
+	munmap(code, size);
+	return false;
+    }
+    _code = code;
+    _code_size = size;
+    _fn = reinterpret_cast<function_type>(code);
+    return true;
+#else
+    (void) zprog, (void) offset_net, (void) offset_transp;
+    return false;
+#endif
+}
+
+void
+CompiledProgram::clear()
+{
+#if CLICK_CLASSIFICATION_JIT
+    if (_code)
+	munmap(_code, _code_size);
+#endif
+    _fn = 0;
+    _code = 0;
+    _code_size = 0;
+}
+
+void
+CompiledProgram::swap(CompiledProgram &x)
+{
+    click_swap(_fn, x._fn);
+    click_swap(_code, x._code);
+    click_swap(_code_size, x._code_size);
+}
+
+RetiredPrograms::RetiredPrograms()
+    : _timer(run_timer, this)
+{
+}
+
+RetiredPrograms::~RetiredPrograms()
+{
+    for (Retired *r = _retired.begin(); r != _retired.end(); ++r)
+	delete r->prog;
+}
+
+void
+RetiredPrograms::initialize(Element *owner)
+{
+    _timer.initialize(owner, true);
+}
+
+void
+RetiredPrograms::retire(CompiledProgram &x)
+{
+    if (!x.compiled())
+	return;
+    if (!_timer.initialized()) {
+	x.clear();
+	return;
+    }
+    Retired r;
+    r.prog = new CompiledProgram;
+    r.prog->swap(x);
+    r.expiry = Timestamp::now_steady() + Timestamp::make_msec(grace_msec);
+    _lock.acquire();
+    _retired.push_back(r);
+    _lock.release();
+    _timer.schedule_after_msec(grace_msec);
+}
+
+void
+RetiredPrograms::run_timer(Timer *t, void *user_data)
+{
+    RetiredPrograms *rp = static_cast<RetiredPrograms *>(user_data);
+    Timestamp now = Timestamp::now_steady();
+    Vector<CompiledProgram *> expired;
+
+    // A retire() racing with this callback rescheduled the timer; its
+    // program has not expired yet and is kept for the next run
+    rp->_lock.acquire();
+    Retired *w = rp->_retired.begin();
+    for (Retired *r = rp->_retired.begin(); r != rp->_retired.end(); ++r)
+	if (r->expiry <= now)
+	    expired.push_back(r->prog);
+	else
+	    *w++ = *r;
+    rp->_retired.resize(w - rp->_retired.begin());
+    bool pending = rp->_retired.size() != 0;
+    rp->_lock.release();
+
+    for (CompiledProgram **p = expired.begin(); p != expired.end(); ++p)
+	delete *p;
+    if (pending && !t->scheduled())
+	t->schedule_after_msec(grace_msec);
+}
+
+
 //
 // RUNNING
 //
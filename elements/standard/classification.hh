@@ -1,8 +1,13 @@
 #ifndef CLICK_CLASSIFICATION_HH
 #define CLICK_CLASSIFICATION_HH 1
 #define CLICK_CLASSIFICATION_WORDWISE_DOMINATOR_FASTPRED 1
+#if CLICK_USERLEVEL && defined(__x86_64__) && defined(__linux__)
+# define CLICK_CLASSIFICATION_JIT 1
+#endif
 #include <click/packet.hh>
 #include <click/vector.hh>
+#include <click/sync.hh>
+#include <click/timer.hh>
 CLICK_DECLS
 class ErrorHandler;
 namespace Classification {
@@ -276,6 +281,104 @@ class CompressedProgram { public:
 };
 
 
+/** @brief Native code for a CompressedProgram.
+ *
+ * A CompiledProgram turns each test of a CompressedProgram into a load, a
+ * mask and a tree of compare-and-branch instructions, so a packet is
+ * classified without interpreting the program. The packet data is given as
+ * three regions, as for IPFilter: the word at offset @a off of the program is
+ * read at offset @a off of the first region, @a off - offset_net of the
+ * second region if @a off >= offset_net, and @a off - offset_transp of the
+ * third region if @a off >= offset_transp.
+ *
+ * Code generation is only available for x86-64 at user level
+ * (CLICK_CLASSIFICATION_JIT). Otherwise compile() fails and callers keep
+ * interpreting the program. match() does not check packet lengths: callers
+ * must only use it on packets at least CompressedProgram::safe_length() long. */
+class CompiledProgram { public:
+
+    typedef int (*function_type)(const unsigned char *, const unsigned char *,
+				 const unsigned char *);
+
+    CompiledProgram()
+	: _fn(0), _code(0), _code_size(0) {
+    }
+    ~CompiledProgram() {
+	clear();
+    }
+
+    bool compiled() const {
+	return _fn;
+    }
+    size_t code_size() const {
+	return _code_size;
+    }
+
+    bool compile(const CompressedProgram &zprog, int offset_net,
+		 int offset_transp);
+    void clear();
+    void swap(CompiledProgram &x);
+
+    int match(const unsigned char *data, const unsigned char *net_data,
+	      const unsigned char *transp_data) const {
+	return _fn(data, net_data, transp_data);
+    }
+
+    /** @brief Return the native code, or null if there is none.
+     *
+     * Elements that can be reconfigured live read the function once and call
+     * it, so a concurrent swap() cannot clear it between test and call. */
+    function_type function() const {
+	return *static_cast<const volatile function_type *>(&_fn);
+    }
+
+  private:
+
+    function_type _fn;
+    void *_code;
+    size_t _code_size;
+
+    CompiledProgram(const CompiledProgram &);
+    CompiledProgram &operator=(const CompiledProgram &);
+
+};
+
+/** @brief Native code replaced by a live reconfiguration.
+ *
+ * When configure() swaps a new CompiledProgram in, other threads may still
+ * be running the old code. retire() takes the old code over and keeps it
+ * mapped for a grace period, after which a timer releases it. Before
+ * initialize(), no thread can run the code and retire() releases it at
+ * once. */
+class RetiredPrograms { public:
+
+    enum { grace_msec = 1000 };
+
+    RetiredPrograms();
+    ~RetiredPrograms();
+
+    void initialize(Element *owner);
+    void retire(CompiledProgram &x);
+
+  private:
+
+    struct Retired {
+	CompiledProgram *prog;
+	Timestamp expiry;
+    };
+
+    Vector<Retired> _retired;
+    Spinlock _lock;
+    Timer _timer;
+
+    static void run_timer(Timer *t, void *user_data);
+
+    RetiredPrograms(const RetiredPrograms &);
+    RetiredPrograms &operator=(const RetiredPrograms &);
+
+};
+
+
 class DominatorOptimizer { public:
 
     DominatorOptimizer(Program *p);
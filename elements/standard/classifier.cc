@@ -230,12 +230,34 @@ Classifier::configure(Vector<String> &conf, ErrorHandler *errh)
 
     if (!errh->nerrors()) {
 	prog.warn_unused_outputs(noutputs(), errh);
+	Classification::Wordwise::CompiledProgram jit;
+	compile_native(prog, jit);
 	_prog = prog;
+	_jit.swap(jit);
+	// other threads may still run the old code after a live reconfigure
+	_retired_jit.retire(jit);
 	return 0;
     } else
 	return -1;
 }
 
+/** Translate @a prog to native code, through its compressed form. All data
+ * comes from a single region, so offsets must stay below the region
+ * boundaries of CompiledProgram. */
+void
+Classifier::compile_native(const Classification::Wordwise::Program &prog,
+			   Classification::Wordwise::CompiledProgram &jit)
+{
+    if (prog.output_everything() >= 0)
+	return;
+    for (const Classification::Wordwise::Insn *in = prog.begin(); in != prog.end(); ++in)
+	if (in->offset >= 0x8000)
+	    return;
+    Classification::Wordwise::CompressedProgram zprog;
+    zprog.compile(prog, false, 0);
+    jit.compile(zprog, 0x8000, 0x8000);
+}
+
 String
 Classifier::program_string(Element *element, void *)
 {
@@ -243,10 +265,25 @@ Classifier::program_string(Element *element, void *)
     return c->_prog.unparse();
 }
 
+String
+Classifier::jit_string(Element *element, void *)
+{
+    Classifier *c = static_cast<Classifier *>(element);
+    return String(c->_jit.compiled());
+}
+
+int
+Classifier::initialize(ErrorHandler *)
+{
+    _retired_jit.initialize(this);
+    return 0;
+}
+
 void
 Classifier::add_handlers()
 {
     add_read_handler("program", Classifier::program_string, 0, Handler::CALM);
+    add_read_handler("jit", Classifier::jit_string, 0, Handler::CALM);
 }
 
 #if HAVE_BATCH
@@ -254,7 +291,7 @@ void
 Classifier::push_batch(int, PacketBatch * batch)
 {
 	CLASSIFY_EACH_PACKET(	(noutputs() + 1),
-							_prog.match,
+							match,
 							batch,
 							checked_output_push_batch);
 
@@ -264,7 +301,7 @@ Classifier::push_batch(int, PacketBatch * batch)
 inline void
 Classifier::push(int, Packet *p)
 {
-    checked_output_push(_prog.match(p), p);
+    checked_output_push(match(p), p);
 }
 
 CLICK_ENDDECLS
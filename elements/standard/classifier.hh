@@ -38,6 +38,11 @@ CLICK_DECLS
  * could ever match a pattern. Usually, this is because an earlier pattern is
  * more general, or because your pattern is contradictory (`12/0806 12/0800').
  *
+ * At user level on x86-64, the optimized program is translated to native code
+ * when the element is configured or reconfigured, and packets long enough
+ * for every test are classified by running that code rather than by
+ * interpreting the program.
+ *
  * =n
  *
  * The IPClassifier and IPFilter elements have a friendlier syntax if you are
@@ -71,6 +76,9 @@ CLICK_DECLS
  *   safe length 22
  *   alignment offset 0
  *
+ * =h jit read-only
+ * Returns true if packets are classified by native code.
+ *
  * =a IPClassifier, IPFilter */
 
 class Classifier : public BatchElement { public:
@@ -85,12 +93,14 @@ class Classifier : public BatchElement { public:
     bool can_live_reconfigure() const		{ return true; }
 
     int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
     void add_handlers() CLICK_COLD;
 
 #if HAVE_BATCH
     void push_batch(int, PacketBatch *);
 #endif
     void push(int, Packet *);
+    inline int match(const Packet *p);
 
     Classification::Wordwise::Program empty_program(ErrorHandler *errh) const;
     static void parse_program(Classification::Wordwise::Program &prog,
@@ -99,10 +109,26 @@ class Classifier : public BatchElement { public:
   protected:
 
     Classification::Wordwise::Program _prog;
+    Classification::Wordwise::CompiledProgram _jit;
+    Classification::Wordwise::RetiredPrograms _retired_jit;
 
+    static void compile_native(const Classification::Wordwise::Program &prog,
+			       Classification::Wordwise::CompiledProgram &jit);
     static String program_string(Element *, void *);
+    static String jit_string(Element *, void *);
 
 };
 
+inline int
+Classifier::match(const Packet *p)
+{
+#if CLICK_CLASSIFICATION_JIT
+    Classification::Wordwise::CompiledProgram::function_type fn = _jit.function();
+    if (likely(fn && p->length() >= _prog.safe_length()))
+	return fn(p->data() - _prog.align_offset(), 0, 0);
+#endif
+    return _prog.match(p);
+}
+
 CLICK_ENDDECLS
 #endif
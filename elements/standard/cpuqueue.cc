@@ -6,9 +6,9 @@
 CLICK_DECLS
 
 CPUQueue::CPUQueue()
-  : _last(0), _drops(0)
+  : _q(0), _last(0)
 {
-  memset(&_q, 0, sizeof(_q));
+  _drops = 0;
 }
 
 CPUQueue::~CPUQueue()
@@ -18,13 +18,13 @@ CPUQueue::~CPUQueue()
 int
 CPUQueue::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    if (click_max_cpu_ids() > 256)
-        return errh->error("too many CPUs for CPUQueue");
     unsigned new_capacity = 128;
     if (Args(conf, this, errh)
 	.read_p("CAPACITY", new_capacity)
 	.complete() < 0)
 	return -1;
+    if (new_capacity == 0)
+	return errh->error("CAPACITY must be positive");
     _capacity = new_capacity;
     return 0;
 }
@@ -32,9 +32,11 @@ CPUQueue::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 CPUQueue::initialize(ErrorHandler *errh)
 {
+  if (!(_q = new PacketRing[click_max_cpu_ids()]))
+    return errh->error("out of memory!");
   for (unsigned i=0; i<click_max_cpu_ids(); i++)
-    if (!(_q[i]._q = new Packet*[_capacity+1]))
-      return errh->error("out of memory!");
+    _q[i].initialize(_capacity);
+  _capacity = _q[0].capacity();
   _drops = 0;
   _last = 0;
   return 0;
@@ -43,34 +45,19 @@ CPUQueue::initialize(ErrorHandler *errh)
 void
 CPUQueue::cleanup(CleanupStage)
 {
-  for (unsigned i=0; i<click_max_cpu_ids(); i++) {
-    for (unsigned j = _q[i]._head; j != _q[i]._tail; j = next_i(j))
-      _q[i]._q[j]->kill();
-    delete[] _q[i]._q;
-    _q[i]._q = 0;
-  }
-}
-
-inline Packet *
-CPUQueue::deq(int n)
-{
-  if (_q[n]._head != _q[n]._tail) {
-    Packet *p = _q[n]._q[_q[n]._head];
-    _q[n]._head = next_i(_q[n]._head);
-    return p;
-  } else
-    return 0;
+  if (!_q)
+    return;
+  for (unsigned i=0; i<click_max_cpu_ids(); i++)
+    while (Packet *p = _q[i].extract())
+      p->kill();
+  delete[] _q;
+  _q = 0;
 }
 
 void
 CPUQueue::push(int, Packet *p)
 {
-    unsigned n = click_current_cpu_id();
-    unsigned next = next_i(_q[n]._tail);
-    if (next != _q[n]._head) {
-	_q[n]._q[_q[n]._tail] = p;
-	_q[n]._tail = next;
-    } else {
+    if (!_q[click_current_cpu_id()].insert(p)) {
 	p->kill();
 	_drops++;
     }
@@ -82,7 +69,7 @@ CPUQueue::pull(int)
     unsigned n = _last;
     Packet *p = 0;
     for (unsigned i = 0; i < click_max_cpu_ids(); i++) {
-	p = deq(n);
+	p = _q[n].extract();
 	n++;
 	if (n == click_max_cpu_ids())
 	    n = 0;
@@ -94,6 +81,63 @@ CPUQueue::pull(int)
     return 0;
 }
 
+#if HAVE_BATCH
+void
+CPUQueue::push_batch(int, PacketBatch *batch)
+{
+    // Insert by bursts of at most BATCH_MAX_PULL packets, so the array stays
+    // small whatever the size of the batch
+    Packet* ps[BATCH_MAX_PULL];
+    PacketRing &q = _q[click_current_cpu_id()];
+    Packet* p = batch->first();
+    while (p) {
+	unsigned count = 0;
+	for (; p && count < BATCH_MAX_PULL; p = p->next())
+	    ps[count++] = p;
+	unsigned n = q.insert_burst(ps, count);
+	for (unsigned i = n; i < count; i++) {
+	    ps[i]->kill();
+	    _drops++;
+	}
+    }
+}
+
+PacketBatch *
+CPUQueue::pull_batch(int, unsigned max)
+{
+    // Link the packets as bursts are extracted. A queue is left once it
+    // gives less than asked for, or once the batch is full
+    Packet* ps[BATCH_MAX_PULL];
+    Packet* head = 0;
+    Packet* tail = 0;
+    unsigned got = 0;
+    unsigned n = _last;
+    for (unsigned i = 0; i < click_max_cpu_ids() && got < max; ) {
+	unsigned want = max - got < BATCH_MAX_PULL ? max - got : BATCH_MAX_PULL;
+	unsigned k = _q[n].extract_burst(ps, want);
+	for (unsigned j = 0; j < k; j++) {
+	    if (tail)
+		tail->set_next(ps[j]);
+	    else
+		head = ps[j];
+	    tail = ps[j];
+	}
+	got += k;
+	if (k == want && got < max)
+	    continue;
+	i++;
+	n++;
+	if (n == click_max_cpu_ids())
+	    n = 0;
+	if (k)
+	    _last = n;
+    }
+    if (got == 0)
+	return 0;
+    return PacketBatch::make_from_simple_list(head, tail, got);
+}
+#endif
+
 String
 CPUQueue::read_handler(Element *e, void *thunk)
 {
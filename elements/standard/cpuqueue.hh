@@ -1,6 +1,7 @@
 #ifndef CPUQUEUE_HH
 #define CPUQUEUE_HH
-#include <click/element.hh>
+#include <click/batchelement.hh>
+#include <click/ring.hh>
 
 CLICK_DECLS
 
@@ -17,23 +18,20 @@ CLICK_DECLS
  * calling the push method. Drops incoming packets if the queue already holds
  * CAPACITY packets. The default for CAPACITY is 128.
  *
+ * Queues are lock-free multi-producer multi-consumer rings, CAPACITY is
+ * rounded up to the next power of 2. Any number of threads may pull from
+ * the element. Batches are enqueued and dequeued in bulk.
+ *
  * =a Queue
  */
-class CPUQueue : public Element {
-  struct {
-    Packet **_q;
-    unsigned _head;
-    unsigned _tail;
-    unsigned _pad[5];
-  } _q[CLICK_CPU_MAX];
+class CPUQueue : public BatchElement {
+  typedef LockFreeMPMCDynamicRing<Packet*> PacketRing;
+
+  PacketRing* _q;
 
   unsigned _last;
   unsigned _capacity;
-  unsigned _drops;
-
-  int next_i(unsigned i) const { return (i!=_capacity ? i+1 : 0); }
-  int prev_i(unsigned i) const { return (i!=0 ? i-1 : _capacity); }
-  Packet *deq(int);
+  atomic_uint32_t _drops;
 
   static String read_handler(Element *, void *) CLICK_COLD;
 
@@ -55,6 +53,10 @@ class CPUQueue : public Element {
 
   void push(int port, Packet *);
   Packet *pull(int port);
+#if HAVE_BATCH
+  void push_batch(int port, PacketBatch *);
+  PacketBatch *pull_batch(int port, unsigned max);
+#endif
 
   void add_handlers() CLICK_COLD;
 };
@@ -35,7 +35,7 @@ DRRSched::cast(const char *n)
     if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
 	return &_notifier;
     else
-	return Element::cast(n);
+	return BatchElement::cast(n);
 }
 
 int
@@ -68,8 +68,10 @@ DRRSched::cleanup(CleanupStage)
 {
     if (_pi) {
 	for (int j = 0; j < ninputs(); j++)
-	    if (_pi[j].head)
-		_pi[j].head->kill();
+	    while (Packet *p = _pi[j].head) {
+		_pi[j].head = p->next();
+		p->kill();
+	    }
 	delete[] _pi;
     }
 }
@@ -85,23 +87,24 @@ DRRSched::pull(int)
     for (int j = 0; j < n; j++) {
 	portinfo &pi = _pi[_next];
 	Packet *p;
-	if ((p = pi.head)) {
-	    pi.head = 0;
+	if ((p = pi.head))
 	    signals_on = true;
-	} else if (pi.signal) {
-	    p = input(_next).pull();
+	else if (pi.signal) {
+	    if ((p = input(_next).pull()))
+		p->set_next(0);
+	    pi.head = p;
 	    signals_on = true;
-	} else
-	    p = 0;
+	}
 
 	if (p == 0)
 	    pi.deficit = 0;
 	else if (p->length() <= pi.deficit) {
 	    pi.deficit -= p->length();
+	    pi.head = p->next();
+	    p->set_next(0);
 	    _notifier.set_active(true);
 	    return p;
-	} else
-	    pi.head = p;
+	}
 
 	_next++;
 	if (_next >= n)
@@ -113,5 +116,59 @@ DRRSched::pull(int)
     return 0;
 }
 
+#if HAVE_BATCH
+PacketBatch *
+DRRSched::pull_batch(int, unsigned max)
+{
+    int n = ninputs();
+    bool signals_on = false;
+    Packet *head = 0, *tail = 0;
+    unsigned count = 0;
+
+    // As pull(), but take all the packets the deficit of an input allows
+    // before moving on, until MAX packets or an idle turn over all inputs.
+    for (int j = 0; j < n; j++) {
+	portinfo &pi = _pi[_next];
+	while (count < max) {
+	    if (!pi.head && pi.signal) {
+		PacketBatch *b = input(_next).pull_batch(max - count);
+		pi.head = b ? b->first() : 0;
+		signals_on = true;
+	    }
+	    Packet *p = pi.head;
+	    if (!p || p->length() > pi.deficit)
+		break;
+	    pi.deficit -= p->length();
+	    pi.head = p->next();
+	    if (tail)
+		tail->set_next(p);
+	    else
+		head = p;
+	    tail = p;
+	    count++;
+	    j = 0;
+	}
+	if (pi.head)
+	    signals_on = true;
+	if (count >= max)
+	    break;
+
+	if (!pi.head)
+	    pi.deficit = 0;
+	_next++;
+	if (_next >= n)
+	    _next = 0;
+	_pi[_next].deficit += _quantum;
+    }
+
+    if (head) {
+	_notifier.set_active(true);
+	return PacketBatch::make_from_simple_list(head, tail, count);
+    }
+    _notifier.set_active(signals_on);
+    return 0;
+}
+#endif
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(DRRSched)
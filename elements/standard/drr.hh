@@ -1,7 +1,7 @@
 // -*- c-basic-offset: 4 -*-
 #ifndef CLICK_DRR_HH
 #define CLICK_DRR_HH
-#include <click/element.hh>
+#include <click/batchelement.hh>
 #include <click/notifier.hh>
 CLICK_DECLS
 
@@ -20,6 +20,11 @@ CLICK_DECLS
  * The inputs usually come from Queues or other pull schedulers.
  * DRRSched uses notification to avoid pulling from empty inputs.
  *
+ * Batches are pulled from an input at a time: DRRSched takes as many packets
+ * from the current input as its deficit allows before moving to the next
+ * one. Packets pulled beyond the deficit are held until the next round of
+ * their input.
+ *
  * Keyword arguments are:
  *
  * =over 8
@@ -38,7 +43,7 @@ CLICK_DECLS
  * =a PrioSched, StrideSched, RoundRobinSched
  */
 
-class DRRSched : public Element { public:
+class DRRSched : public BatchElement { public:
 
     DRRSched() CLICK_COLD;
 
@@ -53,11 +58,14 @@ class DRRSched : public Element { public:
     void cleanup(CleanupStage) CLICK_COLD;
 
     Packet *pull(int port);
+#if HAVE_BATCH
+    PacketBatch *pull_batch(int port, unsigned max) override;
+#endif
 
   private:
 
     struct portinfo {
-	Packet *head;
+	Packet *head;		// list of packets held, linked by next()
 	unsigned deficit;
 	NotifierSignal signal;
     };
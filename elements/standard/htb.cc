@@ -0,0 +1,591 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * htb.{cc,hh} -- element shapes traffic with a hierarchy of token buckets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "htb.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+#define HTB_MTU		1514
+#define HTB_MAX_QUANTUM	200000
+#define HTB_PSEC_PER_SEC	1000000000000LL
+
+HTB::HTB()
+    : _timer(this)
+{
+}
+
+HTB::~HTB()
+{
+}
+
+void *
+HTB::cast(const char *n)
+{
+    if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return BatchElement::cast(n);
+}
+
+int
+HTB::parse_class(const String &conf, int64_t burst, int r2q, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(conf, words);
+    if (words.size() < 3 || words.size() > 4)
+	return errh->error("CLASS %<%s%>: expected ID PARENT RATE [CEIL]", conf.c_str());
+
+    Class c;
+    memset(&c, 0, sizeof(c));
+    c.parent = -1;
+    if (!IntArg().parse(words[0], c.id))
+	return errh->error("CLASS %<%s%>: bad ID", conf.c_str());
+    if (words[1] != "-") {
+	uint32_t pid;
+	if (!IntArg().parse(words[1], pid))
+	    return errh->error("CLASS %<%s%>: bad PARENT", conf.c_str());
+	for (int i = 0; i < _classes.size(); i++)
+	    if (_classes[i].id == pid)
+		c.parent = i;
+	if (c.parent < 0)
+	    return errh->error("CLASS %<%s%>: parent %u must be declared first", conf.c_str(), pid);
+    }
+    if (!BandwidthArg().parse(words[2], c.rate) || c.rate == 0)
+	return errh->error("CLASS %<%s%>: bad RATE", conf.c_str());
+    c.ceil = c.rate;
+    if (words.size() == 4 && (!BandwidthArg().parse(words[3], c.ceil) || c.ceil < c.rate))
+	return errh->error("CLASS %<%s%>: CEIL must be a bandwidth at least RATE", conf.c_str());
+    for (int i = 0; i < _classes.size(); i++)
+	if (_classes[i].id == c.id)
+	    return errh->error("CLASS %<%s%>: ID %u already used", conf.c_str(), c.id);
+
+    int depth = 1;
+    for (int p = c.parent; p >= 0; p = _classes[p].parent)
+	depth++;
+    if (depth > MAX_DEPTH)
+	return errh->error("CLASS %<%s%>: hierarchy deeper than %d", conf.c_str(), (int) MAX_DEPTH);
+
+    c.rate_ps = HTB_PSEC_PER_SEC / c.rate;
+    c.ceil_ps = HTB_PSEC_PER_SEC / c.ceil;
+    if (c.rate_ps == 0)
+	return errh->error("CLASS %<%s%>: RATE too high", conf.c_str());
+    c.burst = burst > HTB_MTU * c.rate_ps ? burst : HTB_MTU * c.rate_ps;
+    c.cburst = burst > HTB_MTU * c.ceil_ps ? burst : HTB_MTU * c.ceil_ps;
+
+    uint64_t quantum = c.rate / r2q;
+    c.quantum = quantum < HTB_MTU ? HTB_MTU : (quantum > HTB_MAX_QUANTUM ? HTB_MAX_QUANTUM : quantum);
+    c.deficit = c.quantum;
+    c.mode = CAN_SEND;
+    c.prev = c.next = c.feed = -1;
+    if (c.parent >= 0)
+	_classes[c.parent].nchildren++;
+    _classes.push_back(c);
+    return 0;
+}
+
+int
+HTB::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Vector<String> classes;
+    int anno = AGGREGATE_ANNO_OFFSET;
+    uint32_t default_id;
+    bool has_default;
+    Timestamp burst = Timestamp::make_msec(0, 1);
+    Timestamp granularity = Timestamp::make_usec(0, 100);
+    int r2q = 10;
+    _limit = 1000;
+
+    if (Args(conf, this, errh)
+	.read_all("CLASS", AnyArg(), classes)
+	.read("ANNO", AnnoArg(4), anno)
+	.read("DEFAULT", default_id).read_status(has_default)
+	.read("LIMIT", _limit)
+	.read("BURST", burst)
+	.read("R2Q", r2q)
+	.read("GRANULARITY", granularity)
+	.complete() < 0)
+	return -1;
+    if (classes.empty())
+	return errh->error("no CLASS");
+    if (r2q <= 0)
+	return errh->error("R2Q must be positive");
+    _granularity = granularity.nsecval();
+    if (_granularity <= 0)
+	return errh->error("GRANULARITY must be positive");
+
+    _classes.clear();
+    _leaf_map.clear();
+    for (int i = 0; i < classes.size(); i++)
+	if (parse_class(classes[i], burst.nsecval() * 1000, r2q, errh) < 0)
+	    return -1;
+
+    // children come after their parents
+    _max_level = 0;
+    for (int i = _classes.size() - 1; i >= 0; i--) {
+	Class &c = _classes[i];
+	if (c.nchildren == 0)
+	    _leaf_map[c.id] = i;
+	if (c.parent >= 0 && _classes[c.parent].level < c.level + 1)
+	    _classes[c.parent].level = c.level + 1;
+	if (c.level > _max_level)
+	    _max_level = c.level;
+    }
+
+    _default = -1;
+    if (has_default) {
+	HashTable<uint32_t, int>::iterator it = _leaf_map.find(default_id);
+	if (!it)
+	    return errh->error("DEFAULT %u is not a leaf class", default_id);
+	_default = it.value();
+    }
+    _anno = anno;
+
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    return 0;
+}
+
+int
+HTB::initialize(ErrorHandler *)
+{
+    int64_t now = now_nsec();
+    for (int i = 0; i < _classes.size(); i++) {
+	_classes[i].tokens = _classes[i].burst;
+	_classes[i].ctokens = _classes[i].cburst;
+	_classes[i].t_c = now;
+    }
+    for (int l = 0; l < MAX_DEPTH; l++)
+	_rows[l] = -1;
+    _wheel.initialize(0x7FFFFFFF);
+    _wheel_time = now;
+    _nwaiting = 0;
+    _timer.initialize(this);
+    _count = 0;
+    _drops = 0;
+    _empty_note.sleep();
+    return 0;
+}
+
+void
+HTB::cleanup(CleanupStage)
+{
+    for (int i = 0; i < _classes.size(); i++)
+	while (Packet *p = _classes[i].head) {
+	    _classes[i].head = p->next();
+	    p->kill();
+	}
+}
+
+inline void
+HTB::list_insert(int &list, int ci)
+{
+    Class &c = _classes[ci];
+    if (list < 0) {
+	c.prev = c.next = ci;
+	list = ci;
+    } else {
+	Class &h = _classes[list];
+	c.prev = h.prev;
+	c.next = list;
+	_classes[h.prev].next = ci;
+	h.prev = ci;
+	// classes often move between lists, and would lose their turn in
+	// DRR rounds: serve first the one with more of its quantum left
+	if ((int64_t) c.deficit * h.quantum > (int64_t) h.deficit * c.quantum)
+	    list = ci;
+    }
+}
+
+inline void
+HTB::list_remove(int &list, int ci)
+{
+    Class &c = _classes[ci];
+    if (c.next == ci)
+	list = -1;
+    else {
+	_classes[c.prev].next = c.next;
+	_classes[c.next].prev = c.prev;
+	if (list == ci)
+	    list = c.next;
+    }
+    c.prev = c.next = -1;
+}
+
+/* Puts active class CI in the row of its level if it can send, or in the
+ * feed of its parent if it may borrow, activating the parent. */
+void
+HTB::place(int ci)
+{
+    Class &c = _classes[ci];
+    if (c.mode == CAN_SEND)
+	list_insert(_rows[c.level], ci);
+    else if (c.mode == MAY_BORROW && c.parent >= 0) {
+	bool parent_active = _classes[c.parent].feed >= 0;
+	list_insert(_classes[c.parent].feed, ci);
+	if (!parent_active)
+	    activate(c.parent);
+    }
+}
+
+void
+HTB::unplace(int ci)
+{
+    Class &c = _classes[ci];
+    if (c.mode == CAN_SEND)
+	list_remove(_rows[c.level], ci);
+    else if (c.mode == MAY_BORROW && c.parent >= 0) {
+	list_remove(_classes[c.parent].feed, ci);
+	if (_classes[c.parent].feed < 0)
+	    deactivate(c.parent);
+    }
+}
+
+inline void
+HTB::activate(int ci)
+{
+    _classes[ci].active = true;
+    place(ci);
+}
+
+inline void
+HTB::deactivate(int ci)
+{
+    unplace(ci);
+    _classes[ci].active = false;
+}
+
+void
+HTB::change_mode(int ci, int mode)
+{
+    Class &c = _classes[ci];
+    if (c.active) {
+	unplace(ci);
+	c.mode = mode;
+	place(ci);
+    } else
+	c.mode = mode;
+}
+
+/* Moves active class CI to the back of the list it is in, so its peers
+ * are served next. */
+inline void
+HTB::rotate(int ci)
+{
+    Class &c = _classes[ci];
+    int *list = 0;
+    if (c.mode == CAN_SEND)
+	list = &_rows[c.level];
+    else if (c.mode == MAY_BORROW && c.parent >= 0)
+	list = &_classes[c.parent].feed;
+    if (list && *list == ci)
+	*list = c.next;
+}
+
+inline void
+HTB::refill(Class &c, int64_t now)
+{
+    int64_t diff = now - c.t_c;
+    if (diff <= 0)
+	return;
+    c.t_c = now;
+    // more than a minute fills any bucket
+    if (diff > 60 * 1000000000LL)
+	diff = 60 * 1000000000LL;
+    diff *= 1000;
+    c.tokens = c.tokens + diff > c.burst ? c.burst : c.tokens + diff;
+    c.ctokens = c.ctokens + diff > c.cburst ? c.cburst : c.ctokens + diff;
+}
+
+/* Charges LEN bytes sent by LEAF, borrowing from its ancestor at LEVEL:
+ * classes from that ancestor up use their rate, and all classes their
+ * ceil. */
+inline void
+HTB::charge(int leaf, int level, int len, int64_t now)
+{
+    for (int ci = leaf; ci >= 0; ci = _classes[ci].parent) {
+	Class &c = _classes[ci];
+	refill(c, now);
+	if (c.level >= level)
+	    c.tokens -= len * c.rate_ps;
+	c.ctokens -= len * c.ceil_ps;
+	c.packets++;
+	c.bytes += len;
+	int mode = c.mode_of();
+	if (mode != c.mode)
+	    change_mode(ci, mode);
+	if (mode != CAN_SEND)
+	    wait(ci, now);
+    }
+}
+
+/* Schedules class CI in the wheel for the time its mode will change. */
+void
+HTB::wait(int ci, int64_t now)
+{
+    Class &c = _classes[ci];
+    int64_t need = c.mode == CANT_SEND ? -c.ctokens : -c.tokens;
+    int64_t wake = now + (need + 999) / 1000;
+    if (c.waiting) {
+	// expire() reschedules classes that wake up too early
+	if (wake >= c.wake)
+	    return;
+	*c.wheel_pprev = c.wheel_next;
+	if (c.wheel_next)
+	    c.wheel_next->wheel_pprev = c.wheel_pprev;
+    } else {
+	c.waiting = true;
+	if (_nwaiting++ == 0 && _wheel_time < now)
+	    _wheel_time = now;
+    }
+
+    int64_t epochs = (wake - _wheel_time + _granularity - 1) / _granularity;
+    if (epochs < 1)
+	epochs = 1;
+    else if (epochs > 0x7FFFFFFF)
+	epochs = 0x7FFFFFFF;
+    c.wake = _wheel_time + epochs * _granularity;
+    _wheel.schedule_after_head(&c, epochs, [](Class *c, Class **head) {
+	    c->wheel_next = *head;
+	    if (*head)
+		(*head)->wheel_pprev = &c->wheel_next;
+	    *head = c;
+	    c->wheel_pprev = head;
+	});
+}
+
+void
+HTB::expire(Class *c, int64_t now)
+{
+    int ci = c - _classes.begin();
+    refill(*c, now);
+    int mode = c->mode_of();
+    if (mode != c->mode)
+	change_mode(ci, mode);
+    if (mode != CAN_SEND)
+	wait(ci, now);
+}
+
+void
+HTB::advance(int64_t now)
+{
+    while (_nwaiting > 0 && now >= _wheel_time) {
+	// take the classes of the bucket first, as expiring them moves
+	// other classes in the wheel
+	_wheel.run_timers([this](Class *c) -> Class * {
+		c->waiting = false;
+		_nwaiting--;
+		_due.push_back(c);
+		return c->wheel_next;
+	    });
+	_wheel_time += _granularity;
+	for (int i = 0; i < _due.size(); i++)
+	    expire(_due[i], now);
+	_due.clear();
+    }
+}
+
+inline bool
+HTB::can_send() const
+{
+    for (int l = 0; l <= _max_level; l++)
+	if (_rows[l] >= 0)
+	    return true;
+    return false;
+}
+
+void
+HTB::update(int64_t now)
+{
+    if (can_send())
+	_empty_note.wake();
+    else
+	_empty_note.sleep();
+    if (_nwaiting > 0) {
+	int64_t t = _wheel_time > now ? _wheel_time : now;
+	Timestamp expiry = Timestamp::make_nsec(t / 1000000000, t % 1000000000);
+	if (!_timer.scheduled() || _timer.expiry_steady() > expiry)
+	    _timer.schedule_at_steady(expiry);
+    }
+}
+
+inline int
+HTB::classify(Packet *p)
+{
+    HashTable<uint32_t, int>::const_iterator it = _leaf_map.find(p->anno_u32(_anno));
+    return it ? it.value() : _default;
+}
+
+inline void
+HTB::enqueue(Packet *p, int leaf)
+{
+    if (leaf < 0 || _classes[leaf].qlen >= _limit) {
+	if (leaf >= 0)
+	    _classes[leaf].drops++;
+	_drops++;
+	p->kill();
+	return;
+    }
+    Class &c = _classes[leaf];
+    p->set_next(0);
+    if (c.tail)
+	c.tail->set_next(p);
+    else
+	c.head = p;
+    c.tail = p;
+    c.qlen++;
+    _count++;
+    if (!c.active)
+	activate(leaf);
+}
+
+inline Packet *
+HTB::dequeue(int64_t now)
+{
+    for (int l = 0; l <= _max_level; l++) {
+	int ci = _rows[l];
+	if (ci < 0)
+	    continue;
+	// descend to a leaf borrowing from the class of the row
+	while (_classes[ci].nchildren)
+	    ci = _classes[ci].feed;
+	Class &leaf = _classes[ci];
+	Packet *p = leaf.head;
+	leaf.head = p->next();
+	if (!leaf.head)
+	    leaf.tail = 0;
+	p->set_next(0);
+	leaf.qlen--;
+	_count--;
+
+	int len = p->length();
+	charge(ci, l, len, now);
+	if (leaf.qlen == 0)
+	    deactivate(ci);
+	// each class up to the row runs DRR among its peers
+	for (; ci >= 0; ci = _classes[ci].parent) {
+	    Class &c = _classes[ci];
+	    c.deficit -= len;
+	    if (c.deficit <= 0) {
+		c.deficit += c.quantum;
+		if (c.active)
+		    rotate(ci);
+	    }
+	    if (c.level >= l)
+		break;
+	}
+	return p;
+    }
+    return 0;
+}
+
+void
+HTB::push(int, Packet *p)
+{
+    enqueue(p, classify(p));
+    if (can_send())
+	_empty_note.wake();
+}
+
+Packet *
+HTB::pull(int)
+{
+    int64_t now = now_nsec();
+    advance(now);
+    Packet *p = dequeue(now);
+    update(now);
+    return p;
+}
+
+#if HAVE_BATCH
+void
+HTB::push_batch(int, PacketBatch *batch)
+{
+    uint32_t last_id = 0;
+    int last_leaf = -2;
+    FOR_EACH_PACKET_SAFE(batch, p) {
+	// packets of a subscriber often come in runs
+	uint32_t id = p->anno_u32(_anno);
+	if (id != last_id || last_leaf == -2) {
+	    last_leaf = classify(p);
+	    last_id = id;
+	}
+	enqueue(p, last_leaf);
+    }
+    if (can_send())
+	_empty_note.wake();
+}
+
+PacketBatch *
+HTB::pull_batch(int, unsigned max)
+{
+    int64_t now = now_nsec();
+    advance(now);
+    PacketBatch *batch;
+    MAKE_BATCH(dequeue(now), batch, max);
+    update(now);
+    return batch;
+}
+#endif
+
+void
+HTB::run_timer(Timer *)
+{
+    int64_t now = now_nsec();
+    advance(now);
+    update(now);
+}
+
+enum { h_length, h_drops, h_classes };
+
+String
+HTB::read_handler(Element *e, void *thunk)
+{
+    HTB *htb = static_cast<HTB *>(e);
+    switch ((intptr_t) thunk) {
+    case h_length:
+	return String(htb->_count);
+    case h_drops:
+	return String(htb->_drops);
+    default: {
+	StringAccum sa;
+	for (int i = 0; i < htb->_classes.size(); i++) {
+	    const Class &c = htb->_classes[i];
+	    sa << c.id << ' ';
+	    if (c.parent >= 0)
+		sa << htb->_classes[c.parent].id;
+	    else
+		sa << '-';
+	    sa << ' ' << c.rate << ' ' << c.ceil << ' ' << c.qlen << ' '
+	       << c.packets << ' ' << c.bytes << ' ' << c.drops << '\n';
+	}
+	return sa.take_string();
+    }
+    }
+}
+
+void
+HTB::add_handlers()
+{
+    add_read_handler("length", read_handler, h_length);
+    add_read_handler("drops", read_handler, h_drops);
+    add_read_handler("classes", read_handler, h_classes);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(HTB)
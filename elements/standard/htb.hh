@@ -0,0 +1,249 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HTB_HH
+#define CLICK_HTB_HH
+#include <click/batchelement.hh>
+#include <click/notifier.hh>
+#include <click/hashtable.hh>
+#include <click/timer.hh>
+#include <click/timerwheel.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HTB(CLASS ID PARENT RATE [CEIL], ..., [I<KEYWORDS>])
+
+=s shaping
+
+shapes traffic with a hierarchy of classes, Hierarchical Token Bucket style
+
+=d
+
+HTB stores packets in per-class queues and emits them following a hierarchy
+of classes, each with an assured RATE and a maximum rate CEIL, in the manner
+of the Linux HTB queueing discipline. A single HTB can shape thousands of
+classes, for instance one per subscriber.
+
+Each CLASS argument declares a class: its numeric ID, the ID of its PARENT
+class or C<-> for a root class, its RATE and its CEIL (default RATE), as
+bandwidths (e.g. C<10Mbps>). Parents must be declared before their children,
+and the hierarchy may be up to 8 classes deep. Packets are queued in leaf
+classes only: a packet goes to the leaf whose ID is in its ANNO annotation,
+or to the DEFAULT leaf if there is no such leaf. Packets with no leaf, and
+packets arriving at a full leaf, are dropped.
+
+A class can send as long as it did not exceed its RATE. Past it, and until
+CEIL, it may borrow the unused rate of its ancestors: the first ancestor
+that did not exceed its own RATE lends it, and all the classes on the way
+must be under their CEIL. Classes that lend from closer in the hierarchy are
+served first. Among the classes served at a time, packets are scheduled with
+Deficit Round Robin, with a quantum of RATE/R2Q bytes (at least 1514 and at
+most 200000), so the unused rate is shared about in proportion to the rates.
+The tokens of a class are counted in time, and may get negative, so packets
+are never delayed to wait for enough tokens, and the long term rates are
+exact.
+
+Classes that cannot send wait in a timer wheel of GRANULARITY epochs until
+they can. HTB is an empty notifier: downstream elements sleep while no class
+can send. A pulled batch is filled in one call.
+
+Keyword arguments are:
+
+=over 8
+
+=item ANNO
+
+Annotation holding the ID of the leaf class of a packet, 4 bytes. Default is
+the AGGREGATE annotation.
+
+=item DEFAULT
+
+ID of the leaf class of packets whose annotation matches no leaf. By default,
+these packets are dropped.
+
+=item LIMIT
+
+Integer. Maximum number of packets in the queue of each leaf. Default is
+1000.
+
+=item BURST
+
+Time. Amount of tokens a class accumulates while idle, in time at the rate
+of the class. At least the time to send 1514 bytes. Default is 1 ms.
+
+=item R2Q
+
+Integer. Divisor of the rates for the DRR quanta. Default is 10.
+
+=item GRANULARITY
+
+Time. Epoch of the timer wheel of waiting classes. Default is 100 us.
+
+=back
+
+B<Multithreaded Click note:> HTB must be pushed and pulled by the same
+thread.
+
+=e
+
+  // 10 Mbps link shared by two customers, guaranteed 3 and 7 Mbps
+  htb :: HTB(CLASS 1 - 10Mbps,
+             CLASS 10 1 3Mbps 10Mbps,
+             CLASS 11 1 7Mbps 10Mbps,
+             DEFAULT 11);
+  c :: IPClassifier(src net 10.0.1.0/24, -);
+  ... -> c;
+  c[0] -> Paint(10) -> a :: AggregatePaint -> htb -> ToDevice(eth1);
+  c[1] -> Paint(11) -> a;
+
+=h length read-only
+
+Returns the number of packets held.
+
+=h drops read-only
+
+Returns the number of packets dropped.
+
+=h classes read-only
+
+Returns one line per class with its ID, its parent's ID, its rate and ceil in
+bytes per second, its queue length, and the number of packets and bytes it
+sent and dropped.
+
+=a BandwidthShaper, DRRSched, FQCoDel */
+
+class HTB : public BatchElement { public:
+
+    HTB() CLICK_COLD;
+    ~HTB() CLICK_COLD;
+
+    const char *class_name() const override	{ return "HTB"; }
+    const char *port_count() const override	{ return PORTS_1_1; }
+    const char *processing() const override	{ return PUSH_TO_PULL; }
+    void *cast(const char *) override;
+
+    int configure(Vector<String> &, ErrorHandler *) override CLICK_COLD;
+    int initialize(ErrorHandler *) override CLICK_COLD;
+    void cleanup(CleanupStage) override CLICK_COLD;
+    void add_handlers() override CLICK_COLD;
+
+    void push(int, Packet *) override;
+    Packet *pull(int) override;
+#if HAVE_BATCH
+    void push_batch(int, PacketBatch *) override;
+    PacketBatch *pull_batch(int, unsigned) override;
+#endif
+    void run_timer(Timer *) override;
+
+    enum { MAX_DEPTH = 8 };
+    enum { CAN_SEND, MAY_BORROW, CANT_SEND };
+
+  private:
+
+    struct Class {
+	uint32_t id;
+	int parent;
+	int level;		// 0 for leaves, above the levels of the children
+	int nchildren;
+
+	uint64_t rate;		// bytes per second
+	uint64_t ceil;
+
+	// tokens are picoseconds of transmission at the rate
+	int64_t rate_ps;	// cost of a byte
+	int64_t ceil_ps;
+	int64_t burst;
+	int64_t cburst;
+	int64_t tokens;
+	int64_t ctokens;
+	int64_t t_c;		// nanoseconds
+	int mode;
+
+	int quantum;
+	int deficit;
+
+	// queue of leaves
+	Packet *head;
+	Packet *tail;
+	unsigned qlen;
+
+	// an active class is in the row of its level if it can send, and
+	// in the feed of its parent if it may borrow
+	bool active;
+	int prev;
+	int next;
+	int feed;		// first active child that may borrow
+
+	// waiting classes are in the timer wheel
+	bool waiting;
+	int64_t wake;		// time of the bucket of the wheel
+	Class *wheel_next;
+	Class **wheel_pprev;
+
+	uint64_t packets;
+	uint64_t bytes;
+	uint32_t drops;
+
+	inline int mode_of() const {
+	    if (ctokens < 0)
+		return CANT_SEND;
+	    else if (tokens >= 0)
+		return CAN_SEND;
+	    else
+		return MAY_BORROW;
+	}
+    };
+
+    Vector<Class> _classes;
+    HashTable<uint32_t, int> _leaf_map;
+    int _rows[MAX_DEPTH];
+    int _max_level;
+
+    int _anno;
+    int _default;
+    unsigned _limit;
+    int64_t _granularity;	// nanoseconds
+
+    TimerWheel<Class> _wheel;
+    int64_t _wheel_time;	// time of the next epoch of the wheel
+    int _nwaiting;
+    Vector<Class *> _due;
+    Timer _timer;
+    ActiveNotifier _empty_note;
+
+    unsigned _count;
+    uint32_t _drops;
+
+    int parse_class(const String &conf, int64_t burst, int r2q, ErrorHandler *errh);
+
+    inline int classify(Packet *p);
+    inline void enqueue(Packet *p, int leaf);
+    inline Packet *dequeue(int64_t now);
+
+    inline void list_insert(int &list, int ci);
+    inline void list_remove(int &list, int ci);
+    void place(int ci);
+    void unplace(int ci);
+    inline void activate(int ci);
+    inline void deactivate(int ci);
+    void change_mode(int ci, int mode);
+    inline void rotate(int ci);
+    inline void refill(Class &c, int64_t now);
+    inline void charge(int leaf, int level, int len, int64_t now);
+    void wait(int ci, int64_t now);
+    void expire(Class *c, int64_t now);
+    void advance(int64_t now);
+    inline bool can_send() const;
+    void update(int64_t now);
+
+    static inline int64_t now_nsec() {
+	return Timestamp::now_steady().nsecval();
+    }
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
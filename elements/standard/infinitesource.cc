@@ -198,6 +198,13 @@ InfiniteSource::setup_packet()
 	_packet = Packet::make(_headroom, _data.data(), _data.length(), 0);
     else if (_datasize <= _data.length())
 	_packet = Packet::make(_headroom, _data.data(), _datasize, 0);
+    else if (!_data.length()) {
+	// no data to repeat (e.g. RandomSource): zero-filled packet
+	WritablePacket *p = Packet::make(_headroom, 0, _datasize, 0);
+	if (p)
+	    memset(p->data(), 0, _datasize);
+	_packet = p;
+    }
     else {
 	// make up some data to fill extra space
 	StringAccum sa;
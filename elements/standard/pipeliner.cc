@@ -22,10 +22,12 @@ Pipeliner::Pipeliner()
         _active(true),_nouseless(false),_always_up(false),
         _allow_direct_traversal(true), _verbose(true),
         sleepiness(0),_sleep_threshold(0), _highwater(0),
-        _task(this), _last_start(0)
+        _task(this), _last_start(0),
+        _target(-1), _hold(0), _held(0)
 {
 #if HAVE_BATCH
     in_batch_mode = BATCH_MODE_YES;
+    _pending = 0;
 #endif
 }
 
@@ -46,17 +48,23 @@ void Pipeliner::cleanup(CleanupStage) {
       for (unsigned i = 0; i < storage.weight(); i++) {
         if (!storage.get_value(i).initialized())
             continue;
-        Packet* p;
-        while ((p = storage.get_value(i).extract()) != 0) {
+        BatchSlot slot;
+        while (storage.get_value(i).extract(slot)) {
 #if HAVE_BATCH
-            if (receives_batch == 1)
-                reinterpret_cast<PacketBatch*>(p)->kill();
+            if (slot.count > 1)
+                PacketBatch::start_head(slot.head)->kill();
             else
 #endif
-                p->kill();
+                slot.head->kill();
         }
       }
     }
+#if HAVE_BATCH
+    if (_pending) {
+        _pending->kill();
+        _pending = 0;
+    }
+#endif
 }
 
 
@@ -75,6 +83,8 @@ Pipeliner::configure(Vector<String> & conf, ErrorHandler * errh)
     .read("NOUSELESS",_nouseless)
     .read("VERBOSE",_verbose)
     .read_or_set("PREFETCH",_prefetch, true)
+    .read("TARGET",_target)
+    .read("HOLD",_hold)
     .complete() < 0)
         return -1;
 
@@ -90,6 +100,12 @@ Pipeliner::configure(Vector<String> & conf, ErrorHandler * errh)
         _burst = INT_MAX;
     }
 
+    if (_target < 0) {
+        _target = _burst;
+    } else if (_target == 0) {
+        _target = INT_MAX;
+    }
+
     //Amount of empty run of task after which it unschedule
 #if HAVE_BATCH
     _sleep_threshold = _ring_size / 2;
@@ -172,7 +188,7 @@ void Pipeliner::push_batch(int,PacketBatch* head) {
     int count = head->count();
     retry:
     //CLWB did not prove helpful here
-    if (storage->insert(head->first())) {
+    if (storage->insert_ref(BatchSlot{head->first(), (unsigned)count})) {
         stats->count += count;
         if (sleepiness >= _sleep_threshold)
             _task.reschedule();
@@ -203,7 +219,7 @@ Pipeliner::push(int,Packet* p)
     }
 
 retry:
-    if (storage->insert(p)) {
+    if (storage->insert_ref(BatchSlot{p, 1})) {
         stats->count++;
     } else {
         if (_block) {
@@ -226,7 +242,17 @@ retry:
         _task.reschedule();
 }
 
-#define HINT_THRESHOLD 32
+#if HAVE_BATCH
+inline void
+Pipeliner::flush_pending()
+{
+    PacketBatch* b = _pending;
+    _pending = 0;
+    _held = 0;
+    output_push_batch(0, b);
+}
+#endif
+
 bool
 Pipeliner::run_task(Task* t)
 {
@@ -235,57 +261,58 @@ Pipeliner::run_task(Task* t)
     for (unsigned j = 0; j < storage.weight(); j++) {
         int i = (_last_start + j) % storage.weight();
         PacketRing& s = storage.get_value(i);
-#if HAVE_BATCH
-        PacketBatch* out = NULL;
-#endif
+        BatchSlot slot;
         int n = 0;
-        while (!s.is_empty() && n < _burst) {
+        while (n < _burst && s.extract(slot)) {
+            n += slot.count;
 #if HAVE_BATCH
-            PacketBatch* b = reinterpret_cast<PacketBatch*>(s.extract());
-
-            if (unlikely(!receives_batch)) {
-                if (out == NULL) {
-                    b->set_tail(b->first());
-                    b->set_count(1);
-                    out = b;
-                } else {
-                    out->append_packet(b->first());
-                }
-                n+=1;
-            } else {
-                n+=b->count();
-                if (out == NULL) {
-                    out = b;
-                } else {
-                    out->append_batch(b);
-                }
-            }
+            //Single packets from non-batch producers do not have a tail
+            PacketBatch* b;
+            if (slot.count == 1)
+                b = PacketBatch::make_from_packet(slot.head);
+            else
+                b = PacketBatch::start_head(slot.head);
+
             if (_prefetch) {
-                FOR_EACH_PACKET(out,p) {
+                FOR_EACH_PACKET(b,p) {
                     __builtin_prefetch(p->data());
                 }
             }
-            //WritablePacket::pool_hint(b->count(),storage.get_mapping(i));
+
+            //Re-batch, without merging batches past the target
+            if (_pending && _pending->count() + slot.count > (unsigned)_target)
+                flush_pending();
+            if (_pending)
+                _pending->append_batch(b);
+            else
+                _pending = b;
+            if (_pending->count() >= (unsigned)_target)
+                flush_pending();
 #else
-            Packet* p = s.extract();
+            Packet* p = slot.head;
             if (_prefetch)
                 __builtin_prefetch(p->data());
             output(0).push(p);
-            //WritablePacket::pool_hint(HINT_THRESHOLD,storage.get_mapping(i));
-            r = true;
 #endif
+            r = true;
         }
         if (s.count() > _highwater)
             _highwater = s.count();
+    }
 
 #if HAVE_BATCH
-        if (out) {
-            output_push_batch(0,out);
+    if (_pending) {
+        if (_pending->count() < (unsigned)_target && _held < _hold && likely(_active)) {
+            //Keep the small batch for the next run, which must happen. An
+            //inactive task is not rescheduled, so it flushes instead.
+            _held++;
             r = true;
+        } else {
+            flush_pending();
         }
+    }
 #endif
 
-    }
     if (unlikely(!_active))
         return r;
 
@@ -312,10 +339,9 @@ Pipeliner::write_handler(const String &conf, Element* e, void*, ErrorHandler* er
     if (!BoolArg().parse(conf,p->_active))
         return errh->error("invalid argument");
 
-    if (p->_active)
-        p->_task.reschedule();
-    else
-        p->_task.unschedule();
+    // When deactivated, the task runs once more to flush a held batch, and
+    // then does not reschedule itself
+    p->_task.reschedule();
     return 0;
 }
 
@@ -25,6 +25,51 @@ of packets pushed to this element to another core, without the inherent
 scheduling cost of normal queues. Multiple thread can push packets to
 this queue, and the home thread of this element will push packet out.
 
+Each pushing thread has its own single-producer ring. When batching is
+enabled, a whole batch takes a single slot of the ring, along with its
+number of packets. The home thread re-batches what it extracts from all rings
+into output batches of up to TARGET packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Integer. Number of slots of each per-thread ring. Defaults to 1024.
+
+=item BURST
+
+Integer. Maximal number of packets extracted from each ring per run.
+Defaults to 32.
+
+=item BLOCKING
+
+Boolean. If true, pushing threads wait for space in the ring instead of
+dropping packets. Defaults to false.
+
+=item TARGET
+
+Integer. Target size of output batches. Small batches coming from the rings
+are merged until they reach TARGET packets. A batch that would make the output
+batch exceed TARGET is pushed in the next one. TARGET only bounds how far
+batches are merged: batches are never split, so a batch pushed into the
+Pipeliner larger than TARGET is pushed out as is. 0 means no limit other than
+BURST. Defaults to BURST.
+
+=item HOLD
+
+Integer. Number of consecutive runs during which a merged batch smaller than
+TARGET may be kept waiting for more packets, trading latency for bigger
+batches. Defaults to 0, output batches are always pushed at the end of the
+run.
+
+=item PREFETCH
+
+Boolean. Prefetch the data of extracted packets. Defaults to true.
+
+=back
+
 
 =a StaticThreadSched, Queue
 
@@ -96,7 +141,17 @@ public:
     bool _allow_direct_traversal;
     bool _verbose;
     bool _prefetch;
-    typedef DynamicRing<Packet*> PacketRing;
+
+    /**
+     * A ring slot is a batch head, or a single packet in non-batch mode,
+     *  and its number of packets, so the home thread can plan re-batching
+     *  without touching the packets.
+     */
+    struct BatchSlot {
+        Packet* head;
+        unsigned count;
+    };
+    typedef DynamicRing<BatchSlot> PacketRing;
 
     per_thread_oread<PacketRing> storage;
     struct stats {
@@ -114,6 +169,14 @@ public:
   protected:
     Task _task;
     unsigned int _last_start;
+    int _target;
+    unsigned _hold;
+    unsigned _held;
+#if HAVE_BATCH
+    PacketBatch* _pending;
+
+    inline void flush_pending();
+#endif
 
 
 };
@@ -53,6 +53,29 @@ PrioSched::pull(int)
     return 0;
 }
 
+#if HAVE_BATCH
+PacketBatch *
+PrioSched::pull_batch(int, unsigned max)
+{
+    // an input giving less than asked is empty, so lower priority inputs
+    // may fill the batch
+    PacketBatch *batch = 0;
+    for (int i = 0; i < ninputs(); i++)
+	if (_signals[i]) {
+	    unsigned n = batch ? batch->count() : 0;
+	    if (PacketBatch *b = input(i).pull_batch(max - n)) {
+		if (batch)
+		    batch->append_batch(b);
+		else
+		    batch = b;
+		if (batch->count() >= max)
+		    break;
+	    }
+	}
+    return batch;
+}
+#endif
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(PrioSched)
 ELEMENT_MT_SAFE(PrioSched)
@@ -1,7 +1,7 @@
 // -*- c-basic-offset: 4 -*-
 #ifndef CLICK_PRIOSCHED_HH
 #define CLICK_PRIOSCHED_HH
-#include <click/element.hh>
+#include <click/batchelement.hh>
 #include <click/notifier.hh>
 CLICK_DECLS
 
@@ -19,10 +19,13 @@ CLICK_DECLS
  * The inputs usually come from Queues or other pull schedulers.
  * PrioSched uses notification to avoid pulling from empty inputs.
  *
+ * A batch pull takes as many packets as possible from input 0, then fills
+ * the rest of the batch from input 1, and so on.
+ *
  * =a Queue, RoundRobinSched, StrideSched, DRRSched, SimplePrioSched
  */
 
-class PrioSched : public Element { public:
+class PrioSched : public BatchElement { public:
 
     PrioSched() CLICK_COLD;
 
@@ -35,6 +38,9 @@ class PrioSched : public Element { public:
     void cleanup(CleanupStage) CLICK_COLD;
 
     Packet *pull(int port);
+#if HAVE_BATCH
+    PacketBatch *pull_batch(int port, unsigned max) override;
+#endif
 
   private:
 
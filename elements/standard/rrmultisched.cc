@@ -68,9 +68,37 @@ RRMultiSched::pull(int)
 
 #if HAVE_BATCH
 PacketBatch *
-RRMultiSched::pull_batch(int port, unsigned max) {
-    PacketBatch *batch;
-    MAKE_BATCH(RRMultiSched::pull(port), batch, max);
+RRMultiSched::pull_batch(int, unsigned max)
+{
+    PacketBatch *batch = 0;
+    unsigned count = 0;
+    int i = _next;
+    for (int j = 0; j < _max && count < max; ) {
+        unsigned want = _n - _n_cur;
+        if (want > max - count)
+            want = max - count;
+        PacketBatch *b = (_signals[i] ? input(i).pull_batch(want) : 0);
+        if (b) {
+            unsigned k = b->count();
+            if (batch)
+                batch->append_batch(b);
+            else
+                batch = b;
+            count += k;
+            _n_cur += k;
+            j = 0;
+            // an input giving less than asked is empty
+            if (_n_cur < _n && k == want)
+                continue;
+        } else
+            j++;
+        i++;
+        if (i >= _max) {
+            i = 0;
+        }
+        _n_cur = 0;
+    }
+    _next = i;
     return batch;
 }
 #endif
@@ -21,6 +21,9 @@ CLICK_DECLS
  * The inputs usually come from Queues or other pull schedulers.
  * RoundRobinSched uses notification to avoid pulling from empty inputs.
  *
+ * A batch pull takes the remaining packets of the turn of an input in a
+ * single pull from that input.
+ *
  * =a PrioSched, StrideSched, DRRMultiSched, RoundRobinSwitch, SimpleRoundRobinSched, RoundRobinSched
  */
 
@@ -107,6 +107,44 @@ StrideSched::pull(int)
     return p;
 }
 
+#if HAVE_BATCH
+PacketBatch *
+StrideSched::pull_batch(int port, unsigned max)
+{
+    PacketBatch *batch = 0;
+    unsigned count = 0;
+    Client *c;
+    while (count < max && (c = _list)) {
+	// the first client gets packets as long as its pass stays at most
+	// the pass of the next one
+	unsigned run = max - count;
+	if (c->_next) {
+	    unsigned r = 1 + (c->_next->_pass - c->_pass) / c->_stride;
+	    if (r < run)
+		run = r;
+	}
+	PacketBatch *b = c->_signal ? input(c - _all).pull_batch(run) : 0;
+	if (b) {
+	    c->_pass += b->count() * c->_stride;
+	    c->remove();
+	    c->insert(&_list);
+	} else {
+	    // go over the other clients as pull() does
+	    Packet *p = pull(port);
+	    if (!p)
+		break;
+	    b = PacketBatch::make_from_packet(p);
+	}
+	count += b->count();
+	if (batch)
+	    batch->append_batch(b);
+	else
+	    batch = b;
+    }
+    return batch;
+}
+#endif
+
 int
 StrideSched::tickets(int port) const
 {
@@ -1,7 +1,7 @@
 // -*- c-basic-offset: 4 -*-
 #ifndef CLICK_STRIDESCHED_HH
 #define CLICK_STRIDESCHED_HH
-#include <click/element.hh>
+#include <click/batchelement.hh>
 #include <click/task.hh>
 #include <click/notifier.hh>
 CLICK_DECLS
@@ -26,13 +26,17 @@ CLICK_DECLS
  * The inputs usually come from Queues or other pull schedulers.
  * StrideSched uses notification to avoid pulling from empty inputs.
  *
+ * A batch pull takes at once from the first input of the queue all the
+ * packets it would get before its pass exceeds the pass of the next input,
+ * so batches follow the same order as single pulls.
+ *
  * =h tickets0...ticketsI<N-1> read/write
  * Returns or sets the number of tickets for each input port.
  *
  * =a PrioSched, RoundRobinSched, DRRSched, StrideSwitch
  */
 
-class StrideSched : public Element { public:
+class StrideSched : public BatchElement { public:
 
     StrideSched() CLICK_COLD;
 
@@ -52,6 +56,9 @@ class StrideSched : public Element { public:
     int set_tickets(int, int, ErrorHandler *);
 
     Packet *pull(int port);
+#if HAVE_BATCH
+    PacketBatch *pull_batch(int port, unsigned max) override;
+#endif
 
   protected:
 
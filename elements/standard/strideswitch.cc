@@ -26,20 +26,38 @@ StrideSwitch::StrideSwitch()
 {
 }
 
+inline int
+StrideSwitch::next()
+{
+    if (!_list)
+	return -1;
+    Client *stridden = _list;
+    if ((_list = stridden->_next))
+	_list->_pprev = &_list;
+    stridden->stride();
+    stridden->insert(&_list);
+    return stridden - _all;
+}
+
 void
 StrideSwitch::push(int, Packet *p)
 {
-    if (_list) {
-	Client *stridden = _list;
-	if ((_list = stridden->_next))
-	    _list->_pprev = &_list;
-	stridden->stride();
-	stridden->insert(&_list);
-	output(stridden - _all).push(p);
-    } else
+    int o = next();
+    if (o >= 0)
+	output_push(o, p);
+    else
 	p->kill();
 }
 
+#if HAVE_BATCH
+void
+StrideSwitch::push_batch(int, PacketBatch *batch)
+{
+    auto fnt = [this](Packet *) { return next(); };
+    CLASSIFY_EACH_PACKET(noutputs() + 1, fnt, batch, checked_output_push_batch);
+}
+#endif
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(StrideSched)
 EXPORT_ELEMENT(StrideSwitch)
@@ -30,6 +30,13 @@ class StrideSwitch : public StrideSched { public:
   const char *processing() const override		{ return PUSH; }
 
   void push(int, Packet *);
+#if HAVE_BATCH
+  void push_batch(int, PacketBatch *);
+#endif
+
+ private:
+
+  inline int next();
 
 };
 
@@ -33,21 +33,11 @@ Strip::configure(Vector<String> &conf, ErrorHandler *errh)
     return Args(conf, this, errh).read_mp("LENGTH", _nbytes).complete();
 }
 
-#if HAVE_BATCH
-PacketBatch *
-Strip::simple_action_batch(PacketBatch *head)
+inline void
+Strip::simple_action_vector(PacketVector &v)
 {
-	FOR_EACH_PACKET(head, current) {
-		current->pull(_nbytes);
-	}
-	return head;
-}
-#endif
-Packet *
-Strip::simple_action(Packet *p)
-{
-    p->pull(_nbytes);
-    return p;
+    for (Packet *p : v)
+        p->pull(_nbytes);
 }
 
 CLICK_ENDDECLS
@@ -18,7 +18,7 @@ CLICK_DECLS
  * =a StripToNetworkHeader, StripIPHeader, EtherEncap, IPEncap, Truncate
  */
 
-class Strip : public BatchElement { public:
+class Strip : public SimpleVectorElement<Strip> { public:
 
     Strip() CLICK_COLD;
 
@@ -27,10 +27,7 @@ class Strip : public BatchElement { public:
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
-#if HAVE_BATCH
-    PacketBatch *simple_action_batch(PacketBatch *);
-#endif
-  Packet *simple_action(Packet *);
+    inline void simple_action_vector(PacketVector &);
 
   private:
 
@@ -115,15 +115,107 @@ ThreadSafeQueue::pull(int)
 }
 
 #if HAVE_BATCH
-void ThreadSafeQueue::push_batch(int port, PacketBatch* batch) {
-    FOR_EACH_PACKET_SAFE(batch,p) {
-        ThreadSafeQueue::push(port,p);
+/**
+ * Like push(), but reserves room for as many packets of the batch as
+ * possible with a single compare-and-swap.
+ */
+void ThreadSafeQueue::push_batch(int, PacketBatch* batch) {
+    Packet* next = batch->first();
+    unsigned left = batch->count();
+tagain:
+    Storage::index_type h, t, nt;
+    unsigned n;
+    do {
+	t = tail();
+	h = head();
+	unsigned room = capacity() - size(h, t);
+	n = left < room ? left : room;
+	if (n == 0)
+	    break;
+	nt = t + n;
+	if (nt > (Storage::index_type)_capacity)
+	    nt -= _capacity + 1;
+#if ! CLICK_ATOMIC_COMPARE_SWAP
+    } while (!_xtail.compare_and_swap(t, nt));
+#else
+    } while (_xtail.compare_swap(t, nt) != t);
+#endif
+
+    if (n > 0) {
+	for (Storage::index_type i = t; i != nt; i = next_i(i)) {
+	    _q[i] = next;
+	    next = next->next();
+	}
+	left -= n;
+	set_tail(nt);
+
+	int s = size(h, nt);
+	if (s > _highwater_length)
+	    _highwater_length = s;
+
+	_empty_note.wake();
+
+	if (s == capacity()) {
+	    _full_note.sleep();
+#if HAVE_MULTITHREAD
+	    if (size() < capacity())
+		_full_note.wake();
+#endif
+	}
+    }
+
+    if (left == 0)
+	return;
+    if (unlikely(_blocking)) {
+	click_relax_fence();
+	goto tagain;
+    }
+    while (left--) {
+	Packet* p = next;
+	next = p->next();
+	push_failure(p);
     }
 }
 
-PacketBatch* ThreadSafeQueue::pull_batch(int port, unsigned max) {
-    PacketBatch* batch;
-    MAKE_BATCH(ThreadSafeQueue::pull(port),batch,max);
+/**
+ * Like pull(), but dequeues up to max packets with a single
+ * compare-and-swap.
+ */
+PacketBatch* ThreadSafeQueue::pull_batch(int, unsigned max) {
+    Storage::index_type h, t, nh;
+    unsigned n;
+    do {
+	h = head();
+	t = tail();
+	unsigned avail = size(h, t);
+	n = max < avail ? max : avail;
+	if (n == 0)
+	    break;
+	nh = h + n;
+	if (nh > (Storage::index_type)_capacity)
+	    nh -= _capacity + 1;
+#if ! CLICK_ATOMIC_COMPARE_SWAP
+    } while (!_xhead.compare_and_swap(h, nh));
+#else
+    } while (_xhead.compare_swap(h, nh) != h);
+#endif
+
+    if (n == 0) {
+	pull_failure();
+	return 0;
+    }
+
+    PacketBatch* batch = PacketBatch::start_head(_q[h]);
+    Packet* last = _q[h];
+    for (Storage::index_type i = next_i(h); i != nh; i = next_i(i)) {
+	last->set_next(_q[i]);
+	last = _q[i];
+    }
+    batch->make_tail(last, n);
+    set_head(nh);
+
+    _sleepiness = 0;
+    _full_note.wake();
     return batch;
 }
 #endif
@@ -37,6 +37,10 @@ IP Address. Can be repeated multiple times, once per destination.
 =item VIP
 IP Address of this load-balancer.
 
+=item LB_MODE, WEIGHT, MAGLEV_SIZE
+
+See FlowIPLoadBalancer.
+
 =back
 
 
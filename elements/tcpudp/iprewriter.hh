@@ -164,6 +164,28 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item SHARDED
+
+Boolean. If true, each thread running this element owns a shard: its own
+mapping table and a share of the pattern's port range (or address range, for
+patterns without ports), namely the values equal to its shard number modulo
+the number of shards. Threads never look at each other's tables, so the NIC
+must steer reply packets to the thread owning their destination port, for
+instance with a flow rule on the port's low bits when the number of shards is
+a power of two. The "shards" handler lists the shard of each thread.
+Incompatible with HANDLE_MIGRATION. Default is false.
+
+=item TIMER_WHEEL
+
+Boolean. If true, flows are expired with a timer wheel of one second epochs
+instead of binary heaps. Refreshing a flow on each packet then only changes
+its expiration time; the flow is looked at again when its bucket is due, and
+put back in the wheel if it was refreshed. Timed-out flows are reaped every
+second, regardless of REAP_INTERVAL. When the table is full, the evicted flow
+is the next to expire of the first best-effort flows of the earliest bucket
+holding one, so the choice is approximate. If no best-effort flow is found
+among the first 64 flows, the new flow is dropped. Default is false.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -193,6 +215,11 @@ space-separated numbers, where the first is the capacity and the second is the
 short-term flow reservation.  When writing, the short-term reservation can be
 omitted; it is then set to the minimum of 50 and one-eighth the capacity.
 
+=h shards read-only
+
+Returns the shard number of each thread when SHARDED is true, one
+`C<thread T shard S/N>' line per thread.
+
 =h tcp_table read-only
 
 Returns a human-readable description of the IPRewriter's current TCP mapping
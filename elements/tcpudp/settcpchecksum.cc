@@ -41,14 +41,17 @@ SetTCPChecksum::configure(Vector<String> &conf, ErrorHandler *errh)
 	.complete();
 }
 
-Packet *
-SetTCPChecksum::simple_action(Packet *p_in)
+/* Checks lengths and clears the checksum of a packet. Returns the packet,
+ * or null if it was dropped. */
+inline WritablePacket *
+SetTCPChecksum::prepare(Packet *p_in, unsigned &plen)
 {
   WritablePacket *p = p_in->uniqueify();
+  if (!p)
+    return 0;
   click_ip *iph = p->ip_header();
   click_tcp *tcph = p->tcp_header();
-  unsigned plen = ntohs(iph->ip_len) - (iph->ip_hl << 2);
-  unsigned csum;
+  plen = ntohs(iph->ip_len) - (iph->ip_hl << 2);
 
   if (!p->has_transport_header() || plen < sizeof(click_tcp)
       || plen > (unsigned)p->transport_length())
@@ -63,9 +66,6 @@ SetTCPChecksum::simple_action(Packet *p_in)
   }
 
   tcph->th_sum = 0;
-  csum = click_in_cksum((unsigned char *)tcph, plen);
-  tcph->th_sum = click_in_cksum_pseudohdr(csum, iph, plen);
-
   return p;
 
  bad:
@@ -74,6 +74,35 @@ SetTCPChecksum::simple_action(Packet *p_in)
   return(0);
 }
 
+inline void
+SetTCPChecksum::simple_action_vector(PacketVector &v)
+{
+  const unsigned char *data[PACKET_VECTOR_CAPACITY];
+  int len[PACKET_VECTOR_CAPACITY];
+  uint16_t csum[PACKET_VECTOR_CAPACITY];
+  unsigned n = 0;
+
+  v.filter([this, &data, &len, &n](Packet *p_in) -> Packet * {
+      unsigned plen;
+      WritablePacket *p = prepare(p_in, plen);
+      if (p) {
+        data[n] = p->transport_header();
+        len[n] = plen;
+        n++;
+      }
+      return p;
+    }, [](Packet *) {});
+
+  if (n == 0)
+    return;
+  click_in_cksum_batch(data, len, csum, n);
+
+  for (unsigned i = 0; i < n; i++) {
+    WritablePacket *p = static_cast<WritablePacket *>(v[i]);
+    p->tcp_header()->th_sum = click_in_cksum_pseudohdr(csum[i], p->ip_header(), len[i]);
+  }
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(SetTCPChecksum)
 ELEMENT_MT_SAFE(SetTCPChecksum)
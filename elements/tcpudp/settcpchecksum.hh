@@ -13,12 +13,13 @@ CLICK_DECLS
  * Input packets should be TCP in IP.
  *
  * Calculates the TCP header's checksum and sets the checksum header field.
- * Uses the IP header fields to generate the pseudo-header.
+ * Uses the IP header fields to generate the pseudo-header. The checksums of
+ * all packets of a batch are computed in one call to click_in_cksum_batch.
  *
  * =a CheckTCPHeader, SetIPChecksum, CheckIPHeader, SetUDPChecksum
  */
 
-class SetTCPChecksum : public SimpleElement<SetTCPChecksum> { public:
+class SetTCPChecksum : public SimpleVectorElement<SetTCPChecksum> { public:
 
   SetTCPChecksum() CLICK_COLD;
   ~SetTCPChecksum() CLICK_COLD;
@@ -27,10 +28,12 @@ class SetTCPChecksum : public SimpleElement<SetTCPChecksum> { public:
   const char *port_count() const override		{ return PORTS_1_1; }
   int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
 
-  Packet *simple_action(Packet *);
+  inline void simple_action_vector(PacketVector &);
 
 private:
   bool _fixoff;
+
+  inline WritablePacket *prepare(Packet *, unsigned &plen);
 };
 
 CLICK_ENDDECLS
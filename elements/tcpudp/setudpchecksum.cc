@@ -34,8 +34,10 @@ SetUDPChecksum::~SetUDPChecksum()
 {
 }
 
-Packet *
-SetUDPChecksum::simple_action(Packet *p_in)
+/* Checks lengths and clears the checksum of a packet. Returns the packet, or
+ * null if it was emitted on output 1 or dropped. */
+inline WritablePacket *
+SetUDPChecksum::prepare(Packet *p_in, int &len)
 {
     WritablePacket *p = p_in->uniqueify();
     if (!p)
@@ -44,7 +46,6 @@ SetUDPChecksum::simple_action(Packet *p_in)
     // XXX check IP header/UDP protocol?
     click_ip *iph = p->ip_header();
     click_udp *udph = p->udp_header();
-    int len;
     if (IP_ISFRAG(iph)
 	|| p->transport_length() < (int) sizeof(click_udp)
 	|| (len = ntohs(udph->uh_ulen),
@@ -62,12 +63,38 @@ SetUDPChecksum::simple_action(Packet *p_in)
     }
 
     udph->uh_sum = 0;
-    unsigned csum = click_in_cksum((unsigned char *)udph, len);
-    udph->uh_sum = click_in_cksum_pseudohdr(csum, iph, len);
-
     return p;
 }
 
+inline void
+SetUDPChecksum::simple_action_vector(PacketVector &v)
+{
+    const unsigned char *data[PACKET_VECTOR_CAPACITY];
+    int lens[PACKET_VECTOR_CAPACITY];
+    uint16_t csum[PACKET_VECTOR_CAPACITY];
+    unsigned n = 0;
+
+    v.filter([this, &data, &lens, &n](Packet *p_in) -> Packet * {
+	    int len;
+	    WritablePacket *p = prepare(p_in, len);
+	    if (p) {
+		data[n] = p->transport_header();
+		lens[n] = len;
+		n++;
+	    }
+	    return p;
+	}, [](Packet *) {});
+
+    if (n == 0)
+    	return;
+    click_in_cksum_batch(data, lens, csum, n);
+
+    for (unsigned i = 0; i < n; i++) {
+	WritablePacket *p = static_cast<WritablePacket *>(v[i]);
+	p->udp_header()->uh_sum = click_in_cksum_pseudohdr(csum[i], p->ip_header(), lens[i]);
+    }
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(SetUDPChecksum)
 ELEMENT_MT_SAFE(SetUDPChecksum)
@@ -14,7 +14,8 @@ CLICK_DECLS
  * Input packets must be UDP in IP (the protocol field isn't checked).
  *
  * Calculates the UDP checksum and sets the UDP header's checksum field. Uses
- * IP header fields to generate the pseudo-header.
+ * IP header fields to generate the pseudo-header. The checksums of all
+ * packets of a batch are computed in one call to click_in_cksum_batch.
  *
  * If input packets are IP fragments, or the UDP length is longer than the
  * packet, then pushes the input packets to the 2nd output, or drops them with
@@ -22,7 +23,7 @@ CLICK_DECLS
  *
  * =a CheckUDPHeader, SetIPChecksum, CheckIPHeader, SetTCPChecksum */
 
-class SetUDPChecksum : public SimpleElement<SetUDPChecksum> { public:
+class SetUDPChecksum : public SimpleVectorElement<SetUDPChecksum> { public:
 
     SetUDPChecksum() CLICK_COLD;
     ~SetUDPChecksum() CLICK_COLD;
@@ -31,7 +32,11 @@ class SetUDPChecksum : public SimpleElement<SetUDPChecksum> { public:
     const char *port_count() const override	{ return PORTS_1_1X2; }
     const char *processing() const override	{ return PROCESSING_A_AH; }
 
-    Packet *simple_action(Packet *);
+    inline void simple_action_vector(PacketVector &);
+
+  private:
+
+    inline WritablePacket *prepare(Packet *, int &len);
 
 };
 
@@ -0,0 +1,343 @@
+/*
+ * statelessiploadbalancer.{cc,hh} -- TCP & UDP load-balancer without
+ * per-connection state
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "statelessiploadbalancer.hh"
+
+#include <click/glue.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/ipflowid.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
+#include <click/packetbatch.hh>
+
+CLICK_DECLS
+
+/* Rewrites the source (SHIFT 0) or destination (SHIFT 1) address of Q,
+ * updating the IP and transport checksums
+ */
+static inline void
+rewrite_address(WritablePacket* q, IPAddress addr, int shift)
+{
+    click_ip *iph = q->ip_header();
+    if (q->has_transport_header() && IP_FIRSTFRAG(iph)
+        && ((iph->ip_p == IP_PROTO_TCP && q->transport_length() >= (int) sizeof(click_tcp))
+            || (iph->ip_p == IP_PROTO_UDP && q->transport_length() >= (int) sizeof(click_udp)
+                && q->udp_header()->uh_sum != 0))) {
+        q->rewrite_ip(addr, shift, iph->ip_p == IP_PROTO_TCP);
+        return;
+    }
+    uint16_t *x = reinterpret_cast<uint16_t *>(&iph->ip_src) + shift * 2;
+    uint32_t old_hw = (uint32_t) x[0] + x[1];
+    old_hw += (old_hw >> 16);
+    memcpy(x, &addr, 4);
+    uint32_t new_hw = (uint32_t) x[0] + x[1];
+    new_hw += (new_hw >> 16);
+    click_update_in_cksum(&iph->ip_sum, old_hw, new_hw);
+}
+
+StatelessIPLoadBalancer::StatelessIPLoadBalancer() : _dst_index(-1) {
+
+}
+
+StatelessIPLoadBalancer::~StatelessIPLoadBalancer() {
+
+}
+
+int
+StatelessIPLoadBalancer::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    bool has_secret;
+    if (Args(this, errh).bind(conf)
+               .read_all("DST",Args::mandatory | Args::positional,DefaultArg<Vector<IPAddress>>(),_dsts)
+               .read_mp("VIP", _vip)
+               .read_or_set("COOKIE_BITS", _cookie_bits, 8)
+               .read("SECRET", _secret).read_status(has_secret)
+               .read_or_set("TIMEOUT", _timeout, 60)
+               .read_or_set("CAPACITY", _capacity, 65536)
+               .consume() < 0)
+        return -1;
+
+    if (parseLb(conf, this, errh) < 0)
+        return -1;
+
+    if (Args(this, errh).bind(conf).complete() < 0)
+        return -1;
+
+    if (_cookie_bits < 1 || _cookie_bits > 16)
+        return errh->error("COOKIE_BITS must be between 1 and 16");
+    _cookie_mask = (1U << _cookie_bits) - 1;
+    if ((uint32_t) _dsts.size() > _cookie_mask + 1)
+        return errh->error("too many destinations for %d COOKIE_BITS", _cookie_bits);
+    if (!has_secret)
+        _secret = ((uint64_t) click_random() << 32) ^ click_random();
+    if (_timeout == 0)
+        return errh->error("TIMEOUT must be positive");
+
+    for (int i = 0; i < _dsts.size(); i++)
+        _dst_index.set(_dsts[i], i);
+
+    return 0;
+}
+
+int
+StatelessIPLoadBalancer::initialize(ErrorHandler *)
+{
+    click_jiffies_t next_gc = click_jiffies() + (click_jiffies_t) _timeout * CLICK_HZ;
+    for (unsigned i = 0; i < _flows.weight(); i++)
+        _flows.get_value(i).next_gc = next_gc;
+    return 0;
+}
+
+void
+StatelessIPLoadBalancer::cleanup(CleanupStage)
+{
+    for (unsigned i = 0; i < _flows.weight(); i++)
+        _flows.get_value(i).flows.clear();
+}
+
+/* Returns the destination of a packet without cookie, from the fallback flow
+ * table of the current thread
+ */
+inline int
+StatelessIPLoadBalancer::pick_fallback(Packet* p, const IPFlowID &flow)
+{
+    FlowTable &t = *_flows;
+    click_jiffies_t now = click_jiffies();
+    if (unlikely(!click_jiffies_less(now, t.next_gc)))
+        run_gc(t, now);
+
+    bool rst = p->ip_header()->ip_p == IP_PROTO_TCP && isRst(p);
+    FlowEntry *e = t.flows.get_pointer(flow);
+    if (e && !click_jiffies_less(e->last + (click_jiffies_t) _timeout * CLICK_HZ, now)) {
+        int server = e->server;
+        if (rst)
+            t.flows.erase(flow);
+        else
+            e->last = now;
+        _stats->stateful++;
+        return server;
+    }
+
+    int server = pick_server(p);
+    if (rst) {
+        if (e)
+            t.flows.erase(flow);
+    } else if (e) {
+        e->server = server;
+        e->last = now;
+    } else if (t.flows.size() < (size_t) _capacity) {
+        FlowEntry &ne = t.flows[flow];
+        ne.server = server;
+        ne.last = now;
+    }
+    return server;
+}
+
+inline Packet*
+StatelessIPLoadBalancer::process(Packet* p)
+{
+    WritablePacket* q = p->uniqueify();
+    if (unlikely(!q))
+        return 0;
+
+    IPFlowID flow(q);
+    int server = -1;
+    uint8_t *ts = find_timestamp(q);
+    if (ts) {
+        // Packets after the SYN echo a timestamp carrying the cookie
+        if (!isSyn(q) || isAck(q)) {
+            uint32_t tsecr;
+            memcpy(&tsecr, ts + 6, 4);
+            uint32_t s = (ntohl(tsecr) ^ cookie_hash(flow)) & _cookie_mask;
+            if (likely(s < (uint32_t) _dsts.size())) {
+                server = s;
+                _stats->stateless++;
+            }
+        }
+        if (server < 0)
+            server = pick_server(q);
+    } else
+        server = pick_fallback(q, flow);
+
+    track_load(q, server);
+    IPAddress srv = _dsts.unchecked_at(server);
+    rewrite_address(q, srv, 1);
+    q->set_dst_ip_anno(srv);
+    return q;
+}
+
+#if HAVE_BATCH
+void
+StatelessIPLoadBalancer::push_batch(int, PacketBatch* batch)
+{
+    EXECUTE_FOR_EACH_PACKET_DROPPABLE([this](Packet* p) { return process(p); }, batch, [](Packet*){});
+
+    if (batch)
+        checked_output_push_batch(0, batch);
+}
+#endif
+
+void
+StatelessIPLoadBalancer::push(int, Packet* p)
+{
+    if (Packet* q = process(p))
+        output_push(0, q);
+}
+
+/* Removes the expired flows of T. Each thread collects its own table, once
+ * per TIMEOUT, so tables need no lock
+ */
+void
+StatelessIPLoadBalancer::run_gc(FlowTable &t, click_jiffies_t now)
+{
+    click_jiffies_t timeout = (click_jiffies_t) _timeout * CLICK_HZ;
+    for (auto it = t.flows.begin(); it != t.flows.end(); ) {
+        if (click_jiffies_less(it.value().last + timeout, now))
+            it = t.flows.erase(it);
+        else
+            ++it;
+    }
+    t.next_gc = now + timeout;
+}
+
+enum { h_stateless = 1000, h_stateful, h_flows };
+
+int
+StatelessIPLoadBalancer::handler(int op, String& s, Element* e, const Handler* h, ErrorHandler* errh) {
+    StatelessIPLoadBalancer *cs = static_cast<StatelessIPLoadBalancer *>(e);
+    return cs->lb_handler(op, s, h->read_user_data(), h->write_user_data(), errh);
+}
+
+int
+StatelessIPLoadBalancer::write_handler(
+        const String &input, Element *e, void *thunk, ErrorHandler *errh) {
+    StatelessIPLoadBalancer *cs = static_cast<StatelessIPLoadBalancer *>(e);
+    return cs->lb_write_handler(input,thunk,errh);
+}
+
+String
+StatelessIPLoadBalancer::read_handler(Element *e, void *thunk) {
+    StatelessIPLoadBalancer *cs = static_cast<StatelessIPLoadBalancer *>(e);
+    return cs->lb_read_handler(thunk);
+}
+
+String
+StatelessIPLoadBalancer::stats_handler(Element *e, void *thunk) {
+    StatelessIPLoadBalancer *cs = static_cast<StatelessIPLoadBalancer *>(e);
+    switch ((uintptr_t) thunk) {
+    case h_stateless:
+    case h_stateful: {
+        uint64_t n = 0;
+        for (unsigned i = 0; i < cs->_stats.weight(); i++) {
+            const Stats &s = cs->_stats.get_value(i);
+            n += (uintptr_t) thunk == h_stateless ? s.stateless : s.stateful;
+        }
+        return String(n);
+    }
+    case h_flows: {
+        size_t n = 0;
+        for (unsigned i = 0; i < cs->_flows.weight(); i++)
+            n += cs->_flows.get_value(i).flows.size();
+        return String(n);
+    }
+    default:
+        return String();
+    }
+}
+
+void
+StatelessIPLoadBalancer::add_handlers() {
+    add_lb_handlers<StatelessIPLoadBalancer>(this);
+    add_read_handler("stateless", stats_handler, h_stateless);
+    add_read_handler("stateful", stats_handler, h_stateful);
+    add_read_handler("flows", stats_handler, h_flows);
+}
+
+
+StatelessIPLoadBalancerReverse::StatelessIPLoadBalancerReverse() {
+
+}
+
+StatelessIPLoadBalancerReverse::~StatelessIPLoadBalancerReverse() {
+
+}
+
+int
+StatelessIPLoadBalancerReverse::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Element* e;
+    if (Args(conf, this, errh)
+               .read_mp("LB", e)
+               .complete() < 0)
+        return -1;
+    _lb = static_cast<StatelessIPLoadBalancer*>(e->cast("StatelessIPLoadBalancer"));
+    if (!_lb)
+        return errh->error("LB must be a StatelessIPLoadBalancer");
+    _lb->add_remote_element(this);
+    return 0;
+}
+
+inline Packet*
+StatelessIPLoadBalancerReverse::process(Packet* p)
+{
+    WritablePacket* q = p->uniqueify();
+    if (unlikely(!q))
+        return 0;
+
+    int server = _lb->_dst_index.get(q->ip_header()->ip_src);
+    rewrite_address(q, _lb->_vip, 0);
+    if (server < 0)
+        return q;
+
+    uint8_t *ts = StatelessIPLoadBalancer::find_timestamp(q);
+    if (ts) {
+        // The hash is the one of the client's direction
+        IPFlowID flow(q, true);
+        uint32_t tsval;
+        memcpy(&tsval, ts + 2, 4);
+        uint32_t cookie = (server ^ _lb->cookie_hash(flow)) & _lb->_cookie_mask;
+        tsval = (ntohl(tsval) & ~_lb->_cookie_mask) | cookie;
+        StatelessIPLoadBalancer::set_tcp_word(q, ts + 2, htonl(tsval));
+    }
+    return q;
+}
+
+#if HAVE_BATCH
+void
+StatelessIPLoadBalancerReverse::push_batch(int, PacketBatch* batch)
+{
+    EXECUTE_FOR_EACH_PACKET_DROPPABLE([this](Packet* p) { return process(p); }, batch, [](Packet*){});
+
+    if (batch)
+        checked_output_push_batch(0, batch);
+}
+#endif
+
+void
+StatelessIPLoadBalancerReverse::push(int, Packet* p)
+{
+    if (Packet* q = process(p))
+        output_push(0, q);
+}
+
+CLICK_ENDDECLS
+
+EXPORT_ELEMENT(StatelessIPLoadBalancerReverse)
+ELEMENT_MT_SAFE(StatelessIPLoadBalancerReverse)
+EXPORT_ELEMENT(StatelessIPLoadBalancer)
+ELEMENT_MT_SAFE(StatelessIPLoadBalancer)
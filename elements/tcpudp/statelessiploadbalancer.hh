@@ -0,0 +1,306 @@
+#ifndef CLICK_STATELESSIPLOADBALANCER_HH
+#define CLICK_STATELESSIPLOADBALANCER_HH
+#include <click/config.h>
+#include <click/tcphelper.hh>
+#include <click/multithread.hh>
+#include <click/glue.hh>
+#include <click/batchelement.hh>
+#include <click/loadbalancer.hh>
+#include <click/hashtable.hh>
+#include <click/ipflowid.hh>
+#include <click/sync.hh>
+#include <click/vector.hh>
+
+CLICK_DECLS
+
+class StatelessIPLoadBalancerReverse;
+
+/**
+=c
+
+StatelessIPLoadBalancer([I<KEYWORDS>])
+
+=s flow
+
+TCP&UDP load-balancer keeping no per-connection state
+
+=d
+
+Load-balancer that only rewrites the destination, like IPLoadBalancer, but
+that remembers the destination of TCP connections in the packets themselves
+instead of in a flow table.
+
+The first packet of a connection goes to the destination chosen by LB_MODE.
+StatelessIPLoadBalancerReverse, which sees the packets of the destinations
+towards the clients, writes a cookie in the low COOKIE_BITS bits of the value
+of the TCP timestamp option. The cookie is the index of the destination,
+XORed with a keyed hash of the connection's 5-tuple. Clients echo the
+timestamp in every packet, so StatelessIPLoadBalancer finds the destination
+of a connection back from the echoed timestamp without any lookup. A SYN
+flood therefore consumes no memory in the load-balancer.
+
+Packets without the timestamp option (UDP, or TCP connections of clients that
+do not use timestamps) fall back to a flow table. Each thread has its own
+table of at most CAPACITY entries, so the packets of such a flow must all be
+handled by the same thread, as with RSS. Entries expire after TIMEOUT seconds
+of inactivity, or when a RST is seen. When the table is full, such packets go
+to the destination LB_MODE picks every time, so a consistent hashing mode
+such as "maglev" should be used. Retransmitted SYNs also go through LB_MODE.
+
+As the cookie is tied to the index of the destination, connections stay on
+their destination when destinations are added, removed or reweighted.
+
+Destinations see the low COOKIE_BITS bits of the echoed timestamps changed,
+including the one echoing their SYN-ACK. This skews their RTT estimations
+from timestamps, and breaks SYN cookies that encode TCP options in the
+timestamp: Linux keeps the window scale, SACK and ECN options of a connection
+in the low 6 bits of the timestamp of a SYN-ACK sent with a SYN cookie, and
+these are overwritten. Destinations must therefore not send SYN cookies
+(net.ipv4.tcp_syncookies set to 0 on Linux).
+
+Checksums are updated incrementally.
+
+Keyword arguments are:
+
+=over 8
+
+=item DST
+
+IP Address. Can be repeated multiple times, once per destination.
+
+=item VIP
+
+IP Address of this load-balancer.
+
+=item COOKIE_BITS
+
+Integer between 1 and 16. Number of bits of the timestamps carrying the
+cookie. There may be at most 2^COOKIE_BITS destinations. Defaults to 8.
+
+=item SECRET
+
+Integer. Key of the hash of the cookie. Load-balancers sharing the same
+destinations must share the same SECRET to forward each other's connections.
+Defaults to a random value.
+
+=item TIMEOUT
+
+Integer. Idle timeout of fallback flows, in seconds. Defaults to 60.
+
+=item CAPACITY
+
+Integer. Maximal number of fallback flows per thread. Defaults to 65536.
+
+=item LB_MODE, WEIGHT, MAGLEV_SIZE
+
+See FlowIPLoadBalancer.
+
+=back
+
+=h stateless read-only
+
+Returns the number of packets forwarded using their cookie.
+
+=h stateful read-only
+
+Returns the number of packets forwarded using the fallback flow table.
+
+=h flows read-only
+
+Returns the number of flows in the fallback flow tables.
+
+=e
+    lb :: StatelessIPLoadBalancer(VIP 10.220.0.1, DST 10.221.0.1, DST 10.221.0.2,
+                                  LB_MODE maglev);
+    lbr :: StatelessIPLoadBalancerReverse(lb);
+
+=a
+
+IPLoadBalancer, FlowIPLoadBalancer */
+
+class StatelessIPLoadBalancer : public BatchElement, public TCPHelper, public LoadBalancer<IPAddress> {
+
+public:
+
+    StatelessIPLoadBalancer() CLICK_COLD;
+    ~StatelessIPLoadBalancer() CLICK_COLD;
+
+    const char *class_name() const override		{ return "StatelessIPLoadBalancer"; }
+    const char *port_count() const override		{ return "1/1"; }
+    const char *processing() const override		{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) override CLICK_COLD;
+    int initialize(ErrorHandler *errh) override CLICK_COLD;
+    void cleanup(CleanupStage) override CLICK_COLD;
+
+#if HAVE_BATCH
+    void push_batch(int, PacketBatch *) override;
+#endif
+
+    void push(int, Packet *) override;
+
+    void add_handlers() override CLICK_COLD;
+
+    /* Returns a pointer to the TCP timestamp option of P, or 0 if P has
+     * none
+     */
+    static inline uint8_t* find_timestamp(Packet* p);
+
+    /* Sets the 32 bits value at FIELD in the TCP header of P, updating the
+     * checksum
+     */
+    static inline void set_tcp_word(WritablePacket* p, uint8_t* field, uint32_t value);
+
+private:
+
+    struct FlowEntry {
+        int server;
+        click_jiffies_t last;
+    };
+
+    struct FlowTable {
+        HashTable<IPFlowID, FlowEntry> flows;
+        click_jiffies_t next_gc;
+    };
+
+    struct Stats {
+        Stats() : stateless(0), stateful(0) {
+        }
+        uint64_t stateless;
+        uint64_t stateful;
+    };
+
+    IPAddress _vip;
+    int _cookie_bits;
+    uint32_t _cookie_mask;
+    uint64_t _secret;
+    uint32_t _timeout;
+    int _capacity;
+    HashTable<IPAddress, int> _dst_index;
+    per_thread<FlowTable> _flows;
+    per_thread<Stats> _stats;
+
+    inline uint32_t cookie_hash(const IPFlowID &flow) const {
+        return mix_hash(_secret ^ (((uint64_t) flow.saddr().addr() << 32)
+                                   | flow.hashcode()));
+    }
+
+    inline int pick_fallback(Packet* p, const IPFlowID &flow);
+    inline Packet* process(Packet* p);
+    void run_gc(FlowTable &t, click_jiffies_t now);
+
+    static int handler(int op, String& s, Element* e, const Handler* h, ErrorHandler* errh);
+    static String read_handler(Element *handler, void *user_data);
+    static int write_handler(
+      const String &, Element *, void *, ErrorHandler *
+  ) CLICK_COLD;
+    static String stats_handler(Element *e, void *user_data) CLICK_COLD;
+    friend class LoadBalancer;
+    friend class StatelessIPLoadBalancerReverse;
+
+};
+
+
+/**
+=c
+
+StatelessIPLoadBalancerReverse(LB)
+
+=s flow
+
+Reverse side for StatelessIPLoadBalancer
+
+=d
+
+Rewrites the source of packets from destinations of StatelessIPLoadBalancer
+LB to its VIP, and writes the cookie of their connection in their TCP
+timestamp option.
+
+=a
+
+StatelessIPLoadBalancer */
+
+class StatelessIPLoadBalancerReverse : public BatchElement, public TCPHelper  {
+
+public:
+
+    StatelessIPLoadBalancerReverse() CLICK_COLD;
+    ~StatelessIPLoadBalancerReverse() CLICK_COLD;
+
+    const char *class_name() const override      { return "StatelessIPLoadBalancerReverse"; }
+    const char *port_count() const override      { return "1/1"; }
+    const char *processing() const override      { return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) override CLICK_COLD;
+
+#if HAVE_BATCH
+    void push_batch(int, PacketBatch *) override;
+#endif
+
+    void push(int, Packet *) override;
+private:
+    StatelessIPLoadBalancer* _lb;
+
+    inline Packet* process(Packet* p);
+};
+
+
+inline uint8_t*
+StatelessIPLoadBalancer::find_timestamp(Packet* p)
+{
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_p != IP_PROTO_TCP || !IP_FIRSTFRAG(iph)
+        || !p->has_transport_header()
+        || p->transport_length() < (int) sizeof(click_tcp))
+        return 0;
+    const click_tcp *th = p->tcp_header();
+    int hlen = th->th_off << 2;
+    if (hlen > p->transport_length())
+        return 0;
+    uint8_t *opt = (uint8_t *) (th + 1);
+    uint8_t *end = (uint8_t *) th + hlen;
+    while (opt < end) {
+        if (*opt == TCPOPT_EOL)
+            break;
+        if (*opt == TCPOPT_NOP) {
+            opt++;
+            continue;
+        }
+        if (opt + 1 >= end || opt[1] < 2 || opt + opt[1] > end)
+            break;
+        if (*opt == TCPOPT_TIMESTAMP)
+            return opt[1] == TCPOLEN_TIMESTAMP ? opt : 0;
+        opt += opt[1];
+    }
+    return 0;
+}
+
+inline void
+StatelessIPLoadBalancer::set_tcp_word(WritablePacket* p, uint8_t* field, uint32_t value)
+{
+    // The checksum sums 16-bit words from the start of the TCP header, and
+    // FIELD may be at an odd offset
+    uint8_t *th = (uint8_t *) p->tcp_header();
+    int start = (field - th) & ~1;
+    int end = (field - th + 5) & ~1;
+    uint32_t old_hw = 0, new_hw = 0;
+    for (int i = start; i < end; i += 2) {
+        uint16_t w;
+        memcpy(&w, th + i, 2);
+        old_hw += w;
+    }
+    memcpy(field, &value, 4);
+    for (int i = start; i < end; i += 2) {
+        uint16_t w;
+        memcpy(&w, th + i, 2);
+        new_hw += w;
+    }
+    old_hw = (old_hw & 0xFFFF) + (old_hw >> 16);
+    old_hw += (old_hw >> 16);
+    new_hw = (new_hw & 0xFFFF) + (new_hw >> 16);
+    new_hw += (new_hw >> 16);
+    click_update_in_cksum(&p->tcp_header()->th_sum, old_hw, new_hw);
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,122 @@
+// -*- c-basic-offset: 4; related-file-name: "packetvectortest.hh" -*-
+/*
+ * packetvectortest.{cc,hh} -- regression test element for PacketVector
+ */
+
+#include <click/config.h>
+#include "packetvectortest.hh"
+#include <click/packetvector.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+PacketVectorTest::PacketVectorTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+static PacketBatch *
+make_numbered_batch(int n, int first = 0)
+{
+    BATCH_CREATE_INIT(batch);
+    for (int i = 0; i < n; i++) {
+        WritablePacket *p = Packet::make(0, 0, 4, 0);
+        p->set_anno_u32(0, first + i);
+        BATCH_CREATE_APPEND(batch, p);
+    }
+    BATCH_CREATE_FINISH(batch);
+    return batch;
+}
+
+static bool
+check_numbered_batch(PacketBatch *batch, unsigned n, int first = 0)
+{
+    if (!batch || batch->count() != n || batch->tail()->next() != 0)
+        return false;
+    unsigned i = 0;
+    FOR_EACH_PACKET(batch, p) {
+        if (p->anno_u32(0) != (uint32_t)(first + i))
+            return false;
+        if (++i == n && p != batch->tail())
+            return false;
+    }
+    return i == n;
+}
+
+int
+PacketVectorTest::initialize(ErrorHandler *errh)
+{
+    PacketVector v;
+    CHECK(v.empty() && v.count() == 0);
+    CHECK(v.to_batch() == 0);
+    CHECK(v.load(0) == 0);
+
+    // Round trip
+    PacketBatch *batch = make_numbered_batch(10);
+    CHECK(v.load(batch) == 0);
+    CHECK(v.count() == 10);
+    for (unsigned i = 0; i < v.count(); i++)
+        CHECK(v[i]->anno_u32(0) == i);
+    batch = v.to_batch();
+    CHECK(v.empty());
+    CHECK(check_numbered_batch(batch, 10));
+
+    // Batches longer than the capacity are loaded in chunks
+    unsigned total = PacketVector::capacity() + 3;
+    batch->kill();
+    batch = make_numbered_batch(total);
+    PacketBatch *remain = v.load(batch);
+    CHECK(v.full());
+    CHECK(check_numbered_batch(remain, 3, PacketVector::capacity()));
+    v.fast_kill();
+    CHECK(v.empty());
+    CHECK(v.load(remain) == 0 && v.count() == 3);
+
+    // Split
+    PacketVector second;
+    v.split(1, second);
+    CHECK(v.count() == 1 && second.count() == 2);
+    CHECK(second[0]->anno_u32(0) == PacketVector::capacity() + 1);
+    v.kill();
+    second.kill();
+
+    // Filter keeps order, drops odd packets
+    v.load(make_numbered_batch(8));
+    int dropped = 0;
+    v.filter([](Packet *p) -> Packet * {
+            return (p->anno_u32(0) & 1) ? 0 : p;
+        }, [&dropped](Packet *p) {
+            dropped++;
+            p->kill();
+        });
+    CHECK(dropped == 4 && v.count() == 4);
+    for (unsigned i = 0; i < v.count(); i++)
+        CHECK(v[i]->anno_u32(0) == 2 * i);
+    v.kill();
+
+    // Classify in 3 outputs, out-of-range outputs go to the last one
+    v.load(make_numbered_batch(9));
+    unsigned counts[3] = {0, 0, 0};
+    bool ordered = true;
+    v.classify(3, [](Packet *p) {
+            return p->anno_u32(0) % 4;
+        }, [&counts, &ordered](int o, PacketBatch *b) {
+            counts[o] = b->count();
+            uint32_t last = 0;
+            FOR_EACH_PACKET(b, p) {
+                if (p != b->first() && p->anno_u32(0) <= last)
+                    ordered = false;
+                last = p->anno_u32(0);
+            }
+            b->kill();
+        });
+    CHECK(v.empty());
+    CHECK(counts[0] == 3 && counts[1] == 2 && counts[2] == 4);
+    CHECK(ordered);
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(PacketVectorTest)
@@ -0,0 +1,34 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PACKETVECTORTEST_HH
+#define CLICK_PACKETVECTORTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+PacketVectorTest()
+
+=s test
+
+runs regression tests for PacketVector
+
+=d
+
+PacketVectorTest runs PacketVector regression tests at initialization time.
+It does not route packets.
+
+*/
+
+class PacketVectorTest : public Element { public:
+
+    PacketVectorTest() CLICK_COLD;
+
+    const char *class_name() const override		{ return "PacketVectorTest"; }
+
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,242 @@
+// -*- c-basic-offset: 4; related-file-name: "ringperftest.hh" -*-
+/*
+ * ringperftest.{cc,hh} -- regression test and microbenchmark element for
+ * the lock-free MPMC ring
+ */
+
+#include <click/config.h>
+#include "ringperftest.hh"
+#include <click/ring.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include <pthread.h>
+CLICK_DECLS
+
+typedef LockFreeMPMCDynamicRing<uintptr_t> TestRing;
+
+RingPerfTest::RingPerfTest()
+    : _producers(2), _consumers(2), _burst(32), _size(1024), _ops(1000000),
+      _verbose(false)
+{
+}
+
+int
+RingPerfTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+        .read("PRODUCERS", _producers)
+        .read("CONSUMERS", _consumers)
+        .read("BURST", _burst)
+        .read("SIZE", _size)
+        .read("OPS", _ops)
+        .read("VERBOSE", _verbose)
+        .complete() < 0)
+        return -1;
+    if (_producers == 0 || _consumers == 0 || _burst == 0 || _size == 0)
+        return errh->error("PRODUCERS, CONSUMERS, BURST and SIZE must be positive");
+    return 0;
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+int
+RingPerfTest::check_semantics(ErrorHandler *errh)
+{
+    TestRing r;
+    r.initialize(6);
+    CHECK(r.capacity() == 8);
+    CHECK(r.is_empty());
+    CHECK(r.extract() == 0);
+
+    uintptr_t in[16], out[16];
+    for (int i = 0; i < 16; i++)
+        in[i] = i + 1;
+
+    CHECK(r.insert(in[0]));
+    CHECK(r.count() == 1);
+    CHECK(r.extract() == 1);
+    CHECK(r.is_empty());
+
+    // Bulk is all or nothing, burst is as much as possible
+    CHECK(r.insert_bulk(in, 5) == 5);
+    CHECK(r.insert_bulk(in + 5, 5) == 0);
+    CHECK(r.count() == 5);
+    CHECK(r.insert_burst(in + 5, 5) == 3);
+    CHECK(r.is_full());
+    CHECK(!r.insert(in[0]));
+    CHECK(r.extract_bulk(out, 9) == 0);
+    CHECK(r.extract_bulk(out, 3) == 3);
+    CHECK(out[0] == 1 && out[1] == 2 && out[2] == 3);
+    CHECK(r.extract_burst(out, 16) == 5);
+    for (int i = 0; i < 5; i++)
+        CHECK(out[i] == (uintptr_t)i + 4);
+    CHECK(r.is_empty());
+    CHECK(r.extract_burst(out, 16) == 0);
+
+    // Indexes wrap around the ring
+    for (int round = 0; round < 10; round++) {
+        CHECK(r.insert_burst(in, 7) == 7);
+        CHECK(r.extract_burst(out, 7) == 7);
+        for (int i = 0; i < 7; i++)
+            CHECK(out[i] == in[i]);
+    }
+    return 0;
+}
+
+namespace {
+struct RingPerfRun {
+    TestRing ring;
+    unsigned burst;
+    unsigned producers;
+    unsigned ops;
+    volatile bool go;
+    atomic_uint32_t consumed;
+    atomic_uint64_t sum;
+};
+
+struct RingPerfThread {
+    RingPerfRun *run;
+    unsigned id;
+    pthread_t thread;
+};
+}
+
+extern "C" {
+static void *ringperf_producer(void *arg)
+{
+    RingPerfThread *t = static_cast<RingPerfThread *>(arg);
+    RingPerfRun *run = t->run;
+    uintptr_t buf[run->burst];
+    while (!run->go)
+        click_relax_fence();
+    // Producer i sends the values i+1, i+1+producers, ...
+    unsigned n = run->ops / run->producers + (t->id < run->ops % run->producers);
+    uintptr_t next = t->id + 1;
+    while (n > 0) {
+        unsigned b = n < run->burst ? n : run->burst;
+        for (unsigned i = 0; i < b; i++, next += run->producers)
+            buf[i] = next;
+        unsigned done = 0;
+        while (done < b) {
+            if (run->burst == 1)
+                done += run->ring.insert(buf[0]);
+            else
+                done += run->ring.insert_burst(buf + done, b - done);
+            if (done < b)
+                click_relax_fence();
+        }
+        n -= b;
+    }
+    return 0;
+}
+
+static void *ringperf_consumer(void *arg)
+{
+    RingPerfThread *t = static_cast<RingPerfThread *>(arg);
+    RingPerfRun *run = t->run;
+    uintptr_t buf[run->burst];
+    uint64_t sum = 0;
+    while (!run->go)
+        click_relax_fence();
+    while (run->consumed < run->ops) {
+        unsigned got;
+        if (run->burst == 1)
+            got = run->ring.extract(buf[0]);
+        else
+            got = run->ring.extract_burst(buf, run->burst);
+        if (got == 0) {
+            click_relax_fence();
+            continue;
+        }
+        for (unsigned i = 0; i < got; i++)
+            sum += buf[i];
+        run->consumed += got;
+    }
+    run->sum += sum;
+    return 0;
+}
+}
+
+int
+RingPerfTest::run(unsigned producers, unsigned consumers, ErrorHandler *errh)
+{
+    RingPerfRun run;
+    run.ring.initialize(_size);
+    run.burst = _burst;
+    run.producers = producers;
+    run.ops = _ops;
+    run.go = false;
+    run.consumed = 0;
+    run.sum = 0;
+
+    RingPerfThread threads[producers + consumers];
+    unsigned started = 0;
+    int err = 0;
+    for (; started < producers + consumers && !err; started++) {
+        RingPerfThread &t = threads[started];
+        t.run = &run;
+        t.id = started < producers ? started : started - producers;
+        err = pthread_create(&t.thread, 0,
+                             started < producers ? ringperf_producer : ringperf_consumer,
+                             &t);
+    }
+    if (err) {
+        // Let the started producers and consumers finish with a short run
+        run.ops = 0;
+        started--;
+    }
+
+    Timestamp start = Timestamp::now_steady();
+    click_fence();
+    run.go = true;
+    for (unsigned i = 0; i < started; i++)
+        pthread_join(threads[i].thread, 0);
+    Timestamp elapsed = Timestamp::now_steady() - start;
+
+    if (err)
+        return errh->error("cannot start thread: %s", strerror(err));
+
+    uint64_t expected = (uint64_t)_ops * (_ops + 1) / 2;
+    CHECK(run.consumed == _ops);
+    CHECK(run.sum == expected);
+    CHECK(run.ring.is_empty());
+
+    double rate = elapsed.doubleval() > 0 ? _ops / elapsed.doubleval() : 0;
+    StringAccum sa;
+    sa << producers << ' ' << consumers << ' ' << (uint64_t)rate << '\n';
+    _results += sa.take_string();
+    if (_verbose)
+        errh->message("%u producers, %u consumers: %.0f ops/s", producers, consumers, rate);
+    return 0;
+}
+
+int
+RingPerfTest::initialize(ErrorHandler *errh)
+{
+    if (check_semantics(errh) < 0)
+        return -1;
+    for (unsigned p = 1; p <= _producers; p++)
+        for (unsigned c = 1; c <= _consumers; c++)
+            if (run(p, c, errh) < 0)
+                return -1;
+    errh->message("All tests pass!");
+    return 0;
+}
+
+String
+RingPerfTest::read_handler(Element *e, void *)
+{
+    return static_cast<RingPerfTest *>(e)->_results;
+}
+
+void
+RingPerfTest::add_handlers()
+{
+    add_read_handler("results", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel umultithread)
+EXPORT_ELEMENT(RingPerfTest)
@@ -0,0 +1,93 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_RINGPERFTEST_HH
+#define CLICK_RINGPERFTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+RingPerfTest([I<keywords>])
+
+=s test
+
+runs regression tests and a microbenchmark for LockFreeMPMCDynamicRing
+
+=d
+
+RingPerfTest first checks the single-threaded semantics of the lock-free
+multi-producer multi-consumer ring, then measures its throughput with every
+combination of 1 to PRODUCERS producer threads and 1 to CONSUMERS consumer
+threads. Each run moves OPS objects through the ring, in bursts of BURST
+objects, and checks that every object was received exactly once. It does not
+route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item PRODUCERS
+
+Maximal number of producer threads. Default is 2.
+
+=item CONSUMERS
+
+Maximal number of consumer threads. Default is 2.
+
+=item BURST
+
+Number of objects inserted or extracted at once. Default is 32. With a BURST
+of 1, the single-object functions are used.
+
+=item SIZE
+
+Size of the ring. Default is 1024.
+
+=item OPS
+
+Number of objects moved per run. Default is 1000000.
+
+=item VERBOSE
+
+Boolean. If true, print the throughput of each run. Default is false.
+
+=back
+
+=h results read-only
+
+Returns one line per run with the number of producers, the number of
+consumers and the measured throughput in objects per second.
+
+=a ThreadSafeQueue, CPUQueue, Pipeliner
+
+*/
+
+class RingPerfTest : public Element { public:
+
+    RingPerfTest() CLICK_COLD;
+
+    const char *class_name() const override		{ return "RingPerfTest"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    unsigned _producers;
+    unsigned _consumers;
+    unsigned _burst;
+    unsigned _size;
+    unsigned _ops;
+    bool _verbose;
+    String _results;
+
+    int check_semantics(ErrorHandler *errh);
+    int run(unsigned producers, unsigned consumers, ErrorHandler *errh);
+
+    static String read_handler(Element *e, void *thunk) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,83 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * timerwheeltest.{cc,hh} -- regression test element for TimerWheel
+ */
+
+#include <click/config.h>
+#include "timerwheeltest.hh"
+#include <click/timerwheel.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+TimerWheelTest::TimerWheelTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+namespace {
+struct TWObject {
+    TWObject *next;
+    uint32_t expiry;
+    uint32_t expired_at;
+};
+}
+
+int
+TimerWheelTest::initialize(ErrorHandler *errh)
+{
+    const int n = 4096;
+    const uint32_t max = 300000;
+    TimerWheel<TWObject> tw;
+    tw.initialize(max);
+
+    auto setter = [](TWObject *o, TWObject *next) { o->next = next; };
+    TWObject *objs = new TWObject[n];
+    uint32_t seed = 1;
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t t = i < 512 ? (uint32_t) i + 1 : 1 + (seed >> 8) % max;
+        objs[i].expiry = t;
+        objs[i].expired_at = 0;
+        tw.schedule_after(&objs[i], t, setter);
+    }
+
+    uint32_t now = 0;
+    int expired = 0, early = 0, calls = 0;
+    while (now <= max + 1) {
+        tw.run_timers([&](TWObject *o) -> TWObject * {
+            TWObject *next = o->next;
+            calls++;
+            if (o->expiry <= now) {
+                o->expired_at = now;
+                expired++;
+            } else {
+                early++;
+                tw.schedule_after(o, o->expiry - now, setter);
+            }
+            return next;
+        });
+        now++;
+    }
+
+    CHECK(expired == n);
+    for (int i = 0; i < n; i++)
+        CHECK(objs[i].expired_at == objs[i].expiry);
+    // Lazy re-bucketing: an object is seen at most once per level
+    CHECK(calls <= n * 3);
+    CHECK(early > 0);
+
+    // Objects scheduled while running land in the future
+    TWObject o;
+    o.expiry = now + 1;
+    tw.schedule_after(&o, 1, setter);
+    CHECK(tw.debug_find(&o, [](TWObject *x) { return x->next; }));
+
+    delete[] objs;
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(TimerWheelTest)
@@ -0,0 +1,36 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TIMERWHEELTEST_HH
+#define CLICK_TIMERWHEELTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TimerWheelTest()
+
+=s test
+
+runs regression tests for TimerWheel
+
+=d
+
+TimerWheelTest runs TimerWheel regression tests at initialization time. It
+checks that objects scheduled in any level of the hierarchical wheel reach
+the expire function before or at their expiration, and are expired exactly
+on time when re-bucketed lazily. It does not route packets.
+
+*/
+
+class TimerWheelTest : public Element { public:
+
+    TimerWheelTest() CLICK_COLD;
+
+    const char *class_name() const override		{ return "TimerWheelTest"; }
+
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
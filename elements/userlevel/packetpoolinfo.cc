@@ -0,0 +1,113 @@
+// -*- c-basic-offset: 4; related-file-name: "packetpoolinfo.hh" -*-
+/*
+ * packetpoolinfo.{cc,hh} -- set packet pool parameters
+ */
+
+#include <click/config.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include "packetpoolinfo.hh"
+
+CLICK_DECLS
+
+int
+PacketPoolInfo::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+#if HAVE_CLICK_PACKET_POOL
+    unsigned size = Packet::pool_size;
+    unsigned data_size = Packet::data_pool_size;
+    unsigned global_count = Packet::global_pool_count;
+    uint64_t memory_cap = Packet::pool_memory_cap;
+    unsigned prewarm = Packet::pool_prewarm_size;
+    if (Args(conf, this, errh)
+        .read("SIZE", size)
+        .read("DATA_SIZE", data_size)
+        .read("GLOBAL_COUNT", global_count)
+        .read("MEMORY_CAP", memory_cap)
+        .read("PREWARM", prewarm)
+        .complete() < 0)
+        return -1;
+    if (size == 0 || data_size == 0 || global_count == 0)
+        return errh->error("pool sizes must be positive");
+    if (Packet::set_pool_sizes(size, data_size, global_count, memory_cap, errh) < 0)
+        return -1;
+    Packet::pool_prewarm_size = prewarm;
+    return 0;
+#else
+    (void)conf;
+    errh->warning("Click was built without the Click packet pool, %s has no effect", class_name());
+    return 0;
+#endif
+}
+
+String
+PacketPoolInfo::read_handler(Element *e, void *thunk)
+{
+#if HAVE_CLICK_PACKET_POOL
+    switch ((uintptr_t) thunk) {
+    case h_size:
+        return String(Packet::pool_size);
+    case h_data_size:
+        return String(Packet::data_pool_size);
+    case h_global_count:
+        return String(Packet::global_pool_count);
+    case h_memory_cap:
+        return String(Packet::pool_memory_cap);
+    case h_stats:
+        return Packet::read_pool_handler(e, 0);
+    }
+#else
+    (void)e;
+    (void)thunk;
+#endif
+    return String();
+}
+
+int
+PacketPoolInfo::write_handler(const String &s, Element *e, void *thunk, ErrorHandler *errh)
+{
+#if HAVE_CLICK_PACKET_POOL
+    uint64_t v;
+    if (Args(e, errh).push_back_words(s).read_mp("VALUE", v).complete() < 0)
+        return -EINVAL;
+    if (v == 0 && (uintptr_t) thunk != h_memory_cap)
+        return errh->error("pool sizes must be positive");
+    if (v > 0xFFFFFFFFU && (uintptr_t) thunk != h_memory_cap)
+        return errh->error("value too large");
+    switch ((uintptr_t) thunk) {
+    case h_size:
+        return Packet::set_pool_sizes(v, 0, 0, Packet::pool_memory_cap, errh);
+    case h_data_size:
+        return Packet::set_pool_sizes(0, v, 0, Packet::pool_memory_cap, errh);
+    case h_global_count:
+        return Packet::set_pool_sizes(0, 0, v, Packet::pool_memory_cap, errh);
+    case h_memory_cap:
+        return Packet::set_pool_sizes(0, 0, 0, v, errh);
+    }
+    return -EINVAL;
+#else
+    (void)s;
+    (void)e;
+    (void)thunk;
+    return errh->error("Click was built without the Click packet pool");
+#endif
+}
+
+void
+PacketPoolInfo::add_handlers()
+{
+    add_read_handler("size", read_handler, h_size);
+    add_write_handler("size", write_handler, h_size);
+    add_read_handler("data_size", read_handler, h_data_size);
+    add_write_handler("data_size", write_handler, h_data_size);
+    add_read_handler("global_count", read_handler, h_global_count);
+    add_write_handler("global_count", write_handler, h_global_count);
+    add_read_handler("memory_cap", read_handler, h_memory_cap);
+    add_write_handler("memory_cap", write_handler, h_memory_cap);
+    add_read_handler("stats", read_handler, h_stats);
+}
+
+CLICK_ENDDECLS
+
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(PacketPoolInfo)
@@ -0,0 +1,110 @@
+#ifndef CLICK_PACKETPOOLINFO_HH
+#define CLICK_PACKETPOOLINFO_HH
+
+#include <click/element.hh>
+
+CLICK_DECLS
+
+/*
+=title PacketPoolInfo
+
+=c
+
+PacketPoolInfo([I<keywords> SIZE, DATA_SIZE, GLOBAL_COUNT, MEMORY_CAP, PREWARM])
+
+=s information
+
+Set Click packet pool parameters.
+
+=d
+
+Set the sizes of the Click packet pool, as the --pool-size, --data-pool-size,
+--global-pool-count, --pool-memory-cap and --pool-prewarm options of the
+userlevel driver. Values given here override the command line.
+
+Keyword arguments:
+
+=over 8
+
+=item SIZE
+
+Integer.  Maximal number of free packets without data buffer kept by each
+thread. Defaults to the current value, 4096 unless changed.
+
+=item DATA_SIZE
+
+Integer.  Maximal number of free packets with a data buffer kept by each
+thread. Defaults to the current value, 4096 unless changed.
+
+=item GLOBAL_COUNT
+
+Integer.  Maximal number of batches of each kind in the global pool, at most
+1024.
+
+=item MEMORY_CAP
+
+Unsigned.  Once the global pool holds that many bytes,
+threads free their excess packets instead of giving them to the global pool.
+0 means no cap. Defaults to 0.
+
+=item PREWARM
+
+Integer.  Number of packets with data buffers allocated in each thread pool
+when threads start. Defaults to 0.
+
+=back
+
+The parameters can be changed at runtime. When a size is lowered, pools
+shrink lazily: each thread hands out its excess packets the next time it
+recycles packets.
+
+Without the Click packet pool, this element does nothing.
+
+=h size read/write
+
+Per-thread pool size.
+
+=h data_size read/write
+
+Per-thread data pool size.
+
+=h global_count read/write
+
+Number of batches in the global pool.
+
+=h memory_cap read/write
+
+Memory cap of the global pool, in bytes.
+
+=h stats read-only
+
+Same as the global packet_pool_stats handler.
+
+=e
+
+  PacketPoolInfo(DATA_SIZE 16384, MEMORY_CAP 512000000, PREWARM 1024)
+
+=a DPDKInfo */
+
+class PacketPoolInfo : public Element {
+public:
+
+    const char *class_name() const override { return "PacketPoolInfo"; }
+
+    int configure_phase() const override { return CONFIGURE_PHASE_FIRST; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) override;
+
+    void add_handlers() override;
+
+  private:
+
+    enum { h_size, h_data_size, h_global_count, h_memory_cap, h_stats };
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &s, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+
+#endif
@@ -5,6 +5,7 @@
 #include <click/vector.hh>
 #include <click/string.hh>
 #include <click/packet.hh>
+#include <click/packetvector.hh>
 #include <click/handler.hh>
 #include <click/master.hh>
 #include <click/element.hh>
@@ -277,5 +278,84 @@ class SimpleElement : public BatchElement { public:
 };
 
 
+
+/**
+ * Batch helper element.
+ *
+ * Build an element that processes packets as a PacketVector instead of a
+ * linked list. Extend SimpleVectorElement<T> and implement
+ * inline void simple_action_vector(PacketVector& v). The function may drop
+ * or replace packets by compacting the vector, usually with
+ * PacketVector::filter.
+ *
+ * Batches are converted to vectors when entering the element and back to
+ * batches when leaving it, batches bigger than PACKET_VECTOR_CAPACITY are
+ * processed in multiple chunks. Single packets are handled as a vector of
+ * one packet.
+ *
+ * Downside :
+ * The inherited element cannot be extended further because of CRTP !
+ */
+template <typename T>
+class SimpleVectorElement : public BatchElement { public:
+
+    void push(int port, Packet *p) override {
+        p = _sv_action(p);
+        if (p)
+            output(port).push(p);
+    }
+
+    Packet* pull(int port) override {
+        Packet *p = input(port).pull();
+        if (p)
+            p = _sv_action(p);
+        return p;
+    }
+
+#if HAVE_BATCH
+    void push_batch(int port, PacketBatch* head) override final {
+        head = _sv_action_batch(head);
+        if (head)
+            output(port).push_batch(head);
+    }
+
+    PacketBatch* pull_batch(int port, unsigned max) override final {
+        PacketBatch* head = input_pull_batch(port,max);
+        if (head)
+            head = _sv_action_batch(head);
+        return head;
+    }
+#endif
+
+  private:
+
+    inline Packet* _sv_action(Packet* p) {
+        PacketVector v;
+        v.push_back(p);
+        static_cast<T&>(*this).simple_action_vector(v);
+        return v.empty() ? 0 : v[0];
+    }
+
+    inline PacketBatch* _sv_action_batch(PacketBatch* batch) {
+        PacketVector v;
+        PacketBatch* out = 0;
+        while (batch) {
+            batch = v.load(batch);
+            static_cast<T&>(*this).simple_action_vector(v);
+            if (PacketBatch* b = v.to_batch()) {
+                if (out)
+                    out->append_batch(b);
+                else
+                    out = b;
+            }
+        }
+        return out;
+    }
+
+    SimpleVectorElement(){};
+    friend T;
+
+};
+
 CLICK_ENDDECLS
 #endif
@@ -3,6 +3,9 @@
 #include <click/flow/flowelement.hh>
 #include <click/timerwheel.hh>
 #include <click/batchbuilder.hh>
+#include <click/hugepagearena.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
 #include <type_traits>
 
 class _FlowManagerIMPState { public:
@@ -58,6 +61,8 @@ class VirtualFlowManagerIMP : public VirtualFlowManager, public Router::InitFutu
     int parse(Args *args) {
         double recycle_interval = 0;
         int timeout = 0;
+        int syn_timeout = -1;
+        int tcp_timeout = -1;
         int ret =
             (*args)
                 .read_or_set_p("CAPACITY", _capacity, 65536) // HT capacity
@@ -65,6 +70,8 @@ class VirtualFlowManagerIMP : public VirtualFlowManager, public Router::InitFutu
                 .read_or_set("VERBOSE", _verbose, 0)
                 .read_or_set("CACHE", _cache, 1)
                 .read_or_set("TIMEOUT", timeout, 0) // Timeout for the entries
+                .read("SYN_TIMEOUT", syn_timeout) // Timeout for TCP flows that only sent a SYN
+                .read("TCP_TIMEOUT", tcp_timeout) // Timeout for other TCP flows
                 .read_or_set("RECYCLE_INTERVAL", recycle_interval, 1)
                 .consume();
 
@@ -72,6 +79,9 @@ class VirtualFlowManagerIMP : public VirtualFlowManager, public Router::InitFutu
         _epochs_per_sec = max(1, 1000 / _recycle_interval_ms);
         _timeout_ms = timeout * 1000;
         _timeout_epochs = timeout * _epochs_per_sec;
+        _syn_timeout_ms = syn_timeout >= 0 ? syn_timeout * 1000 : _timeout_ms;
+        _tcp_timeout_ms = tcp_timeout >= 0 ? tcp_timeout * 1000 : _timeout_ms;
+        _tcp_timeouts = _syn_timeout_ms != _timeout_ms || _tcp_timeout_ms != _timeout_ms;
 
         //_reserve += reserve_size() is called by the parrent
 
@@ -99,15 +109,17 @@ class VirtualFlowManagerIMP : public VirtualFlowManager, public Router::InitFutu
             }
 
             if (_timeout_epochs > 0) {
-                t._timer_wheel.initialize(_timeout_epochs);
+                t._timer_wheel.initialize(
+                    to_epochs(max(_timeout_ms, max(_syn_timeout_ms, _tcp_timeout_ms))));
             }
 
-            t.fcbs =  (FlowControlBlock*)CLICK_ALIGNED_ALLOC(_flow_state_size_full * _capacity);
-            CLICK_ASSERT_ALIGNED(t.fcbs);
-            bzero(t.fcbs,_flow_state_size_full * _capacity);
+            // Huge pages when the arena is enabled, avoiding TLB misses on lookups
+            t.fcbs =  (FlowControlBlock*)HugepageArena::allocate(_flow_state_size_full * _capacity);
             if (!t.fcbs) {
                 return errh->error("Could not init data for table core %d!", core);
             }
+            CLICK_ASSERT_ALIGNED(t.fcbs);
+            bzero(t.fcbs,_flow_state_size_full * _capacity);
             
             if constexpr (State::need_fid()) {
                 t.flows_stack = (uint32_t *)CLICK_ALIGNED_ALLOC(sizeof(uint32_t) * (_capacity + 1));
@@ -176,13 +188,14 @@ class VirtualFlowManagerIMP : public VirtualFlowManager, public Router::InitFutu
                 int64_t old = (recent - prev->lastseen).msecval();
                 click_chatter("Old %li : %s %s fid %d",old, recent.unparse().c_str(), prev->lastseen.unparse().c_str(),get_fcb_flowid(prev) );
 
-                tw.schedule_after(prev, _timeout_epochs,  setter);
+                tw.schedule_after(prev, to_epochs(*get_fcb_timeout(prev)),  setter);
                 return next;
             }
 
             int old = (recent - prev->lastseen).msecval();
+            int timeout_ms = *get_fcb_timeout(prev);
 
-            if (old + _recycle_interval_ms >= _timeout_ms) {
+            if (old + _recycle_interval_ms >= timeout_ms) {
 
                 //expire
                 //click_chatter("Release %p", prev);
@@ -206,9 +219,8 @@ class VirtualFlowManagerIMP : public VirtualFlowManager, public Router::InitFutu
             } else {
                 //No need for lock as we'll be the only one to enqueue there
                 if (likely(prev != *get_next_released_fcb(prev))) {
-                    int r = (_timeout_ms) - old; //Time left in ms
-                    r = (r * (_epochs_per_sec)) / 1000;
-                    tw.schedule_after(prev, r, setter);
+                    int r = timeout_ms - old; //Time left in ms
+                    tw.schedule_after(prev, to_epochs(r), setter);
                 }
                 else
                 {
@@ -229,9 +241,18 @@ class VirtualFlowManagerIMP : public VirtualFlowManager, public Router::InitFutu
         if (have_maintainer)
             recent = Timestamp::recent_steady();
 
-        FOR_EACH_PACKET_SAFE(batch, p) {
-                ((T*)this)->process(p, b, recent);
+        // Classify by bursts: all keys of a burst are looked up at once
+        Packet* burst[lookup_burst];
+        int n = 0;
+        FOR_EACH_PACKET_SAFE_PREFETCH(batch, p) {
+            burst[n++] = p;
+            if (n == lookup_burst) {
+                process_burst(burst, n, b, recent);
+                n = 0;
+            }
         }
+        if (n)
+            process_burst(burst, n, b, recent);
 
         batch = b.finish();
         if (batch) {
@@ -245,62 +266,147 @@ class VirtualFlowManagerIMP : public VirtualFlowManager, public Router::InitFutu
         fcb_stack = tmp;
     }
 
+    /**
+     * Look up @a n keys at once, ret[i] receives what find() returns for
+     * keys[i]. Tables supporting bulk lookups override this to hash all
+     * keys and prefetch their buckets before resolving them.
+     */
+    inline void find_batch(IPFlow5ID *keys, int *ret, int n) {
+        for (int i = 0; i < n; i++)
+            ret[i] = ((T*)this)->find(keys[i]);
+    }
 
-inline void process(Packet *p, BatchBuilder &b, Timestamp &recent) {
-    IPFlow5ID fid = IPFlow5ID(p);
-    if (_cache && fid == b.last_id) {
-        b.append(p);
-        return;
+    /**
+     * Insert @a n distinct keys at once, ret[i] receives what insert()
+     * returns for keys[i] and flowids[i].
+     */
+    inline void insert_batch(IPFlow5ID *keys, int *flowids, int *ret, int n) {
+        for (int i = 0; i < n; i++)
+            ret[i] = ((T*)this)->insert(keys[i], flowids[i]);
     }
 
-    FlowControlBlock *fcb;
-    auto &state = *_tables;
+protected:
 
-    int ret = ((T*)this)->find(fid);
+    static constexpr int lookup_burst = 32;
 
-    if (ret <= 0) { 
-        uint32_t flowid;
-        if constexpr (State::need_fid()) {
-            flowid = state.imp_flows_pop();
-            if (unlikely(flowid == 0)) {
-                click_chatter("ID is 0 and table is full!");
-                p->kill();
-                return;
-            }
-
-            // INSERT IN TABLE
-        
-            ret = ((T*)this)->insert(fid, flowid);
+/**
+ * Classify a burst of packets: extract all keys, look them up together,
+ * insert the new flows together, then build the per-flow batches in order.
+ */
+inline void process_burst(Packet** burst, int n, BatchBuilder &b, Timestamp &recent) {
+    IPFlow5ID keys[lookup_burst];
+    int rets[lookup_burst];
+    auto &state = *_tables;
 
+    for (int i = 0; i < n; i++)
+        keys[i] = IPFlow5ID(burst[i]);
+
+    ((T*)this)->find_batch(keys, rets, n);
+
+    // New flows. Packets of the same new flow share one insertion
+    IPFlow5ID mkeys[lookup_burst];
+    int mfids[lookup_burst];
+    int mrets[lookup_burst];
+    int8_t alias[lookup_burst];
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        if (likely(rets[i] > 0))
+            continue;
+        int j = 0;
+        while (j < m && !(mkeys[j] == keys[i]))
+            j++;
+        alias[i] = j;
+        if (j < m)
+            continue;
+        mkeys[m] = keys[i];
+        if constexpr (State::need_fid()) {
+            mfids[m] = state.imp_flows_pop();
         } else {
-            
-            ret = ((T*)this)->insert(fid, 0);
-
-            flowid = ret;
+            mfids[m] = 0;
         }
+        m++;
+    }
 
-        if (unlikely(ret < 0)) {
-            p->kill();
-            return;
+    if (unlikely(m > 0)) {
+        int k = 0;
+        IPFlow5ID ikeys[lookup_burst];
+        int ifids[lookup_burst];
+        int irets[lookup_burst];
+        for (int j = 0; j < m; j++) {
+            if constexpr (State::need_fid()) {
+                if (unlikely(mfids[j] == 0)) {
+                    click_chatter("ID is 0 and table is full!");
+                    mrets[j] = -1;
+                    continue;
+                }
+            }
+            ikeys[k] = mkeys[j];
+            ifids[k] = mfids[j];
+            k++;
         }
-        fcb = get_fcb_from_flowid(ret);
-
-
-        if constexpr (State::need_fid()) {
-            *(get_fcb_flowid(fcb)) = flowid;
+        if (k)
+            ((T*)this)->insert_batch(ikeys, ifids, irets, k);
+        for (int j = 0, ik = 0; j < m; j++) {
+            if constexpr (State::need_fid()) {
+                if (unlikely(mfids[j] == 0))
+                    continue;
+            }
+            int ret = irets[ik++];
+            mrets[j] = ret;
+            if (unlikely(ret < 0)) {
+                if constexpr (State::need_fid()) {
+                    state.imp_flows_push(mfids[j]);
+                }
+                continue;
+            }
+            FlowControlBlock *fcb = get_fcb_from_flowid(ret);
+            if constexpr (State::need_fid()) {
+                *(get_fcb_flowid(fcb)) = mfids[j];
+            }
+            if (_timeout_epochs) {
+                memcpy(get_fcb_key(fcb), &mkeys[j], sizeof(IPFlow5ID));
+                Packet *first = 0;
+                for (int i = 0; i < n; i++) {
+                    if (rets[i] <= 0 && alias[i] == j) {
+                        first = burst[i];
+                        break;
+                    }
+                }
+                uint32_t t = flow_timeout(first, mkeys[j]);
+                *get_fcb_timeout(fcb) = t;
+                state._timer_wheel.schedule_after(fcb, to_epochs(t), setter);
+            }
         }
+    }
 
-        if (_timeout_epochs) {
-            memcpy(get_fcb_key(fcb), &fid, sizeof(IPFlow5ID));
-            state._timer_wheel.schedule_after(fcb, _timeout_epochs, setter);
-        }
+    for (int i = 0; i < n; i++) {
+        if (rets[i] > 0)
+            process(burst[i], keys[i], rets[i], false, b, recent);
+        else if (likely(mrets[alias[i]] >= 0))
+            process(burst[i], keys[i], mrets[alias[i]], true, b, recent);
+        else
+            burst[i]->kill();
+    }
+}
 
-    } // (end)It's a new flow
-    else
-    { // Old flow
-        fcb = get_fcb_from_flowid(ret);
+/**
+ * Append a packet to the batch of its flow @a ret, pushing the current
+ * batch if it belongs to another flow.
+ */
+inline void process(Packet *p, IPFlow5ID &fid, int ret, bool is_new, BatchBuilder &b, Timestamp &recent) {
+    if (_cache && fid == b.last_id) {
+        b.append(p);
+        return;
     }
 
+    FlowControlBlock *fcb = get_fcb_from_flowid(ret);
+
+    // A SYN-only flow becomes established. The wheel entry is not moved,
+    // the maintainer will re-bucket it with the new timeout
+    if (!is_new && _tcp_timeouts && unlikely(*get_fcb_timeout(fcb) == _syn_timeout_ms)
+        && _timeout_epochs && fid.proto() == IP_PROTO_TCP)
+        *get_fcb_timeout(fcb) = flow_timeout(p, fid);
+
     if (b.last == ret) {
         b.append(p);
     } else {
@@ -327,8 +433,6 @@ inline void process(Packet *p, BatchBuilder &b, Timestamp &recent) {
 }
 
 
-protected:
-
     #define FCB_DATA(fcb, offset) (((uint8_t *)(fcb->data_32)) + (offset))
 
     static inline uint32_t *get_fcb_flowid(FlowControlBlock *fcb) {
@@ -353,17 +457,42 @@ protected:
 
     inline static const int reserve_size() {
         if constexpr (State::need_fid()) {
-             return sizeof(uint32_t) + sizeof(IPFlow5ID) + sizeof(FlowControlBlock*);
+             return sizeof(uint32_t) + sizeof(IPFlow5ID) + sizeof(FlowControlBlock*) + sizeof(uint32_t);
         } else {
-             return sizeof(IPFlow5ID) + sizeof(FlowControlBlock*);
+             return sizeof(IPFlow5ID) + sizeof(FlowControlBlock*) + sizeof(uint32_t);
         }
        
     }
 
     inline static FlowControlBlock** get_next_released_fcb(FlowControlBlock *fcb) {
-	    return (FlowControlBlock**) FCB_DATA(fcb, reserve_size() - sizeof(FlowControlBlock*));
+	    return (FlowControlBlock**) FCB_DATA(fcb, reserve_size() - sizeof(uint32_t) - sizeof(FlowControlBlock*));
+    };
+
+    /**
+     * Returns the location of the timeout of the flow, in msec
+     */
+    inline static uint32_t* get_fcb_timeout(FlowControlBlock *fcb) {
+	    return (uint32_t*) FCB_DATA(fcb, reserve_size() - sizeof(uint32_t));
     };
 
+    /**
+     * Timeout of a flow according to its packet: SYN_TIMEOUT for TCP flows
+     * that only sent a SYN, TCP_TIMEOUT for other TCP flows, TIMEOUT else.
+     */
+    inline uint32_t flow_timeout(Packet *p, const IPFlow5ID &fid) {
+        if (!_tcp_timeouts || fid.proto() != IP_PROTO_TCP)
+            return _timeout_ms;
+        const click_tcp *th = p->tcp_header();
+        if ((th->th_flags & (TH_SYN | TH_ACK)) == TH_SYN)
+            return _syn_timeout_ms;
+        return _tcp_timeout_ms;
+    }
+
+    inline uint32_t to_epochs(uint32_t ms) {
+        uint32_t e = (uint64_t)ms * _epochs_per_sec / 1000;
+        return e ? e : 1;
+    }
+
     
     const static auto constexpr setter = [](FlowControlBlock* prev, FlowControlBlock* next)
     {
@@ -414,6 +543,9 @@ protected:
     bool _cache;
     uint32_t _timeout_epochs;
     uint32_t _timeout_ms;          // Timeout for deletion
+    uint32_t _syn_timeout_ms;      // Timeout of TCP flows that only sent a SYN
+    uint32_t _tcp_timeout_ms;      // Timeout of other TCP flows
+    bool _tcp_timeouts;            // TCP flows have their own timeouts
     uint32_t _epochs_per_sec;      // Granularity for the epoch
     uint16_t _recycle_interval_ms; // When to run the maintainer
     const bool have_maintainer = true;
@@ -0,0 +1,137 @@
+// -*- related-file-name: "../../lib/hugepagearena.cc" -*-
+#ifndef CLICK_HUGEPAGEARENA_HH
+#define CLICK_HUGEPAGEARENA_HH
+#include <click/glue.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+class ErrorHandler;
+
+#if CLICK_USERLEVEL && ALLOW_MMAP
+# define HAVE_HUGEPAGE_ARENA 1
+#endif
+
+/** @brief Size of the packet buffers handed out by the huge page arena */
+#ifndef CLICK_HUGEPAGE_BUFFER_SIZE
+# define CLICK_HUGEPAGE_BUFFER_SIZE 2048
+#endif
+
+/**
+ * @brief Huge page backed memory for packet data and large tables
+ *
+ * Without DPDK, packet buffers come from the C++ allocator and are spread
+ * over 4K pages, so high packet rates cause many TLB misses. The arena
+ * reserves one contiguous region backed by huge pages (2MB, or 1GB if asked
+ * and available) and cuts it in buffers of CLICK_HUGEPAGE_BUFFER_SIZE bytes.
+ *
+ * If no huge pages are reserved in the system, the region is mapped with
+ * normal pages and transparent huge pages are requested with madvise(), so
+ * the arena always works. When the arena is exhausted, alloc_buffer() returns
+ * null and callers fall back to the normal allocator.
+ *
+ * The arena is enabled with the --hugepage-arena option of the userlevel
+ * driver. Packet::alloc_data() then takes buffers from it, and
+ * Packet::release_buffer() recognizes them with contains().
+ *
+ * Large tables, such as the FlowControlBlock tables of flow managers, are
+ * allocated with allocate() and freed with deallocate(). These use a
+ * dedicated huge page mapping when the arena is enabled, and
+ * CLICK_ALIGNED_ALLOC otherwise.
+ */
+class HugepageArena { public:
+
+    /**
+     * @brief Reserve the arena
+     * @param size Size of the arena in bytes
+     * @param page_size Huge page size in bytes, 0 for the system default
+     * @return 0 on success, or a negative error
+     *
+     * Must be called before any thread allocates packets.
+     */
+    static int initialize(size_t size, size_t page_size, ErrorHandler *errh);
+
+    /** @brief Return true if the arena was initialized */
+    static inline bool enabled() {
+        return _base != 0;
+    }
+
+    /** @brief Return true if the arena is backed by explicit huge pages */
+    static inline bool huge() {
+        return _huge;
+    }
+
+    /** @brief Return true if @a p is a buffer of the arena */
+    static inline bool contains(const void *p) {
+        return (const unsigned char *)p >= _base && (const unsigned char *)p < _end;
+    }
+
+    /**
+     * @brief Allocate a buffer of CLICK_HUGEPAGE_BUFFER_SIZE bytes
+     * @return the buffer, or null if the arena is exhausted
+     */
+    static inline unsigned char *alloc_buffer();
+
+    /** @brief Give back a buffer of the arena */
+    static inline void free_buffer(unsigned char *p);
+
+    /**
+     * @brief Allocate a large zone, cache-line aligned
+     *
+     * Tries huge pages first if the arena is enabled.
+     */
+    static void *allocate(size_t size);
+
+    /** @brief Free a zone obtained with allocate() of the same @a size */
+    static void deallocate(void *p, size_t size);
+
+  private:
+
+    // Buffers are cached per thread to avoid contention on the free list
+    enum { cache_size = 64 };
+
+    struct link {
+        link *next;
+    };
+
+    struct thread_cache {
+        unsigned count;
+        unsigned char *buffers[cache_size];
+    };
+
+    static unsigned char *_base;
+    static unsigned char *_end;
+    static size_t _page_size;
+    static bool _huge;
+
+    static atomic_uint32_t _next;       // index of the next never-used buffer
+    static uint32_t _nbuffers;
+    static link *_free;                 // buffers given back by thread caches
+    static SimpleSpinlock _lock;
+
+    static __thread thread_cache _cache;
+
+    static unsigned char *refill();
+    static void flush();
+    static void *map(size_t size, size_t page_size, bool &huge);
+
+};
+
+#if HAVE_HUGEPAGE_ARENA
+inline unsigned char *
+HugepageArena::alloc_buffer()
+{
+    if (likely(_cache.count))
+        return _cache.buffers[--_cache.count];
+    return refill();
+}
+
+inline void
+HugepageArena::free_buffer(unsigned char *p)
+{
+    if (unlikely(_cache.count == cache_size))
+        flush();
+    _cache.buffers[_cache.count++] = p;
+}
+#endif
+
+CLICK_ENDDECLS
+#endif
@@ -3,12 +3,21 @@
 #define CLICK_IP6TABLE_HH
 #include <click/glue.hh>
 #include <click/vector.hh>
+#include <click/hashtable.hh>
+#include <click/pair.hh>
 #include <click/ip6address.hh>
 CLICK_DECLS
 
 // IP6 routing table.
 // Lookup by longest prefix.
 // Each entry contains a gateway and an output index.
+//
+// Routes are expanded in a multibit trie with 8-bit strides: a lookup reads
+// at most one node per byte of the destination, and stops at the first node
+// without a child for that byte, so /64 routes take at most 8 node reads
+// whatever the size of the table. lookup_batch() walks several destinations
+// in lockstep and prefetches the next node of each, so the cache misses of
+// the batch overlap.
 
 class IP6Table { public:
 
@@ -16,10 +25,11 @@ class IP6Table { public:
   ~IP6Table();
 
   bool lookup(const IP6Address &dst, IP6Address &gw, int &index) const;
+  void lookup_batch(const IP6Address *dst, int n, IP6Address *gw, int *index) const;
 
-  void add(const IP6Address &dst, const IP6Address &mask, const IP6Address &gw, int index);
+  bool add(const IP6Address &dst, const IP6Address &mask, const IP6Address &gw, int index);
   void del(const IP6Address &dst, const IP6Address &mask);
-  void clear()				{ _v.clear(); }
+  void clear();
   String dump();
 
  private:
@@ -32,6 +42,31 @@ class IP6Table { public:
     int _valid;
   };
   Vector<Entry> _v;
+  Vector<int> _vfree;
+
+  // Exact (prefix, length) -> index in _v
+  HashTable<Pair<IP6Address, int>, int> _routes;
+
+  enum { STRIDE = 8, NSLOTS = 1 << STRIDE, NLEVELS = 128 / STRIDE };
+  enum { ROUTE_MASK = 0x00FFFFFF, DEPTH_SHIFT = 24 };
+
+  // A slot gives the longest route ending in its node that covers it (index
+  // in _v + 1, and the route length in the high byte), and the child node
+  // for the next byte. Node 0 is the root, so a null child means none.
+  struct Slot {
+    uint32_t info;
+    uint32_t child;
+  };
+  struct Node {
+    Slot slots[NSLOTS];
+  };
+  Vector<Node> _nodes;
+  Vector<uint32_t> _nodes_free;
+  uint32_t _default;
+
+  uint32_t alloc_node();
+  bool node_empty(uint32_t node) const;
+  int find(const IP6Address &prefix, int len) const;
 
 };
 
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <random>
 #include <iterator>
+#include <cmath>
 #if HAVE_DPDK
 #include <click/dpdk_glue.hh>
 #endif
@@ -14,13 +15,14 @@
 #include <click/tcphelper.hh>
 #include <click/straccum.hh>
 #include <click/args.hh>
+#include <click/error.hh>
 #include <click/timer.hh>
 #include <click/algorithm.hh>
 
 template <typename T>
 class LoadBalancer { public:
 
-    LoadBalancer() : _current(0), _dsts(), _weights_helper(), _mode_case(round_robin) {
+    LoadBalancer() : _current(0), _dsts(), _weights_helper(), _mode_case(round_robin), _maglev_size(65537) {
         modetrans.find_insert("rr",round_robin);
         modetrans.find_insert("hash",direct_hash);
         modetrans.find_insert("chash",direct_chash);
@@ -35,6 +37,8 @@ class LoadBalancer { public:
         modetrans.find_insert("least",least_load);
         modetrans.find_insert("pow2",pow2);
         modetrans.find_insert("table",table);
+        modetrans.find_insert("maglev",maglev);
+        modetrans.find_insert("rendezvous",rendezvous);
         lsttrans.find_insert("conn",connections);
         lsttrans.find_insert("packets",packets);
         lsttrans.find_insert("bytes",bytes);
@@ -57,8 +61,9 @@ class LoadBalancer { public:
         direct_hash_agg,
         direct_hash_ip,
         least_load,
-        table
-
+        table,
+        maglev,
+        rendezvous
     };
 
     static bool isLoadBased(LBMode mode) {
@@ -90,6 +95,13 @@ class LoadBalancer { public:
         uint64_t raw_cpu_load;
     } CLICK_CACHE_ALIGN;
 
+    // A backend of the rendezvous mode
+    struct RendezvousNode {
+        unsigned server;
+        uint64_t seed;
+        double weight;
+    };
+
 protected:
     HashTable<String, LBMode> modetrans;
     HashTable<String, LSTMode> lsttrans;
@@ -102,6 +114,10 @@ protected:
     Vector <unsigned> _selector;
     Vector <unsigned> _cst_hash;
     Vector <unsigned> _spares;
+    Vector <unsigned> _lb_weights;
+    unprotected_rcu_singlewriter<Vector <unsigned>,2> _maglev;
+    unprotected_rcu_singlewriter<Vector <RendezvousNode>,2> _rendezvous;
+    unsigned _maglev_size;
     bool _track_load;
     bool _force_track_load;
     int _awrr_interval;
@@ -188,6 +204,128 @@ protected:
         _cst_hash.swap(new_hash);
     }
 
+    static inline uint64_t mix_hash(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    /* Seed of a backend for the Maglev and rendezvous modes. It depends on
+     * the destination only, not on its index, so the order of DST
+     * arguments does not matter.
+     */
+    uint64_t server_seed(unsigned server) {
+        return mix_hash(CLICK_NAME(hashcode)(_dsts[server]));
+    }
+
+    static bool is_prime(unsigned n) {
+        if (n < 2)
+            return false;
+        for (unsigned i = 2; i * i <= n; i++)
+            if (n % i == 0)
+                return false;
+        return true;
+    }
+
+    /* Builds the Maglev lookup table of the active backends. Each backend
+     * fills the table in the order of its own permutation, as many times per
+     * round as its weight allows, so a change of one backend only moves
+     * roughly the entries it gains or loses.
+     */
+    void build_maglev() {
+        Vector<unsigned> servers;
+        unsigned wmax = 0;
+        for (int i = 0; i < _selector.size(); i++) {
+            unsigned w = _lb_weights[_selector[i]];
+            if (w == 0)
+                continue;
+            servers.push_back(_selector[i]);
+            if (w > wmax)
+                wmax = w;
+        }
+        if (servers.size() == 0) {
+            click_chatter("No backend with a weight, keeping the previous Maglev table");
+            return;
+        }
+
+        // The table must depend neither on the order backends were activated
+        // nor on the order of DST arguments, so backends fill it in the
+        // order of their seed
+        const unsigned m = _maglev_size;
+        int n = servers.size();
+        Vector<std::pair<uint64_t, unsigned> > order;
+        for (int i = 0; i < n; i++)
+            order.push_back(std::make_pair(server_seed(servers[i]), servers[i]));
+        std::sort(order.begin(), order.end());
+        Vector<unsigned> offset(n, 0), skip(n, 0), next(n, 0);
+        Vector<uint64_t> credit(n, 0);
+        for (int i = 0; i < n; i++) {
+            servers[i] = order[i].second;
+            uint64_t seed = order[i].first;
+            offset[i] = (seed >> 32) % m;
+            skip[i] = ((uint32_t) seed) % (m - 1) + 1;
+        }
+
+        Vector<unsigned> &table = _maglev.write_begin();
+        table.assign(m, (unsigned) -1);
+        unsigned filled = 0;
+        while (filled < m) {
+            for (int i = 0; i < n && filled < m; i++) {
+                credit[i] += _lb_weights[servers[i]];
+                if (credit[i] < wmax)
+                    continue;
+                credit[i] -= wmax;
+                unsigned c = (offset[i] + (uint64_t) next[i] * skip[i]) % m;
+                while (table[c] != (unsigned) -1) {
+                    next[i]++;
+                    c = (offset[i] + (uint64_t) next[i] * skip[i]) % m;
+                }
+                table[c] = servers[i];
+                next[i]++;
+                filled++;
+            }
+        }
+        _maglev.write_commit();
+    }
+
+    /* Builds the list of backends of the rendezvous mode
+     */
+    void build_rendezvous() {
+        Vector<RendezvousNode> &nodes = _rendezvous.write_begin();
+        nodes.clear();
+        for (int i = 0; i < _selector.size(); i++) {
+            unsigned s = _selector[i];
+            if (_lb_weights[s] == 0)
+                continue;
+            RendezvousNode node;
+            node.server = s;
+            node.seed = server_seed(s);
+            node.weight = _lb_weights[s];
+            nodes.push_back(node);
+        }
+        _rendezvous.write_commit();
+    }
+
+    /* Rebuilds the structures of hash-based modes after the set of active
+     * backends or their weights changed
+     */
+    void rebuild() {
+        if (_mode_case == constant_hash_agg) {
+            build_hash_ring();
+        } else if (_mode_case == maglev) {
+            build_maglev();
+        } else if (_mode_case == rendezvous) {
+            build_rendezvous();
+        }
+    }
+
+    static inline uint64_t flow_hash(const Packet* p) {
+        return mix_hash(IPFlowID(p, false).hashcode());
+    }
+
     static void atc(Timer *timer, void *user_data) {
         LoadBalancer* lb = (LoadBalancer*)user_data;
         uint64_t metric_tot = 0;
@@ -254,6 +392,8 @@ protected:
         int cst_buckets;
         int nserver;
         bool force_track_load;
+        unsigned maglev_size;
+        Vector<unsigned> weights;
         int ret = Args(lb, errh).bind(conf)
             .read_or_set("LB_MODE", lb_mode,"rr")
             .read_or_set("LST_MODE",lst_mode,"conn")
@@ -262,11 +402,39 @@ protected:
             .read_or_set("FORCE_TRACK_LOAD", force_track_load, false)
             .read_or_set("NSERVER", nserver, 0)
             .read("CST_BUCKETS", cst_buckets).read_status(has_cst_buckets)
-            .read_or_set("AWRR_ALPHA", alpha, 0).consume();
+            .read_or_set("AWRR_ALPHA", alpha, 0)
+            .read_or_set("MAGLEV_SIZE", maglev_size, 65537)
+            .read_all("WEIGHT", weights).consume();
 
         if (ret < 0)
             return -1;
 
+        if (!is_prime(maglev_size) || maglev_size < (unsigned) _dsts.size())
+            return errh->error("MAGLEV_SIZE must be a prime number, at least the number of destinations");
+        _maglev_size = maglev_size;
+        if (weights.size() && weights.size() != _dsts.size())
+            return errh->error("WEIGHT must be given once per destination");
+        if (weights.size()) {
+            // Destinations start active in order, one of them must have a
+            // weight for hash-based modes to pick it
+            int nactive = nserver ? nserver : (autoscale ? 1 : _dsts.size());
+            bool weighted = false;
+            for (int i = 0; i < nactive && i < weights.size(); i++)
+                weighted |= weights[i] != 0;
+            if (!weighted)
+                return errh->error("WEIGHT must not be 0 for every active destination");
+        }
+        _lb_weights = weights;
+
+        if (lb_mode == "maglev" || lb_mode == "rendezvous") {
+            // A destination is known by its seed in these modes, a
+            // duplicate would get the same place in the table twice
+            for (int i = 0; i < _dsts.size(); i++)
+                for (int j = 0; j < i; j++)
+                    if (_dsts[i] == _dsts[j])
+                        return errh->error("DST %d is the same destination as DST %d", i, j);
+        }
+
         _alpha = alpha;
         _autoscale = autoscale;
 	_force_track_load = force_track_load;
@@ -279,6 +447,66 @@ protected:
         return ret;
     }
 
+    /* Activates spare backend SERVER. Other backends keep their place, so
+     * hash-based modes keep most of the flows on the same backend.
+     */
+    int add_server(unsigned server, ErrorHandler* errh) {
+        Vector<unsigned> news;
+        news.reserve(_dsts.size());
+        for (int i = 0; i < _spares.size(); i++) {
+            if (_spares[i] != server)
+                news.push_back(_spares[i]);
+        }
+        if (news.size() == _spares.size())
+            return errh->error("Backend %u is not a spare", server);
+        _spares.swap(news);
+        _selector.push_back(server);
+        rebuild();
+        return 0;
+    }
+
+    /* Deactivates active backend SERVER
+     */
+    int remove_server(unsigned server, ErrorHandler* errh) {
+        Vector<unsigned> news;
+        news.reserve(_dsts.size());
+        for (int i = 0; i < _selector.size(); i++) {
+            if (_selector[i] != server)
+                news.push_back(_selector[i]);
+        }
+        if (news.size() == _selector.size())
+            return errh->error("Backend %u is not active", server);
+        if (news.size() == 0)
+            return errh->error("Cannot remove the last backend");
+        if (!has_weighted_server(server))
+            return errh->error("Cannot remove the last backend with a weight");
+        _spares.push_back(server);
+        _selector.swap(news);
+        rebuild();
+        return 0;
+    }
+
+    int set_server_weight(unsigned server, unsigned weight, ErrorHandler* errh) {
+        if (server >= (unsigned) _lb_weights.size())
+            return errh->error("Invalid backend %u", server);
+        if (weight == 0 && !has_weighted_server(server))
+            return errh->error("Cannot set the weight of the last backend with a weight to 0");
+        _lb_weights[server] = weight;
+        rebuild();
+        return 0;
+    }
+
+    /* Returns true if an active backend other than EXCEPT has a non-zero
+     * weight. Hash-based modes need one to build their structures.
+     */
+    bool has_weighted_server(unsigned except) const {
+        for (int i = 0; i < _selector.size(); i++) {
+            if (_selector[i] != except && _lb_weights[_selector[i]] != 0)
+                return true;
+        }
+        return false;
+    }
+
     void add_server() {
         if (_spares.size() == 0) {
             click_chatter("No server to add!");
@@ -297,9 +525,7 @@ protected:
             news.push_back(_selector[i]);
         }
         _selector.swap(news);
-        if (_mode_case == constant_hash_agg) {
-            build_hash_ring();
-        }
+        rebuild();
     }
 
     void remove_server() {
@@ -310,6 +536,10 @@ protected:
 
         int id = click_random() % _selector.size();
         int removed = _selector[id];
+        if (!has_weighted_server(removed)) {
+            click_chatter("Cannot remove the last server with a weight!");
+            return;
+        }
         Vector<unsigned> news;
         news.reserve(_dsts.size());
         for (int i = 0; i < _selector.size(); i++) {
@@ -320,13 +550,11 @@ protected:
         }
         _spares.push_back(removed);
         _selector.swap(news);
-        if (_mode_case == constant_hash_agg) {
-            build_hash_ring();
-        }
+        rebuild();
     }
 
     enum {
-            h_load,h_load_raw,h_nb_total_servers,h_nb_active_servers,h_load_conn,h_load_packets,h_load_bytes,h_add_server,h_remove_server,h_lb_max
+            h_load,h_load_raw,h_nb_total_servers,h_nb_active_servers,h_load_conn,h_load_packets,h_load_bytes,h_add_server,h_remove_server,h_weight,h_lb_max
     };
 
 
@@ -402,12 +630,35 @@ protected:
         LoadBalancer *cs = this;
         switch((uintptr_t) thunk) {
             case h_add_server: {
-                add_server();
-                break;
+                if (!input)
+                    add_server();
+                else {
+                    unsigned server;
+                    if (!IntArg().parse(input, server))
+                        return errh->error("Expected a backend index");
+                    return add_server(server, errh);
+                }
+                return 0;
             }
             case h_remove_server: {
-                remove_server();
-                break;
+                if (!input)
+                    remove_server();
+                else {
+                    unsigned server;
+                    if (!IntArg().parse(input, server))
+                        return errh->error("Expected a backend index");
+                    return remove_server(server, errh);
+                }
+                return 0;
+            }
+            case h_weight: {
+                unsigned server, weight;
+                if (Args(errh).push_back_words(input)
+                        .read_mp("BACKEND", server)
+                        .read_mp("WEIGHT", weight)
+                        .complete() < 0)
+                    return -1;
+                return set_server_weight(server, weight, errh);
             }
         }
         return -1;
@@ -443,6 +694,12 @@ protected:
                     acc << cs->get_load_metric(i,bytes) << (i == cs->_dsts.size() -1?"":" ");
                 }
                 return acc.take_string();}
+            case h_weight:{
+                StringAccum acc;
+                for (int i = 0; i < cs->_lb_weights.size(); i ++) {
+                    acc << cs->_lb_weights[i] << (i == cs->_lb_weights.size() -1?"":" ");
+                }
+                return acc.take_string();}
             default:
                 return "<none>";
         }
@@ -476,6 +733,8 @@ protected:
         e->add_read_handler("load_packets", e->read_handler, h_load_packets);
         e->add_write_handler("remove_server", e->write_handler, h_remove_server);
         e->add_write_handler("add_server", e->write_handler, h_add_server);
+        e->add_read_handler("weight", e->read_handler, h_weight);
+        e->add_write_handler("weight", e->write_handler, h_weight);
     }
 
     void set_mode(String mode, String metric="cpu", Element* owner=0,int awrr_timer_interval = -1, int nserver = 0) {
@@ -523,11 +782,14 @@ protected:
         for (int i = 0; i < nserver; i++)
             _selector.push_back(i);
 
+        if (_lb_weights.size() != _dsts.size())
+            _lb_weights.assign(_dsts.size(), 1);
+
         if (_mode_case == constant_hash_agg) {
             if (_cst_hash.size() == 0)
                 _cst_hash.resize(_dsts.size() * 100);
-            build_hash_ring();
         }
+        rebuild();
 
         _loads.resize(_dsts.size());
         CLICK_ASSERT_ALIGNED(_loads.data());
@@ -674,6 +936,30 @@ protected:
                 _weights_helper.read_end();
                 return r;
                         }
+            case maglev: {
+                auto & mt = _maglev.read_begin();
+                unsigned r = mt.unchecked_at(flow_hash(p) % mt.size());
+                _maglev.read_end();
+                return r;
+            }
+            case rendezvous: {
+                auto & nodes = _rendezvous.read_begin();
+                uint64_t h = flow_hash(p);
+                double best = -1;
+                unsigned r = 0;
+                for (int i = 0; i < nodes.size(); i++) {
+                    const RendezvousNode &n = nodes.unchecked_at(i);
+                    // Score is -weight / ln(u), with u uniform in (0,1)
+                    double u = ((mix_hash(h ^ n.seed) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+                    double score = -n.weight / std::log(u);
+                    if (score > best) {
+                        best = score;
+                        r = n.server;
+                    }
+                }
+                _rendezvous.read_end();
+                return r;
+            }
             default: {
                 //click_chatter("No mode set, go to bucket 0");
                 return 0;
@@ -57,7 +57,19 @@ CLICK_DECLS
 #define HAVE_BATCH_RECYCLE 1
 #endif
 
+/* Keep one global pool per NUMA node, and send data buffers freed on a
+ * remote node back to their home node */
+#if HAVE_CLICK_PACKET_POOL && HAVE_MULTITHREAD && HAVE_NUMA && \
+    !HAVE_VECTOR_PACKET_POOL && !HAVE_DPDK_PACKET_POOL && !HAVE_NETMAP_PACKET_POOL
+# define HAVE_NUMA_PACKET_POOL 1
+# ifndef CLICK_PACKET_POOL_MAX_NUMA
+#  define CLICK_PACKET_POOL_MAX_NUMA 8
+# endif
+#endif
+
 class IP6Address;
+class Element;
+class ErrorHandler;
 class WritablePacket;
 class PacketBatch;
 #if HAVE_DPDK
@@ -124,6 +136,18 @@ class Packet { public:
 
     static int max_data_pool_size();
     static void static_cleanup();
+#if HAVE_CLICK_PACKET_POOL
+    static void static_initialize();
+    static String read_pool_handler(Element *e, void *thunk);
+    static int set_pool_sizes(unsigned size, unsigned data_size, unsigned global_count,
+                              uint64_t memory_cap, ErrorHandler *errh);
+    static unsigned pool_prewarm_size;
+    static unsigned pool_size;              // max packets without data per thread
+    static unsigned data_pool_size;         // max packets with data per thread
+    static unsigned global_pool_count;      // max batches of packets in the global pool
+    static unsigned global_data_pool_count; // max batches of data packets in the global pool
+    static uint64_t pool_memory_cap;        // max bytes in the global pool, 0 for no cap
+#endif
 
     inline void kill();
 
@@ -153,6 +177,9 @@ class Packet { public:
     inline const unsigned char *end_buffer() const;
     inline uint32_t buffer_length() const;
 
+    inline void prefetch() const;
+    inline void prefetch_data() const;
+
 #if CLICK_LINUXMODULE
     struct sk_buff *skb()		{ return (struct sk_buff *)this; }
     const struct sk_buff *skb() const	{ return (const struct sk_buff*)this; }
@@ -982,6 +1009,15 @@ private:
             p(0), pcount(0), pd(0), pdcount(0)
 #endif
         {
+            hits = misses = phits = pmisses = refills = transfers = 0;
+            outstanding = 0;
+#if HAVE_NUMA_PACKET_POOL
+            node = 0;
+            for (int i = 0; i < CLICK_PACKET_POOL_MAX_NUMA; i++) {
+                remote_pd[i] = 0;
+                remote_pdcount[i] = 0;
+            }
+#endif
         }
 #if HAVE_VECTOR_PACKET_POOL
         Stack<Packet*> p;
@@ -992,6 +1028,21 @@ private:
         WritablePacket* pd;             // free data buffers, linked by pd->next
         unsigned pdcount;           // # buffers in `pd` list
 #endif
+#if HAVE_NUMA_PACKET_POOL
+        int node;                   // NUMA node of the thread
+        WritablePacket* remote_pd[CLICK_PACKET_POOL_MAX_NUMA]; // buffers freed here
+                                    //   but allocated on another node
+        unsigned remote_pdcount[CLICK_PACKET_POOL_MAX_NUMA];
+#endif
+        // statistics, only written by the owner thread
+        uint64_t hits;              // data packets taken from the pool
+        uint64_t misses;            // data packets allocated as the pool was empty
+        uint64_t phits;             // packets without data taken from the pool
+        uint64_t pmisses;           // packets without data allocated
+        uint64_t refills;           // batches taken from the global pool
+        uint64_t transfers;         // pool_transfer() calls
+        int64_t outstanding;        // data packets given minus data packets
+                                    //   recycled by this thread
     #  if HAVE_MULTITHREAD
         PacketPool* thread_pool_next; // link to next per-thread pool
     #  endif
@@ -1037,6 +1088,7 @@ class WritablePacket : public Packet { public:
 # if HAVE_CLICK_PACKET_POOL
     static PacketPool& get_local_packet_pool();
     static void initialize_local_packet_pool();
+    static void pool_prewarm();
 # endif
 
     static void pool_transfer(int from, int to);
@@ -1098,6 +1150,12 @@ class WritablePacket : public Packet { public:
     static WritablePacket *pool_batch_allocate(uint16_t count);
     static void recycle_packet_batch(WritablePacket *head, Packet* tail, unsigned count);
     static void recycle_data_batch(WritablePacket *head, Packet* tail, unsigned count);
+    static void pool_fill_data(PacketPool &packet_pool, unsigned count);
+# if HAVE_NUMA_PACKET_POOL
+    static inline int buffer_node(const Packet *p);
+    static void flush_remote(PacketPool &packet_pool, int node);
+    static inline void recycle_remote(PacketPool &packet_pool, WritablePacket *p, int node);
+# endif
 #endif
 
     friend class Packet;
@@ -1323,6 +1381,27 @@ Packet::buffer_length() const
     return end_buffer() - buffer();
 }
 
+/** @brief Prefetch the packet metadata.
+ *
+ * Prefetches the first cache line of the packet structure and the annotation
+ * area, which also holds the next() and prev() pointers. */
+inline void
+Packet::prefetch() const
+{
+    __builtin_prefetch(this);
+    __builtin_prefetch(xanno());
+}
+
+/** @brief Prefetch the first cache line of packet data.
+ *
+ * This reads the data() pointer, so the metadata should have been prefetched
+ * some time before. */
+inline void
+Packet::prefetch_data() const
+{
+    __builtin_prefetch(data());
+}
+
 inline Packet *
 Packet::next() const
 {
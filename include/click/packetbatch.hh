@@ -30,6 +30,38 @@ CLICK_DECLS
 
 #define FOR_EACH_PACKET_SAFE(batch,p) FOR_EACH_PACKET_LL_SAFE(batch->first(),p)
 
+/**
+ * Default number of packets ahead of the current one that the _PREFETCH
+ *  iteration macros prefetch. Can be changed at runtime through
+ *  PacketBatch::prefetch_distance, 0 disables prefetching.
+ */
+#ifndef CLICK_PREFETCH_DISTANCE
+# define CLICK_PREFETCH_DISTANCE 4
+#endif
+
+/**
+ * Iterate over all packets of a batch as FOR_EACH_PACKET, but prefetch the
+ *  metadata and the first data cache line of the packets that are
+ *  PacketBatch::prefetch_distance packets ahead. Use in elements reading the
+ *  headers of all packets, so the first header access is not a cache miss.
+ */
+#define FOR_EACH_PACKET_PREFETCH(batch,p) \
+    for (Packet* p = batch->first(), *fepp_ahead = PacketBatch::prefetch_start(p);\
+         p != 0;\
+         p = p->next(), fepp_ahead = PacketBatch::prefetch_next(fepp_ahead))
+
+/**
+ * Same as FOR_EACH_PACKET_SAFE, with prefetching as FOR_EACH_PACKET_PREFETCH.
+ *  The current packet can be modified, but not the following ones.
+ */
+#define FOR_EACH_PACKET_LL_SAFE_PREFETCH(first,p) \
+                Packet* fepsp_ahead = PacketBatch::prefetch_start(first);\
+                Packet* fep_next = ((first != 0)? first->next() : 0 );\
+                Packet* p = first;\
+                for (;p != 0;p=fep_next,fep_next=(p==0?0:p->next()),fepsp_ahead=PacketBatch::prefetch_next(fepsp_ahead))
+
+#define FOR_EACH_PACKET_SAFE_PREFETCH(batch,p) FOR_EACH_PACKET_LL_SAFE_PREFETCH(batch->first(),p)
+
 /**
  * Execute a function on each packets of a batch. The function may return
  * another packet to replace the current one. This version cannot drop !
@@ -141,6 +173,19 @@ CLICK_DECLS
                 }\
             }\
 
+/**
+ * Same as EXECUTE_FOR_EACH_PACKET_DROPPABLE, but prefetch packets ahead of the
+ * current one as FOR_EACH_PACKET_PREFETCH does.
+ */
+#define EXECUTE_FOR_EACH_PACKET_DROPPABLE_PREFETCH(fnt,batch,on_drop) {\
+            Packet* efepdp_ahead = PacketBatch::prefetch_start(batch->first());\
+            auto efepdp_fnt = [&](Packet* efepdp_p) -> Packet* {\
+                efepdp_ahead = PacketBatch::prefetch_next(efepdp_ahead);\
+                return fnt(efepdp_p);\
+            };\
+            EXECUTE_FOR_EACH_PACKET_DROPPABLE(efepdp_fnt,batch,on_drop);\
+        }
+
 /**
  * Same as EXECUTE_FOR_EACH_PACKET_DROPPABLE but build a list of dropped packet
  * instead of calling a function
@@ -306,6 +351,19 @@ CLICK_DECLS
         }\
     }
 
+/**
+ * Equivalent to CLASSIFY_EACH_PACKET, but prefetch packets ahead of the
+ * current one as FOR_EACH_PACKET_PREFETCH does.
+ */
+#define CLASSIFY_EACH_PACKET_PREFETCH(nbatches,fnt,cep_batch,on_finish) {\
+        Packet* cepp_ahead = PacketBatch::prefetch_start(cep_batch->first());\
+        auto cepp_fnt = [&](Packet* cepp_p) -> int {\
+            cepp_ahead = PacketBatch::prefetch_next(cepp_ahead);\
+            return fnt(cepp_p);\
+        };\
+        CLASSIFY_EACH_PACKET(nbatches,cepp_fnt,cep_batch,on_finish);\
+    }
+
 /**
  * Equivalent to CLASSIFY_EACH_PACKET but ignore the packet if fnt returns -1
  */
@@ -467,6 +525,50 @@ public :
         set_count(count() + 1);
     }
 
+    /**
+     * Number of packets ahead of the current one prefetched by the _PREFETCH
+     *  iteration macros, defaults to CLICK_PREFETCH_DISTANCE.
+     */
+    static unsigned prefetch_distance;
+
+    /**
+     * @brief Start a prefetching pipeline on a list of packets
+     *
+     * Prefetches the data of the prefetch_distance first packets, and the
+     *  metadata of the following one.
+     *
+     * @return The packet to pass to prefetch_next() afterwards
+     */
+    static inline Packet* prefetch_start(Packet* p) {
+        if (!prefetch_distance)
+            return 0;
+        for (unsigned i = 0; p && i < prefetch_distance; i++) {
+            p->prefetch_data();
+            p = p->next();
+            if (p)
+                p->prefetch();
+        }
+        return p;
+    }
+
+    /**
+     * @brief Advance a prefetching pipeline by one packet
+     *
+     * Prefetches the data of @a ahead, whose metadata was prefetched by the
+     *  previous step, and the metadata of the packet after it.
+     *
+     * @return The new packet ahead
+     */
+    static inline Packet* prefetch_next(Packet* ahead) {
+        if (!ahead)
+            return 0;
+        Packet* n = ahead->next();
+        if (n)
+            n->prefetch();
+        ahead->prefetch_data();
+        return n;
+    }
+
     /**
      * Return the number of packets in this batch
      */
@@ -0,0 +1,269 @@
+// -*- c-basic-offset: 4; related-file-name: "packetbatch.hh" -*-
+#ifndef CLICK_PACKETVECTOR_HH
+#define CLICK_PACKETVECTOR_HH
+#include <click/packetbatch.hh>
+CLICK_DECLS
+
+/**
+ * Maximal number of packets held by a PacketVector. Longer batches are
+ *  processed in multiple chunks.
+ */
+#ifndef PACKET_VECTOR_CAPACITY
+# define PACKET_VECTOR_CAPACITY 256
+#endif
+
+/**
+ * Array-backed batch of packets.
+ *
+ * A PacketBatch is a simply linked list, so walking it is a chain of
+ *  dependent loads on Packet::next(). A PacketVector keeps the pointers to
+ *  the packets of a batch in a fixed-size array, so the n-th packet is known
+ *  without touching the previous ones. This allows to prefetch packets ahead
+ *  of time and to hand contiguous slices of packets to vectorized kernels.
+ *
+ * The graph still exchanges PacketBatch. Elements that want to work on
+ *  vectors convert at their boundaries with load() and to_batch(), or extend
+ *  SimpleVectorElement that does it for them.
+ *
+ * The next and prev pointers of packets held in the vector are meaningless
+ *  until to_batch() relinks them. Iterate with for (Packet* p : vector).
+ */
+class PacketVector { public:
+
+    PacketVector() : _count(0) {
+    }
+
+    /**
+     * Return the number of packets in this vector
+     */
+    inline unsigned count() const {
+        return _count;
+    }
+
+    static inline unsigned capacity() {
+        return PACKET_VECTOR_CAPACITY;
+    }
+
+    inline bool empty() const {
+        return _count == 0;
+    }
+
+    inline bool full() const {
+        return _count == PACKET_VECTOR_CAPACITY;
+    }
+
+    inline Packet*& operator[](unsigned i) {
+        assert(i < _count);
+        return _p[i];
+    }
+
+    inline Packet* operator[](unsigned i) const {
+        assert(i < _count);
+        return _p[i];
+    }
+
+    inline Packet** data() {
+        return _p;
+    }
+
+    inline Packet** begin() {
+        return _p;
+    }
+
+    inline Packet** end() {
+        return _p + _count;
+    }
+
+    /**
+     * Append a packet. The vector must not be full.
+     */
+    inline void push_back(Packet* p) {
+        assert(_count < PACKET_VECTOR_CAPACITY);
+        _p[_count++] = p;
+    }
+
+    /**
+     * Forget all packets, without killing them.
+     */
+    inline void clear() {
+        _count = 0;
+    }
+
+    /**
+     * Shrink the vector to its @a n first packets, the others are forgotten.
+     */
+    inline void resize(unsigned n) {
+        assert(n <= _count);
+        _count = n;
+    }
+
+    /**
+     * @brief Move packets of a batch into this vector
+     *
+     * @param batch A batch of packets, may be null
+     * @return The remaining of the batch that did not fit in the vector, or
+     *  null if all packets were loaded
+     */
+    inline PacketBatch* load(PacketBatch* batch);
+
+    /**
+     * @brief Relink all packets into a PacketBatch, in order.
+     *
+     * The vector is empty afterwards.
+     * @return The batch, or null if the vector was empty
+     */
+    inline PacketBatch* to_batch();
+
+    /**
+     * @brief Cut the vector in two
+     *
+     * @param n Number of packets to keep in this vector
+     * @param second Vector where packets after the @a n first are appended
+     */
+    inline void split(unsigned n, PacketVector& second);
+
+    /**
+     * @brief Compact the vector according to a function
+     *
+     * @param fnt Function called on each packet, returning the packet to
+     *  keep at this place (may be another one), or null to remove it
+     * @param on_drop Function called on each packet for which fnt returned
+     *  null
+     *
+     * Order of remaining packets is preserved.
+     */
+    template <typename F, typename D>
+    inline void filter(F fnt, D on_drop);
+
+    /**
+     * @brief Split the vector in batches according to an output index
+     *
+     * Equivalent of CLASSIFY_EACH_PACKET. The vector is empty afterwards.
+     *
+     * @param nbatches Number of output batches
+     * @param fnt Function returning the output index of a packet. Values out
+     *  of [0, nbatches) select the last batch.
+     * @param on_finish Function called with each output index and its
+     *  non-empty batch, usually checked_output_push_batch
+     */
+    template <typename F, typename Fin>
+    inline void classify(unsigned nbatches, F fnt, Fin on_finish);
+
+    /**
+     * Kill all packets of the vector
+     */
+    inline void kill() {
+        for (unsigned i = 0; i < _count; i++)
+            _p[i]->kill();
+        _count = 0;
+    }
+
+    /**
+     * Kill all packets of the vector using the batch recycling path
+     */
+    inline void fast_kill() {
+        if (PacketBatch* b = to_batch())
+            b->fast_kill();
+    }
+
+  private:
+
+    unsigned _count;
+    Packet* _p[PACKET_VECTOR_CAPACITY];
+
+};
+
+inline PacketBatch*
+PacketVector::load(PacketBatch* batch)
+{
+    if (!batch)
+        return 0;
+    unsigned total = batch->count();
+    unsigned room = PACKET_VECTOR_CAPACITY - _count;
+    unsigned n = total < room ? total : room;
+    Packet* p = batch->first();
+    for (unsigned i = 0; i < n; i++) {
+        _p[_count++] = p;
+        p = p->next();
+    }
+    if (n == total)
+        return 0;
+    PacketBatch* remain = PacketBatch::start_head(p);
+    remain->set_tail(batch->tail());
+    remain->set_count(total - n);
+    return remain;
+}
+
+inline PacketBatch*
+PacketVector::to_batch()
+{
+    if (_count == 0)
+        return 0;
+    PacketBatch* batch = PacketBatch::start_head(_p[0]);
+    for (unsigned i = 1; i < _count; i++)
+        _p[i - 1]->set_next(_p[i]);
+    batch->make_tail(_p[_count - 1], _count);
+    _count = 0;
+    return batch;
+}
+
+inline void
+PacketVector::split(unsigned n, PacketVector& second)
+{
+    if (n >= _count)
+        return;
+    for (unsigned i = n; i < _count; i++)
+        second.push_back(_p[i]);
+    _count = n;
+}
+
+template <typename F, typename D>
+inline void
+PacketVector::filter(F fnt, D on_drop)
+{
+    unsigned j = 0;
+    for (unsigned i = 0; i < _count; i++) {
+        Packet* p = _p[i];
+        Packet* q = fnt(p);
+        if (unlikely(q == 0)) {
+            on_drop(p);
+            continue;
+        }
+        _p[j++] = q;
+    }
+    _count = j;
+}
+
+template <typename F, typename Fin>
+inline void
+PacketVector::classify(unsigned nbatches, F fnt, Fin on_finish)
+{
+    PacketBatch* out[nbatches];
+    Packet* tails[nbatches];
+    unsigned counts[nbatches];
+    bzero(out, sizeof(PacketBatch*) * nbatches);
+    for (unsigned i = 0; i < _count; i++) {
+        Packet* p = _p[i];
+        int o = fnt(p);
+        if (o < 0 || o >= (int)nbatches)
+            o = nbatches - 1;
+        if (out[o]) {
+            tails[o]->set_next(p);
+            counts[o]++;
+        } else {
+            out[o] = PacketBatch::start_head(p);
+            counts[o] = 1;
+        }
+        tails[o] = p;
+    }
+    _count = 0;
+    for (unsigned o = 0; o < nbatches; o++) {
+        if (out[o]) {
+            out[o]->make_tail(tails[o], counts[o]);
+            on_finish(o, out[o]);
+        }
+    }
+}
+
+CLICK_ENDDECLS
+#endif
@@ -4,8 +4,8 @@
 
 #include <click/atomic.hh>
 #include <click/sync.hh>
+#include <click/algorithm.hh>
 #if HAVE_DPDK
-# include <click/algorithm.hh>
 # include <rte_ring.h>
 # include <rte_errno.h>
 # include <click/dpdk_glue.hh>
@@ -131,6 +131,32 @@ public:
             return false;
     }
 
+    /**
+     * Extract the oldest element into @a v, for element types that cannot
+     *  be compared to 0. Returns false if the ring is empty.
+     */
+    inline bool extract(T &v) {
+        if (is_empty())
+            return false;
+        v = ring[tail];
+        click_compiler_fence();
+        inc_i(tail);
+        return true;
+    }
+
+    /**
+     * Insert a copy of @a v, for element types that are not pointers.
+     *  Returns false if the ring is full.
+     */
+    inline bool insert_ref(const T &v) {
+        if (is_full())
+            return false;
+        ring[head] = v;
+        click_compiler_fence();
+        inc_i(head);
+        return true;
+    }
+
     inline unsigned int count() {
         int count = (int)head - (int)tail;
         if (count < 0)
@@ -163,6 +189,216 @@ public:
 template <typename T>
 using DynamicRing = SPSCDynamicRing<T>;
 
+/**
+ * Lock-free bounded multi-producer multi-consumer ring
+ *
+ * Same algorithm than DPDK's rte_ring : producers and consumers each have a
+ *  head and a tail index. A producer reserves n slots by moving the producer
+ *  head with a compare-and-swap, copies its objects and then publishes them
+ *  by moving the producer tail, once the producers that reserved slots
+ *  before it published theirs. Consumers do the same on the consumer side.
+ *  Reserving n slots costs a single compare-and-swap, so the bulk and burst
+ *  functions should be preferred to move batches of objects.
+ *
+ * Bulk functions move exactly n objects or nothing, burst functions move as
+ *  many objects as possible, up to n.
+ *
+ * The storage is given by subclasses, see LockFreeMPMCDynamicRing and
+ *  LockFreeMPMCRing.
+ */
+template <typename T> class LockFreeMPMCBaseRing {
+  protected:
+
+    struct headtail {
+        volatile uint32_t head;
+        volatile uint32_t tail;
+    } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    headtail _prod;
+    headtail _cons;
+    uint32_t _mask;
+    T* _ring;
+
+    LockFreeMPMCBaseRing() : _mask(0), _ring(0) {
+        _prod.head = _prod.tail = 0;
+        _cons.head = _cons.tail = 0;
+    }
+
+    static inline bool cas(volatile uint32_t &x, uint32_t expected, uint32_t desired) {
+#if ! CLICK_ATOMIC_COMPARE_SWAP
+        return atomic_uint32_t::compare_and_swap(x, expected, desired);
+#else
+        return atomic_uint32_t::compare_swap(x, expected, desired) == expected;
+#endif
+    }
+
+    /**
+     * Wait for the previous reservations of the same side to be released,
+     *  then release ours.
+     */
+    static inline void update_tail(headtail &ht, uint32_t old, uint32_t next) {
+        while (unlikely(ht.tail != old))
+            click_relax_fence();
+        ht.tail = next;
+    }
+
+    inline unsigned do_insert(const T* obj, unsigned n, bool fixed) {
+        uint32_t head, next;
+        do {
+            head = _prod.head;
+            click_read_fence();
+            uint32_t free = _mask + 1 + _cons.tail - head;
+            if (unlikely(n > free)) {
+                if (fixed || free == 0)
+                    return 0;
+                n = free;
+            }
+            next = head + n;
+        } while (unlikely(!cas(_prod.head, head, next)));
+
+        for (unsigned i = 0; i < n; i++)
+            _ring[(head + i) & _mask] = obj[i];
+        click_write_fence();
+        update_tail(_prod, head, next);
+        return n;
+    }
+
+    inline unsigned do_extract(T* obj, unsigned n, bool fixed) {
+        uint32_t head, next;
+        do {
+            head = _cons.head;
+            click_read_fence();
+            uint32_t entries = _prod.tail - head;
+            if (unlikely(n > entries)) {
+                if (fixed || entries == 0)
+                    return 0;
+                n = entries;
+            }
+            next = head + n;
+        } while (unlikely(!cas(_cons.head, head, next)));
+
+        for (unsigned i = 0; i < n; i++)
+            obj[i] = _ring[(head + i) & _mask];
+        click_read_fence();
+        update_tail(_cons, head, next);
+        return n;
+    }
+
+  public:
+
+    inline bool insert(T v) {
+        return do_insert(&v, 1, true) == 1;
+    }
+
+    inline bool insert_ref(const T &v) {
+        return do_insert(&v, 1, true) == 1;
+    }
+
+    inline T extract() {
+        T v;
+        if (do_extract(&v, 1, true) == 0)
+            return 0;
+        return v;
+    }
+
+    inline bool extract(T &v) {
+        return do_extract(&v, 1, true) == 1;
+    }
+
+    /**
+     * Insert the @a n objects of @a obj, or none if there is not enough space.
+     * @return n, or 0 on failure
+     */
+    inline unsigned insert_bulk(const T* obj, unsigned n) {
+        return do_insert(obj, n, true);
+    }
+
+    /**
+     * Insert up to @a n objects of @a obj.
+     * @return the number of objects inserted
+     */
+    inline unsigned insert_burst(const T* obj, unsigned n) {
+        return do_insert(obj, n, false);
+    }
+
+    /**
+     * Extract exactly @a n objects into @a obj, or none if the ring holds
+     *  less than @a n objects.
+     * @return n, or 0 on failure
+     */
+    inline unsigned extract_bulk(T* obj, unsigned n) {
+        return do_extract(obj, n, true);
+    }
+
+    /**
+     * Extract up to @a n objects into @a obj.
+     * @return the number of objects extracted
+     */
+    inline unsigned extract_burst(T* obj, unsigned n) {
+        return do_extract(obj, n, false);
+    }
+
+    /**
+     * Number of objects in the ring. Only a snapshot if other threads
+     *  access the ring.
+     */
+    inline unsigned int count() const {
+        uint32_t c = _prod.tail - _cons.tail;
+        return c > _mask + 1 ? _mask + 1 : c;
+    }
+
+    inline unsigned int capacity() const {
+        return _mask + 1;
+    }
+
+    inline bool is_empty() const {
+        return _prod.tail == _cons.tail;
+    }
+
+    inline bool is_full() const {
+        return count() == capacity();
+    }
+};
+
+/**
+ * Lock-free MPMC ring with size set at initialization time
+ *
+ * The size is rounded up to the next power of 2.
+ */
+template <typename T> class LockFreeMPMCDynamicRing : public LockFreeMPMCBaseRing<T> {
+  public:
+    LockFreeMPMCDynamicRing() {
+    }
+
+    ~LockFreeMPMCDynamicRing() {
+        delete[] this->_ring;
+    }
+
+    inline bool initialized() const {
+        return this->_ring != 0;
+    }
+
+    inline void initialize(int size, const char* = 0) {
+        assert(!this->_ring && size > 0);
+        uint32_t n = next_pow2(size);
+        this->_ring = new T[n];
+        this->_mask = n - 1;
+    }
+};
+
+/**
+ * Lock-free MPMC ring of fixed size, RING_SIZE must be a power of 2
+ */
+template <typename T, size_t RING_SIZE> class LockFreeMPMCRing : public LockFreeMPMCBaseRing<T> {
+    static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "RING_SIZE must be a power of 2");
+    T _storage[RING_SIZE];
+  public:
+    LockFreeMPMCRing() {
+        this->_ring = _storage;
+        this->_mask = RING_SIZE - 1;
+    }
+};
+
 #if HAVE_DPDK
 /**
  * Ring with size set at initialization time
@@ -201,6 +437,43 @@ template <typename T> class MPMCDynamicRing {
             return o;
     }
 
+#if RTE_VERSION >= RTE_VERSION_NUM(17,5,0,0)
+    inline unsigned insert_bulk(T* obj, unsigned n) {
+        return rte_ring_mp_enqueue_bulk(_ring, (void**)obj, n, 0);
+    }
+
+    inline unsigned insert_burst(T* obj, unsigned n) {
+        return rte_ring_mp_enqueue_burst(_ring, (void**)obj, n, 0);
+    }
+
+    inline unsigned extract_bulk(T* obj, unsigned n) {
+        return rte_ring_mc_dequeue_bulk(_ring, (void**)obj, n, 0);
+    }
+
+    inline unsigned extract_burst(T* obj, unsigned n) {
+        return rte_ring_mc_dequeue_burst(_ring, (void**)obj, n, 0);
+    }
+#else
+    inline unsigned insert_bulk(T* obj, unsigned n) {
+        return rte_ring_mp_enqueue_bulk(_ring, (void**)obj, n) == 0 ? n : 0;
+    }
+
+    inline unsigned insert_burst(T* obj, unsigned n) {
+        return rte_ring_mp_enqueue_burst(_ring, (void**)obj, n);
+    }
+
+    inline unsigned extract_bulk(T* obj, unsigned n) {
+        return rte_ring_mc_dequeue_bulk(_ring, (void**)obj, n) == 0 ? n : 0;
+    }
+
+    inline unsigned extract_burst(T* obj, unsigned n) {
+        return rte_ring_mc_dequeue_burst(_ring, (void**)obj, n);
+    }
+#endif
+
+    inline unsigned int count() {
+        return rte_ring_count(_ring);
+    }
 
     inline bool is_empty() {
         return rte_ring_empty(_ring);
@@ -240,32 +513,9 @@ template <typename T> class MPSCDynamicRing : public MPMCDynamicRing<T> {
 /**
  * Ring with size set at initialization time
  *
- * Not optimized
+ * Without DPDK, this is the lock-free ring above.
  */
-template <typename T> class MPMCDynamicRing : public SPSCDynamicRing<T> {
-	Spinlock _lock;
-
-public:
-
-	MPMCDynamicRing() : _lock() {
-
-	}
-
-    inline T extract() {
-        _lock.acquire();
-        T v= SPSCDynamicRing<T> :: extract();
-        _lock.release();
-        return v;
-    }
-
-    inline bool insert(T v) {
-	_lock.acquire();
-	bool r = SPSCDynamicRing<T> :: insert(v);
-	_lock.release();
-	return r;
-    }
-
-};
+template <typename T> class MPMCDynamicRing : public LockFreeMPMCDynamicRing<T> {};
 template <typename T> class MPSCDynamicRing : public MPMCDynamicRing<T> {};
 
 #endif
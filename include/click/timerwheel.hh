@@ -2,19 +2,45 @@
 #define CLICK_TIMERWHEEL_HH 1
 
 #include <click/algorithm.hh>
+#include <click/vector.hh>
+#include <click/sync.hh>
+#include <functional>
 
 CLICK_DECLS
 
-template <typename T>
+/**
+ * Hierarchical timer wheel of intrusive objects.
+ *
+ * Time is counted in epochs, advanced by run_timers(). Level 0 has one
+ * bucket per epoch, level l has one bucket per 2^(BITS*l) epochs. An object
+ * is put in the lowest level that can hold its expiration.
+ *
+ * Buckets of upper levels are not cascaded one object at a time. When the
+ * bucket of an upper level becomes due, its objects are given to the
+ * expire function of run_timers(), as objects of level 0. The expire
+ * function checks if the object is really expired, and if not, schedules
+ * it again for the remaining time, which lands in a lower level. This lazy
+ * re-bucketing lets the caller decide with up-to-date state (eg last seen
+ * time, per-object timeout), and the maintenance cost scales with the
+ * number of expiring objects instead of the number of live ones.
+ *
+ * The expire function may therefore see objects before their timeout, but
+ * never after.
+ */
+template <typename T, int BITS = 8>
 class TimerWheel {
     public:
-        TimerWheel() : _index(0) {
+        TimerWheel() : _index(0), _levels(0) {
         }
 
+        /**
+         * Initialize the wheel for timeouts up to @a max epochs.
+         */
         void initialize(int max) {
-            max = next_pow2(max + 2);
-            _mask = max - 1;
-            _buckets.resize(max, 0);
+            _levels = 1;
+            while (_levels < 32 / BITS && ((uint64_t)max + 2) >> (BITS * _levels))
+                _levels++;
+            _buckets.resize(_levels << BITS, 0);
         }
 
         /**
@@ -23,8 +49,7 @@ class TimerWheel {
          */
         inline void schedule_after(T* obj, uint32_t timeout, const std::function<void(T*,T*)> setter) {
             assert(timeout > 0); //Likely a bug
-            assert(timeout < _mask);
-            unsigned id = ((*(volatile uint32_t*)&_index) + timeout) & _mask;
+            unsigned id = bucket((*(volatile uint32_t*)&_index), timeout);
 
             //click_chatter("Enqueue %p at %d", obj, id);
             T* f = _buckets.unchecked_at(id);
@@ -35,7 +60,7 @@ class TimerWheel {
 
         inline void schedule_after_mp(T* obj, uint32_t timeout, const std::function<void(T*,T*)> setter) {
             _writers_lock.acquire();
-            unsigned id = ((*(volatile uint32_t*)&_index) + timeout) & _mask;
+            unsigned id = bucket((*(volatile uint32_t*)&_index), timeout);
 
             //click_chatter("Enqueuemp %p at %d", obj, id);
             T* f = _buckets.unchecked_at(id);
@@ -46,22 +71,85 @@ class TimerWheel {
         }
 
         /**
+         * Schedule @a obj in @a timeout epochs, letting @a link insert it
+         * in front of the bucket list whose head is given. Unlike
+         * schedule_after(), this lets objects keep a pointer to the
+         * previous link, so they can be unlinked before they expire.
+         * @pre timeout > 0 and <= max given epochs at initialization
+         */
+        inline void schedule_after_head(T* obj, uint32_t timeout, const std::function<void(T*,T**)> link) {
+            assert(timeout > 0);
+            unsigned id = bucket(_index, timeout);
+            link(obj, &_buckets.unchecked_at(id));
+        }
+
+        /**
+         * Index of the next epoch to be run.
+         */
+        inline uint32_t index() const {
+            return _index;
+        }
+
+        /**
+         * Advance by one epoch, calling @a expire on each object of the
+         * buckets that are due. @a expire returns the next object of the
+         * list, and may schedule the given one again.
+         *
          * Must be called by one thread only!
          */
         inline void run_timers(std::function<T*(T*)> expire) {
-            T* f = _buckets.unchecked_at((_index) & _mask);
-            //click_chatter("Expire %d -> %d (_mask %d)", _index, _index & _mask, _mask);
-            while (f != 0) {
-                f = expire(f);
+            uint32_t now = _index;
+            //Upper levels first, so re-bucketed objects due now are not missed
+            for (int l = _levels - 1; l > 0; l--) {
+                unsigned shift = BITS * l;
+                if ((now & ((1U << shift) - 1)) == 0)
+                    run_bucket((l << BITS) | ((now >> shift) & mask), expire);
             }
-            _buckets.unchecked_at((_index) & _mask) = 0;
+            //click_chatter("Expire %d -> %d", _index, _index & mask);
+            run_bucket(now & mask, expire);
             _index++;
         }
 
+        /**
+         * Empty all the buckets, calling @a expire on each object. Objects
+         * scheduled again by @a expire are kept.
+         */
+        void drain(std::function<T*(T*)> expire) {
+            Vector<T*> heads = _buckets;
+            for (int i = 0; i < _buckets.size(); i++)
+                _buckets[i] = 0;
+            for (int i = 0; i < heads.size(); i++) {
+                T* f = heads[i];
+                while (f != 0)
+                    f = expire(f);
+            }
+        }
+
+        /**
+         * Return the first object for which @a pred is true, scanning
+         * buckets by due time, or null. Objects of a bucket are not sorted.
+         * If @a limit is not negative, give up after looking at @a limit
+         * objects.
+         */
+        T* find(std::function<bool(T*)> pred, std::function<T*(T*)> next, int limit = -1) const {
+            for (int l = 0; l < _levels; l++) {
+                unsigned start = (_index >> (BITS * l)) & mask;
+                for (unsigned i = 0; i <= mask; i++) {
+                    T* a = _buckets.unchecked_at((l << BITS) | ((start + i) & mask));
+                    for (; a; a = next(a)) {
+                        if (pred(a))
+                            return a;
+                        if (limit >= 0 && --limit < 0)
+                            return 0;
+                    }
+                }
+            }
+            return 0;
+        }
+
         bool debug_find(T*obj, std::function<T*(T*)> next ) {
-            int id = _index;
-            for (int i =0; i <= _mask; i++) {
-                T* a = _buckets[(id + i) & _mask];
+            for (int i = 0; i < _buckets.size(); i++) {
+                T* a = _buckets[i];
                 while(a) {
                 if (a == obj)
                     return true;
@@ -72,8 +160,32 @@ class TimerWheel {
         }
 
     private:
-        uint32_t _mask;
+        enum { mask = (1 << BITS) - 1 };
+
+        /**
+         * Return the bucket of an object expiring @a timeout epochs after
+         * @a now: the lowest level where the expiration is less than a full
+         * turn ahead.
+         */
+        inline unsigned bucket(uint32_t now, uint32_t timeout) const {
+            uint32_t e = now + timeout;
+            int l = 0;
+            while (l < _levels - 1 && ((e >> (BITS * l)) - (now >> (BITS * l))) > mask)
+                l++;
+            assert(((e >> (BITS * l)) - (now >> (BITS * l))) <= mask);
+            return (l << BITS) | ((e >> (BITS * l)) & mask);
+        }
+
+        inline void run_bucket(unsigned id, std::function<T*(T*)> &expire) {
+            T* f = _buckets.unchecked_at(id);
+            _buckets.unchecked_at(id) = 0;
+            while (f != 0) {
+                f = expire(f);
+            }
+        }
+
         uint32_t _index;
+        int _levels;
         Vector<T*> _buckets;
         Spinlock _writers_lock;
 };
@@ -141,6 +141,17 @@ uint16_t click_in_cksum_pseudohdr_raw(uint32_t csum, uint32_t src, uint32_t dst,
 # define click_in_cksum_pseudohdr_raw(csum, src, dst, proto, transport_len) \
 		csum_tcpudp_magic((src), (dst), (transport_len), (proto), ~(csum) & 0xFFFF)
 #endif
+/** @brief Calculate the Internet checksums of several data ranges.
+ * @param x data to checksum, one pointer per range
+ * @param len number of bytes of each range
+ * @param[out] csum checksum of each range
+ * @param n number of ranges
+ *
+ * Equivalent to calling click_in_cksum() on each range. */
+void click_in_cksum_batch(const unsigned char * const *x, const int *len, uint16_t *csum, int n);
+/** @brief Return the name of the checksum implementation in use, such as
+ * "avx2" or "generic". */
+const char *click_in_cksum_impl(void);
 uint16_t click_in_cksum_pseudohdr_hard(uint32_t csum, const struct click_ip *iph, int packet_len);
 void click_update_zero_in_cksum_hard(uint16_t *csum, const unsigned char *addr, int len);
 
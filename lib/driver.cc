@@ -458,6 +458,9 @@ click_static_initialize()
 
     Router::add_read_handler(0, "classes", read_handler, (void *)GH_CLASSES);
     Router::add_read_handler(0, "packages", read_handler, (void *)GH_PACKAGES);
+#if HAVE_CLICK_PACKET_POOL
+    Packet::static_initialize();
+#endif
 
 #ifdef HAVE_RAND_ALIGN
     char * env = getenv("CLICK_ELEM_RAND_SEED");
@@ -0,0 +1,181 @@
+// -*- related-file-name: "../include/click/hugepagearena.hh" -*-
+/*
+ * hugepagearena.cc -- huge page backed packet buffers and tables
+ */
+
+#include <click/config.h>
+#include <click/hugepagearena.hh>
+#include <click/error.hh>
+#if HAVE_HUGEPAGE_ARENA
+# include <sys/mman.h>
+# include <errno.h>
+# include <string.h>
+#endif
+CLICK_DECLS
+
+#define CLICK_HUGEPAGE_DEFAULT_SIZE (2UL * 1024 * 1024)
+
+unsigned char *HugepageArena::_base = 0;
+unsigned char *HugepageArena::_end = 0;
+size_t HugepageArena::_page_size = CLICK_HUGEPAGE_DEFAULT_SIZE;
+bool HugepageArena::_huge = false;
+atomic_uint32_t HugepageArena::_next;
+uint32_t HugepageArena::_nbuffers = 0;
+HugepageArena::link *HugepageArena::_free = 0;
+SimpleSpinlock HugepageArena::_lock;
+__thread HugepageArena::thread_cache HugepageArena::_cache;
+
+static inline size_t
+round_up(size_t size, size_t page_size)
+{
+    return (size + page_size - 1) & ~(page_size - 1);
+}
+
+#if HAVE_HUGEPAGE_ARENA
+# ifndef MAP_HUGE_SHIFT
+#  define MAP_HUGE_SHIFT 26
+# endif
+
+/**
+ * Map @a size bytes, with huge pages of @a page_size if the system has some
+ * reserved. Otherwise fall back to normal pages and ask for transparent huge
+ * pages. @a huge tells which one was obtained.
+ */
+void *
+HugepageArena::map(size_t size, size_t page_size, bool &huge)
+{
+    void *p;
+# ifdef MAP_HUGETLB
+    int hflags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB
+        | (__builtin_ctzl(page_size) << MAP_HUGE_SHIFT);
+    p = mmap(0, size, PROT_READ | PROT_WRITE, hflags, -1, 0);
+    if (p != MAP_FAILED) {
+        huge = true;
+        return p;
+    }
+# endif
+    huge = false;
+    p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return 0;
+# if defined(MADV_HUGEPAGE) && HAVE_MADVISE
+    (void) madvise(p, size, MADV_HUGEPAGE);
+# endif
+    return p;
+}
+
+int
+HugepageArena::initialize(size_t size, size_t page_size, ErrorHandler *errh)
+{
+    if (_base)
+        return errh->error("huge page arena already initialized");
+    if (!page_size)
+        page_size = CLICK_HUGEPAGE_DEFAULT_SIZE;
+    if (page_size & (page_size - 1))
+        return errh->error("huge page size must be a power of 2");
+    size = round_up(size, page_size);
+    if (size / CLICK_HUGEPAGE_BUFFER_SIZE > 0xFFFFFFFFUL)
+        return errh->error("huge page arena too large");
+
+    bool huge;
+    void *p = map(size, page_size, huge);
+    if (!p)
+        return errh->error("could not map %lu bytes for the huge page arena: %s",
+                           (unsigned long) size, strerror(errno));
+    if (!huge)
+        errh->warning("no %luKB huge pages available, the packet arena relies on transparent huge pages",
+                      (unsigned long) (page_size >> 10));
+
+    _page_size = page_size;
+    _huge = huge;
+    _nbuffers = size / CLICK_HUGEPAGE_BUFFER_SIZE;
+    _next = 0;
+    _base = (unsigned char *) p;
+    _end = _base + size;
+    return 0;
+}
+
+/**
+ * Refill the thread cache, first from buffers given back by other threads,
+ * then from the never-used part of the arena. Return one buffer, or null if
+ * the arena is exhausted.
+ */
+unsigned char *
+HugepageArena::refill()
+{
+    thread_cache &c = _cache;
+    if (_free) {
+        _lock.acquire();
+        while (_free && c.count < cache_size / 2) {
+            link *l = _free;
+            _free = l->next;
+            c.buffers[c.count++] = reinterpret_cast<unsigned char *>(l);
+        }
+        _lock.release();
+        if (c.count)
+            return c.buffers[--c.count];
+    }
+
+    if (_next.value() >= _nbuffers)
+        return 0;
+    uint32_t first = _next.fetch_and_add(cache_size / 2);
+    if (first >= _nbuffers)
+        return 0;
+    uint32_t n = _nbuffers - first;
+    if (n > cache_size / 2)
+        n = cache_size / 2;
+    for (uint32_t i = 1; i < n; i++)
+        c.buffers[c.count++] = _base + (size_t) (first + i) * CLICK_HUGEPAGE_BUFFER_SIZE;
+    return _base + (size_t) first * CLICK_HUGEPAGE_BUFFER_SIZE;
+}
+
+/**
+ * Give half of the thread cache back to the global free list
+ */
+void
+HugepageArena::flush()
+{
+    thread_cache &c = _cache;
+    link *head = 0;
+    for (unsigned i = 0; i < cache_size / 2; i++) {
+        link *l = reinterpret_cast<link *>(c.buffers[--c.count]);
+        l->next = head;
+        head = l;
+    }
+    link *tail = head;
+    while (tail->next)
+        tail = tail->next;
+    _lock.acquire();
+    tail->next = _free;
+    _free = head;
+    _lock.release();
+}
+#endif
+
+void *
+HugepageArena::allocate(size_t size)
+{
+#if HAVE_HUGEPAGE_ARENA
+    if (enabled() && size >= _page_size / 2) {
+        bool huge;
+        return map(round_up(size, _page_size), _page_size, huge);
+    }
+#endif
+    return CLICK_ALIGNED_ALLOC(size);
+}
+
+void
+HugepageArena::deallocate(void *p, size_t size)
+{
+    if (!p)
+        return;
+#if HAVE_HUGEPAGE_ARENA
+    if (enabled() && size >= _page_size / 2) {
+        munmap(p, round_up(size, _page_size));
+        return;
+    }
+#endif
+    CLICK_ALIGNED_FREE(p, size);
+}
+
+CLICK_ENDDECLS
@@ -16,38 +16,162 @@
 # include <string.h>
 #endif
 
+#if !CLICK_LINUXMODULE && !CLICK_BSDMODULE && !CLICK_MINIOS \
+    && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define CLICK_IN_CKSUM_DISPATCH 1
+# include <immintrin.h>
+#endif
+
 #if !CLICK_LINUXMODULE
-uint16_t
-click_in_cksum(const unsigned char *addr, int len)
+/*
+ * The one's complement sum does not depend on the order in which words are
+ * added, nor on their size: summing 32-bit or 64-bit words and folding the
+ * carries back gives the same result as summing 16-bit words. The kernels
+ * below return an unfolded sum; in_cksum_fold() reduces it.
+ */
+static inline uint16_t
+in_cksum_fold(uint64_t sum)
 {
-    int nleft = len;
-    const uint16_t *w = (const uint16_t *)addr;
-    uint32_t sum = 0;
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return sum;
+}
+
+static uint64_t
+in_cksum_sum_generic(const unsigned char *addr, int len)
+{
+    uint64_t sum = 0;
+    uint32_t w;
     uint16_t answer = 0;
 
-    /*
-     * Our algorithm is simple, using a 32 bit accumulator (sum), we add
-     * sequential 16 bit words to it, and at the end, fold back all the
-     * carry bits from the top 16 bits into the lower 16 bits.
-     */
-    while (nleft > 1)  {
-	sum += *w++;
-	nleft -= 2;
+    while (len >= 16) {
+	uint32_t a, b, c, d;
+	memcpy(&a, addr, 4);
+	memcpy(&b, addr + 4, 4);
+	memcpy(&c, addr + 8, 4);
+	memcpy(&d, addr + 12, 4);
+	sum += (uint64_t) a + b + c + d;
+	addr += 16;
+	len -= 16;
+    }
+    while (len >= 4) {
+	memcpy(&w, addr, 4);
+	sum += w;
+	addr += 4;
+	len -= 4;
+    }
+    if (len >= 2) {
+	uint16_t h;
+	memcpy(&h, addr, 2);
+	sum += h;
+	addr += 2;
+	len -= 2;
     }
 
     /* mop up an odd byte, if necessary */
-    if (nleft == 1) {
-	*(unsigned char *)(&answer) = *(const unsigned char *)w ;
+    if (len == 1) {
+	*(unsigned char *)(&answer) = *addr;
 	sum += answer;
     }
+    return sum;
+}
 
-    /* add back carry outs from top 16 bits to low 16 bits */
-    sum = (sum & 0xffff) + (sum >> 16);
-    sum += (sum >> 16);
-    /* guaranteed now that the lower 16 bits of sum are correct */
+# if CLICK_IN_CKSUM_DISPATCH
+/*
+ * The AVX2 kernel widens 16-bit words to 32-bit lanes. Each block adds at
+ * most 2 * 0xFFFF to a lane, so lanes are spilled to the 64-bit sum every
+ * 32768 blocks, before they can overflow. There is no SSE kernel: the
+ * generic one, summing 32-bit words, is as fast.
+ */
+#  define IN_CKSUM_MAX_BLOCKS 32768
+
+__attribute__((target("avx2"))) static uint64_t
+in_cksum_sum_avx2(const unsigned char *addr, int len)
+{
+    uint64_t sum = 0;
+    const __m256i zero = _mm256_setzero_si256();
+    while (len >= 32) {
+	int blocks = len / 32;
+	if (blocks > IN_CKSUM_MAX_BLOCKS)
+	    blocks = IN_CKSUM_MAX_BLOCKS;
+	__m256i acc0 = zero, acc1 = zero;
+	for (int i = 0; i < blocks; i++) {
+	    __m256i v = _mm256_loadu_si256((const __m256i *) addr);
+	    acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(v, zero));
+	    acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(v, zero));
+	    addr += 32;
+	}
+	len -= blocks * 32;
+	uint32_t lanes[16];
+	_mm256_storeu_si256((__m256i *) lanes, acc0);
+	_mm256_storeu_si256((__m256i *) (lanes + 8), acc1);
+	for (int i = 0; i < 16; i++)
+	    sum += lanes[i];
+    }
+    return sum + in_cksum_sum_generic(addr, len);
+}
+# endif
+
+typedef uint64_t (*in_cksum_sum_t)(const unsigned char *, int);
+
+static in_cksum_sum_t in_cksum_sum_impl;
+static const char *in_cksum_impl_name;
+
+/* Choose the fastest kernel the CPU supports, once. Concurrent first calls
+ * choose the same kernel, so the race is harmless. */
+static in_cksum_sum_t
+in_cksum_resolve(void)
+{
+    in_cksum_sum_t f = in_cksum_sum_generic;
+    const char *name = "generic";
+# if CLICK_IN_CKSUM_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+	f = in_cksum_sum_avx2;
+	name = "avx2";
+    }
+# endif
+    in_cksum_impl_name = name;
+    in_cksum_sum_impl = f;
+    return f;
+}
+
+static inline in_cksum_sum_t
+in_cksum_sum(void)
+{
+    in_cksum_sum_t f = in_cksum_sum_impl;
+    return f ? f : in_cksum_resolve();
+}
+
+uint16_t
+click_in_cksum(const unsigned char *addr, int len)
+{
+    /* IP headers and other short ranges are not worth a SIMD kernel */
+    if (len < 64)
+	return ~in_cksum_fold(in_cksum_sum_generic(addr, len));
+    return ~in_cksum_fold(in_cksum_sum()(addr, len));
+}
+
+void
+click_in_cksum_batch(const unsigned char * const *addr, const int *len,
+		     uint16_t *csum, int n)
+{
+    in_cksum_sum_t f = in_cksum_sum();
+    for (int i = 0; i < n; i++) {
+	if (i + 1 < n)
+	    __builtin_prefetch(addr[i + 1]);
+	csum[i] = ~in_cksum_fold(f(addr[i], len[i]));
+    }
+}
 
-    answer = ~sum;              /* truncate to 16 bits */
-    return answer;
+const char *
+click_in_cksum_impl(void)
+{
+    in_cksum_sum();
+    return in_cksum_impl_name;
 }
 
 uint16_t
@@ -119,3 +243,20 @@ click_update_zero_in_cksum_hard(uint16_t *csum, const unsigned char *x, int len)
     // if we get here, all bytes were zero, so the checksum is ~0
     *csum = ~0;
 }
+
+#if CLICK_LINUXMODULE
+void
+click_in_cksum_batch(const unsigned char * const *addr, const int *len,
+		     uint16_t *csum, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+	csum[i] = click_in_cksum(addr[i], len[i]);
+}
+
+const char *
+click_in_cksum_impl(void)
+{
+    return "kernel";
+}
+#endif
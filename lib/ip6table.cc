@@ -1,6 +1,6 @@
 // -*- c-basic-offset: 2; related-file-name: "../include/click/ip6table.hh" -*-
 /*
- * ip6table.{cc,hh} -- a stupid IP6 routing table, best for small routing tables
+ * ip6table.{cc,hh} -- IP6 routing table using a multibit trie
  * Peilei Fan, Robert Morris
  *
  * Copyright (c) 1999-2000 Massachusetts Institute of Technology
@@ -21,72 +21,255 @@
 #include <click/straccum.hh>
 CLICK_DECLS
 
+// Number of lookups walked in lockstep by lookup_batch()
+#define IP6TABLE_LOOKUP_BURST 16
+
 IP6Table::IP6Table()
 {
+  clear();
 }
 
 IP6Table::~IP6Table()
 {
 }
 
+void
+IP6Table::clear()
+{
+  _v.clear();
+  _vfree.clear();
+  _routes.clear();
+  _nodes.resize(1);
+  memset(&_nodes[0], 0, sizeof(Node));
+  _nodes_free.clear();
+  _default = 0;
+}
+
+uint32_t
+IP6Table::alloc_node()
+{
+  uint32_t n;
+  if (_nodes_free.size()) {
+    n = _nodes_free.back();
+    _nodes_free.pop_back();
+  } else {
+    n = _nodes.size();
+    _nodes.resize(n + 1);
+  }
+  memset(&_nodes[n], 0, sizeof(Node));
+  return n;
+}
+
+bool
+IP6Table::node_empty(uint32_t node) const
+{
+  const Slot *slots = _nodes[node].slots;
+  for (int i = 0; i < NSLOTS; i++)
+    if (slots[i].info || slots[i].child)
+      return false;
+  return true;
+}
+
+int
+IP6Table::find(const IP6Address &prefix, int len) const
+{
+  HashTable<Pair<IP6Address, int>, int>::const_iterator it
+    = _routes.find(Pair<IP6Address, int>(prefix, len));
+  return it ? it.value() : -1;
+}
+
 bool
 IP6Table::lookup(const IP6Address &dst, IP6Address &gw, int &index) const
 {
-  int best = -1;
+  const unsigned char *a = dst.data();
+  uint32_t best = _default;
+  uint32_t node = 0;
 
-  for (int i = 0; i < _v.size(); i++)
-    if (_v[i]._valid && dst.matches_prefix(_v[i]._dst, _v[i]._mask)) {
-      if (best < 0 || _v[i]._mask.mask_as_specific(_v[best]._mask))
-        best = i;
-    }
+  for (int level = 0; level < NLEVELS; level++) {
+    const Slot &s = _nodes[node].slots[a[level]];
+    if (s.info)
+      best = s.info;
+    if (!s.child)
+      break;
+    node = s.child;
+  }
 
-  if (best < 0)
+  if (!best)
     return false;
-  else {
-    gw = _v[best]._gw;
-    index = _v[best]._index;
-    return true;
-  }
+  const Entry &e = _v[(best & ROUTE_MASK) - 1];
+  gw = e._gw;
+  index = e._index;
+  return true;
 }
 
+/*
+ * Look up @a n destinations, setting @a index to -1 for those without a
+ * route. Destinations go down the trie together, one level per round, and
+ * the node each one needs next is prefetched while the others are served.
+ */
 void
+IP6Table::lookup_batch(const IP6Address *dst, int n, IP6Address *gw, int *index) const
+{
+  uint32_t node[IP6TABLE_LOOKUP_BURST];
+  uint32_t best[IP6TABLE_LOOKUP_BURST];
+
+  for (int base = 0; base < n; base += IP6TABLE_LOOKUP_BURST) {
+    int m = n - base < IP6TABLE_LOOKUP_BURST ? n - base : IP6TABLE_LOOKUP_BURST;
+    const IP6Address *d = dst + base;
+    for (int i = 0; i < m; i++) {
+      node[i] = 0;
+      best[i] = _default;
+    }
+
+    // Nodes are never children of another, so a null node marks a finished walk
+    bool active = true;
+    for (int level = 0; level < NLEVELS && active; level++) {
+      active = false;
+      for (int i = 0; i < m; i++) {
+        if (level && !node[i])
+          continue;
+        const Slot &s = _nodes[node[i]].slots[d[i].data()[level]];
+        if (s.info)
+          best[i] = s.info;
+        node[i] = s.child;
+        if (s.child && level + 1 < NLEVELS) {
+          __builtin_prefetch(&_nodes[s.child].slots[d[i].data()[level + 1]]);
+          active = true;
+        }
+      }
+    }
+
+    for (int i = 0; i < m; i++) {
+      if (best[i]) {
+        const Entry &e = _v[(best[i] & ROUTE_MASK) - 1];
+        gw[base + i] = e._gw;
+        index[base + i] = e._index;
+      } else
+        index[base + i] = -1;
+    }
+  }
+}
+
+bool
 IP6Table::add(const IP6Address &dst, const IP6Address &mask,
 	      const IP6Address &gw, int index)
 {
-  struct Entry e;
+  int len = mask.mask_to_prefix_len();
+  if (len < 0)
+    return false;
+  IP6Address prefix = dst & mask;
 
-  e._dst = dst & mask;
+  // Replacing a route leaves the trie unchanged
+  int r = find(prefix, len);
+  if (r >= 0) {
+    _v[r]._gw = gw;
+    _v[r]._index = index;
+    return true;
+  }
+
+  if (_vfree.size()) {
+    r = _vfree.back();
+    _vfree.pop_back();
+  } else {
+    if (_v.size() >= ROUTE_MASK)
+      return false;
+    r = _v.size();
+    _v.push_back(Entry());
+  }
+  Entry &e = _v[r];
+  e._dst = prefix;
   e._mask = mask;
   e._gw = gw;
   e._index = index;
   e._valid = 1;
+  _routes.set(Pair<IP6Address, int>(prefix, len), r);
 
-  // Just in case, so we never encounter duplicate routes...
-  del(dst, mask);
+  uint32_t info = (r + 1) | ((uint32_t) len << DEPTH_SHIFT);
+  if (len == 0) {
+    _default = info;
+    return true;
+  }
 
-  for (int i = 0; i < _v.size(); i++)
-    if (!_v[i]._valid) {
-      _v[i] = e;
-      return;
+  // The route ends in the node of level k, where it covers a range of slots
+  const unsigned char *a = prefix.data();
+  int k = (len - 1) / STRIDE;
+  uint32_t node = 0;
+  for (int level = 0; level < k; level++) {
+    uint32_t child = _nodes[node].slots[a[level]].child;
+    if (!child) {
+      child = alloc_node();
+      _nodes[node].slots[a[level]].child = child;
     }
-  _v.push_back(e);
+    node = child;
+  }
+
+  Slot *slots = _nodes[node].slots;
+  int first = a[k];
+  int last = first + (1 << ((k + 1) * STRIDE - len));
+  for (int i = first; i < last; i++)
+    if ((slots[i].info >> DEPTH_SHIFT) <= (uint32_t) len)
+      slots[i].info = info;
+  return true;
 }
 
 void
 IP6Table::del(const IP6Address &dst, const IP6Address &mask)
 {
-  IP6Address dstnet = dst & mask;
+  int len = mask.mask_to_prefix_len();
+  if (len < 0)
+    return;
+  IP6Address prefix = dst & mask;
+  int r = find(prefix, len);
+  if (r < 0)
+    return;
+
+  _v[r]._valid = 0;
+  _vfree.push_back(r);
+  _routes.erase(Pair<IP6Address, int>(prefix, len));
 
-  for (int i = 0; i < _v.size(); i++)
-    if (_v[i]._valid && (_v[i]._dst == dstnet) && (_v[i]._mask == mask))
-      _v[i]._valid = 0;
+  if (len == 0) {
+    _default = 0;
+    return;
+  }
+
+  const unsigned char *a = prefix.data();
+  int k = (len - 1) / STRIDE;
+  uint32_t path[NLEVELS];
+  path[0] = 0;
+  for (int level = 0; level < k; level++)
+    if (!(path[level + 1] = _nodes[path[level]].slots[a[level]].child))
+      return;
+
+  // Slots of the route fall back to the longest shorter route covering it,
+  // if that one ends in the same node; shallower ones are found on the way
+  uint32_t replacement = 0;
+  for (int l = len - 1; l > k * STRIDE; l--) {
+    int p = find(prefix & IP6Address::make_prefix(l), l);
+    if (p >= 0) {
+      replacement = (p + 1) | ((uint32_t) l << DEPTH_SHIFT);
+      break;
+    }
+  }
+
+  Slot *slots = _nodes[path[k]].slots;
+  int first = a[k];
+  int last = first + (1 << ((k + 1) * STRIDE - len));
+  for (int i = first; i < last; i++)
+    if ((slots[i].info & ROUTE_MASK) == (uint32_t) r + 1)
+      slots[i].info = replacement;
+
+  // Give back the nodes left empty
+  for (int level = k; level > 0 && node_empty(path[level]); level--) {
+    _nodes_free.push_back(path[level]);
+    _nodes[path[level - 1]].slots[a[level - 1]].child = 0;
+  }
 }
 
 String
 IP6Table::dump()
 {
     StringAccum sa;
-    if (_v.size())
+    if (_routes.size())
         sa << "# Active routes\n";
     for (int i = 0; i < _v.size(); i++)
         if (_v[i]._valid) {
@@ -27,8 +27,14 @@
 #include <click/ring.hh>
 #include <click/vector.hh>
 #include <click/netmapdevice.hh>
+#include <click/straccum.hh>
+#if HAVE_CLICK_PACKET_POOL
+# include <click/router.hh>
+# include <click/error.hh>
+#endif
 #if CLICK_USERLEVEL || CLICK_MINIOS
 # include <unistd.h>
+# include <click/hugepagearena.hh>
 #endif
 #if HAVE_DPDK
 # include <rte_malloc.h>
@@ -38,6 +44,10 @@
 # include <rte_lcore.h>
 # include <rte_mempool.h>
 #endif
+#if HAVE_NUMA_PACKET_POOL
+# include <click/numa.hh>
+# include <sched.h>
+#endif
 CLICK_DECLS
 
 /** @file packet.hh
@@ -241,6 +251,11 @@ Packet::release_buffer(unsigned char* head) {
                 if (NetmapBufQ::is_valid_netmap_buffer(head))
                     NetmapBufQ::local_pool()->insert_p(head);
                 else
+# endif
+# if HAVE_HUGEPAGE_ARENA
+                if (HugepageArena::contains(head))
+                    HugepageArena::free_buffer(head);
+                else
 # endif
                 {
 #  if HAVE_DPDK
@@ -289,13 +304,16 @@ Packet::delete_buffer(unsigned char* head, unsigned char* end
 // important to do so quickly. This specialized packet allocator saves
 // pre-initialized Packet objects, either with or without data, for fast
 // reuse. It can support multithreaded deployments: each thread has its own
-// pool, with a global pool to even out imbalance.
+// pool, with a global pool to even out imbalance. With NUMA support, there
+// is one global pool per node, and data buffers freed by a thread of another
+// node are sent back to their home node by batches.
 
 #if HAVE_DPDK_PACKET_POOL
 #  define CLICK_PACKET_POOL_BUFSIZ		DPDKDevice::MBUF_DATA_SIZE
 #else
 #  define CLICK_PACKET_POOL_BUFSIZ		2048
 #endif
+// Default sizes, changed at runtime through Packet::pool_size and friends
 // see LIMIT in packetpool-01.clicktest
 #  define CLICK_PACKET_POOL_SIZE		4096 
 #  define CLICK_PACKET_DATA_POOL_SIZE		4096
@@ -305,29 +323,104 @@ Packet::delete_buffer(unsigned char* head, unsigned char* end
 #else 
 #  define CLICK_GLOBAL_PACKET_DATA_POOL_COUNT	32
 #endif
+// maximal number of batches in each ring of the global pool
+#  define CLICK_GLOBAL_PACKET_POOL_MAX		1024
+// data buffers freed on a remote NUMA node are sent home by lists of this size
+#  define CLICK_PACKET_POOL_REMOTE_BATCH		256
 
 
 #  if HAVE_MULTITHREAD
 static __thread PacketPool *thread_packet_pool;
 
 #if HAVE_VECTOR_PACKET_POOL
-typedef MPMCRing<WritablePacket**,CLICK_GLOBAL_PACKET_POOL_COUNT> BatchPRing;
-typedef MPMCRing<WritablePacket**,CLICK_GLOBAL_PACKET_DATA_POOL_COUNT> BatchPDRing;
+typedef LockFreeMPMCRing<WritablePacket**,CLICK_GLOBAL_PACKET_POOL_COUNT> BatchPRing;
+typedef LockFreeMPMCRing<WritablePacket**,CLICK_GLOBAL_PACKET_DATA_POOL_COUNT> BatchPDRing;
 #else
-typedef MPMCRing<WritablePacket*,CLICK_GLOBAL_PACKET_POOL_COUNT> BatchPRing;
-typedef MPMCRing<WritablePacket*,CLICK_GLOBAL_PACKET_DATA_POOL_COUNT> BatchPDRing;
+typedef LockFreeMPMCRing<WritablePacket*,CLICK_GLOBAL_PACKET_POOL_MAX> BatchPRing;
+typedef LockFreeMPMCRing<WritablePacket*,CLICK_GLOBAL_PACKET_POOL_MAX> BatchPDRing;
 #endif
 
-struct GlobalPacketPool {
+struct NodePacketPool {
     BatchPRing pbatch;     // batches of free packets, linked by p->prev()
                                 //   p->anno_u32(0) is # packets in batch
     BatchPDRing pdbatch;        // batches of packet with data buffers
+};
+
+#if HAVE_NUMA_PACKET_POOL
+#  define CLICK_PACKET_POOL_NODES	CLICK_PACKET_POOL_MAX_NUMA
+#else
+#  define CLICK_PACKET_POOL_NODES	1
+#endif
+
+struct GlobalPacketPool {
+    NodePacketPool nodes[CLICK_PACKET_POOL_NODES]; // one per NUMA node
 
     PacketPool* thread_pools;   // all thread packet pools
 
     volatile uint32_t lock;
+#if HAVE_NUMA_PACKET_POOL
+    int nnodes;                 // number of NUMA nodes in use
+#endif
+    atomic_uint64_t bytes;      // memory held by the batches of all rings
 };
 static GlobalPacketPool global_packet_pool;
+
+/** @brief Return the global pool of the NUMA node of a thread pool. */
+static CLICK_ALWAYS_INLINE inline
+NodePacketPool& global_node_pool(PacketPool& pp) {
+#if HAVE_NUMA_PACKET_POOL
+    return global_packet_pool.nodes[pp.node];
+#else
+    (void)pp;
+    return global_packet_pool.nodes[0];
+#endif
+}
+
+#  if !HAVE_VECTOR_PACKET_POOL
+#   define CLICK_PACKET_POOL_PACKET_BYTES	sizeof(WritablePacket)
+#   define CLICK_PACKET_POOL_DATA_BYTES	(sizeof(WritablePacket) + CLICK_PACKET_POOL_BUFSIZ)
+
+/**
+ * @brief Give a batch of @a count packets to a ring of the global pool
+ *
+ * @param limit Maximal number of batches in the ring
+ * @param unit Memory used by one packet of the batch
+ * @return false if the ring is full or the memory cap would be exceeded, the
+ *  caller must then free the batch
+ */
+static inline bool
+global_pool_insert(BatchPRing &ring, WritablePacket *head, unsigned count,
+                   unsigned limit, uint64_t unit)
+{
+    uint64_t size = count * unit;
+    if (ring.count() >= limit)
+        return false;
+    if (Packet::pool_memory_cap && global_packet_pool.bytes + size > Packet::pool_memory_cap)
+        return false;
+    head->set_anno_u32(0, count);
+    if (!ring.insert(head))
+        return false;
+    global_packet_pool.bytes += size;
+    return true;
+}
+
+/**
+ * @brief Take a batch from a ring of the global pool
+ */
+static inline WritablePacket *
+global_pool_extract(BatchPRing &ring, uint64_t unit)
+{
+    WritablePacket *p = ring.extract();
+    if (p)
+        global_packet_pool.bytes -= p->anno_u32(0) * unit;
+    return p;
+}
+#  endif
+
+#if HAVE_NUMA_PACKET_POOL
+/** @brief NUMA node of the thread, as known by alloc_data() */
+static __thread int thread_numa_node = -1;
+#endif
 #else
 static PacketPool global_packet_pool = {0,0,0,0};
 #  endif
@@ -358,10 +451,22 @@ void WritablePacket::initialize_local_packet_pool() {
     PacketPool *pp = thread_packet_pool;
     if (!pp) {
         pp = new PacketPool();
+#  if HAVE_NUMA_PACKET_POOL
+        int cpu = sched_getcpu();
+        int node = cpu < 0 ? 0 : Numa::get_numa_node_of_cpu(cpu);
+        if (node < 0 || node >= CLICK_PACKET_POOL_MAX_NUMA)
+            node = 0;
+        pp->node = node;
+        thread_numa_node = node;
+#  endif
         while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
             /* do nothing */;
         pp->thread_pool_next = global_packet_pool.thread_pools;
         global_packet_pool.thread_pools = pp;
+#  if HAVE_NUMA_PACKET_POOL
+        if (pp->node >= global_packet_pool.nnodes)
+            global_packet_pool.nnodes = pp->node + 1;
+#  endif
         thread_packet_pool = pp;
         click_compiler_fence();
         global_packet_pool.lock = 0;
@@ -394,6 +499,7 @@ WritablePacket::pool_batch_allocate(uint16_t count)
             } else {
                 packet_pool.p = static_cast<WritablePacket*>(p->next());
                 taken_from_pool++;
+                packet_pool.phits++;
             }
             if (head == 0) {
                 head = p;
@@ -419,8 +525,36 @@ CLICK_OPTNONE WritablePacket *
 WritablePacket::pool_prepare_data_burst(uint16_t count)
 {
         PacketPool& packet_pool = local_packet_pool();
-        while (unlikely(packet_pool.pdcount < count)) {
+        if (unlikely(packet_pool.pdcount < count)) {
             //TODO : check from global pool
+            packet_pool.misses += count - packet_pool.pdcount;
+            pool_fill_data(packet_pool, count);
+        }
+
+        return packet_pool.pd;
+}
+
+CLICK_ALWAYS_INLINE void
+WritablePacket::pool_consumed_data_burst(uint16_t n, WritablePacket* tail) {
+        PacketPool& packet_pool = local_packet_pool();
+        packet_pool.pdcount -= n;
+        packet_pool.pd = tail;
+        packet_pool.hits += n;
+        packet_pool.outstanding += n;
+}
+
+/**
+ * Allocate new packets with buffer until the local pool holds @a count of them
+ */
+void
+WritablePacket::pool_fill_data(PacketPool &packet_pool, unsigned count)
+{
+#if HAVE_VECTOR_PACKET_POOL
+        (void)packet_pool;
+        (void)count;
+        assert(false);
+#else
+        while (packet_pool.pdcount < count) {
             WritablePacket* p = new WritablePacket;
             p->alloc_data(0,CLICK_PACKET_POOL_BUFSIZ,0);
 #if HAVE_DPDK_PACKET_POOL
@@ -434,15 +568,20 @@ WritablePacket::pool_prepare_data_burst(uint16_t count)
             packet_pool.pd = p;
             packet_pool.pdcount++;
         }
-
-        return packet_pool.pd;
+#endif
 }
 
-CLICK_ALWAYS_INLINE void
-WritablePacket::pool_consumed_data_burst(uint16_t n, WritablePacket* tail) {
-        PacketPool& packet_pool = local_packet_pool();
-        packet_pool.pdcount -= n;
-        packet_pool.pd = tail;
+/**
+ * Fill the local pool with Packet::pool_prewarm_size packets with buffer, so
+ * the first packets do not hit the allocator.
+ */
+void
+WritablePacket::pool_prewarm()
+{
+    unsigned n = pool_prewarm_size;
+    if (n > data_pool_size)
+        n = data_pool_size;
+    pool_fill_data(local_packet_pool(), n);
 }
 
 inline WritablePacket *
@@ -454,10 +593,11 @@ WritablePacket::pool_allocate()
 #else
 #  if HAVE_MULTITHREAD
     if (!packet_pool.p) {
-        WritablePacket *pp = global_packet_pool.pbatch.extract();
+        WritablePacket *pp = global_pool_extract(global_node_pool(packet_pool).pbatch, CLICK_PACKET_POOL_PACKET_BYTES);
         if (pp) {
             packet_pool.p = pp;
             packet_pool.pcount = pp->anno_u32(0);
+            packet_pool.refills++;
         }
 
     }
@@ -467,8 +607,10 @@ WritablePacket::pool_allocate()
         if (p) {
             packet_pool.p = static_cast<WritablePacket*>(p->next());
             --packet_pool.pcount;
+            packet_pool.phits++;
         } else {
         p = new WritablePacket;
+            packet_pool.pmisses++;
         }
         return p;
 #endif
@@ -487,10 +629,11 @@ WritablePacket::pool_data_allocate()
 #else
 #  if HAVE_MULTITHREAD
     if (unlikely(!packet_pool.pd)) {
-        WritablePacket *pd = global_packet_pool.pdbatch.extract();
+        WritablePacket *pd = global_pool_extract(global_node_pool(packet_pool).pdbatch, CLICK_PACKET_POOL_DATA_BYTES);
         if (pd) {
             packet_pool.pd = pd;
             packet_pool.pdcount = pd->anno_u32(0);
+            packet_pool.refills++;
         }
 	}
 #  endif /* HAVE_MULTITHREAD */
@@ -499,10 +642,13 @@ WritablePacket::pool_data_allocate()
     if (pd) {
         packet_pool.pd = static_cast<WritablePacket*>(pd->next());
         --packet_pool.pdcount;
+        packet_pool.hits++;
     } else {
         pd = pool_allocate();
         pd->alloc_data(0,CLICK_PACKET_POOL_BUFSIZ,0);
+        packet_pool.misses++;
     }
+    packet_pool.outstanding++;
     return pd;
 #endif
 }
@@ -550,7 +696,7 @@ WritablePacket::check_packet_pool_size(PacketPool &packet_pool, unsigned n) {
     if (unlikely(packet_pool.p.count() + n >= CLICK_PACKET_POOL_SIZE)) {
         WritablePacket** ps = new WritablePacket*[CLICK_PACKET_POOL_SIZE / 2];
         memcpy(ps, packet_pool.p.extract_burst(CLICK_PACKET_POOL_SIZE / 2), sizeof(WritablePacket*) * CLICK_PACKET_POOL_SIZE / 2);
-        global_packet_pool.pbatch.insert(ps);
+        global_node_pool(packet_pool).pbatch.insert(ps);
     }
 }
 
@@ -562,16 +708,16 @@ WritablePacket::check_data_pool_size(PacketPool &packet_pool, unsigned n) {
     if (unlikely(packet_pool.pd.count() + n >= CLICK_PACKET_DATA_POOL_SIZE)) {
         WritablePacket** ps = new WritablePacket*[CLICK_PACKET_POOL_SIZE / 2];
         memcpy(ps, packet_pool.pd.extract_burst(CLICK_PACKET_POOL_SIZE / 2), sizeof(WritablePacket*) * CLICK_PACKET_POOL_SIZE / 2);
-        global_packet_pool.pdbatch.insert(ps);
+        global_node_pool(packet_pool).pdbatch.insert(ps);
     }
 }
 #else
 inline void
 WritablePacket::check_packet_pool_size(PacketPool &packet_pool, unsigned n) {
 #  if HAVE_MULTITHREAD
-    if (unlikely(packet_pool.p && packet_pool.pcount + n > CLICK_PACKET_POOL_SIZE)) {
-        packet_pool.p->set_anno_u32(0, packet_pool.pcount);
-        if (!global_packet_pool.pbatch.insert(packet_pool.p)) { //Si le nombre de batch est au max -> delete
+    if (unlikely(packet_pool.p && packet_pool.pcount + n > Packet::pool_size)) {
+        if (!global_pool_insert(global_node_pool(packet_pool).pbatch, packet_pool.p, packet_pool.pcount,
+                                Packet::global_pool_count, CLICK_PACKET_POOL_PACKET_BYTES)) { //Si le nombre de batch est au max -> delete
             while (WritablePacket *p = packet_pool.p) { //On supprime le batch
                 packet_pool.p = static_cast<WritablePacket *>(p->next());
                 ::operator delete((void *) p);
@@ -581,7 +727,7 @@ WritablePacket::check_packet_pool_size(PacketPool &packet_pool, unsigned n) {
         packet_pool.pcount = 0;
     }
 #  else /* !HAVE_MULTITHREAD */
-    if (packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
+    while (packet_pool.p && packet_pool.pcount + n > Packet::pool_size) {
         WritablePacket* tmp = (WritablePacket*)packet_pool.p->next();
         ::operator delete((void *) packet_pool.p);
         packet_pool.p = tmp;
@@ -590,28 +736,39 @@ WritablePacket::check_packet_pool_size(PacketPool &packet_pool, unsigned n) {
 #  endif /* HAVE_MULTITHREAD */
 }
 
+#  if HAVE_MULTITHREAD
+/**
+ * Free a list of packets with data buffers, linked by next()
+ */
+static void
+free_data_list(WritablePacket *pd)
+{
+    while (pd) {
+        WritablePacket *next = static_cast<WritablePacket *>(pd->next());
+        #if HAVE_DPDK_PACKET_POOL
+            rte_pktmbuf_free((struct rte_mbuf*)pd->destructor_argument());
+        #else
+            Packet::release_buffer(pd->buffer());
+        #endif
+        ::operator delete((void *) pd);
+        pd = next;
+    }
+}
+#  endif
+
 inline void
 WritablePacket::check_data_pool_size(PacketPool &packet_pool, unsigned n) {
 #  if HAVE_MULTITHREAD
-    if (unlikely(packet_pool.pd && packet_pool.pdcount + n > CLICK_PACKET_DATA_POOL_SIZE)) {
-        packet_pool.pd->set_anno_u32(0, packet_pool.pdcount);
-        if (!global_packet_pool.pdbatch.insert(packet_pool.pd)) {
-            while (WritablePacket *pd = packet_pool.pd) {
-                packet_pool.pd = static_cast<WritablePacket *>(pd->next());
-                #if HAVE_DPDK_PACKET_POOL
-                    rte_pktmbuf_free((struct rte_mbuf*)pd->destructor_argument());
-                #else
-                    Packet::release_buffer(pd->buffer());
-                #endif
-                ::operator delete((void *) pd);
-            }
-        }
+    if (unlikely(packet_pool.pd && packet_pool.pdcount + n > Packet::data_pool_size)) {
+        if (!global_pool_insert(global_node_pool(packet_pool).pdbatch, packet_pool.pd, packet_pool.pdcount,
+                                Packet::global_data_pool_count, CLICK_PACKET_POOL_DATA_BYTES))
+            free_data_list(packet_pool.pd);
         packet_pool.pd = 0;
         packet_pool.pdcount = 0;
     }
 
 #  else /* !HAVE_MULTITHREAD */
-    if (packet_pool.pdcount == CLICK_PACKET_DATA_POOL_SIZE) {
+    while (packet_pool.pd && packet_pool.pdcount + n > Packet::data_pool_size) {
         WritablePacket* tmp = (WritablePacket*)packet_pool.pd->next();
         ::operator delete((void *) packet_pool.pd);
         packet_pool.pd = tmp;
@@ -621,6 +778,48 @@ WritablePacket::check_data_pool_size(PacketPool &packet_pool, unsigned n) {
 }
 #endif
 
+#if HAVE_NUMA_PACKET_POOL
+/**
+ * @brief Return the NUMA node a pool data buffer was allocated on, or -1 if
+ * unknown
+ *
+ * Pool buffers have no destructor, so alloc_data() keeps the node in the
+ * destructor argument.
+ */
+inline int
+WritablePacket::buffer_node(const Packet *p) {
+    return (int)(intptr_t)p->_destructor_argument - 1;
+}
+
+/**
+ * @brief Send the buffers freed on this thread that belong to @a node back
+ * to the global pool of @a node
+ */
+void
+WritablePacket::flush_remote(PacketPool &packet_pool, int node) {
+    WritablePacket *pd = packet_pool.remote_pd[node];
+    if (!pd)
+        return;
+    if (!global_pool_insert(global_packet_pool.nodes[node].pdbatch, pd, packet_pool.remote_pdcount[node],
+                            Packet::global_data_pool_count, CLICK_PACKET_POOL_DATA_BYTES))
+        free_data_list(pd);
+    packet_pool.remote_pd[node] = 0;
+    packet_pool.remote_pdcount[node] = 0;
+}
+
+/**
+ * @brief Keep a buffer of another NUMA node aside, instead of putting it in
+ * the local pool
+ */
+inline void
+WritablePacket::recycle_remote(PacketPool &packet_pool, WritablePacket *p, int node) {
+    p->set_next(packet_pool.remote_pd[node]);
+    packet_pool.remote_pd[node] = p;
+    if (unlikely(++packet_pool.remote_pdcount[node] >= CLICK_PACKET_POOL_REMOTE_BATCH))
+        flush_remote(packet_pool, node);
+}
+#endif
+
 inline bool WritablePacket::is_from_data_pool(WritablePacket *p) {
 #if HAVE_DPDK_PACKET_POOL
 	return likely(
@@ -665,6 +864,14 @@ WritablePacket::recycle(WritablePacket *p)
     bool data = is_from_data_pool(p);
 
     if (likely(data)) {
+        packet_pool.outstanding--;
+#if HAVE_NUMA_PACKET_POOL
+        int node = buffer_node(p);
+        if (unlikely(node >= 0 && node != packet_pool.node)) {
+            recycle_remote(packet_pool, p, node);
+            return;
+        }
+#endif
         check_data_pool_size(packet_pool, 1);
 #if HAVE_VECTOR_PACKET_POOL
         packet_pool.pd.insert(p);
@@ -673,7 +880,7 @@ WritablePacket::recycle(WritablePacket *p)
         p->set_next(packet_pool.pd);
         packet_pool.pd = p;
 # if !HAVE_BATCH_RECYCLE
-        assert(packet_pool.pdcount <= CLICK_PACKET_DATA_POOL_SIZE);
+        assert(packet_pool.pdcount <= Packet::data_pool_size);
 # endif
 #endif
     } else {
@@ -686,7 +893,7 @@ WritablePacket::recycle(WritablePacket *p)
         p->set_next(packet_pool.p);
         packet_pool.p = p;
 # if !HAVE_BATCH_RECYCLE
-        assert(packet_pool.pcount <= CLICK_PACKET_POOL_SIZE);
+        assert(packet_pool.pcount <= Packet::pool_size);
 # endif
 #endif
     }
@@ -743,6 +950,36 @@ WritablePacket::recycle_data_batch(WritablePacket *head, Packet* tail, unsigned
 #if HAVE_VECTOR_PACKET_POOL
     assert(false);
 #else
+    packet_pool.outstanding -= count;
+# if HAVE_NUMA_PACKET_POOL
+    if (unlikely(global_packet_pool.nnodes > 1)) {
+        // Only keep the buffers of the local node, in order
+        WritablePacket *local = 0;
+        Packet *last = 0;
+        unsigned local_count = 0;
+        Packet *p = head;
+        for (unsigned i = 0; i < count; i++) {
+            Packet *next = p->next();
+            int node = buffer_node(p);
+            if (unlikely(node >= 0 && node != packet_pool.node))
+                recycle_remote(packet_pool, static_cast<WritablePacket *>(p), node);
+            else {
+                if (last)
+                    last->set_next(p);
+                else
+                    local = static_cast<WritablePacket *>(p);
+                last = p;
+                local_count++;
+            }
+            p = next;
+        }
+        if (!local_count)
+            return;
+        head = local;
+        tail = last;
+        count = local_count;
+    }
+# endif
     check_data_pool_size(packet_pool, count);
     packet_pool.pdcount += count;
     tail->set_next(packet_pool.pd);
@@ -789,7 +1026,17 @@ Packet::alloc_data(uint32_t headroom, uint32_t length, uint32_t tailroom)
           d = (unsigned char*)rte_malloc(0, n, 64);
       else
 # endif
-      d = new unsigned char[n];
+      {
+# if HAVE_HUGEPAGE_ARENA
+        if (n <= CLICK_HUGEPAGE_BUFFER_SIZE && HugepageArena::enabled())
+            d = HugepageArena::alloc_buffer();
+        if (!d)
+# endif
+            d = new unsigned char[n];
+      }
+# if HAVE_NUMA_PACKET_POOL
+      _destructor_argument = (void *)(intptr_t)(thread_numa_node + 1);
+# endif
     }
     if (!d)
 	return false;
@@ -836,6 +1083,14 @@ Packet::alloc_data(uint32_t headroom, uint32_t length, uint32_t tailroom)
 void WritablePacket::pool_transfer(int from, int to) {
     (void)from;
     (void)to;
+#if HAVE_CLICK_PACKET_POOL
+# if HAVE_MULTITHREAD
+    if (PacketPool *pp = thread_packet_pool)
+        pp->transfers++;
+# else
+    global_packet_pool.transfers++;
+# endif
+#endif
 }
 
 #if HAVE_DPDK && !CLICK_PACKET_USE_DPDK
@@ -1576,10 +1831,6 @@ cleanup_pool(PacketPool *pp, int global)
 # endif
         ::operator delete((void *) pd);
     }
-# if !HAVE_BATCH_RECYCLE
-    assert(pcount <= CLICK_PACKET_POOL_SIZE);
-    assert(pdcount <= CLICK_PACKET_DATA_POOL_SIZE);
-# endif
     assert(global || (pcount == pp->pcount && pdcount == pp->pdcount));
 #endif
 }
@@ -1589,12 +1840,148 @@ int
 Packet::max_data_pool_size()
 {
 #if HAVE_CLICK_PACKET_POOL
-	return CLICK_GLOBAL_PACKET_DATA_POOL_COUNT * CLICK_PACKET_DATA_POOL_SIZE;
+	return global_data_pool_count * data_pool_size;
 #else
 	return 0;
 #endif
 }
 
+#if HAVE_CLICK_PACKET_POOL
+unsigned Packet::pool_prewarm_size = 0;
+unsigned Packet::pool_size = CLICK_PACKET_POOL_SIZE;
+unsigned Packet::data_pool_size = CLICK_PACKET_DATA_POOL_SIZE;
+unsigned Packet::global_pool_count = CLICK_GLOBAL_PACKET_POOL_COUNT;
+unsigned Packet::global_data_pool_count = CLICK_GLOBAL_PACKET_DATA_POOL_COUNT;
+uint64_t Packet::pool_memory_cap = 0;
+
+/**
+ * @brief Change the packet pool sizes
+ *
+ * Zero values leave the corresponding setting unchanged, except for
+ * @a memory_cap where 0 removes the cap. Pools shrink lazily: a thread pool
+ * larger than its new size is given back to the global pool, or freed, the
+ * next time it receives packets.
+ */
+int
+Packet::set_pool_sizes(unsigned size, unsigned data_size, unsigned global_count,
+                       uint64_t memory_cap, ErrorHandler *errh)
+{
+# if HAVE_VECTOR_PACKET_POOL
+    (void)size;
+    (void)data_size;
+    (void)global_count;
+    (void)memory_cap;
+    return errh->error("packet pool sizes are fixed with the vector packet pool");
+# else
+    if (global_count > CLICK_GLOBAL_PACKET_POOL_MAX)
+        return errh->error("global pool count must be at most %d", CLICK_GLOBAL_PACKET_POOL_MAX);
+    if (size)
+        pool_size = size;
+    if (data_size)
+        data_pool_size = data_size;
+    if (global_count)
+        global_pool_count = global_data_pool_count = global_count;
+    pool_memory_cap = memory_cap;
+    return 0;
+# endif
+}
+
+enum { H_POOL_STATS, H_POOL_HITS, H_POOL_MISSES, H_POOL_REFILLS,
+       H_POOL_TRANSFERS, H_POOL_OUTSTANDING };
+
+static void
+add_pool_stats(PacketPool &total, const PacketPool &pp)
+{
+    total.hits += pp.hits;
+    total.misses += pp.misses;
+    total.phits += pp.phits;
+    total.pmisses += pp.pmisses;
+    total.refills += pp.refills;
+    total.transfers += pp.transfers;
+    total.outstanding += pp.outstanding;
+# if !HAVE_VECTOR_PACKET_POOL
+    total.pcount += pp.pcount;
+    total.pdcount += pp.pdcount;
+# endif
+}
+
+static void
+print_pool_stats(StringAccum &sa, const PacketPool &pp)
+{
+    sa << "hits " << pp.hits << " misses " << pp.misses
+       << " packet_hits " << pp.phits << " packet_misses " << pp.pmisses
+       << " refills " << pp.refills << " transfers " << pp.transfers
+       << " outstanding " << pp.outstanding;
+# if !HAVE_VECTOR_PACKET_POOL
+    sa << " free " << pp.pdcount << " free_packets " << pp.pcount;
+# endif
+    sa << '\n';
+}
+
+/**
+ * @brief Global read handlers giving the packet pool statistics
+ *
+ * Counters are summed over all thread pools. The packet_pool_stats handler
+ * gives one line per thread pool, then the total.
+ */
+String
+Packet::read_pool_handler(Element *, void *thunk)
+{
+    PacketPool total;
+# if !HAVE_VECTOR_PACKET_POOL
+    total.pcount = total.pdcount = 0;
+# endif
+    StringAccum sa;
+# if HAVE_MULTITHREAD
+    int i = 0;
+    for (PacketPool *pp = global_packet_pool.thread_pools; pp; pp = pp->thread_pool_next, i++) {
+        add_pool_stats(total, *pp);
+        if ((intptr_t)thunk == H_POOL_STATS) {
+            sa << "pool " << i << ": ";
+            print_pool_stats(sa, *pp);
+        }
+    }
+# else
+    add_pool_stats(total, global_packet_pool);
+# endif
+    switch ((intptr_t)thunk) {
+    case H_POOL_STATS:
+        sa << "total: ";
+        print_pool_stats(sa, total);
+# if HAVE_MULTITHREAD && !HAVE_VECTOR_PACKET_POOL
+        sa << "global: bytes " << (uint64_t)global_packet_pool.bytes << '\n';
+# endif
+        return sa.take_string();
+    case H_POOL_HITS:
+        return String(total.hits);
+    case H_POOL_MISSES:
+        return String(total.misses);
+    case H_POOL_REFILLS:
+        return String(total.refills);
+    case H_POOL_TRANSFERS:
+        return String(total.transfers);
+    case H_POOL_OUTSTANDING:
+        return String(total.outstanding);
+    default:
+        return String();
+    }
+}
+
+/**
+ * @brief Register the packet pool global handlers
+ */
+void
+Packet::static_initialize()
+{
+    Router::add_read_handler(0, "packet_pool_stats", read_pool_handler, (void *)H_POOL_STATS);
+    Router::add_read_handler(0, "packet_pool_hits", read_pool_handler, (void *)H_POOL_HITS);
+    Router::add_read_handler(0, "packet_pool_misses", read_pool_handler, (void *)H_POOL_MISSES);
+    Router::add_read_handler(0, "packet_pool_refills", read_pool_handler, (void *)H_POOL_REFILLS);
+    Router::add_read_handler(0, "packet_pool_transfers", read_pool_handler, (void *)H_POOL_TRANSFERS);
+    Router::add_read_handler(0, "packet_pool_outstanding", read_pool_handler, (void *)H_POOL_OUTSTANDING);
+}
+#endif
+
 void
 Packet::static_cleanup()
 {
@@ -1602,18 +1989,24 @@ Packet::static_cleanup()
 	# if HAVE_MULTITHREAD
 		while (PacketPool* pp = global_packet_pool.thread_pools) {
 		global_packet_pool.thread_pools = pp->thread_pool_next;
+    #  if HAVE_NUMA_PACKET_POOL
+		for (int i = 0; i < CLICK_PACKET_POOL_MAX_NUMA; i++)
+			WritablePacket::flush_remote(*pp, i);
+    #  endif
 		cleanup_pool(pp, 0);
 		delete pp;
 		}
     #  if HAVE_VECTOR_PACKET_POOL
     #  else
 		PacketPool fake_pool;
+		for (int i = 0; i < CLICK_PACKET_POOL_NODES; i++) {
 		do {
-			fake_pool.p = global_packet_pool.pbatch.extract();
-			fake_pool.pd = global_packet_pool.pdbatch.extract();
+			fake_pool.p = global_packet_pool.nodes[i].pbatch.extract();
+			fake_pool.pd = global_packet_pool.nodes[i].pdbatch.extract();
 			if (!fake_pool.p && !fake_pool.pd) break;
 			cleanup_pool(&fake_pool, 1);
 		} while(true);
+		}
 
     #  endif
 	# else
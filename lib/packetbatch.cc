@@ -27,6 +27,8 @@ CLICK_DECLS
 
 #if HAVE_BATCH
 
+unsigned PacketBatch::prefetch_distance = CLICK_PREFETCH_DISTANCE;
+
 # if HAVE_CLICK_PACKET_POOL
 
 /**
@@ -660,6 +660,7 @@ RouterThread::driver()
 #endif
 # if HAVE_CLICK_PACKET_POOL
     WritablePacket::initialize_local_packet_pool();
+    WritablePacket::pool_prewarm();
 # endif
 #if HAVE_CLICK_LOAD
     //Initialize the load update time
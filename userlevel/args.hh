@@ -4,6 +4,7 @@
 #include <click/lexer.hh>
 #include <click/driver.hh>
 #include <click/userutils.hh>
+#include <click/hugepagearena.hh>
 
 #define HELP_OPT                300
 #define VERSION_OPT             301
@@ -26,18 +27,34 @@
 #define THREADS_AFF_OPT         319
 #define DPDK_OPT                320
 #define SIMTICK_OPT             321
+#define PREFETCH_OPT            322
+#define POOL_PREWARM_OPT        323
+#define POOL_SIZE_OPT           324
+#define DATA_POOL_SIZE_OPT      325
+#define GLOBAL_POOL_COUNT_OPT   326
+#define POOL_MEMORY_CAP_OPT     327
+#define HUGEPAGE_ARENA_OPT      328
+#define HUGEPAGE_SIZE_OPT       329
 
 static const Clp_Option options[] = {
     { "allow-reconfigure", 'R', ALLOW_RECONFIG_OPT, 0, Clp_Negate },
     { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
     { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
+    { "data-pool-size", 0, DATA_POOL_SIZE_OPT, Clp_ValUnsigned, 0 },
     { "dpdk", 0, DPDK_OPT, 0, 0 },
     { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
+    { "global-pool-count", 0, GLOBAL_POOL_COUNT_OPT, Clp_ValUnsigned, 0 },
     { "handler", 'h', HANDLER_OPT, Clp_ValString, 0 },
     { "help", 0, HELP_OPT, 0, 0 },
+    { "hugepage-arena", 0, HUGEPAGE_ARENA_OPT, Clp_ValUnsigned, 0 },
+    { "hugepage-size", 0, HUGEPAGE_SIZE_OPT, Clp_ValUnsigned, 0 },
     { "output", 'o', OUTPUT_OPT, Clp_ValString, 0 },
     { "socket", 0, SOCKET_OPT, Clp_ValInt, 0 },
+    { "pool-prewarm", 0, POOL_PREWARM_OPT, Clp_ValUnsigned, 0 },
+    { "pool-size", 0, POOL_SIZE_OPT, Clp_ValUnsigned, 0 },
+    { "pool-memory-cap", 0, POOL_MEMORY_CAP_OPT, Clp_ValUnsignedLong, 0 },
     { "port", 'p', PORT_OPT, Clp_ValString, 0 },
+    { "prefetch-distance", 0, PREFETCH_OPT, Clp_ValUnsigned, 0 },
     { "quit", 'q', QUIT_OPT, 0, 0 },
     { "simtime", 0, SIMTIME_OPT, Clp_ValDouble, Clp_Optional },
     { "simulation-time", 0, SIMTIME_OPT, Clp_ValDouble, Clp_Optional },
@@ -89,6 +106,30 @@ Options:\n\
 #if HAVE_DECL_PTHREAD_SETAFFINITY_NP
     printf("\
   -a, --affinity[=N]            Pin threads to CPUs starting at #N (default 0).\n");
+#endif
+#if HAVE_BATCH
+    printf("\
+      --prefetch-distance N     Prefetch packets N packets ahead in batch\n\
+                                processing, 0 to disable (default %d).\n", CLICK_PREFETCH_DISTANCE);
+#endif
+#if HAVE_CLICK_PACKET_POOL
+    printf("\
+      --pool-prewarm N          Fill the packet pool of each thread with N\n\
+                                packets at startup (default 0).\n\
+      --pool-size N             Keep up to N free packets per thread (default %u).\n\
+      --data-pool-size N        Keep up to N free packets with data buffers per\n\
+                                thread (default %u).\n\
+      --global-pool-count N     Keep up to N batches of each kind in the global\n\
+                                packet pool (default %u).\n\
+      --pool-memory-cap BYTES   Free packets instead of keeping them in the\n\
+                                global pool above BYTES, 0 for no cap.\n",
+           Packet::pool_size, Packet::data_pool_size, Packet::global_pool_count);
+#endif
+#if HAVE_HUGEPAGE_ARENA
+    printf("\
+      --hugepage-arena MB       Allocate packet data and flow tables from an\n\
+                                arena of MB megabytes of huge pages.\n\
+      --hugepage-size KB        Size of the huge pages of the arena (default 2048).\n");
 #endif
     printf("\
   -p, --port PORT               Listen for control connections on TCP port.\n\
@@ -128,6 +169,8 @@ struct click_args_t {
   Vector<String> cs_sockets;
   bool warnings = true;
   int click_affinity_offset = -1;
+  size_t hugepage_arena = 0;
+  size_t hugepage_size = 0;
   Clp_Parser *clp;
 };
 
@@ -256,6 +299,54 @@ int parse(int argc, char** argv, click_args_t &click_args) {
 #endif
       break;
 
+     case PREFETCH_OPT:
+#if HAVE_BATCH
+      PacketBatch::prefetch_distance = clp->val.u;
+#else
+      errh->warning("Click was built without batching support, --prefetch-distance has no effect");
+#endif
+      break;
+
+     case POOL_PREWARM_OPT:
+#if HAVE_CLICK_PACKET_POOL
+      Packet::pool_prewarm_size = clp->val.u;
+#else
+      errh->warning("Click was built without the Click packet pool, --pool-prewarm has no effect");
+#endif
+      break;
+
+     case HUGEPAGE_ARENA_OPT:
+#if HAVE_HUGEPAGE_ARENA
+      click_args.hugepage_arena = (size_t) clp->val.u << 20;
+#else
+      errh->warning("Click was built without huge page arena support, --hugepage-arena has no effect");
+#endif
+      break;
+
+     case HUGEPAGE_SIZE_OPT:
+      click_args.hugepage_size = (size_t) clp->val.u << 10;
+      break;
+
+     case POOL_SIZE_OPT:
+     case DATA_POOL_SIZE_OPT:
+     case GLOBAL_POOL_COUNT_OPT:
+     case POOL_MEMORY_CAP_OPT:
+#if HAVE_CLICK_PACKET_POOL
+      if (opt != POOL_MEMORY_CAP_OPT && clp->val.u == 0) {
+          errh->error("%s must be positive", Clp_CurOptionName(clp));
+          return cleanup(clp, 1);
+      }
+      if (Packet::set_pool_sizes(opt == POOL_SIZE_OPT ? clp->val.u : 0,
+                                 opt == DATA_POOL_SIZE_OPT ? clp->val.u : 0,
+                                 opt == GLOBAL_POOL_COUNT_OPT ? clp->val.u : 0,
+                                 opt == POOL_MEMORY_CAP_OPT ? clp->val.ul : Packet::pool_memory_cap,
+                                 errh) < 0)
+          return cleanup(clp, 1);
+#else
+      errh->warning("Click was built without the Click packet pool, %s has no effect", Clp_CurOptionName(clp));
+#endif
+      break;
+
      case THREADS_AFF_OPT:
 #if HAVE_DECL_PTHREAD_SETAFFINITY_NP
       if (clp->negated)
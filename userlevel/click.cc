@@ -465,6 +465,12 @@ main(int argc, char **argv)
      }
 #endif
 
+#if HAVE_HUGEPAGE_ARENA
+  if (args.hugepage_arena
+      && HugepageArena::initialize(args.hugepage_arena, args.hugepage_size, errh) < 0)
+      return cleanup(args.clp, 1);
+#endif
+
   // provide hotconfig handler if asked
   if (args.allow_reconfigure)
       Router::add_write_handler(0, "hotconfig", hotconfig_handler, &args, Handler::f_raw | Handler::f_nonexclusive);